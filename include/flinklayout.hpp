@@ -0,0 +1,266 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, C++ register layouts                  *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file flinklayout.hpp
+ *  @brief Header-only C++17 description of the register maps of the flink functions.
+ *
+ *  Each function is described by a class template parameterized by the
+ *  number of channels of the subdevice. All accessors return byte
+ *  offsets relative to the subdevice (or a Bit, for single bit
+ *  registers) and are constexpr. If the number of channels is known at
+ *  compile time, offsets are constants:
+ *
+ *      constexpr uint32_t offset = flink::layout::Pwm<4>{}.hightime(2);
+ *
+ *  Otherwise it is passed to the constructor of the dynamic layout and
+ *  offsets cost the same arithmetic as in the C functions:
+ *
+ *      flink::layout::Pwm<> pwm(flink_subdevice_get_nofchannels(subdev));
+ *      flink_write(subdev, pwm.hightime(channel), REGISTER_WITH, &hightime);
+ *
+ *  The layouts are checked against the offsets of flinklib.h by static
+ *  assertions at the end of this file. Channels are not range-checked.
+ */
+
+#ifndef FLINKLAYOUT_HPP_
+#define FLINKLAYOUT_HPP_
+
+#include "flinklib.h"
+
+#include <cstdint>
+
+namespace flink {
+namespace layout {
+
+inline constexpr uint32_t dynamic = 0;							// number of channels known at run time only
+inline constexpr uint32_t register_width = REGISTER_WITH;			// byte
+inline constexpr uint32_t function_base = HEADER_SIZE + SUBHEADER_SIZE;	// first function specific register
+
+/**
+ * @brief Single bit of a register.
+ */
+struct Bit {
+	uint32_t offset;
+	uint8_t  bit;
+};
+
+/*******************************************************************
+ *                                                                 *
+ *  Number of channels                                             *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Number of channels known at compile time.
+ */
+template<uint32_t N = dynamic>
+class Channels {
+public:
+	constexpr Channels() { }
+	static constexpr uint32_t nof_channels() { return N; }
+};
+
+/**
+ * @brief Number of channels known at run time, usually flink_subdevice_get_nofchannels().
+ */
+template<>
+class Channels<dynamic> {
+public:
+	explicit constexpr Channels(uint32_t nof_channels) : n(nof_channels) { }
+	constexpr uint32_t nof_channels() const { return n; }
+private:
+	uint32_t n;
+};
+
+/*******************************************************************
+ *                                                                 *
+ *  Registers common to all subdevices                             *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Header and subheader of a subdevice.
+ */
+struct Header {
+	static constexpr uint32_t type()         { return 0x0; }	// function id, sub function id and version
+	static constexpr uint32_t mem_size()     { return 0x4; }
+	static constexpr uint32_t nof_channels() { return 0x8; }
+	static constexpr uint32_t unique_id()    { return 0xC; }
+	static constexpr uint32_t status()       { return STATUS_OFFSET; }
+	static constexpr uint32_t config()       { return CONFIG_OFFSET; }
+	static constexpr Bit      reset()        { return { CONFIG_OFFSET, RESET_BIT }; }
+};
+
+/*******************************************************************
+ *                                                                 *
+ *  Functions                                                      *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Info subdevice, the description holds INFO_DESC_SIZE characters.
+ */
+struct Info {
+	static constexpr uint32_t description()      { return function_base + register_width; }
+	static constexpr uint32_t description_size() { return INFO_DESC_SIZE; }
+};
+
+template<uint32_t N = dynamic>
+class AnalogInput : public Channels<N> {
+public:
+	using Channels<N>::Channels;
+	static constexpr uint32_t resolution()          { return function_base; }
+	static constexpr uint32_t value(uint32_t channel) { return function_base + ANALOG_INPUT_FIRST_VALUE_OFFSET + register_width * channel; }
+};
+
+template<uint32_t N = dynamic>
+class AnalogOutput : public Channels<N> {
+public:
+	using Channels<N>::Channels;
+	static constexpr uint32_t resolution()          { return function_base; }
+	static constexpr uint32_t value(uint32_t channel) { return function_base + ANALOG_OUTPUT_FIRST_VALUE_OFFSET + register_width * channel; }
+};
+
+template<uint32_t N = dynamic>
+class Counter : public Channels<N> {
+public:
+	using Channels<N>::Channels;
+	static constexpr uint32_t count(uint32_t channel) { return function_base + register_width * channel; }
+};
+
+/**
+ * @brief GPIO subdevice, directions and values hold one bit per channel.
+ */
+template<uint32_t N = dynamic>
+class Gpio : public Channels<N> {
+public:
+	using Channels<N>::Channels;
+	static constexpr uint32_t bits = register_width * 8;	// channels per direction or value register
+
+	static constexpr uint32_t base_clock() { return function_base; }
+	constexpr uint32_t words() const { return (this->nof_channels() - 1) / bits + 1; }
+	static constexpr Bit direction(uint32_t channel) {
+		return { function_base + register_width + channel / bits * register_width, static_cast<uint8_t>(channel % bits) };
+	}
+	constexpr Bit value(uint32_t channel) const {
+		return { function_base + register_width * (1 + words() + channel / bits), static_cast<uint8_t>(channel % bits) };
+	}
+	constexpr uint32_t debounce(uint32_t channel) const { return function_base + register_width * (1 + 2 * words() + channel); }
+};
+
+template<uint32_t N = dynamic>
+class Pwm : public Channels<N> {
+public:
+	using Channels<N>::Channels;
+	static constexpr uint32_t base_clock()            { return function_base + PWM_BASECLK_OFFSET; }
+	static constexpr uint32_t period(uint32_t channel) { return function_base + PWM_FIRSTPWM_OFFSET + register_width * channel; }
+	constexpr uint32_t hightime(uint32_t channel) const { return period(this->nof_channels() + channel); }
+};
+
+template<uint32_t N = dynamic>
+class Ppwa : public Channels<N> {
+public:
+	using Channels<N>::Channels;
+	static constexpr uint32_t base_clock()            { return function_base + PPWA_BASECLK_OFFSET; }
+	static constexpr uint32_t period(uint32_t channel) { return function_base + PPWA_FIRSTPPWA_OFFSET + register_width * channel; }
+	constexpr uint32_t hightime(uint32_t channel) const { return period(this->nof_channels() + channel); }
+};
+
+/**
+ * @brief Watchdog subdevice, one channel.
+ */
+struct Watchdog {
+	static constexpr uint32_t base_clock() { return function_base; }
+	static constexpr uint32_t counter()    { return function_base + WD_FIRST_COUNTER_OFFSET; }
+	static constexpr Bit      status()     { return { STATUS_OFFSET, 0 }; }
+	static constexpr Bit      arm()        { return { CONFIG_OFFSET, 0 }; }
+};
+
+/**
+ * @brief Reflective sensor subdevice, values followed by the upper and lower levels of the interrupts.
+ */
+template<uint32_t N = dynamic>
+class ReflectiveSensor : public Channels<N> {
+public:
+	using Channels<N>::Channels;
+	static constexpr uint32_t resolution()           { return function_base; }
+	static constexpr uint32_t value(uint32_t channel) { return function_base + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + register_width * channel; }
+	constexpr uint32_t upper_level(uint32_t channel) const { return value(this->nof_channels() + channel); }
+	constexpr uint32_t lower_level(uint32_t channel) const { return value(2 * this->nof_channels() + channel); }
+};
+
+/**
+ * @brief Stepper motor subdevice, one block of registers per kind, one register per channel in each block.
+ */
+template<uint32_t N = dynamic>
+class StepperMotor : public Channels<N> {
+public:
+	using Channels<N>::Channels;
+
+	enum Register : uint32_t {
+		local_conf = 0,
+		set_atomic,
+		reset_atomic,
+		prescaler_start,
+		prescaler_top,
+		acceleration,
+		steps_to_do,
+		steps_done,
+		nof_registers
+	};
+
+	static constexpr uint32_t base_clock() { return function_base; }
+	static constexpr Bit global_step_reset() { return { CONFIG_OFFSET, GLOBAL_STEP_RESET }; }
+	constexpr uint32_t reg(uint32_t channel, Register r) const {
+		return function_base + STEPPER_MOTOR_FIRST_CONF_OFFSET + register_width * (this->nof_channels() * r + channel);
+	}
+};
+
+/**
+ * @brief Interrupt multiplexer, one table entry per interrupt.
+ */
+template<uint32_t N = dynamic>
+class IrqMultiplexer : public Channels<N> {
+public:
+	using Channels<N>::Channels;
+	static constexpr uint32_t entry(uint32_t irq) { return function_base + register_width * irq; }
+};
+
+/*******************************************************************
+ *                                                                 *
+ *  Checks against flinklib.h                                      *
+ *                                                                 *
+ *******************************************************************/
+
+static_assert(Header::status() == STATUS_OFFSET && Header::config() == CONFIG_OFFSET, "header");
+static_assert(Header::unique_id() + register_width == HEADER_SIZE, "header size");
+static_assert(Info::description() == HEADER_SIZE + SUBHEADER_SIZE + REGISTER_WITH, "info description");
+static_assert(AnalogInput<4>{}.value(0) == HEADER_SIZE + SUBHEADER_SIZE + ANALOG_INPUT_FIRST_VALUE_OFFSET, "analog input");
+static_assert(AnalogOutput<4>{}.value(3) == HEADER_SIZE + SUBHEADER_SIZE + ANALOG_OUTPUT_FIRST_VALUE_OFFSET + 3 * REGISTER_WITH, "analog output");
+static_assert(Counter<4>{}.count(1) == HEADER_SIZE + SUBHEADER_SIZE + REGISTER_WITH, "counter");
+static_assert(Gpio<32>{}.words() == 1 && Gpio<33>{}.words() == 2, "gpio words");
+static_assert(Gpio<32>{}.value(31).offset == HEADER_SIZE + SUBHEADER_SIZE + 2 * REGISTER_WITH && Gpio<32>{}.value(31).bit == 31, "gpio value");
+static_assert(Gpio<64>{}.value(32).offset == HEADER_SIZE + SUBHEADER_SIZE + 4 * REGISTER_WITH && Gpio<64>{}.value(32).bit == 0, "gpio value");
+static_assert(Gpio<32>{}.debounce(0) == HEADER_SIZE + SUBHEADER_SIZE + 3 * REGISTER_WITH, "gpio debounce");
+static_assert(Pwm<4>{}.hightime(0) == HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET + 4 * REGISTER_WITH, "pwm hightime");
+static_assert(Pwm<>(4).hightime(1) == Pwm<4>{}.hightime(1), "dynamic layout");
+static_assert(Ppwa<4>{}.hightime(3) == HEADER_SIZE + SUBHEADER_SIZE + PPWA_FIRSTPPWA_OFFSET + 7 * REGISTER_WITH, "ppwa hightime");
+static_assert(Watchdog::counter() == HEADER_SIZE + SUBHEADER_SIZE + REGISTER_WITH, "watchdog counter");
+static_assert(ReflectiveSensor<4>{}.lower_level(0) == HEADER_SIZE + SUBHEADER_SIZE + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + 8 * REGISTER_WITH, "sensor lower level");
+static_assert(StepperMotor<4>{}.reg(1, StepperMotor<4>::steps_done) == HEADER_SIZE + SUBHEADER_SIZE + STEPPER_MOTOR_FIRST_CONF_OFFSET + 29 * REGISTER_WITH, "stepper motor");
+
+} // namespace layout
+} // namespace flink
+
+#endif // FLINKLAYOUT_HPP_
@@ -43,6 +43,241 @@ ssize_t flink_read(flink_subdev* subdev, uint32_t offset, uint8_t size, void* rd
 ssize_t flink_write(flink_subdev* subdev, uint32_t offset, uint8_t size, void* wdata);
 int     flink_read_bit(flink_subdev* subdev, uint32_t offset, uint8_t bit, void* rdata);
 int     flink_write_bit(flink_subdev* subdev, uint32_t offset, uint8_t bit, void* wdata);
+ssize_t flink_read_block(flink_subdev* subdev, uint32_t offset, uint32_t size, void* rdata);
+ssize_t flink_write_block(flink_subdev* subdev, uint32_t offset, uint32_t size, const void* wdata);
+uint64_t flink_get_nof_syscalls(flink_dev* dev);
+int     flink_sim_get_time(flink_dev* dev, uint64_t* time_ns);
+int     flink_sim_get_nof_bytes(flink_dev* dev, uint64_t* nof_bytes);
+
+// Errors
+#define FLINK_NOERROR		0x2000					// No error
+#define FLINK_EUNKNOWN		(FLINK_NOERROR + 1)		// Unknown error
+#define FLINK_ENOTSUPPORTED	(FLINK_NOERROR + 2)		// Not supported
+#define FLINK_EINVALDEV		(FLINK_NOERROR + 3)		// Invalid device
+#define FLINK_EINVALSUBDEV	(FLINK_NOERROR + 4)		// Invalid subdevice
+#define FLINK_EINVALCHAN	(FLINK_NOERROR + 5)		// Invalid channel
+#define FLINK_ENULLPTR		(FLINK_NOERROR + 6)		// Null ptr as argument
+#define FLINK_UNKNOWNIOCTL	(FLINK_NOERROR + 7)		// Unknown ioctl command
+#define FLINK_WRONGSUBDEVT	(FLINK_NOERROR + 8)		// Wrong subdevice type
+#define FLINK_EQUEUEFULL	(FLINK_NOERROR + 9)		// Queue full
+#define FLINK_ETIMEOUT		(FLINK_NOERROR + 10)	// Timeout
+#define FLINK_EINVALARG		(FLINK_NOERROR + 11)	// Invalid argument
+#define FLINK_EBUSY			(FLINK_NOERROR + 12)	// Busy
+#define FLINK_ENOTPERMITTED	(FLINK_NOERROR + 13)	// Not permitted
+#define FLINK_ENOTAVAIL		(FLINK_NOERROR + 14)	// Not available
+#define FLINK_ENOSPACE		(FLINK_NOERROR + 15)	// No space left
+#define FLINK_ESHUTDOWN		(FLINK_NOERROR + 16)	// Shut down
+
+const char* flink_strerror(int e);
+void        flink_perror(const char* p);
+int         flink_get_errno(void);
+
+// Statistics
+typedef enum _flink_op {
+	FLINK_OP_DEVICE_INFO,		/// Reading the number and headers of the subdevices
+	FLINK_OP_SELECT,
+	FLINK_OP_READ,
+	FLINK_OP_WRITE,
+	FLINK_OP_READ_BIT,
+	FLINK_OP_WRITE_BIT,
+	FLINK_OP_READ_BLOCK,
+	FLINK_OP_WRITE_BLOCK,
+	FLINK_OP_IRQ,				/// Registering and unregistering interrupts
+	FLINK_OP_OTHER,
+	FLINK_NOF_OPS
+} flink_op;
+
+#define FLINK_STATS_BUCKETS	32	// latency histogram buckets
+
+typedef struct _flink_op_stats {
+	uint64_t count;
+	uint64_t errors;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t histogram[FLINK_STATS_BUCKETS];	/// Bucket i counts latencies of 2^i to 2^(i+1)-1 ns, the last bucket all longer ones
+} flink_op_stats;
+
+int         flink_stats_snapshot(flink_dev* dev, flink_op_stats* ops, flink_op_stats* subdevices);
+int         flink_stats_reset(flink_dev* dev);
+const char* flink_op2str(flink_op op);
+
+// Trace
+#define FLINK_TRACE_OFF			0		// nothing is recorded
+#define FLINK_TRACE_ERRORS		1		// errors and failed operations are recorded (default)
+#define FLINK_TRACE_ALL			2		// all operations are recorded
+#define FLINK_TRACE_LEVEL_MASK	0xFF
+#define FLINK_TRACE_STDERR		0x100	// errors are also printed to stderr when they occur
+#define FLINK_TRACE_OP_ERROR	0xFFFF	// operation of entries recorded where an error is raised
+#define FLINK_TRACE_OP_DEBUG	0xFFFE	// operation of debug messages of a library built with DEBUG
+
+typedef struct _flink_trace_entry {
+	uint64_t time_ns;			/// CLOCK_MONOTONIC
+	uint64_t site;				/// Code address where an error was raised, format string of a debug message, 0 for operations
+	uint32_t offset;			/// Register offset of the operation
+	int32_t  error;				/// errno or flink error, 0 if the operation succeeded
+	uint32_t tid;				/// Thread id of the recording thread
+	uint16_t op;				/// flink_op or FLINK_TRACE_OP_ERROR
+	int16_t  subdev;			/// Subdevice id, -1 if none
+} flink_trace_entry;
+
+void   flink_trace_set_level(int level);
+int    flink_trace_get_level(void);
+size_t flink_trace_read(flink_trace_entry* entries, size_t max);
+int    flink_trace_format(const flink_trace_entry* entry, char* buf, size_t size);
+int    flink_trace_dump(int fd);
+
+// Chrome trace
+int flink_chrome_trace_start(uint32_t max_events);
+int flink_chrome_trace_stop(const char* file_name);
+
+// Record
+#define FLINK_RECORD_MAGIC		"FLINKREC"
+#define FLINK_RECORD_VERSION	1
+#define FLINK_RECORD_OP_DEVICE	0xFF	// entry announcing a device, data holds the function id of each subdevice
+
+typedef struct _flink_record_header {
+	char     magic[8];			/// FLINK_RECORD_MAGIC
+	uint32_t version;			/// FLINK_RECORD_VERSION
+	uint32_t reserved;
+} flink_record_header;
+
+typedef struct _flink_record_entry {
+	uint64_t time_ns;			/// Start of the access since the start of the recording
+	uint32_t offset;			/// Register offset
+	uint32_t size;				/// Nof data bytes following the entry
+	uint16_t dev;				/// Index of the device in the order devices were announced
+	uint8_t  op;				/// flink_op or FLINK_RECORD_OP_DEVICE
+	uint8_t  subdev;			/// Subdevice id, nof subdevices for FLINK_RECORD_OP_DEVICE
+	uint8_t  bit;				/// Bit number of bit accesses
+	uint8_t  reserved[3];
+} flink_record_entry;
+
+int flink_record_start(const char* file_name);
+int flink_record_stop(void);
+
+// Configuration
+int flink_config_apply(flink_dev* dev, const char* file_name, uint32_t* error_line);
+
+// Snapshot
+#define FLINK_SNAPSHOT_MAGIC	"FLINKSNP"
+#define FLINK_SNAPSHOT_VERSION	1
+
+int flink_snapshot_save(flink_dev* dev, void** snapshot, size_t* size);
+int flink_snapshot_restore(flink_dev* dev, const void* snapshot, size_t size);
+
+// Remote devices served by flinkd, opened as "unix:<socket>"
+#define FLINK_REMOTE_PREFIX		"unix:"
+#define FLINK_REMOTE_MAX_SIZE	0x10000	// data bytes of a request or response at most
+
+typedef enum {
+	FLINK_REMOTE_NOF_SUBDEVICES,
+	FLINK_REMOTE_SUBDEVICE_INFO,
+	FLINK_REMOTE_READ,
+	FLINK_REMOTE_WRITE,
+	FLINK_REMOTE_READ_BIT,
+	FLINK_REMOTE_WRITE_BIT,
+	FLINK_REMOTE_READ_BLOCK,
+	FLINK_REMOTE_WRITE_BLOCK,
+	FLINK_NOF_REMOTE_CMDS
+} flink_remote_cmd;
+
+typedef struct _flink_remote_request {
+	uint32_t id;				/// Echoed in the response, responses are sent in the order of the requests
+	uint8_t  cmd;				/// flink_remote_cmd
+	uint8_t  subdev;			/// Subdevice id
+	uint8_t  bit;				/// Bit number of bit accesses
+	uint8_t  value;				/// Bit value of FLINK_REMOTE_WRITE_BIT
+	uint32_t offset;			/// Register offset
+	uint32_t size;				/// Nof bytes to read, nof data bytes following the request for writes
+} flink_remote_request;
+
+typedef struct _flink_remote_response {
+	uint32_t id;				/// Id of the request
+	int32_t  result;			/// Return value of the operation, -errno in case of failure
+	uint32_t size;				/// Nof data bytes following the response
+} flink_remote_response;
+
+typedef struct _flink_remote_subdev_info {
+	uint16_t function_id;
+	uint8_t  sub_function_id;
+	uint8_t  function_version;
+	uint32_t base_addr;
+	uint32_t mem_size;
+	uint32_t nof_channels;
+	uint32_t unique_id;
+} flink_remote_subdev_info;		/// Data of the response to FLINK_REMOTE_SUBDEVICE_INFO
+
+// Devices behind spidev, opened as "spi:<spidev device file or registered endpoint>"
+#define FLINK_SPI_PREFIX		"spi:"
+#define FLINK_SPI_WRITE			0x80000000	// write bit of the command word, the other bits hold the nof data bytes
+#define FLINK_SPI_HEADER_SIZE	8			// command word and byte address, little endian
+#define FLINK_SPI_TURNAROUND	4			// dummy bytes between the header and the data of a read
+
+typedef struct _flink_spi_frame {
+	const uint8_t* tx;			/// Bytes to send
+	uint8_t*       rx;			/// Bytes received, NULL if not needed
+	uint32_t       len;			/// Nof bytes
+} flink_spi_frame;				/// Transfer with chip select asserted
+
+typedef struct _flink_spi_endpoint {
+	int    (*message)(void* data, const flink_spi_frame* frames, uint32_t nof_frames);	/// Returns 0 on success, -1 with errno set in case of failure
+	void*    data;				/// Passed to message()
+	uint32_t max_message;		/// Nof bytes of all frames of a message at most, 0 for the default
+	uint32_t max_burst;			/// Nof data bytes of a frame at most, 0 for no limit
+} flink_spi_endpoint;
+
+int flink_spi_register_endpoint(const char* name, const flink_spi_endpoint* endpoint);
+
+// Asynchronous requests, executed by an I/O thread per queue
+#define FLINK_ASYNC_CONTROL			0	// priority of the control path, overtakes queued bulk requests
+#define FLINK_ASYNC_BULK			1	// priority of logging and diagnostics
+#define FLINK_ASYNC_NOF_PRIORITIES	2
+
+typedef struct _flink_async         flink_async;
+typedef struct _flink_async_request flink_async_request;
+typedef void (*flink_async_callback)(flink_async_request* request, void* arg);
+
+flink_async*         flink_async_create(flink_dev* dev);
+int                  flink_async_destroy(flink_async* async);
+int                  flink_async_get_fd(flink_async* async);
+flink_async_request* flink_async_read(flink_async* async, flink_subdev* subdev, uint32_t offset, uint32_t size, void* rdata,
+                                      uint8_t priority, flink_async_callback callback, void* arg);
+flink_async_request* flink_async_write(flink_async* async, flink_subdev* subdev, uint32_t offset, uint32_t size, const void* wdata,
+                                       uint8_t priority, flink_async_callback callback, void* arg);
+flink_async_request* flink_async_read_bit(flink_async* async, flink_subdev* subdev, uint32_t offset, uint8_t bit, uint8_t* rdata,
+                                          uint8_t priority, flink_async_callback callback, void* arg);
+flink_async_request* flink_async_write_bit(flink_async* async, flink_subdev* subdev, uint32_t offset, uint8_t bit, uint8_t value,
+                                           uint8_t priority, flink_async_callback callback, void* arg);
+flink_async_request* flink_async_get_completed(flink_async* async);
+int                  flink_async_done(flink_async_request* request);
+ssize_t              flink_async_wait(flink_async_request* request);
+ssize_t              flink_async_get_result(flink_async_request* request);
+int                  flink_async_release(flink_async_request* request);
+
+// Devices exposed by Linux UIO, opened as "uio:<UIO device file or file holding the register space>"
+#define FLINK_UIO_PREFIX		"uio:"
+
+// Process image shared between processes
+typedef struct _flink_image flink_image;
+
+typedef struct _flink_image_sample {
+	uint64_t seq;				/// Odd while the sample is written, 2 * (index + 1) when complete
+	uint64_t time_ns;			/// Time of publishing (CLOCK_MONOTONIC)
+	uint32_t values[];			/// nof_values values
+} flink_image_sample;
+
+flink_image* flink_image_create(const char* name, uint32_t nof_values, uint32_t history);
+int          flink_image_publish(flink_image* image, const uint32_t* values);
+int          flink_image_publish_registers(flink_image* image, flink_subdev* subdev, uint32_t offset);
+flink_image* flink_image_open(const char* name);
+int          flink_image_close(flink_image* image);
+uint32_t     flink_image_get_nof_values(flink_image* image);
+uint32_t     flink_image_get_history(flink_image* image);
+uint64_t     flink_image_get_head(flink_image* image);
+const flink_image_sample* flink_image_get_sample(flink_image* image, uint64_t index);
+int          flink_image_sample_valid(flink_image* image, const flink_image_sample* sample, uint64_t index);
+int          flink_image_read(flink_image* image, uint64_t index, uint32_t* values, uint64_t* time_ns);
+
 
 
 // ############ Subdevice operations ############
@@ -88,6 +323,7 @@ const char*   flink_subdevice_id2str(uint8_t subdev_id);
 
 // Info
 int flink_info_get_description(flink_subdev* subdev, char* value);
+int flink_get_fingerprint(flink_dev* dev, uint64_t* fingerprint);
 
 // Analog input
 int flink_analog_in_get_resolution(flink_subdev* subdev, uint32_t* resolution);
@@ -146,6 +382,58 @@ int flink_stepperMotor_get_steps_to_do(flink_subdev* subdev, uint32_t channel, u
 int flink_stepperMotor_get_steps_have_done(flink_subdev* subdev, uint32_t channel, uint32_t* steps);
 int flink_steppermotor_global_step_reset(flink_subdev* subdev);
 
+// Stepper Motor move queue
+#define FLINK_STEPPER_QUEUE_SIZE	64	// moves, at least two S-curve profiles
+#define FLINK_STEPPER_NO_IRQ		-1
+
+typedef struct _flink_stepper_queue flink_stepper_queue;
+
+typedef struct _flink_stepper_move {
+	uint32_t config;			/// Local config register (direction, step and phase mode), start and mode bits are managed by the queue
+	uint32_t prescaler_start;	/// Start speed prescaler
+	uint32_t prescaler_top;		/// Top speed prescaler
+	uint32_t acceleration;		/// Acceleration between start and top speed
+	uint32_t steps;				/// Number of steps to do
+} flink_stepper_move;
+
+flink_stepper_queue* flink_stepperMotor_queue_create(flink_subdev* subdev, uint32_t channel, int irq);
+int     flink_stepperMotor_queue_destroy(flink_stepper_queue* queue);
+int     flink_stepperMotor_queue_push(flink_stepper_queue* queue, const flink_stepper_move* move, uint64_t* move_id);
+int     flink_stepperMotor_queue_wait(flink_stepper_queue* queue, uint64_t move_id, int timeout_ms);
+int     flink_stepperMotor_queue_get_position(flink_stepper_queue* queue, int64_t* position);
+
+typedef struct _flink_stepper_latency {
+	uint64_t count;				/// Number of measured transitions between two queued moves
+	uint64_t min_ns;			/// Shortest time from completion of a move to start of the next one
+	uint64_t max_ns;			/// Longest time from completion of a move to start of the next one
+	uint64_t total_ns;			/// Sum of all measured times
+} flink_stepper_latency;
+
+int flink_stepperMotor_queue_get_latency(flink_stepper_queue* queue, flink_stepper_latency* latency);
+
+// Stepper Motor S-curve profiles
+#define FLINK_STEPPER_PHASE_SEGMENTS	4	// segments per jerk or acceleration phase
+#define FLINK_STEPPER_PROFILE_SEGMENTS	(2 * 3 * FLINK_STEPPER_PHASE_SEGMENTS + 1)	// maximum segments of a profile
+
+typedef struct _flink_stepper_profile_params {
+	uint32_t base_clk;			/// Base clock of the subdevice in Hz
+	uint32_t start_speed;		/// Start and stop speed [steps/s]
+	uint32_t top_speed;			/// Top speed [steps/s]
+	uint32_t acceleration;		/// Maximum acceleration [steps/s^2]
+	uint32_t jerk;				/// Maximum jerk [steps/s^3]
+	uint32_t steps;				/// Length of the move [steps]
+} flink_stepper_profile_params;
+
+typedef struct _flink_stepper_profile {
+	flink_stepper_profile_params params;
+	uint32_t            nof_segments;
+	flink_stepper_move segments[FLINK_STEPPER_PROFILE_SEGMENTS];	/// Prescaler and acceleration segments, config is unused
+} flink_stepper_profile;
+
+int flink_stepperMotor_profile_get(const flink_stepper_profile_params* params, flink_stepper_profile* profile);
+int flink_stepperMotor_profile_cached(const flink_stepper_profile_params* params);
+int flink_stepperMotor_queue_push_profile(flink_stepper_queue* queue, const flink_stepper_profile* profile, uint32_t config, uint64_t* move_id);
+
 // Reflective sensor
 int flink_reflectivesensor_get_resolution(flink_subdev* subdev, uint32_t* resolution);
 int flink_reflectivesensor_get_value(flink_subdev* subdev, uint32_t channel, uint32_t* value);
@@ -153,6 +441,10 @@ int flink_reflectivesensor_set_upper_level_int(flink_subdev* subdev, uint32_t ch
 int flink_reflectivesensor_get_upper_level_int(flink_subdev* subdev, uint32_t channel, uint32_t* value);
 int flink_reflectivesensor_set_lower_level_int(flink_subdev* subdev, uint32_t channel, uint32_t value);
 int flink_reflectivesensor_get_lower_level_int(flink_subdev* subdev, uint32_t channel, uint32_t* value);
+int flink_reflectivesensor_get_values(flink_subdev* subdev, uint32_t* values);
+int flink_reflectivesensor_set_levels(flink_subdev* subdev, const uint32_t* upper, const uint32_t* lower);
+int flink_reflectivesensor_get_levels(flink_subdev* subdev, uint32_t* upper, uint32_t* lower);
+int flink_reflectivesensor_calibrate(flink_subdev* subdev, uint32_t nof_samples, uint32_t interval_us, uint32_t hysteresis, uint32_t* upper, uint32_t* lower);
 
 // Interrupt
 int flink_register_irq(flink_dev *dev, uint32_t irq_number);
@@ -160,6 +452,42 @@ int flink_unregister_irq(flink_dev *dev, uint32_t irq_number);
 int flink_get_signal_offset(flink_dev *dev, uint32_t *offset);
 int flink_set_irq_multiplex(flink_subdev *subdev, uint32_t irq, uint32_t flink_irq);
 int flink_get_irq_multiplex(flink_subdev *subdev, uint32_t irq, uint32_t *flink_irq);
+int flink_set_irq_multiplex_table(flink_subdev *subdev, const uint32_t *table);
+int flink_get_irq_multiplex_table(flink_subdev *subdev, uint32_t *table);
+
+// Custom subdevices, described by drivers with a register map
+#define FLINK_REG_READ		0x1			// register can be read
+#define FLINK_REG_WRITE		0x2			// register can be written
+#define FLINK_REG_RW		(FLINK_REG_READ | FLINK_REG_WRITE)
+#define FLINK_REG_BITS		0x4			// one bit per channel, 32 channels per register
+#define FLINK_REG_NEXT		0xFFFFFFFF	// offset of a register following the previous one
+
+typedef struct _flink_register {
+	const char* name;
+	uint32_t    offset;		/// Byte offset of the register of channel 0 relative to the function registers, or FLINK_REG_NEXT
+	uint32_t    stride;		/// Nof bytes between the registers of two channels, 0 for a register common to all channels
+	uint32_t    mode;		/// FLINK_REG_READ, FLINK_REG_WRITE and FLINK_REG_BITS
+} flink_register;
+
+typedef struct _flink_driver {
+	const char*           name;
+	uint16_t              function_id;
+	uint8_t               sub_function_id;
+	uint32_t              nof_registers;
+	const flink_register* registers;	/// Register map, must remain valid while the driver is registered
+} flink_driver;
+
+typedef struct _flink_custom_plan flink_custom_plan;
+
+int      flink_custom_register_driver(const flink_driver* driver);
+int      flink_custom_unregister_driver(uint16_t function_id, uint8_t sub_function_id);
+int      flink_custom_get_register(flink_subdev* subdev, const char* name);
+int      flink_custom_read(flink_subdev* subdev, int reg, uint32_t channel, uint32_t* value);
+int      flink_custom_write(flink_subdev* subdev, int reg, uint32_t channel, uint32_t value);
+flink_custom_plan* flink_custom_plan_create(flink_subdev* subdev, const int* regs, uint32_t nof_regs);
+uint32_t flink_custom_plan_get_nof_values(flink_custom_plan* plan);
+int      flink_custom_plan_read(flink_custom_plan* plan, uint32_t* values);
+int      flink_custom_plan_destroy(flink_custom_plan* plan);
 
 // ############ Exit states ############
 #define EXIT_SUCCESS	0
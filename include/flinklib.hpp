@@ -0,0 +1,464 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, C++ header file                       *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file flinklib.hpp
+ *  @brief Header-only C++20 layer with coroutines for register accesses.
+ *
+ *  Device owns an open flink device, Subdevice is a handle of one of its
+ *  subdevices. The register operations of a Subdevice are awaitables:
+ *
+ *      flink::Task<> blink(flink::Subdevice gpio) {
+ *          uint32_t value = co_await gpio.read(offset);
+ *          co_await gpio.write(offset, value ^ 1);
+ *      }
+ *
+ *      flink::Executor executor;
+ *      executor.spawn(blink(gpio));
+ *      executor.run();
+ *
+ *  An operation is submitted to the executor when it is created and
+ *  completes in the next transaction of the executor. A transaction is
+ *  run when all coroutines are suspended, it executes all operations
+ *  submitted since the last one: per subdevice, consecutive reads or
+ *  writes of contiguous registers are merged into block transfers, the
+ *  transfers are executed in the order of submission. A register accessed
+ *  twice ends a block transfer, so every access reaches the device.
+ *  Operations created
+ *  before awaiting the first of them are thus executed together:
+ *
+ *      auto a = pwm.read(period0), b = pwm.read(period1);	// one transfer
+ *      uint32_t sum = co_await a + co_await b;
+ *
+ *  Outside of Executor::run() operations are executed immediately.
+ *  Failed operations throw flink::Error.
+ */
+
+#ifndef FLINKLIB_HPP_
+#define FLINKLIB_HPP_
+
+#include "flinklib.h"
+
+#include <algorithm>
+#include <coroutine>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace flink {
+
+/**
+ * @brief Failed operation, with the flink error code.
+ */
+class Error : public std::runtime_error {
+public:
+	Error(const std::string& what, int code) : std::runtime_error(what + ": " + flink_strerror(code)), code_(code) { }
+	int code() const noexcept { return code_; }
+
+private:
+	int code_;
+};
+
+class Executor;
+class Subdevice;
+
+namespace detail {
+
+[[noreturn]] inline void fail(const char* what) {
+	throw Error(what, flink_get_errno());
+}
+
+enum class OpType : uint8_t { read, write, read_bit, write_bit };
+
+/**
+ * @brief Register operation, submitted to the executor on construction.
+ * Not movable, the executor refers to it until it completes.
+ */
+class Operation {
+public:
+	Operation(const Operation&) = delete;
+	Operation& operator=(const Operation&) = delete;
+	inline ~Operation();
+
+	bool await_ready() const noexcept { return executor_ == nullptr; }
+	void await_suspend(std::coroutine_handle<> handle) noexcept { handle_ = handle; }
+
+protected:
+	inline Operation(flink_subdev* subdev, OpType type, uint32_t offset, uint32_t value, uint8_t bit);
+
+	void check() const {
+		if(error_) throw Error(type_ == OpType::read || type_ == OpType::read_bit ? "flink read" : "flink write", error_);
+	}
+
+	friend class flink::Executor;
+	flink_subdev*           subdev_;
+	OpType                  type_;
+	uint8_t                 bit_;
+	uint32_t                offset_;
+	uint32_t                value_;
+	int                     error_ = 0;
+	Executor*               executor_ = nullptr;	/// Set while the operation is pending
+	std::coroutine_handle<> handle_;				/// Coroutine awaiting the operation
+};
+
+template<typename T> class Promise;
+
+} // namespace detail
+
+/**
+ * @brief Awaitable register operation, returning T.
+ */
+template<typename T>
+class Op : public detail::Operation {
+public:
+	T await_resume() const {
+		check();
+		if constexpr(std::is_same_v<T, bool>) return value_ != 0;
+		else if constexpr(!std::is_void_v<T>) return value_;
+	}
+
+private:
+	friend class Subdevice;
+	using detail::Operation::Operation;
+};
+
+/**
+ * @brief Lazily started coroutine, awaitable by other coroutines or spawned on an executor.
+ */
+template<typename T = void>
+class Task {
+public:
+	using promise_type = detail::Promise<T>;
+
+	Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) { }
+	Task& operator=(Task&& other) noexcept {
+		if(this != &other) {
+			if(handle_) handle_.destroy();
+			handle_ = std::exchange(other.handle_, nullptr);
+		}
+		return *this;
+	}
+	~Task() { if(handle_) handle_.destroy(); }
+
+	bool done() const noexcept { return !handle_ || handle_.done(); }
+
+	bool await_ready() const noexcept { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+		handle_.promise().continuation = awaiting;
+		return handle_;
+	}
+	T await_resume() { return handle_.promise().result(); }
+
+private:
+	friend class detail::Promise<T>;
+	friend class Executor;
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) { }
+	std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+class PromiseBase {
+public:
+	struct FinalAwaiter {
+		bool await_ready() const noexcept { return false; }
+		template<typename P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept { return handle.promise().continuation; }
+		void await_resume() const noexcept { }
+	};
+
+	std::suspend_always initial_suspend() const noexcept { return { }; }
+	FinalAwaiter final_suspend() const noexcept { return { }; }
+	void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+	std::coroutine_handle<> continuation = std::noop_coroutine();
+	std::exception_ptr exception;
+
+protected:
+	void rethrow() const { if(exception) std::rethrow_exception(exception); }
+};
+
+template<typename T>
+class Promise : public PromiseBase {
+public:
+	Task<T> get_return_object() { return Task<T>(std::coroutine_handle<Promise>::from_promise(*this)); }
+	void return_value(T value) { value_ = std::move(value); }
+	T result() { rethrow(); return std::move(*value_); }
+
+private:
+	std::optional<T> value_;
+};
+
+template<>
+class Promise<void> : public PromiseBase {
+public:
+	Task<void> get_return_object() { return Task<void>(std::coroutine_handle<Promise>::from_promise(*this)); }
+	void return_void() const noexcept { }
+	void result() const { rethrow(); }
+};
+
+} // namespace detail
+
+/**
+ * @brief Runs coroutines and executes their register operations in transactions.
+ */
+class Executor {
+public:
+	static constexpr uint32_t max_transfer = 0x400;	///< Bytes of a merged transfer at most
+
+	Executor() = default;
+	Executor(const Executor&) = delete;
+	Executor& operator=(const Executor&) = delete;
+
+	/**
+	 * @brief Starts a coroutine with the next call of run().
+	 */
+	void spawn(Task<> task) {
+		ready_.push_back(task.handle_);
+		tasks_.push_back(std::move(task));
+	}
+
+	/**
+	 * @brief Runs the spawned coroutines until all of them completed.
+	 * The exception of a failed coroutine is rethrown after all completed.
+	 */
+	void run() {
+		Executor* outer = std::exchange(current_, this);
+		try {
+			while(true) {
+				while(!ready_.empty()) {
+					std::coroutine_handle<> handle = ready_.front();
+					ready_.pop_front();
+					handle.resume();
+				}
+				if(pending_.empty()) break;
+				transaction();
+			}
+		}
+		catch(...) {
+			current_ = outer;
+			throw;
+		}
+		current_ = outer;
+
+		std::vector<Task<>> tasks = std::move(tasks_);
+		tasks_.clear();
+		for(Task<>& task : tasks) task.await_resume();
+	}
+
+	uint64_t nof_transactions() const noexcept { return nof_transactions_; }
+	uint64_t nof_transfers() const noexcept { return nof_transfers_; }
+
+	/**
+	 * @brief Executor running on this thread, nullptr outside of run().
+	 */
+	static Executor* current() noexcept { return current_; }
+
+private:
+	friend class detail::Operation;
+	using Ops = std::vector<detail::Operation*>;
+
+	void submit(detail::Operation* op) { pending_.push_back(op); }
+	void cancel(detail::Operation* op) { pending_.erase(std::find(pending_.begin(), pending_.end(), op)); }
+
+	/**
+	 * @brief Executes all pending operations and makes their coroutines ready.
+	 */
+	void transaction() {
+		Ops ops = std::move(pending_);
+		pending_.clear();
+		nof_transactions_++;
+
+		// Group by subdevice, keeping the order within a subdevice
+		std::stable_sort(ops.begin(), ops.end(), [](const detail::Operation* a, const detail::Operation* b) {
+			return std::less<flink_subdev*>()(a->subdev_, b->subdev_);
+		});
+		auto begin = ops.begin();
+		while(begin != ops.end()) {
+			auto end = begin + 1;
+			if(is_block_op(*begin)) {	// runs of reads or writes, bit operations one by one
+				while(end != ops.end() && (*end)->subdev_ == (*begin)->subdev_ && (*end)->type_ == (*begin)->type_) ++end;
+			}
+			if((*begin)->type_ == detail::OpType::read) execute_reads(begin, end);
+			else if((*begin)->type_ == detail::OpType::write) execute_writes(begin, end);
+			else execute_bit(*begin);
+			begin = end;
+		}
+
+		for(detail::Operation* op : ops) {
+			op->executor_ = nullptr;
+			if(op->handle_) ready_.push_back(op->handle_);
+		}
+	}
+
+	static bool is_block_op(const detail::Operation* op) {
+		return op->type_ == detail::OpType::read || op->type_ == detail::OpType::write;
+	}
+
+	/**
+	 * @brief Finds the operations in submission order which access one contiguous range of registers, each register once.
+	 * @return Ops::iterator: End of the operations, first and last contain the first and last register.
+	 */
+	static Ops::iterator contiguous(Ops::iterator begin, Ops::iterator end, uint32_t& first, uint32_t& last) {
+		first = last = (*begin)->offset_;
+		auto run = begin + 1;
+		for(; run != end; ++run) {
+			uint32_t offset = (*run)->offset_;
+			uint32_t lo = std::min(first, offset), hi = std::max(last, offset);
+			if((offset + REGISTER_WITH != first && offset != last + REGISTER_WITH) || hi + REGISTER_WITH - lo > max_transfer) break;	// not adjacent or already in the range
+			first = lo;
+			last = hi;
+		}
+		return run;
+	}
+
+	void execute_reads(Ops::iterator begin, Ops::iterator end) {
+		while(begin != end) {
+			uint32_t first, last;
+			auto run = contiguous(begin, end, first, last);
+			uint32_t size = last + REGISTER_WITH - first;
+			buffer_.resize(size);
+			int error = flink_read_block((*begin)->subdev_, first, size, buffer_.data()) == (ssize_t)size ? 0 : flink_get_errno();
+			nof_transfers_++;
+			for(; begin != run; ++begin) {
+				(*begin)->error_ = error;
+				if(!error) std::memcpy(&(*begin)->value_, buffer_.data() + ((*begin)->offset_ - first), REGISTER_WITH);
+			}
+		}
+	}
+
+	void execute_writes(Ops::iterator begin, Ops::iterator end) {
+		while(begin != end) {
+			uint32_t first, last;
+			auto run = contiguous(begin, end, first, last);
+			uint32_t size = last + REGISTER_WITH - first;
+			buffer_.resize(size);
+			for(auto op = begin; op != run; ++op) std::memcpy(buffer_.data() + ((*op)->offset_ - first), &(*op)->value_, REGISTER_WITH);
+			int error = flink_write_block((*begin)->subdev_, first, size, buffer_.data()) == (ssize_t)size ? 0 : flink_get_errno();
+			nof_transfers_++;
+			for(; begin != run; ++begin) (*begin)->error_ = error;
+		}
+	}
+
+	void execute_bit(detail::Operation* op) {
+		uint8_t bit = op->value_;
+		int ret = op->type_ == detail::OpType::read_bit ? flink_read_bit(op->subdev_, op->offset_, op->bit_, &bit)
+		                                               : flink_write_bit(op->subdev_, op->offset_, op->bit_, &bit);
+		op->error_ = ret < 0 ? flink_get_errno() : 0;
+		op->value_ = bit;
+		nof_transfers_++;
+	}
+
+	std::deque<std::coroutine_handle<>> ready_;
+	Ops                                 pending_;
+	std::vector<Task<>>                 tasks_;
+	std::vector<uint8_t>                buffer_;
+	uint64_t                            nof_transactions_ = 0;
+	uint64_t                            nof_transfers_ = 0;
+	static inline thread_local Executor* current_ = nullptr;
+};
+
+namespace detail {
+
+inline Operation::Operation(flink_subdev* subdev, OpType type, uint32_t offset, uint32_t value, uint8_t bit)
+	: subdev_(subdev), type_(type), bit_(bit), offset_(offset), value_(value), executor_(Executor::current()) {
+	if(executor_) {
+		executor_->submit(this);
+		return;
+	}
+	Executor::Ops ops = { this };	// no executor, execute now
+	Executor executor;
+	if(type == OpType::read) executor.execute_reads(ops.begin(), ops.end());
+	else if(type == OpType::write) executor.execute_writes(ops.begin(), ops.end());
+	else executor.execute_bit(this);
+}
+
+inline Operation::~Operation() {
+	if(executor_) executor_->cancel(this);
+}
+
+} // namespace detail
+
+/**
+ * @brief Handle of a subdevice, valid as long as its Device is open.
+ */
+class Subdevice {
+public:
+	Subdevice() = default;
+	explicit Subdevice(flink_subdev* subdev) : subdev_(subdev) { }
+
+	flink_subdev* get() const noexcept { return subdev_; }
+	explicit operator bool() const noexcept { return subdev_ != nullptr; }
+
+	uint8_t  id() const { return flink_subdevice_get_id(subdev_); }
+	uint16_t function() const { return flink_subdevice_get_function(subdev_); }
+	uint32_t mem_size() const { return flink_subdevice_get_memsize(subdev_); }
+	uint32_t nof_channels() const { return flink_subdevice_get_nofchannels(subdev_); }
+	uint32_t unique_id() const { return flink_subdevice_get_unique_id(subdev_); }
+
+	Op<uint32_t> read(uint32_t offset) const { return Op<uint32_t>(subdev_, detail::OpType::read, offset, 0, 0); }
+	Op<void>     write(uint32_t offset, uint32_t value) const { return Op<void>(subdev_, detail::OpType::write, offset, value, 0); }
+	Op<bool>     read_bit(uint32_t offset, uint8_t bit) const { return Op<bool>(subdev_, detail::OpType::read_bit, offset, 0, bit); }
+	Op<void>     write_bit(uint32_t offset, uint8_t bit, bool value) const { return Op<void>(subdev_, detail::OpType::write_bit, offset, value, bit); }
+
+private:
+	flink_subdev* subdev_ = nullptr;
+};
+
+/**
+ * @brief Open flink device, closed by the destructor.
+ */
+class Device {
+public:
+	explicit Device(const char* file_name) : dev_(flink_open(file_name)) {
+		if(dev_ == nullptr) detail::fail("flink_open");
+	}
+	Device(Device&& other) noexcept : dev_(std::exchange(other.dev_, nullptr)) { }
+	Device& operator=(Device&& other) noexcept {
+		if(this != &other) {
+			if(dev_) flink_close(dev_);
+			dev_ = std::exchange(other.dev_, nullptr);
+		}
+		return *this;
+	}
+	~Device() { if(dev_) flink_close(dev_); }
+
+	flink_dev* get() const noexcept { return dev_; }
+
+	int nof_subdevices() const { return flink_get_nof_subdevices(dev_); }
+
+	Subdevice subdevice(uint8_t id) const {
+		flink_subdev* subdev = flink_get_subdevice_by_id(dev_, id);
+		if(subdev == nullptr) detail::fail("flink_get_subdevice_by_id");
+		return Subdevice(subdev);
+	}
+
+	Subdevice subdevice_by_unique_id(uint32_t unique_id) const {
+		flink_subdev* subdev = flink_get_subdevice_by_unique_id(dev_, unique_id);
+		if(subdev == nullptr) detail::fail("flink_get_subdevice_by_unique_id");
+		return Subdevice(subdev);
+	}
+
+private:
+	flink_dev* dev_;
+};
+
+} // namespace flink
+
+#endif // FLINKLIB_HPP_
@@ -0,0 +1,579 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, asynchronous requests                 *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file async.c
+ *  @brief Asynchronous register accesses, executed by an I/O thread.
+ *
+ *  Requests are queued per priority and subdevice. The I/O thread
+ *  always serves the highest priority with queued requests and takes
+ *  turns between the subdevices, executing up to ASYNC_BATCH requests
+ *  of a subdevice at once. Within a batch, runs of contiguous reads or
+ *  writes are merged into one block transfer. Requests of the same
+ *  priority and subdevice are executed in the order of submission.
+ *
+ *  A completed request is either passed to its callback, called by the
+ *  I/O thread, or appended to the completion list of the queue, which is
+ *  signaled through an eventfd.
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "error.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define ASYNC_NOF_SUBDEVS	(UINT8_MAX + 1)
+#define ASYNC_BATCH			32			// requests of a subdevice executed in one turn at most
+#define ASYNC_MAX_MERGE		0x1000		// bytes of a merged block transfer at most
+
+typedef enum {
+	ASYNC_READ,
+	ASYNC_WRITE,
+	ASYNC_READ_BIT,
+	ASYNC_WRITE_BIT
+} async_type;
+
+typedef enum {
+	ASYNC_QUEUED,
+	ASYNC_RUNNING,
+	ASYNC_DONE
+} async_state;
+
+struct _flink_async_request {
+	flink_async_request* next;
+	flink_async_request* prev;
+	flink_async*         async;
+	flink_subdev*        subdev;
+	uint8_t              type;			/// async_type
+	uint8_t              priority;
+	uint8_t              bit;
+	uint8_t              state;			/// async_state, protected by the lock of the queue
+	uint8_t              listed;		/// In the completion list
+	uint32_t             offset;
+	uint32_t             size;
+	void*                rdata;
+	ssize_t              result;
+	int                  error;			/// flink_errno of a failed request
+	flink_async_callback callback;
+	void*                arg;
+	uint8_t              wdata[];		/// Copy of the data to write
+};
+
+typedef struct _async_fifo {
+	flink_async_request* head;
+	flink_async_request* tail;
+} async_fifo;
+
+struct _flink_async {
+	flink_dev*           dev;
+	pthread_t            thread;
+	pthread_mutex_t      lock;
+	pthread_cond_t       queued;		/// Signaled for the I/O thread
+	pthread_cond_t       done;			/// Broadcast when a request without callback completes
+	int                  stop;
+	int                  event_fd;
+	async_fifo           queues[FLINK_ASYNC_NOF_PRIORITIES][ASYNC_NOF_SUBDEVS];
+	uint32_t             nof_queued[FLINK_ASYNC_NOF_PRIORITIES];
+	uint32_t             turn[FLINK_ASYNC_NOF_PRIORITIES];	/// Subdevice to serve next
+	async_fifo           completed;
+	uint8_t              buffer[ASYNC_MAX_MERGE];			/// Merged transfers, used by the I/O thread only
+};
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static void fifo_push(async_fifo* fifo, flink_async_request* request) {
+	request->next = NULL;
+	request->prev = fifo->tail;
+	if(fifo->tail) fifo->tail->next = request;
+	else fifo->head = request;
+	fifo->tail = request;
+}
+
+static void fifo_remove(async_fifo* fifo, flink_async_request* request) {
+	if(request->prev) request->prev->next = request->next;
+	else fifo->head = request->next;
+	if(request->next) request->next->prev = request->prev;
+	else fifo->tail = request->prev;
+}
+
+/**
+ * @brief Takes the next batch of requests, all of the same subdevice.
+ * The lock of the queue must be held.
+ * @return flink_async_request*: List of the requests, NULL if none is queued.
+ */
+static flink_async_request* async_take_batch(flink_async* async) {
+	flink_async_request* batch;
+	flink_async_request* last;
+	async_fifo* fifo;
+	uint32_t p, i, n;
+
+	for(p = 0; p < FLINK_ASYNC_NOF_PRIORITIES && async->nof_queued[p] == 0; p++);
+	if(p == FLINK_ASYNC_NOF_PRIORITIES) return NULL;
+
+	for(i = 0; i < ASYNC_NOF_SUBDEVS; i++) {
+		fifo = &async->queues[p][(async->turn[p] + i) % ASYNC_NOF_SUBDEVS];
+		if(fifo->head) break;
+	}
+	async->turn[p] = (async->turn[p] + i + 1) % ASYNC_NOF_SUBDEVS;
+
+	batch = fifo->head;
+	for(last = batch, n = 1; n < ASYNC_BATCH && last->next; last = last->next, n++);
+	fifo->head = last->next;
+	if(fifo->head == NULL) fifo->tail = NULL;
+	else fifo->head->prev = NULL;
+	last->next = NULL;
+	async->nof_queued[p] -= n;
+	for(last = batch; last; last = last->next) last->state = ASYNC_RUNNING;
+	return batch;
+}
+
+/**
+ * @brief Number of requests, starting with the given one, which can be merged into one block transfer.
+ */
+static uint32_t async_run_length(flink_async_request* request, uint32_t* size) {
+	flink_async_request* r = request;
+	uint32_t n = 1;
+
+	*size = r->size;
+	if(r->type != ASYNC_READ && r->type != ASYNC_WRITE) return 1;
+	while(r->next && r->next->type == request->type && r->next->offset == r->offset + r->size && *size + r->next->size <= ASYNC_MAX_MERGE) {
+		r = r->next;
+		*size += r->size;
+		n++;
+	}
+	return n;
+}
+
+static void async_execute(flink_async* async, flink_async_request* request) {
+	flink_async_request* r;
+	uint32_t n, i, size, pos;
+	ssize_t ret;
+
+	while(request) {
+		n = async_run_length(request, &size);
+		if(n > 1 && request->type == ASYNC_READ) {
+			ret = flink_read_block(request->subdev, request->offset, size, async->buffer);
+			for(r = request, pos = 0, i = 0; i < n; pos += r->size, r = r->next, i++) {
+				if(ret == size) memcpy(r->rdata, async->buffer + pos, r->size);
+				r->result = ret == size ? r->size : EXIT_ERROR;
+				r->error = flink_errno;
+			}
+		}
+		else if(n > 1) {
+			for(r = request, pos = 0, i = 0; i < n; pos += r->size, r = r->next, i++) memcpy(async->buffer + pos, r->wdata, r->size);
+			ret = flink_write_block(request->subdev, request->offset, size, async->buffer);
+			for(r = request, i = 0; i < n; r = r->next, i++) {
+				r->result = ret == size ? r->size : EXIT_ERROR;
+				r->error = flink_errno;
+			}
+		}
+		else {
+			switch(request->type) {
+				case ASYNC_READ:
+					request->result = flink_read_block(request->subdev, request->offset, request->size, request->rdata);
+					break;
+				case ASYNC_WRITE:
+					request->result = flink_write_block(request->subdev, request->offset, request->size, request->wdata);
+					break;
+				case ASYNC_READ_BIT:
+					request->result = flink_read_bit(request->subdev, request->offset, request->bit, request->rdata);
+					break;
+				case ASYNC_WRITE_BIT:
+					request->result = flink_write_bit(request->subdev, request->offset, request->bit, request->wdata);
+					break;
+			}
+			request->error = flink_errno;
+		}
+		while(n--) request = request->next;
+	}
+}
+
+/**
+ * @brief Completes the requests of a list, calling their callbacks or appending them to the completion list.
+ */
+static void async_complete(flink_async* async, flink_async_request* request) {
+	flink_async_request* next;
+	uint64_t nof_listed = 0;
+
+	pthread_mutex_lock(&async->lock);
+	for(next = request; next; next = next->next) {
+		if(next->callback == NULL) nof_listed++;
+	}
+	while(request) {
+		next = request->next;
+		if(request->callback) {
+			request->state = ASYNC_DONE;
+			pthread_mutex_unlock(&async->lock);
+			request->callback(request, request->arg);	// may release the request
+			pthread_mutex_lock(&async->lock);
+		}
+		else {
+			request->state = ASYNC_DONE;
+			request->listed = 1;
+			fifo_push(&async->completed, request);
+		}
+		request = next;
+	}
+	if(nof_listed) {
+		pthread_cond_broadcast(&async->done);
+		if(write(async->event_fd, &nof_listed, sizeof(nof_listed)) != sizeof(nof_listed)) nof_listed = 0;	// counter can't overflow in practice
+	}
+	pthread_mutex_unlock(&async->lock);
+}
+
+static void* async_thread(void* arg) {
+	flink_async* async = arg;
+	flink_async_request* batch;
+
+	pthread_mutex_lock(&async->lock);
+	while(1) {
+		batch = async_take_batch(async);
+		if(batch == NULL) {
+			if(async->stop) break;
+			pthread_cond_wait(&async->queued, &async->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&async->lock);
+		async_execute(async, batch);
+		async_complete(async, batch);
+		pthread_mutex_lock(&async->lock);
+	}
+	pthread_mutex_unlock(&async->lock);
+	return NULL;
+}
+
+/**
+ * @brief Allocates and queues a request.
+ */
+static flink_async_request* async_submit(flink_async* async, flink_subdev* subdev, uint8_t type, uint32_t offset, uint32_t size,
+                                         uint8_t bit, void* rdata, const void* wdata, uint8_t priority, flink_async_callback callback, void* arg) {
+	flink_async_request* request;
+
+	if(async == NULL || subdev == NULL || (rdata == NULL && wdata == NULL)) {
+		flink_error(FLINK_ENULLPTR);
+		return NULL;
+	}
+	if(subdev->parent != async->dev) {
+		flink_error(FLINK_EINVALSUBDEV);
+		return NULL;
+	}
+	if(priority >= FLINK_ASYNC_NOF_PRIORITIES) {
+		flink_error(FLINK_EINVALARG);
+		return NULL;
+	}
+	request = calloc(1, sizeof(flink_async_request) + (wdata ? size : 0));
+	if(request == NULL) {
+		libc_error();
+		return NULL;
+	}
+	request->async    = async;
+	request->subdev   = subdev;
+	request->type     = type;
+	request->priority = priority;
+	request->bit      = bit;
+	request->offset   = offset;
+	request->size     = size;
+	request->rdata    = rdata;
+	request->callback = callback;
+	request->arg      = arg;
+	if(wdata) memcpy(request->wdata, wdata, size);
+
+	pthread_mutex_lock(&async->lock);
+	if(async->stop) {
+		pthread_mutex_unlock(&async->lock);
+		free(request);
+		flink_error(FLINK_ESHUTDOWN);
+		return NULL;
+	}
+	fifo_push(&async->queues[priority][subdev->id], request);
+	async->nof_queued[priority]++;
+	pthread_cond_signal(&async->queued);
+	pthread_mutex_unlock(&async->lock);
+	return request;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Creates a queue for asynchronous requests and starts its I/O thread.
+ * @param dev: Flink device.
+ * @return flink_async*: The queue, or NULL in case of failure.
+ */
+flink_async* flink_async_create(flink_dev* dev) {
+	flink_async* async;
+	int ret;
+
+	if(dev == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return NULL;
+	}
+	async = calloc(1, sizeof(flink_async));
+	if(async == NULL) {
+		libc_error();
+		return NULL;
+	}
+	async->dev = dev;
+	async->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(async->event_fd < 0) {
+		libc_error();
+		free(async);
+		return NULL;
+	}
+	pthread_mutex_init(&async->lock, NULL);
+	pthread_cond_init(&async->queued, NULL);
+	pthread_cond_init(&async->done, NULL);
+	ret = pthread_create(&async->thread, NULL, async_thread, async);
+	if(ret) {
+		flink_error(ret);
+		close(async->event_fd);
+		pthread_mutex_destroy(&async->lock);
+		pthread_cond_destroy(&async->queued);
+		pthread_cond_destroy(&async->done);
+		free(async);
+		return NULL;
+	}
+	return async;
+}
+
+/**
+ * @brief Executes the queued requests, stops the I/O thread and frees the queue.
+ * Requests not released yet are freed, their handles become invalid.
+ * @param async: Queue.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_async_destroy(flink_async* async) {
+	flink_async_request* request;
+
+	if(async == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&async->lock);
+	async->stop = 1;
+	pthread_cond_signal(&async->queued);
+	pthread_mutex_unlock(&async->lock);
+	pthread_join(async->thread, NULL);
+
+	while((request = async->completed.head)) {
+		fifo_remove(&async->completed, request);
+		free(request);
+	}
+	close(async->event_fd);
+	pthread_mutex_destroy(&async->lock);
+	pthread_cond_destroy(&async->queued);
+	pthread_cond_destroy(&async->done);
+	free(async);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Eventfd of the queue, readable while completed requests without callback are listed.
+ * Reading the eventfd resets it, flink_async_get_completed() takes the requests.
+ * @param async: Queue.
+ * @return int: File descriptor, -1 in case of failure.
+ */
+int flink_async_get_fd(flink_async* async) {
+	if(async == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	return async->event_fd;
+}
+
+/**
+ * @brief Queues a read of registers.
+ * @param async: Queue.
+ * @param subdev: Subdevice of the device of the queue.
+ * @param offset: Offset of the first register.
+ * @param size: Nof bytes to read.
+ * @param rdata: Buffer for the data, must be valid until the request completed.
+ * @param priority: FLINK_ASYNC_CONTROL or FLINK_ASYNC_BULK.
+ * @param callback: Called by the I/O thread on completion, NULL to list the request for flink_async_get_completed().
+ * @param arg: Argument of the callback.
+ * @return flink_async_request*: The request, NULL in case of failure.
+ */
+flink_async_request* flink_async_read(flink_async* async, flink_subdev* subdev, uint32_t offset, uint32_t size, void* rdata,
+                                      uint8_t priority, flink_async_callback callback, void* arg) {
+	return async_submit(async, subdev, ASYNC_READ, offset, size, 0, rdata, NULL, priority, callback, arg);
+}
+
+/**
+ * @brief Queues a write of registers, the data is copied.
+ * @param async: Queue.
+ * @param subdev: Subdevice of the device of the queue.
+ * @param offset: Offset of the first register.
+ * @param size: Nof bytes to write.
+ * @param wdata: Data to write.
+ * @param priority: FLINK_ASYNC_CONTROL or FLINK_ASYNC_BULK.
+ * @param callback: Called by the I/O thread on completion, NULL to list the request for flink_async_get_completed().
+ * @param arg: Argument of the callback.
+ * @return flink_async_request*: The request, NULL in case of failure.
+ */
+flink_async_request* flink_async_write(flink_async* async, flink_subdev* subdev, uint32_t offset, uint32_t size, const void* wdata,
+                                       uint8_t priority, flink_async_callback callback, void* arg) {
+	return async_submit(async, subdev, ASYNC_WRITE, offset, size, 0, NULL, wdata, priority, callback, arg);
+}
+
+/**
+ * @brief Queues a read of a single bit.
+ * @param async: Queue.
+ * @param subdev: Subdevice of the device of the queue.
+ * @param offset: Offset of the register.
+ * @param bit: Bit number.
+ * @param rdata: Receives the bit, must be valid until the request completed.
+ * @param priority: FLINK_ASYNC_CONTROL or FLINK_ASYNC_BULK.
+ * @param callback: Called by the I/O thread on completion, NULL to list the request for flink_async_get_completed().
+ * @param arg: Argument of the callback.
+ * @return flink_async_request*: The request, NULL in case of failure.
+ */
+flink_async_request* flink_async_read_bit(flink_async* async, flink_subdev* subdev, uint32_t offset, uint8_t bit, uint8_t* rdata,
+                                          uint8_t priority, flink_async_callback callback, void* arg) {
+	return async_submit(async, subdev, ASYNC_READ_BIT, offset, sizeof(uint8_t), bit, rdata, NULL, priority, callback, arg);
+}
+
+/**
+ * @brief Queues a write of a single bit.
+ * @param async: Queue.
+ * @param subdev: Subdevice of the device of the queue.
+ * @param offset: Offset of the register.
+ * @param bit: Bit number.
+ * @param value: Bit value.
+ * @param priority: FLINK_ASYNC_CONTROL or FLINK_ASYNC_BULK.
+ * @param callback: Called by the I/O thread on completion, NULL to list the request for flink_async_get_completed().
+ * @param arg: Argument of the callback.
+ * @return flink_async_request*: The request, NULL in case of failure.
+ */
+flink_async_request* flink_async_write_bit(flink_async* async, flink_subdev* subdev, uint32_t offset, uint8_t bit, uint8_t value,
+                                           uint8_t priority, flink_async_callback callback, void* arg) {
+	return async_submit(async, subdev, ASYNC_WRITE_BIT, offset, sizeof(uint8_t), bit, NULL, &value, priority, callback, arg);
+}
+
+/**
+ * @brief Takes the oldest completed request without callback from the completion list.
+ * @param async: Queue.
+ * @return flink_async_request*: The request, NULL if none is listed.
+ */
+flink_async_request* flink_async_get_completed(flink_async* async) {
+	flink_async_request* request;
+
+	if(async == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return NULL;
+	}
+	pthread_mutex_lock(&async->lock);
+	request = async->completed.head;
+	if(request) {
+		fifo_remove(&async->completed, request);
+		request->listed = 0;
+	}
+	pthread_mutex_unlock(&async->lock);
+	return request;
+}
+
+/**
+ * @brief Checks if a request completed, without blocking.
+ * @param request: Request.
+ * @return int: 1 if completed, 0 if not, -1 in case of failure.
+ */
+int flink_async_done(flink_async_request* request) {
+	int done;
+
+	if(request == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&request->async->lock);
+	done = request->state == ASYNC_DONE;
+	pthread_mutex_unlock(&request->async->lock);
+	return done;
+}
+
+/**
+ * @brief Waits for a request without callback to complete.
+ * @param request: Request.
+ * @return ssize_t: Result of the request, see flink_async_get_result().
+ */
+ssize_t flink_async_wait(flink_async_request* request) {
+	flink_async* async;
+
+	if(request == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(request->callback) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+	async = request->async;
+	pthread_mutex_lock(&async->lock);
+	while(request->state != ASYNC_DONE) pthread_cond_wait(&async->done, &async->lock);
+	pthread_mutex_unlock(&async->lock);
+	return flink_async_get_result(request);
+}
+
+/**
+ * @brief Result of a completed request.
+ * @param request: Request.
+ * @return ssize_t: Nof bytes read or written, 0 for bit accesses, -1 if the request failed, flink_errno is set to its error.
+ */
+ssize_t flink_async_get_result(flink_async_request* request) {
+	if(request == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(request->state != ASYNC_DONE) {
+		flink_error(FLINK_EBUSY);
+		return EXIT_ERROR;
+	}
+	if(request->result < 0) flink_error(request->error);
+	return request->result;
+}
+
+/**
+ * @brief Frees a completed request, e.g. from its callback.
+ * @param request: Request.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_async_release(flink_async_request* request) {
+	flink_async* async;
+
+	if(request == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	async = request->async;
+	pthread_mutex_lock(&async->lock);
+	if(request->state != ASYNC_DONE) {
+		pthread_mutex_unlock(&async->lock);
+		flink_error(FLINK_EBUSY);
+		return EXIT_ERROR;
+	}
+	if(request->listed) fifo_remove(&async->completed, request);
+	pthread_mutex_unlock(&async->lock);
+	free(request);
+	return EXIT_SUCCESS;
+}
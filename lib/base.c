@@ -28,10 +28,19 @@
 #include "valid.h"
 #include "error.h"
 #include "log.h"
+#include "transport.h"
+#include "stats.h"
 
 #include <stdlib.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include <string.h>
+
+static const flink_transport* const transports[] = {
+	&flink_sim_transport,
+	&flink_remote_transport,
+	&flink_spi_transport,
+	&flink_uio_transport,
+};
+#define NOF_TRANSPORTS (sizeof(transports) / sizeof(transports[0]))
 
 
 /*******************************************************************
@@ -99,6 +108,28 @@ static int get_subdevices(flink_dev* dev) {
 }
 
 
+/**
+ * @brief Select the transport for a file name.
+ * 
+ * @param file_name: File name, optionally starting with a transport prefix.
+ * @param path: Contains the file name without the prefix.
+ * @return const flink_transport*: The transport to use.
+ */
+static const flink_transport* select_transport(const char* file_name, const char** path) {
+	size_t i, len;
+	
+	for(i = 0; i < NOF_TRANSPORTS; i++) {
+		len = strlen(transports[i]->prefix);
+		if(strncmp(file_name, transports[i]->prefix, len) == 0) {
+			*path = file_name + len;
+			return transports[i];
+		}
+	}
+	*path = file_name;
+	return &flink_chardev_transport;
+}
+
+
 /*******************************************************************
  *                                                                 *
  *  Public methods                                                 *
@@ -107,29 +138,47 @@ static int get_subdevices(flink_dev* dev) {
 
 /**
  * @brief Opens a flink device file
- * @param file_name: Device file (null terminated array).
+ * @param file_name: Device file (null terminated array), optionally starting with a transport prefix like "sim:".
  * @return flink_dev*: Pointer to the opened flink device or NULL in case of error.
  */
 flink_dev* flink_open(const char* file_name) {
 	flink_dev* dev = NULL;
+	const char* path;
+	
+	if(file_name == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return NULL;
+	}
 	
 	// Allocate memory for flink_t
-	dev = malloc(sizeof(flink_dev));
+	dev = calloc(1, sizeof(flink_dev));
 	if(dev == NULL) { // allocation failed
 		libc_error();
 		return NULL;
 	}
 	
+	dev->selected = -1;
+	dev->info_subdev = -1;
+	dev->fingerprint = 0;
+	pthread_mutex_init(&dev->block_lock, NULL);
+	pthread_mutex_init(&dev->irq_lock, NULL);
+	flink_stats_init(dev);
+	
 	// Open device file
-	dev->fd = open(file_name, O_RDWR);
-	if(dev->fd < 0) { // failed to open device
+	dev->transport = select_transport(file_name, &path);
+	if(dev->transport->open(dev, path) < 0) { // failed to open device
+		pthread_mutex_destroy(&dev->block_lock);
+		pthread_mutex_destroy(&dev->irq_lock);
 		free(dev);
-		libc_error();
 		return NULL;
 	}
 	
 	if(get_subdevices(dev) < 0) { // reading subdevices failed
-		close(dev->fd);
+		dev->transport->close(dev);
+		flink_stats_free(dev);
+		free(dev->subdevices);
+		pthread_mutex_destroy(&dev->block_lock);
+		pthread_mutex_destroy(&dev->irq_lock);
 		free(dev);
 		return NULL;
 	}
@@ -150,10 +199,17 @@ int flink_close(flink_dev* dev) {
 	}
 	
 	if(dev->subdevices) {
+		for(int i = 0; i < dev->nof_subdevices; i++) {
+			free(dev->subdevices[i].irq_table);
+			free(dev->subdevices[i].custom);
+		}
 		free(dev->subdevices);
 	}
 	
-	close(dev->fd);
+	dev->transport->close(dev);
+	pthread_mutex_destroy(&dev->block_lock);
+	pthread_mutex_destroy(&dev->irq_lock);
+	flink_stats_free(dev);
 	free(dev);
 	return EXIT_SUCCESS;
 }
@@ -207,10 +263,15 @@ int flink_subdevice_select(flink_subdev* subdev, uint8_t exclusive) {
 	ioctl_cmd_t cmd = SELECT_SUBDEVICE;
 	if(exclusive) cmd = SELECT_SUBDEVICE_EXCL;
 	
+	pthread_mutex_lock(&subdev->parent->block_lock);
 	if(flink_ioctl(subdev->parent, cmd, &(subdev->id)) < 0) {
+		subdev->parent->selected = -1;
+		pthread_mutex_unlock(&subdev->parent->block_lock);
 		libc_error();
 		return EXIT_ERROR;
 	}
+	subdev->parent->selected = subdev->id;
+	pthread_mutex_unlock(&subdev->parent->block_lock);
 	return EXIT_SUCCESS;
 }
 
@@ -229,7 +290,7 @@ flink_subdev* flink_get_subdevice_by_id(flink_dev* dev, uint8_t subdev_id) {
 	}
 
 	// Check subdevice id
-	if(subdev_id > dev->nof_subdevices) {
+	if(subdev_id >= dev->nof_subdevices) {
 		flink_error(FLINK_EINVALSUBDEV);
 		return NULL;
 	}
@@ -333,3 +394,13 @@ uint32_t flink_subdevice_get_nofchannels(flink_subdev* subdev) {
 uint32_t flink_subdevice_get_unique_id(flink_subdev* subdev) {
 	return subdev->unique_id;
 }
+
+/**
+ * @brief Get the number of system calls issued for a device.
+ * Simulated devices count the system calls a device file would need.
+ * @param dev: The device.
+ * @return uint64_t: Number of system calls since the device was opened.
+ */
+uint64_t flink_get_nof_syscalls(flink_dev* dev) {
+	return __atomic_load_n(&dev->nof_syscalls, __ATOMIC_RELAXED);
+}
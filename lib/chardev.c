@@ -0,0 +1,102 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, device file transport                 *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file chardev.c
+ *  @brief Transport for flink device files of the flink kernel module.
+ *
+ *  Register operations are ioctl calls on the device file. Blocks are
+ *  read and written with pread/pwrite on the device file after
+ *  selecting the subdevice, which is only done again if another
+ *  subdevice was selected before.
+ */
+
+#include "flinklib.h"
+#include "flinkioctl.h"
+#include "types.h"
+#include "error.h"
+#include "transport.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+static int chardev_open(flink_dev* dev, const char* path) {
+	dev->fd = open(path, O_RDWR);
+	if(dev->fd < 0) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
+
+static void chardev_close(flink_dev* dev) {
+	close(dev->fd);
+}
+
+static int chardev_ioctl(flink_dev* dev, int cmd, void* arg) {
+	flink_count_syscall(dev);
+	return ioctl(dev->fd, cmd, arg);
+}
+
+/**
+ * @brief Selects a subdevice for the read and write calls of the device file.
+ * The device block_lock must be held.
+ */
+static int chardev_select(flink_subdev* subdev) {
+	flink_dev* dev = subdev->parent;
+
+	if(dev->selected == subdev->id) return EXIT_SUCCESS;
+	flink_count_syscall(dev);
+	if(ioctl(dev->fd, SELECT_SUBDEVICE, &(subdev->id)) < 0) {
+		dev->selected = -1;
+		return EXIT_ERROR;
+	}
+	dev->selected = subdev->id;
+	return EXIT_SUCCESS;
+}
+
+static ssize_t chardev_read_block(flink_subdev* subdev, uint32_t offset, uint32_t size, void* rdata) {
+	flink_dev* dev = subdev->parent;
+	ssize_t ret = EXIT_ERROR;
+
+	pthread_mutex_lock(&dev->block_lock);
+	if(chardev_select(subdev) == EXIT_SUCCESS) {
+		flink_count_syscall(dev);
+		ret = pread(dev->fd, rdata, size, offset);
+	}
+	pthread_mutex_unlock(&dev->block_lock);
+	return ret;
+}
+
+static ssize_t chardev_write_block(flink_subdev* subdev, uint32_t offset, uint32_t size, const void* wdata) {
+	flink_dev* dev = subdev->parent;
+	ssize_t ret = EXIT_ERROR;
+
+	pthread_mutex_lock(&dev->block_lock);
+	if(chardev_select(subdev) == EXIT_SUCCESS) {
+		flink_count_syscall(dev);
+		ret = pwrite(dev->fd, wdata, size, offset);
+	}
+	pthread_mutex_unlock(&dev->block_lock);
+	return ret;
+}
+
+const flink_transport flink_chardev_transport = {
+	.prefix      = NULL,
+	.open        = chardev_open,
+	.close       = chardev_close,
+	.ioctl       = chardev_ioctl,
+	.read_block  = chardev_read_block,
+	.write_block = chardev_write_block,
+};
@@ -0,0 +1,206 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, Chrome trace export                   *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file chromeTrace.c
+ *  @brief Recording of operations in the Chrome trace event format.
+ *
+ *  While recording, every ioctl and block transfer is stored as a
+ *  complete event in a buffer allocated when recording starts. Writers
+ *  claim a slot with an atomic increment, no locks are taken. Events
+ *  which do not fit into the buffer are dropped and counted. The buffer
+ *  is written as JSON when recording stops and can be loaded into
+ *  chrome://tracing or Perfetto.
+ *
+ *  Recording starts at load time if the environment variable
+ *  FLINK_CHROME_TRACE names a file, which is written at exit.
+ */
+
+#define _GNU_SOURCE
+#include "flinklib.h"
+#include "error.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define DEFAULT_EVENTS	(1 << 18)	// events recorded when started by FLINK_CHROME_TRACE
+
+typedef struct _chrome_event {
+	uint64_t start_ns;
+	uint64_t end_ns;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t tid;
+	int16_t  subdev;
+	uint8_t  op;
+	uint8_t  ready;		/// Set when the event is completely written
+} chrome_event;
+
+int flink_chrome_trace_on = 0;
+
+static chrome_event* events = NULL;
+static uint32_t capacity = 0;
+static uint64_t next_event = 0;
+static uint64_t writers = 0;	/// Recording threads, stop waits for them
+static const char* env_file = NULL;
+static __thread uint32_t tid = 0;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static void write_env_trace(void) {
+	flink_chrome_trace_stop(env_file);
+}
+
+__attribute__((constructor)) static void chrome_trace_init(void) {
+	env_file = getenv("FLINK_CHROME_TRACE");
+	if(env_file && *env_file && flink_chrome_trace_start(DEFAULT_EVENTS) == EXIT_SUCCESS) atexit(write_env_trace);
+}
+
+static void write_event(FILE* f, const chrome_event* e, int first) {
+	fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"flink\",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":%d,\"tid\":%u",
+	        first ? "" : ",", flink_op2str(e->op),
+	        (unsigned long long)(e->start_ns / 1000), (unsigned)(e->start_ns % 1000),
+	        (unsigned long long)((e->end_ns - e->start_ns) / 1000), (unsigned)((e->end_ns - e->start_ns) % 1000),
+	        getpid(), e->tid);
+	if(e->subdev >= 0) fprintf(f, ",\"args\":{\"subdev\":%d,\"offset\":%u,\"size\":%u}", e->subdev, e->offset, e->size);
+	fprintf(f, "}");
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Library internal methods                                       *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Records an operation, called only while the recorder is active.
+ * @param op: Operation.
+ * @param subdev: Subdevice id or -1.
+ * @param offset: Register offset.
+ * @param size: Nof bytes accessed.
+ * @param start_ns: Start of the operation.
+ * @param end_ns: End of the operation.
+ */
+void flink_chrome_trace_record(flink_op op, int subdev, uint32_t offset, uint32_t size, uint64_t start_ns, uint64_t end_ns) {
+	chrome_event* e;
+	uint64_t i;
+
+	__atomic_fetch_add(&writers, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&flink_chrome_trace_on, __ATOMIC_SEQ_CST)) {
+		i = __atomic_fetch_add(&next_event, 1, __ATOMIC_RELAXED);
+		if(i < capacity) {
+			if(tid == 0) tid = syscall(SYS_gettid);
+			e = &events[i];
+			e->start_ns = start_ns;
+			e->end_ns = end_ns;
+			e->offset = offset;
+			e->size = size;
+			e->tid = tid;
+			e->subdev = subdev;
+			e->op = op;
+			__atomic_store_n(&e->ready, 1, __ATOMIC_RELEASE);
+		}
+	}
+	__atomic_fetch_sub(&writers, 1, __ATOMIC_RELEASE);
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Starts recording all operations of all devices for a Chrome trace.
+ * @param max_events: Nof events which are recorded at most, later events are dropped.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_chrome_trace_start(uint32_t max_events) {
+	if(max_events == 0) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+	if(events != NULL) {
+		flink_error(FLINK_EBUSY);
+		return EXIT_ERROR;
+	}
+	events = calloc(max_events, sizeof(chrome_event));
+	if(events == NULL) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	capacity = max_events;
+	__atomic_store_n(&next_event, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&flink_chrome_trace_on, 1, __ATOMIC_SEQ_CST);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Stops recording and writes the recorded events as a Chrome trace.
+ * @param file_name: JSON file to write, NULL discards the events.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_chrome_trace_stop(const char* file_name) {
+	uint64_t n, i, dropped = 0;
+	int first = 1, ret = EXIT_SUCCESS;
+	FILE* f;
+
+	if(events == NULL) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+	__atomic_store_n(&flink_chrome_trace_on, 0, __ATOMIC_SEQ_CST);
+	while(__atomic_load_n(&writers, __ATOMIC_ACQUIRE)) sched_yield();
+
+	n = __atomic_load_n(&next_event, __ATOMIC_RELAXED);
+	if(n > capacity) {
+		dropped = n - capacity;
+		n = capacity;
+	}
+	if(file_name) {
+		f = fopen(file_name, "w");
+		if(f == NULL) {
+			libc_error();
+			ret = EXIT_ERROR;
+		}
+		else {
+			fprintf(f, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":%llu},\"traceEvents\":[", (unsigned long long)dropped);
+			for(i = 0; i < n; i++) {
+				if(!__atomic_load_n(&events[i].ready, __ATOMIC_ACQUIRE)) continue;
+				write_event(f, &events[i], first);
+				first = 0;
+			}
+			fprintf(f, "\n]}\n");
+			if(fclose(f) != 0) {
+				libc_error();
+				ret = EXIT_ERROR;
+			}
+		}
+	}
+
+	free(events);
+	events = NULL;
+	capacity = 0;
+	return ret;
+}
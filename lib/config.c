@@ -0,0 +1,356 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, declarative device configuration      *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file config.c
+ *  @brief Applies a configuration file to a flink device.
+ *
+ *  The configuration lists the desired register contents per subdevice,
+ *  subdevices are selected by their unique id. The whole file is parsed
+ *  and checked before the device is accessed. For each subdevice the span
+ *  of configured registers is then read in a single transfer, compared
+ *  with the desired contents, and only runs of differing registers are
+ *  written, each run in a single transfer.
+ *
+ *  File format, one statement per line, '#' starts a comment:
+ *
+ *    subdevice <unique id>       following lines apply to this subdevice
+ *    direction <channel> in|out  GPIO direction
+ *    value <channel> <value>     GPIO output or analog output value
+ *    debounce <channel> <value>  GPIO debounce time
+ *    period <channel> <value>    PWM period
+ *    hightime <channel> <value>  PWM high time
+ *    upper <channel> <value>     Reflective sensor upper level
+ *    lower <channel> <value>     Reflective sensor lower level
+ *    irq <irq> <flink irq>       Interrupt multiplexer entry
+ *    register <offset> <value>   Any register of the subdevice
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "error.h"
+#include "valid.h"
+#include "config.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define CONFIG_BASE			(HEADER_SIZE + SUBHEADER_SIZE)
+#define CONFIG_MERGE_GAP	2	// unchanged, fully configured registers rewritten to merge two changed runs into one transfer
+#define CONFIG_MAX_TOKENS	4
+
+typedef struct _config_image {
+	uint32_t* value;	/// Desired register contents
+	uint32_t* mask;		/// Configured bits of each register
+	uint32_t  first;	/// First configured register
+	uint32_t  last;		/// Last configured register
+} config_image;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static int parse_number(const char* s, uint32_t* value) {
+	char* end;
+	unsigned long v;
+
+	errno = 0;
+	v = strtoul(s, &end, 0);
+	if(errno || end == s || *end != '\0' || v > UINT32_MAX) return EXIT_ERROR;
+	*value = v;
+	return EXIT_SUCCESS;
+}
+
+static int set_bits(flink_subdev* subdev, config_image* img, uint32_t offset, uint32_t mask, uint32_t value) {
+	uint32_t reg = offset / REGISTER_WITH;
+
+	if(offset % REGISTER_WITH || offset + REGISTER_WITH > subdev->mem_size) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+	if(img->value == NULL) {
+		img->value = calloc(subdev->mem_size / REGISTER_WITH, sizeof(uint32_t));
+		img->mask = calloc(subdev->mem_size / REGISTER_WITH, sizeof(uint32_t));
+		if(img->value == NULL || img->mask == NULL) {
+			libc_error();
+			return EXIT_ERROR;
+		}
+		img->first = img->last = reg;
+	}
+	if(reg < img->first) img->first = reg;
+	if(reg > img->last) img->last = reg;
+	img->value[reg] = (img->value[reg] & ~mask) | (value & mask);
+	img->mask[reg] |= mask;
+	return EXIT_SUCCESS;
+}
+
+static int parse_statement(flink_subdev* subdev, config_image* img, char** tok, int n) {
+	uint32_t words, ch, value;
+	uint16_t func = subdev->function_id;
+
+	if(n != 3 || parse_number(tok[1], &ch) < 0) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+	if(func == GPIO_INTERFACE_ID && strcmp(tok[0], "direction") == 0) {
+		if(strcmp(tok[2], "in") == 0) value = 0;
+		else if(strcmp(tok[2], "out") == 0) value = 0xFFFFFFFF;
+		else {
+			flink_error(FLINK_EINVALARG);
+			return EXIT_ERROR;
+		}
+	}
+	else if(parse_number(tok[2], &value) < 0) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+
+	if(strcmp(tok[0], "register") == 0) return set_bits(subdev, img, ch, 0xFFFFFFFF, value);
+	if(ch >= subdev->nof_channels) {
+		flink_error(FLINK_EINVALCHAN);
+		return EXIT_ERROR;
+	}
+
+	switch(func) {
+		case GPIO_INTERFACE_ID:
+			words = (subdev->nof_channels - 1) / (REGISTER_WITH * 8) + 1;
+			if(strcmp(tok[0], "direction") == 0) {
+				return set_bits(subdev, img, CONFIG_BASE + 4 + (ch / 32) * REGISTER_WITH, 1u << (ch % 32), value);
+			}
+			if(strcmp(tok[0], "value") == 0) {
+				return set_bits(subdev, img, CONFIG_BASE + 4 + (words + ch / 32) * REGISTER_WITH, 1u << (ch % 32), value ? 0xFFFFFFFF : 0);
+			}
+			if(strcmp(tok[0], "debounce") == 0) {
+				return set_bits(subdev, img, CONFIG_BASE + 4 + words * REGISTER_WITH * 2 + ch * REGISTER_WITH, 0xFFFFFFFF, value);
+			}
+			break;
+		case PWM_INTERFACE_ID:
+			if(strcmp(tok[0], "period") == 0) {
+				return set_bits(subdev, img, CONFIG_BASE + PWM_FIRSTPWM_OFFSET + ch * REGISTER_WITH, 0xFFFFFFFF, value);
+			}
+			if(strcmp(tok[0], "hightime") == 0) {
+				return set_bits(subdev, img, CONFIG_BASE + PWM_FIRSTPWM_OFFSET + (subdev->nof_channels + ch) * REGISTER_WITH, 0xFFFFFFFF, value);
+			}
+			break;
+		case ANALOG_OUTPUT_INTERFACE_ID:
+			if(strcmp(tok[0], "value") == 0) {
+				return set_bits(subdev, img, CONFIG_BASE + ANALOG_OUTPUT_FIRST_VALUE_OFFSET + ch * REGISTER_WITH, 0xFFFFFFFF, value);
+			}
+			break;
+		case SENSOR_INTERFACE_ID:
+			if(strcmp(tok[0], "upper") == 0) {
+				return set_bits(subdev, img, CONFIG_BASE + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + (subdev->nof_channels + ch) * REGISTER_WITH, 0xFFFFFFFF, value);
+			}
+			if(strcmp(tok[0], "lower") == 0) {
+				return set_bits(subdev, img, CONFIG_BASE + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + (2 * subdev->nof_channels + ch) * REGISTER_WITH, 0xFFFFFFFF, value);
+			}
+			break;
+		case IRQ_MULTIPLEXER_INTERFACE_ID:
+			if(strcmp(tok[0], "irq") == 0) {
+				return set_bits(subdev, img, CONFIG_BASE + ch * REGISTER_WITH, 0xFFFFFFFF, value);
+			}
+			break;
+		default:
+			break;
+	}
+	flink_error(FLINK_EINVALARG);	// statement not supported by the function of the subdevice
+	return EXIT_ERROR;
+}
+
+static int parse_file(flink_dev* dev, FILE* f, config_image* images, uint32_t* error_line) {
+	flink_subdev* subdev = NULL;
+	char* tok[CONFIG_MAX_TOKENS + 1];
+	char* line = NULL;
+	char* save;
+	size_t len = 0;
+	uint32_t line_nr = 0, unique_id;
+	int n, ret = EXIT_SUCCESS;
+
+	while(ret == EXIT_SUCCESS && getline(&line, &len, f) != -1) {
+		line_nr++;
+		if(strchr(line, '#')) *strchr(line, '#') = '\0';
+		n = 0;
+		for(tok[n] = strtok_r(line, " \t\r\n", &save); tok[n] && n < CONFIG_MAX_TOKENS; tok[n] = strtok_r(NULL, " \t\r\n", &save)) n++;
+		if(n == 0) continue;
+
+		if(strcmp(tok[0], "subdevice") == 0) {
+			if(n != 2 || parse_number(tok[1], &unique_id) < 0) {
+				flink_error(FLINK_EINVALARG);
+				ret = EXIT_ERROR;
+			}
+			else if((subdev = flink_get_subdevice_by_unique_id(dev, unique_id)) == NULL) {
+				flink_error(FLINK_EINVALSUBDEV);
+				ret = EXIT_ERROR;
+			}
+		}
+		else if(subdev == NULL || tok[n] != NULL) {
+			flink_error(FLINK_EINVALARG);	// no subdevice selected or too many tokens
+			ret = EXIT_ERROR;
+		}
+		else {
+			ret = parse_statement(subdev, &images[subdev->id], tok, n);
+		}
+		if(ret < 0) {
+			dbg_print("Invalid configuration in line %u\n", line_nr);
+			if(error_line) *error_line = line_nr;
+		}
+	}
+	free(line);
+	return ret;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Library internal methods                                       *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Writes a range of registers, skipping registers which already hold the value.
+ * The range is read in a single transfer, runs of differing registers
+ * are written in a single transfer each. Unchanged registers between
+ * two runs are only rewritten if all their bits are written.
+ * @param subdev: Subdevice to write.
+ * @param offset: Offset of the first register.
+ * @param nof_registers: Nof registers in the range.
+ * @param value: Desired contents of the registers.
+ * @param mask: Bits of each register to write, the other bits are kept. NULL writes all bits.
+ * @return int: Nof registers written, -1 in case of failure.
+ */
+int flink_write_changed(flink_subdev* subdev, uint32_t offset, uint32_t nof_registers, const uint32_t* value, const uint32_t* mask) {
+	uint32_t size = nof_registers * REGISTER_WITH;
+	uint32_t* cur = malloc(size);
+	uint32_t* new = malloc(size);
+	uint32_t i, first, last, reg;
+	int written = 0;
+
+	pthread_mutex_lock(&subdev->parent->irq_lock);	// the multiplexer table is cached
+	if(cur == NULL || new == NULL) {
+		libc_error();
+		written = EXIT_ERROR;
+		goto out;
+	}
+	if(flink_read_block(subdev, offset, size, cur) != size) {
+		libc_error();
+		written = EXIT_ERROR;
+		goto out;
+	}
+	for(i = 0; i < nof_registers; i++) {
+		new[i] = mask ? (cur[i] & ~mask[i]) | (value[i] & mask[i]) : value[i];
+	}
+
+	i = 0;
+	while(i < nof_registers) {
+		if(new[i] == cur[i]) {
+			i++;
+			continue;
+		}
+		first = last = i;
+		for(i = first + 1; i < nof_registers && i <= last + CONFIG_MERGE_GAP + 1; i++) {
+			if(new[i] != cur[i]) last = i;
+			else if(mask && mask[i] != 0xFFFFFFFF) break;	// never rewrite bits which are not configured, e.g. sampled GPIO levels
+		}
+		i = last + 1;
+
+		size = (last - first + 1) * REGISTER_WITH;
+		dbg_print("  --> writing registers 0x%x to 0x%x on subdevice %d\n", offset + first * REGISTER_WITH, offset + last * REGISTER_WITH, subdev->id);
+		if(flink_write_block(subdev, offset + first * REGISTER_WITH, size, new + first) != size) {
+			free(subdev->irq_table); // state of the registers unknown
+			subdev->irq_table = NULL;
+			libc_error();
+			written = EXIT_ERROR;
+			goto out;
+		}
+		written += last - first + 1;
+	}
+
+	// Keep the cached multiplexer table consistent
+	if(subdev->irq_table) {
+		for(i = 0; i < nof_registers; i++) {
+			if(offset + i * REGISTER_WITH < CONFIG_BASE) continue;
+			reg = (offset + i * REGISTER_WITH - CONFIG_BASE) / REGISTER_WITH;
+			if(reg < subdev->nof_channels) subdev->irq_table[reg] = new[i];
+		}
+	}
+
+out:
+	pthread_mutex_unlock(&subdev->parent->irq_lock);
+	free(cur);
+	free(new);
+	return written;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Applies a configuration file to a device.
+ * Only registers differing from the configuration are written.
+ * Nothing is written if the file contains an error.
+ * @param dev: Device to configure.
+ * @param file_name: Configuration file.
+ * @param error_line: Gets the number of the first invalid line, 0 if the failure is not caused by a line. May be NULL.
+ * @return int: Nof registers written, -1 in case of failure.
+ */
+int flink_config_apply(flink_dev* dev, const char* file_name, uint32_t* error_line) {
+	config_image* images;
+	FILE* f;
+	int i, n, written = 0;
+
+	if(error_line) *error_line = 0;
+	if(file_name == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(!validate_flink_dev(dev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	images = calloc(dev->nof_subdevices, sizeof(config_image));
+	if(images == NULL) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	f = fopen(file_name, "r");
+	if(f == NULL) {
+		libc_error();
+		free(images);
+		return EXIT_ERROR;
+	}
+
+	if(parse_file(dev, f, images, error_line) < 0) written = EXIT_ERROR;
+	fclose(f);
+
+	for(i = 0; i < dev->nof_subdevices; i++) {
+		if(written >= 0 && images[i].value) {
+			n = flink_write_changed(&dev->subdevices[i], images[i].first * REGISTER_WITH, images[i].last - images[i].first + 1,
+			                        images[i].value + images[i].first, images[i].mask + images[i].first);
+			written = n < 0 ? EXIT_ERROR : written + n;
+		}
+		free(images[i].value);
+		free(images[i].mask);
+	}
+	free(images);
+	return written;
+}
@@ -0,0 +1,26 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, declarative device configuration      *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file config.h
+ *  @brief Writing of register ranges with state diffing.
+ */
+
+#ifndef FLINKLIB_CONFIG_H_
+#define FLINKLIB_CONFIG_H_
+
+#include "types.h"
+
+int flink_write_changed(flink_subdev* subdev, uint32_t offset, uint32_t nof_registers, const uint32_t* value, const uint32_t* mask);
+
+#endif // FLINKLIB_CONFIG_H_
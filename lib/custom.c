@@ -0,0 +1,522 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, custom subdevices                     *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file custom.c
+ *  @brief Subdevices of user-defined functions, described by drivers.
+ *
+ *  A driver is registered for a function id and sub function id and
+ *  describes the register map of the function: named registers, each
+ *  either common to all channels, with one register per channel at a
+ *  fixed stride or with one bit per channel. The register map is checked
+ *  when the driver is registered.
+ *
+ *  On the first access to a subdevice of the function, the register map
+ *  is bound to the subdevice: the offset and size of every register are
+ *  computed for its number of channels and checked against its memory
+ *  size. The bound map is a copy kept with the subdevice until the
+ *  device is closed, registering another driver later does not change
+ *  it. Accesses only add the channel to the precomputed offset.
+ *
+ *  A plan reads the registers of all channels of several registers with
+ *  as few block transfers as possible: registers at contiguous offsets
+ *  are read in one transfer, the values are then copied from the
+ *  transferred words in the order of the registers.
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "error.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define CUSTOM_MAX_DRIVERS	16
+#define CUSTOM_BITS			(REGISTER_WITH * 8)		// channels per register with one bit per channel
+#define CUSTOM_NO_BIT		0xFF
+
+typedef struct _custom_reg {
+	const char* name;		/// Points into the names of the map
+	uint32_t    offset;		/// Offset of channel 0 relative to the subdevice
+	uint32_t    stride;
+	uint32_t    size;		/// Nof bytes of the registers of all channels
+	uint32_t    nof_values;	/// Nof channels, 1 for a common register
+	uint32_t    mode;
+} custom_reg;
+
+struct _flink_custom_map {
+	uint32_t   nof_registers;
+	custom_reg registers[];	/// Followed by the names
+};
+
+typedef struct _custom_transfer {
+	uint32_t offset;
+	uint32_t size;
+	uint32_t word;			/// Index of the first word in the buffer
+} custom_transfer;
+
+typedef struct _custom_source {
+	uint32_t word;			/// Index of the word in the buffer
+	uint8_t  bit;			/// CUSTOM_NO_BIT for the whole word
+} custom_source;
+
+struct _flink_custom_plan {
+	flink_subdev*    subdev;
+	uint32_t         nof_transfers;
+	custom_transfer* transfers;
+	uint32_t*        buffer;
+	uint32_t         nof_values;
+	custom_source*   sources;	/// Source of every value
+};
+
+static flink_driver    drivers[CUSTOM_MAX_DRIVERS];
+static pthread_mutex_t drivers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Computes the number of values and bytes of a register for a number of channels.
+ */
+static void custom_reg_size(const flink_register* reg, uint32_t nof_channels, uint32_t* nof_values, uint32_t* size) {
+	if(reg->mode & FLINK_REG_BITS) {
+		*nof_values = nof_channels;
+		*size = nof_channels ? ((nof_channels - 1) / CUSTOM_BITS + 1) * REGISTER_WITH : REGISTER_WITH;
+	}
+	else if(reg->stride) {
+		*nof_values = nof_channels;
+		*size = nof_channels ? (nof_channels - 1) * reg->stride + REGISTER_WITH : 0;
+	}
+	else {
+		*nof_values = 1;
+		*size = REGISTER_WITH;
+	}
+}
+
+/**
+ * @brief Checks the register map of a driver.
+ * @return int: 0 if valid, -1 otherwise.
+ */
+static int custom_check_driver(const flink_driver* driver) {
+	const flink_register* reg;
+	uint32_t i, k;
+
+	if(driver->name == NULL || driver->nof_registers == 0 || driver->registers == NULL) return EXIT_ERROR;
+	for(i = 0; i < driver->nof_registers; i++) {
+		reg = &driver->registers[i];
+		if(reg->name == NULL || (reg->mode & FLINK_REG_RW) == 0 || (reg->mode & ~(FLINK_REG_RW | FLINK_REG_BITS))) return EXIT_ERROR;
+		if((reg->offset != FLINK_REG_NEXT && reg->offset % REGISTER_WITH) || reg->stride % REGISTER_WITH) return EXIT_ERROR;
+		if((reg->mode & FLINK_REG_BITS) && reg->stride) return EXIT_ERROR;
+		for(k = 0; k < i; k++) {
+			if(strcmp(driver->registers[k].name, reg->name) == 0) return EXIT_ERROR;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Builds the register map of a subdevice from the driver of its function.
+ * @return flink_custom_map*: The map, NULL in case of failure.
+ */
+static struct _flink_custom_map* custom_bind(flink_subdev* subdev) {
+	const flink_driver* driver = NULL;
+	struct _flink_custom_map* map;
+	const flink_register* reg;
+	custom_reg* r;
+	uint32_t offset = HEADER_SIZE + SUBHEADER_SIZE, names_size = 0, i;
+	char* names;
+
+	pthread_mutex_lock(&drivers_lock);
+	map = __atomic_load_n(&subdev->custom, __ATOMIC_ACQUIRE);
+	if(map) {
+		pthread_mutex_unlock(&drivers_lock);
+		return map;
+	}
+	for(i = 0; i < CUSTOM_MAX_DRIVERS; i++) {
+		if(drivers[i].registers && drivers[i].function_id == subdev->function_id && drivers[i].sub_function_id == subdev->sub_function_id) {
+			driver = &drivers[i];
+			break;
+		}
+	}
+	if(driver == NULL) {
+		pthread_mutex_unlock(&drivers_lock);
+		flink_error(FLINK_WRONGSUBDEVT);
+		return NULL;
+	}
+
+	for(i = 0; i < driver->nof_registers; i++) names_size += strlen(driver->registers[i].name) + 1;
+	map = malloc(sizeof(struct _flink_custom_map) + driver->nof_registers * sizeof(custom_reg) + names_size);
+	if(map == NULL) {
+		pthread_mutex_unlock(&drivers_lock);
+		libc_error();
+		return NULL;
+	}
+	map->nof_registers = driver->nof_registers;
+	names = (char*)&map->registers[map->nof_registers];
+	for(i = 0; i < driver->nof_registers; i++) {
+		reg = &driver->registers[i];
+		r = &map->registers[i];
+		r->offset = reg->offset == FLINK_REG_NEXT ? offset : HEADER_SIZE + SUBHEADER_SIZE + reg->offset;
+		r->stride = reg->stride;
+		r->mode = reg->mode;
+		custom_reg_size(reg, subdev->nof_channels, &r->nof_values, &r->size);
+		if(r->offset < HEADER_SIZE + SUBHEADER_SIZE || r->offset > subdev->mem_size || r->size > subdev->mem_size - r->offset) {
+			dbg_print("Register %s of driver %s exceeds subdevice %u\n", reg->name, driver->name, subdev->id);
+			pthread_mutex_unlock(&drivers_lock);
+			free(map);
+			flink_error(FLINK_EINVALARG);
+			return NULL;
+		}
+		offset = r->offset + r->size;
+		r->name = names;
+		strcpy(names, reg->name);
+		names += strlen(reg->name) + 1;
+	}
+	__atomic_store_n(&subdev->custom, map, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&drivers_lock);
+	return map;
+}
+
+/**
+ * @brief Gets the register map of a subdevice, binding it on first use.
+ */
+static inline struct _flink_custom_map* custom_map(flink_subdev* subdev) {
+	struct _flink_custom_map* map;
+
+	if(subdev == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return NULL;
+	}
+	map = __atomic_load_n(&subdev->custom, __ATOMIC_ACQUIRE);
+	return map ? map : custom_bind(subdev);
+}
+
+/**
+ * @brief Gets a register of a subdevice and checks the channel and the access.
+ */
+static inline const custom_reg* custom_get(flink_subdev* subdev, int reg, uint32_t channel, uint32_t mode) {
+	struct _flink_custom_map* map = custom_map(subdev);
+
+	if(map == NULL) return NULL;
+	if(reg < 0 || (uint32_t)reg >= map->nof_registers) {
+		flink_error(FLINK_EINVALARG);
+		return NULL;
+	}
+	if(channel >= map->registers[reg].nof_values) {
+		flink_error(FLINK_EINVALCHAN);
+		return NULL;
+	}
+	if((map->registers[reg].mode & mode) == 0) {
+		flink_error(FLINK_ENOTPERMITTED);
+		return NULL;
+	}
+	return &map->registers[reg];
+}
+
+static int custom_compare_offset(const void* a, const void* b) {
+	const custom_transfer* x = a;
+	const custom_transfer* y = b;
+	return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Registers a driver for the subdevices of a function.
+ * A driver registered before for the same function is replaced. Subdevices
+ * accessed before keep the register map of the previous driver.
+ * @param driver: Driver, copied. The register map is referenced.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_custom_register_driver(const flink_driver* driver) {
+	flink_driver* free_entry = NULL;
+	int i, ret = EXIT_SUCCESS;
+
+	if(driver == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(custom_check_driver(driver) < 0) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&drivers_lock);
+	for(i = 0; i < CUSTOM_MAX_DRIVERS; i++) {
+		if(drivers[i].registers && drivers[i].function_id == driver->function_id && drivers[i].sub_function_id == driver->sub_function_id) {
+			memset(&drivers[i], 0, sizeof(flink_driver));
+		}
+		if(free_entry == NULL && drivers[i].registers == NULL) free_entry = &drivers[i];
+	}
+	if(free_entry) {
+		*free_entry = *driver;
+	}
+	else {
+		flink_error(FLINK_ENOSPACE);
+		ret = EXIT_ERROR;
+	}
+	pthread_mutex_unlock(&drivers_lock);
+	return ret;
+}
+
+/**
+ * @brief Removes the driver of a function.
+ * @param function_id: Function id.
+ * @param sub_function_id: Sub function id.
+ * @return int: 0 on success, -1 if no driver is registered for the function.
+ */
+int flink_custom_unregister_driver(uint16_t function_id, uint8_t sub_function_id) {
+	int i, ret = EXIT_ERROR;
+
+	pthread_mutex_lock(&drivers_lock);
+	for(i = 0; i < CUSTOM_MAX_DRIVERS; i++) {
+		if(drivers[i].registers && drivers[i].function_id == function_id && drivers[i].sub_function_id == sub_function_id) {
+			memset(&drivers[i], 0, sizeof(flink_driver));
+			ret = EXIT_SUCCESS;
+		}
+	}
+	pthread_mutex_unlock(&drivers_lock);
+	if(ret < 0) flink_error(FLINK_ENOTAVAIL);
+	return ret;
+}
+
+/**
+ * @brief Looks up a register of a custom subdevice by its name.
+ * @param subdev: Subdevice.
+ * @param name: Name of the register in the driver.
+ * @return int: Index of the register, -1 in case of failure.
+ */
+int flink_custom_get_register(flink_subdev* subdev, const char* name) {
+	struct _flink_custom_map* map = custom_map(subdev);
+	uint32_t i;
+
+	if(map == NULL) return EXIT_ERROR;
+	if(name == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	for(i = 0; i < map->nof_registers; i++) {
+		if(strcmp(map->registers[i].name, name) == 0) return i;
+	}
+	flink_error(FLINK_ENOTAVAIL);
+	return EXIT_ERROR;
+}
+
+/**
+ * @brief Reads a register of a custom subdevice.
+ * @param subdev: Subdevice.
+ * @param reg: Index of the register.
+ * @param channel: Channel, 0 for a register common to all channels.
+ * @param value: Contains the value of the register, 0 or 1 for a register with one bit per channel.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_custom_read(flink_subdev* subdev, int reg, uint32_t channel, uint32_t* value) {
+	const custom_reg* r;
+	uint8_t bit;
+
+	if(value == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	r = custom_get(subdev, reg, channel, FLINK_REG_READ);
+	if(r == NULL) return EXIT_ERROR;
+
+	if(r->mode & FLINK_REG_BITS) {
+		if(flink_read_bit(subdev, r->offset + channel / CUSTOM_BITS * REGISTER_WITH, channel % CUSTOM_BITS, &bit)) {
+			libc_error();
+			return EXIT_ERROR;
+		}
+		*value = bit;
+	}
+	else if(flink_read(subdev, r->offset + channel * r->stride, REGISTER_WITH, value) != REGISTER_WITH) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Writes a register of a custom subdevice.
+ * @param subdev: Subdevice.
+ * @param reg: Index of the register.
+ * @param channel: Channel, 0 for a register common to all channels.
+ * @param value: Value, 0 or 1 for a register with one bit per channel.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_custom_write(flink_subdev* subdev, int reg, uint32_t channel, uint32_t value) {
+	const custom_reg* r;
+	uint8_t bit;
+
+	r = custom_get(subdev, reg, channel, FLINK_REG_WRITE);
+	if(r == NULL) return EXIT_ERROR;
+
+	if(r->mode & FLINK_REG_BITS) {
+		bit = value ? 1 : 0;
+		if(flink_write_bit(subdev, r->offset + channel / CUSTOM_BITS * REGISTER_WITH, channel % CUSTOM_BITS, &bit)) {
+			libc_error();
+			return EXIT_ERROR;
+		}
+	}
+	else if(flink_write(subdev, r->offset + channel * r->stride, REGISTER_WITH, &value) != REGISTER_WITH) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Creates a plan reading all channels of several registers of a custom subdevice.
+ * @param subdev: Subdevice.
+ * @param regs: Indices of the registers, all readable.
+ * @param nof_regs: Nof registers.
+ * @return flink_custom_plan*: The plan, NULL in case of failure.
+ */
+flink_custom_plan* flink_custom_plan_create(flink_subdev* subdev, const int* regs, uint32_t nof_regs) {
+	flink_custom_plan* plan;
+	const custom_reg* r;
+	custom_transfer* t;
+	uint32_t i, k, n, nof_words = 0, offset;
+
+	if(regs == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return NULL;
+	}
+	for(i = 0; i < nof_regs; i++) {
+		if(custom_get(subdev, regs[i], 0, FLINK_REG_READ) == NULL) return NULL;
+	}
+	plan = calloc(1, sizeof(flink_custom_plan));
+	if(plan == NULL) {
+		libc_error();
+		return NULL;
+	}
+	plan->subdev = subdev;
+	plan->transfers = malloc(nof_regs * sizeof(custom_transfer) + 1);
+
+	// Registers sorted by offset, contiguous and overlapping ones merged
+	for(i = 0; plan->transfers && i < nof_regs; i++) {
+		r = &subdev->custom->registers[regs[i]];
+		plan->transfers[i].offset = r->offset;
+		plan->transfers[i].size = r->size;
+		plan->nof_values += r->nof_values;
+	}
+	if(plan->transfers && nof_regs) {
+		qsort(plan->transfers, nof_regs, sizeof(custom_transfer), custom_compare_offset);
+		for(i = 1, n = 0; i < nof_regs; i++) {
+			t = &plan->transfers[n];
+			if(plan->transfers[i].offset <= t->offset + t->size) {
+				if(plan->transfers[i].offset + plan->transfers[i].size > t->offset + t->size) {
+					t->size = plan->transfers[i].offset + plan->transfers[i].size - t->offset;
+				}
+			}
+			else {
+				plan->transfers[++n] = plan->transfers[i];
+			}
+		}
+		plan->nof_transfers = n + 1;
+		for(i = 0; i < plan->nof_transfers; i++) {
+			plan->transfers[i].word = nof_words;
+			nof_words += plan->transfers[i].size / REGISTER_WITH;
+		}
+	}
+	plan->buffer = malloc(nof_words * REGISTER_WITH + 1);
+	plan->sources = malloc(plan->nof_values * sizeof(custom_source) + 1);
+	if(plan->transfers == NULL || plan->buffer == NULL || plan->sources == NULL) {
+		flink_custom_plan_destroy(plan);
+		libc_error();
+		return NULL;
+	}
+
+	// Source of every value in the buffer
+	for(i = 0, n = 0; i < nof_regs; i++) {
+		r = &subdev->custom->registers[regs[i]];
+		if(r->nof_values == 0) continue;
+		for(t = plan->transfers; r->offset >= t->offset + t->size; t++);
+		for(k = 0; k < r->nof_values; k++, n++) {
+			if(r->mode & FLINK_REG_BITS) {
+				offset = r->offset + k / CUSTOM_BITS * REGISTER_WITH;
+				plan->sources[n].bit = k % CUSTOM_BITS;
+			}
+			else {
+				offset = r->offset + k * r->stride;
+				plan->sources[n].bit = CUSTOM_NO_BIT;
+			}
+			plan->sources[n].word = t->word + (offset - t->offset) / REGISTER_WITH;
+		}
+	}
+	dbg_print("Plan of subdevice %u: %u values in %u transfers\n", subdev->id, plan->nof_values, plan->nof_transfers);
+	return plan;
+}
+
+/**
+ * @brief Returns the number of values read by a plan.
+ * @param plan: Plan.
+ * @return uint32_t: Nof channels of all registers of the plan, 1 for each register common to all channels.
+ */
+uint32_t flink_custom_plan_get_nof_values(flink_custom_plan* plan) {
+	if(plan == NULL) return 0;
+	return plan->nof_values;
+}
+
+/**
+ * @brief Reads the registers of a plan.
+ * @param plan: Plan.
+ * @param values: Array with flink_custom_plan_get_nof_values() entries, contains the values of all channels of
+ *                one register after the other, in the order the registers were given.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_custom_plan_read(flink_custom_plan* plan, uint32_t* values) {
+	const custom_source* s;
+	uint32_t i;
+
+	if(plan == NULL || values == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	for(i = 0; i < plan->nof_transfers; i++) {
+		if(flink_read_block(plan->subdev, plan->transfers[i].offset, plan->transfers[i].size, plan->buffer + plan->transfers[i].word) != plan->transfers[i].size) {
+			libc_error();
+			return EXIT_ERROR;
+		}
+	}
+	for(i = 0, s = plan->sources; i < plan->nof_values; i++, s++) {
+		values[i] = s->bit == CUSTOM_NO_BIT ? plan->buffer[s->word] : plan->buffer[s->word] >> s->bit & 1;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Frees a plan.
+ * @param plan: Plan.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_custom_plan_destroy(flink_custom_plan* plan) {
+	if(plan == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	free(plan->transfers);
+	free(plan->buffer);
+	free(plan->sources);
+	free(plan);
+	return EXIT_SUCCESS;
+}
@@ -18,12 +18,15 @@
  *  @author Martin Züger
  */
 
+#include "flinklib.h"
 #include "error.h"
 #include <errno.h>
 #include "log.h"
+#include "trace.h"
 #include <string.h>
 
 __thread int flink_errno = 0;
+static __thread int recorded = 0;		// flink_errno is recorded and still in errno, reporting it again adds nothing
 
 const char* flinklib_error_strings[] = {
 	"No error",
@@ -35,6 +38,14 @@ const char* flinklib_error_strings[] = {
 	"Null ptr as argument",
 	"Unknown ioctl command",
 	"Wrong subdevice type",
+	"Queue full",
+	"Timeout",
+	"Invalid argument",
+	"Busy",
+	"Not permitted",
+	"Not available",
+	"No space left",
+	"Shut down",
 };
 #define NOF_ERRORS (sizeof(flinklib_error_strings) / sizeof(char*))
 
@@ -53,17 +64,39 @@ void flink_perror(const char* p) {
 }
 
 
+int flink_get_errno(void) {
+	return flink_errno;
+}
+
+
 void libc_error(void) {
+	if(recorded && flink_errno == errno) return;	// passed up from a failed operation or a called function
 	flink_errno = errno;
-	if(PRINT_ERRORS_TO_STDERR){
-		flink_perror("libc error");
+	recorded = 1;
+	if(flink_trace_enabled(FLINK_TRACE_ERRORS)) {
+		flink_trace_record(FLINK_TRACE_OP_ERROR, -1, 0, flink_errno, __builtin_return_address(0));
 	}
 }
 
 
 void flink_error(int e) {
 	flink_errno = e;
-	if(PRINT_ERRORS_TO_STDERR){
-		flink_perror("flink error");
+	errno = e;		// for the libc_error() of the caller
+	recorded = 1;
+	if(flink_trace_enabled(FLINK_TRACE_ERRORS)) {
+		flink_trace_record(FLINK_TRACE_OP_ERROR, -1, 0, e, __builtin_return_address(0));
+	}
+}
+
+
+void flink_op_done(uint16_t op, int subdev, uint32_t offset, int failed) {
+	if(failed) {
+		flink_errno = errno;
+		recorded = 1;
+		if(flink_trace_enabled(FLINK_TRACE_ERRORS)) flink_trace_record(op, subdev, offset, flink_errno, NULL);
+		errno = flink_errno;	// for the libc_error() of the caller
+		return;
 	}
+	recorded = 0;
+	if(flink_trace_enabled(FLINK_TRACE_ALL)) flink_trace_record(op, subdev, offset, 0, NULL);
 }
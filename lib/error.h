@@ -23,19 +23,13 @@
 
 // ############ Errorhandling ############
 
-#define FLINK_NOERROR		0x2000					// No error
-#define FLINK_EUNKNOWN		(FLINK_NOERROR + 1)		// Unknown error
-#define FLINK_ENOTSUPPORTED	(FLINK_NOERROR + 2)		// Not supported
-#define FLINK_EINVALDEV		(FLINK_NOERROR + 3)		// Invalid device
-#define FLINK_EINVALSUBDEV	(FLINK_NOERROR + 4)		// Invalid subdevice
-#define FLINK_EINVALCHAN	(FLINK_NOERROR + 5)		// Invalid channel
-#define FLINK_ENULLPTR		(FLINK_NOERROR + 6)		// Null ptr as argument
-#define FLINK_UNKNOWNIOCTL	(FLINK_NOERROR + 7)		// Unknown ioctl command
-#define FLINK_WRONGSUBDEVT	(FLINK_NOERROR + 8)		// Wrong subdevice type
+// The error codes are defined in flinklib.h
+#include "flinklib.h"
+
+extern __thread int flink_errno;
 
-const char* flink_strerror(int e);
-void flink_perror(const char* p);
 void libc_error(void);
 void flink_error(int e);
+void flink_op_done(uint16_t op, int subdev, uint32_t offset, int failed);	// records an operation, sets flink_errno from errno if it failed
 
 #endif // FLINKLIB_ERROR_H_
@@ -0,0 +1,360 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, shared process image                  *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file image.c
+ *  @brief Sharing of sampled values between processes.
+ *
+ *  A process image is a POSIX shared memory segment holding a header
+ *  and a ring of samples, each with a timestamp and a fixed number of
+ *  values. One process publishes samples, any number of processes read
+ *  them without system calls and without copying.
+ *
+ *  Every sample is protected by its own sequence number, which is odd
+ *  while the sample is written and 2 * (index + 1) when sample number
+ *  index is complete. A reader checks the sequence number before and
+ *  after using a sample; if it changed, the publisher has overwritten
+ *  the sample meanwhile. The header holds the number of samples
+ *  published, the latest sample is the one before.
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "error.h"
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define IMAGE_MAGIC		"FLINKIMG"
+#define IMAGE_VERSION	1
+#define IMAGE_ALIGN		64		// cache line, samples do not share lines
+#define IMAGE_ROUND(x)	(((x) + IMAGE_ALIGN - 1) / IMAGE_ALIGN * IMAGE_ALIGN)
+
+typedef struct _image_header {
+	char     magic[8];			/// IMAGE_MAGIC
+	uint32_t version;			/// IMAGE_VERSION
+	uint32_t nof_values;		/// Values per sample
+	uint32_t history;			/// Samples in the ring
+	uint32_t sample_size;		/// Bytes per sample including the padding
+	uint64_t head;				/// Nof samples published
+} image_header;
+
+struct _flink_image {
+	image_header* header;
+	uint8_t*      samples;
+	size_t        size;			/// Size of the mapping
+	char*         name;			/// Name of the segment, set if created by this process
+};
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static inline flink_image_sample* image_slot(flink_image* image, uint64_t index) {
+	return (flink_image_sample*)(image->samples + (index % image->header->history) * image->header->sample_size);
+}
+
+/**
+ * @brief Marks the next sample as being written.
+ * @return flink_image_sample*: The sample.
+ */
+static flink_image_sample* begin_sample(flink_image* image, uint64_t index) {
+	flink_image_sample* s = image_slot(image, index);
+
+	__atomic_store_n(&s->seq, 2 * index + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	s->time_ns = flink_time_ns();
+	return s;
+}
+
+static void end_sample(flink_image* image, flink_image_sample* s, uint64_t index) {
+	__atomic_store_n(&s->seq, 2 * index + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&image->header->head, index + 1, __ATOMIC_RELEASE);
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Creates a process image to publish samples.
+ * An existing image with the same name is replaced.
+ * @param name: Name of the shared memory segment, e.g. "/flink_inputs".
+ * @param nof_values: Values per sample.
+ * @param history: Nof samples kept in the ring.
+ * @return flink_image*: The image, NULL in case of failure.
+ */
+flink_image* flink_image_create(const char* name, uint32_t nof_values, uint32_t history) {
+	flink_image* image;
+	uint32_t sample_size = IMAGE_ROUND(sizeof(flink_image_sample) + (uint64_t)nof_values * sizeof(uint32_t));
+	int fd;
+
+	if(name == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return NULL;
+	}
+	if(nof_values == 0 || history == 0 || nof_values > (UINT32_MAX - IMAGE_ALIGN - sizeof(flink_image_sample)) / sizeof(uint32_t)) {
+		flink_error(FLINK_EINVALARG);
+		return NULL;
+	}
+	image = calloc(1, sizeof(flink_image));
+	if(image == NULL) {
+		libc_error();
+		return NULL;
+	}
+	image->size = IMAGE_ROUND(sizeof(image_header)) + (size_t)history * sample_size;
+	image->name = strdup(name);
+
+	shm_unlink(name);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if(image->name == NULL || fd < 0 || ftruncate(fd, image->size) < 0) {
+		libc_error();
+		if(fd >= 0) {
+			close(fd);
+			shm_unlink(name);
+		}
+		free(image->name);
+		free(image);
+		return NULL;
+	}
+	image->header = mmap(NULL, image->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(image->header == MAP_FAILED) {
+		libc_error();
+		shm_unlink(name);
+		free(image->name);
+		free(image);
+		return NULL;
+	}
+	image->samples = (uint8_t*)image->header + IMAGE_ROUND(sizeof(image_header));
+
+	image->header->version = IMAGE_VERSION;
+	image->header->nof_values = nof_values;
+	image->header->history = history;
+	image->header->sample_size = sample_size;
+	__atomic_store_n(&image->header->head, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(image->header->magic, IMAGE_MAGIC, sizeof(image->header->magic));	// readers accept the image from now on
+	return image;
+}
+
+/**
+ * @brief Publishes a sample, stamped with the current time (CLOCK_MONOTONIC).
+ * Only the process which created the image publishes, from one thread at a time.
+ * @param image: Image created by flink_image_create().
+ * @param values: nof_values values.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_image_publish(flink_image* image, const uint32_t* values) {
+	flink_image_sample* s;
+	uint64_t index;
+
+	if(image == NULL || values == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(image->name == NULL) {
+		flink_error(FLINK_ENOTPERMITTED);	// opened by a reader
+		return EXIT_ERROR;
+	}
+	index = image->header->head;
+	s = begin_sample(image, index);
+	memcpy(s->values, values, image->header->nof_values * sizeof(uint32_t));
+	end_sample(image, s, index);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Reads nof_values consecutive registers in one block transfer directly into the next sample and publishes it.
+ * @param image: Image created by flink_image_create().
+ * @param subdev: Subdevice to read.
+ * @param offset: Offset of the first register.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_image_publish_registers(flink_image* image, flink_subdev* subdev, uint32_t offset) {
+	flink_image_sample* s;
+	uint32_t size;
+	uint64_t index;
+
+	if(image == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(image->name == NULL) {
+		flink_error(FLINK_ENOTPERMITTED);	// opened by a reader
+		return EXIT_ERROR;
+	}
+	index = image->header->head;
+	size = image->header->nof_values * REGISTER_WITH;
+	s = begin_sample(image, index);
+	if(flink_read_block(subdev, offset, size, s->values) != size) {
+		libc_error();	// the slot stays marked as being written until the next sample
+		return EXIT_ERROR;
+	}
+	end_sample(image, s, index);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Opens a process image published by another process.
+ * @param name: Name of the shared memory segment.
+ * @return flink_image*: The image, NULL in case of failure.
+ */
+flink_image* flink_image_open(const char* name) {
+	flink_image* image;
+	struct stat st;
+	int fd;
+
+	if(name == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return NULL;
+	}
+	image = calloc(1, sizeof(flink_image));
+	if(image == NULL) {
+		libc_error();
+		return NULL;
+	}
+	fd = shm_open(name, O_RDONLY, 0);
+	if(fd < 0 || fstat(fd, &st) < 0) {
+		libc_error();
+		if(fd >= 0) close(fd);
+		free(image);
+		return NULL;
+	}
+	image->size = st.st_size;
+	image->header = image->size >= sizeof(image_header) ? mmap(NULL, image->size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+	if(image->header == MAP_FAILED) {
+		if(image->size < sizeof(image_header)) flink_error(FLINK_EINVALARG);
+		else libc_error();
+		free(image);
+		return NULL;
+	}
+	if(memcmp(image->header->magic, IMAGE_MAGIC, sizeof(image->header->magic)) != 0 || image->header->version != IMAGE_VERSION ||
+	   image->header->history == 0 || image->size < IMAGE_ROUND(sizeof(image_header)) + (size_t)image->header->history * image->header->sample_size) {
+		flink_error(FLINK_EINVALARG);
+		munmap(image->header, image->size);
+		free(image);
+		return NULL;
+	}
+	image->samples = (uint8_t*)image->header + IMAGE_ROUND(sizeof(image_header));
+	return image;
+}
+
+/**
+ * @brief Closes a process image. The creator also removes the shared memory segment.
+ * @param image: Image to close.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_image_close(flink_image* image) {
+	if(image == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	munmap(image->header, image->size);
+	if(image->name) {
+		shm_unlink(image->name);
+		free(image->name);
+	}
+	free(image);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Get the number of values per sample.
+ * @param image: Process image.
+ * @return uint32_t: Nof values.
+ */
+uint32_t flink_image_get_nof_values(flink_image* image) {
+	return image->header->nof_values;
+}
+
+/**
+ * @brief Get the number of samples kept in the ring.
+ * @param image: Process image.
+ * @return uint32_t: Nof samples.
+ */
+uint32_t flink_image_get_history(flink_image* image) {
+	return image->header->history;
+}
+
+/**
+ * @brief Get the number of samples published so far, the latest has the index one less.
+ * @param image: Process image.
+ * @return uint64_t: Nof samples.
+ */
+uint64_t flink_image_get_head(flink_image* image) {
+	return __atomic_load_n(&image->header->head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Gets a sample in place, without copying.
+ * The values may be overwritten while they are used. Check with
+ * flink_image_sample_valid() after using them.
+ * @param image: Process image.
+ * @param index: Index of the sample.
+ * @return const flink_image_sample*: The sample, NULL if it is not or no longer available.
+ */
+const flink_image_sample* flink_image_get_sample(flink_image* image, uint64_t index) {
+	flink_image_sample* s = image_slot(image, index);
+
+	if(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != 2 * index + 2) return NULL;
+	return s;
+}
+
+/**
+ * @brief Checks if a sample was left untouched since flink_image_get_sample().
+ * @param image: Process image.
+ * @param sample: Sample got by flink_image_get_sample().
+ * @param index: Index of the sample.
+ * @return int: 1 if the values used are consistent, 0 if the sample was overwritten.
+ */
+int flink_image_sample_valid(flink_image* image, const flink_image_sample* sample, uint64_t index) {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&sample->seq, __ATOMIC_RELAXED) == 2 * index + 2;
+}
+
+/**
+ * @brief Copies a sample.
+ * @param image: Process image.
+ * @param index: Index of the sample.
+ * @param values: Contains the nof_values values.
+ * @param time_ns: Contains the time the sample was published, may be NULL.
+ * @return int: 0 on success, -1 if the sample is not or no longer available.
+ */
+int flink_image_read(flink_image* image, uint64_t index, uint32_t* values, uint64_t* time_ns) {
+	const flink_image_sample* s = flink_image_get_sample(image, index);
+
+	if(s == NULL) {
+		flink_error(FLINK_ENOTAVAIL);
+		return EXIT_ERROR;
+	}
+	memcpy(values, s->values, image->header->nof_values * sizeof(uint32_t));
+	if(time_ns) *time_ns = s->time_ns;
+	if(!flink_image_sample_valid(image, s, index)) {
+		flink_error(FLINK_ENOTAVAIL);
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
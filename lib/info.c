@@ -25,33 +25,120 @@
 #include "types.h"
 #include "error.h"
 #include "log.h"
+#include "valid.h"
 
 #include <stdint.h>
+#include <string.h>
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME        0x100000001b3ULL
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+	const uint8_t* p = data;
+	while(size--) {
+		hash ^= *p++;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
 
 /**
  * @brief Reads the description field of an info subdevice
+ * The description is read in a single transfer on first use and
+ * served from a copy kept with the device handle afterwards.
  * @param subdev: Subdevice.
  * @param desc: String containing the description.
  * @return int: 0 on success, -1 in case of failure.
  */
 int flink_info_get_description(flink_subdev* subdev, char* desc) {
+	flink_dev* dev = subdev->parent;
 	uint32_t offset;
 	int i, k;
-	uint32_t data;
+	uint32_t data[INFO_DESC_SIZE / REGISTER_WITH];
+	
+	if(desc == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	
+	pthread_mutex_lock(&dev->block_lock);
+	if(dev->info_subdev == subdev->id) {
+		memcpy(desc, dev->info_desc, INFO_DESC_SIZE);
+		pthread_mutex_unlock(&dev->block_lock);
+		return EXIT_SUCCESS;
+	}
+	pthread_mutex_unlock(&dev->block_lock);
 	
 	dbg_print("Reading description from info subdevice with id %d\n", subdev->id);
 	
 	offset = HEADER_SIZE + SUBHEADER_SIZE + REGISTER_WITH;
-	for(i = 0; i < INFO_DESC_SIZE; i += 4, offset += 4) {
-		if(flink_read(subdev, offset, 4, &data) != REGISTER_WITH) {
-			libc_error();
-			return EXIT_ERROR;
-		}
+	if(flink_read_block(subdev, offset, INFO_DESC_SIZE, data) != INFO_DESC_SIZE) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	for(i = 0; i < INFO_DESC_SIZE / REGISTER_WITH; i++) {
 		for (k = REGISTER_WITH - 1; k >= 0; k--) {
-			*((uint8_t *)desc) = (uint8_t)(data >> (k * 8));
+			*((uint8_t *)desc) = (uint8_t)(data[i] >> (k * 8));
 			desc++;
 		}
-		dbg_print("\t 0x%x\n", data);	
+		dbg_print("\t 0x%x\n", data[i]);	
 	}
+	desc -= INFO_DESC_SIZE;
+	
+	pthread_mutex_lock(&dev->block_lock);
+	memcpy(dev->info_desc, desc, INFO_DESC_SIZE);
+	dev->info_subdev = subdev->id;
+	pthread_mutex_unlock(&dev->block_lock);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Gets a fingerprint identifying the FPGA design of a device.
+ * The fingerprint is a 64 bit FNV-1a hash over the header of all subdevices
+ * and the description of the first info subdevice. It changes whenever
+ * another design is loaded and can be used as a key for cached device data.
+ * @param dev: Device.
+ * @param fingerprint: Contains the fingerprint.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_get_fingerprint(flink_dev* dev, uint64_t* fingerprint) {
+	uint64_t hash = FNV_OFFSET_BASIS;
+	char desc[INFO_DESC_SIZE];
+	flink_subdev* subdev;
+	int i, info_found = 0;
+	
+	if(!validate_flink_dev(dev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	if(fingerprint == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(dev->fingerprint) {
+		*fingerprint = dev->fingerprint;
+		return EXIT_SUCCESS;
+	}
+	
+	hash = fnv1a(hash, &dev->nof_subdevices, sizeof(dev->nof_subdevices));
+	for(i = 0; i < dev->nof_subdevices; i++) {
+		subdev = dev->subdevices + i;
+		hash = fnv1a(hash, &subdev->function_id, sizeof(subdev->function_id));
+		hash = fnv1a(hash, &subdev->sub_function_id, sizeof(subdev->sub_function_id));
+		hash = fnv1a(hash, &subdev->function_version, sizeof(subdev->function_version));
+		hash = fnv1a(hash, &subdev->base_addr, sizeof(subdev->base_addr));
+		hash = fnv1a(hash, &subdev->mem_size, sizeof(subdev->mem_size));
+		hash = fnv1a(hash, &subdev->nof_channels, sizeof(subdev->nof_channels));
+		hash = fnv1a(hash, &subdev->unique_id, sizeof(subdev->unique_id));
+		if(!info_found && subdev->function_id == INFO_DEVICE_ID) {
+			if(flink_info_get_description(subdev, desc) < 0) return EXIT_ERROR;
+			hash = fnv1a(hash, desc, INFO_DESC_SIZE);
+			info_found = 1;
+		}
+	}
+	if(hash == 0) hash = 1; // 0 marks a fingerprint not yet computed
+	
+	dev->fingerprint = hash;
+	*fingerprint = hash;
 	return EXIT_SUCCESS;
 }
@@ -25,9 +25,43 @@
 #include "flinkioctl.h"
 #include "types.h"
 #include "error.h"
+#include "valid.h"
 #include "log.h"
+#include "probes.h"
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define IRQ_TABLE_OFFSET (HEADER_SIZE + SUBHEADER_SIZE)
+#define IRQ_TABLE_MERGE_GAP 2	// unchanged entries rewritten to merge two changed runs into one transfer
+
+FLINK_PROBE_DEFINE(irq_register);
+FLINK_PROBE_DEFINE(irq_unregister);
+
+/**
+ * @brief Reads the multiplexer table into the subdevice cache.
+ * The irq_lock of the device must be held.
+ */
+static int irq_table_load(flink_subdev *subdev) {
+	uint32_t size = subdev->nof_channels * REGISTER_WITH;
+	
+	if(subdev->irq_table == NULL) {
+		subdev->irq_table = malloc(size);
+		if(subdev->irq_table == NULL) {
+			libc_error();
+			return EXIT_ERROR;
+		}
+	}
+	if(flink_read_block(subdev, IRQ_TABLE_OFFSET, size, subdev->irq_table) != size) {
+		free(subdev->irq_table);
+		subdev->irq_table = NULL;
+		libc_error();
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
 
 /**
  * @brief Registers a irq handler
@@ -45,6 +79,7 @@ int flink_register_irq(flink_dev *dev, uint32_t irq_number){
 
 	// read data from device
 	read_size = flink_ioctl(dev, REGISTER_IRQ, &ioctl_arg);
+	FLINK_PROBE2(irq_register, irq_number, read_size);
 	if(read_size < 0) {
 		libc_error();
 		return EXIT_ERROR;
@@ -69,6 +104,7 @@ int flink_unregister_irq(flink_dev *dev, uint32_t irq_number){
 
 	// read data from device
 	read_size = flink_ioctl(dev, UNREGISTER_IRQ, &ioctl_arg);
+	FLINK_PROBE2(irq_unregister, irq_number, read_size);
 	if(read_size < 0) {
 		libc_error();
 		return EXIT_ERROR;
@@ -114,10 +150,18 @@ int flink_set_irq_multiplex(flink_subdev *subdev, uint32_t irq, uint32_t flink_i
 	offset = HEADER_SIZE + SUBHEADER_SIZE + REGISTER_WITH*irq;
 	dbg_print("  --> calculated offset is 0x%x!\n", offset);
 
+	if(!validate_flink_subdev(subdev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&subdev->parent->irq_lock);
 	if(flink_write(subdev, offset, REGISTER_WITH, &flink_irq) != REGISTER_WITH) {
+		pthread_mutex_unlock(&subdev->parent->irq_lock);
 		libc_error();
 		return EXIT_ERROR;
 	}
+	if(subdev->irq_table && irq < subdev->nof_channels) subdev->irq_table[irq] = flink_irq;
+	pthread_mutex_unlock(&subdev->parent->irq_lock);
 
 	return EXIT_SUCCESS;
 }
@@ -141,3 +185,83 @@ int flink_get_irq_multiplex(flink_subdev *subdev, uint32_t irq, uint32_t *flink_
 	}
 	return EXIT_SUCCESS;
 }
+
+
+/**
+ * @brief Programs the whole multiplexer table.
+ * The table is compared with a cached copy of the multiplexer registers,
+ * read in a single transfer on first use. Only runs of changed entries
+ * are written, each run in a single transfer.
+ * @param subdev: Flink subdevice.
+ * @param table: Source IRQ for each destination IRQ, one entry per channel of the subdevice.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_set_irq_multiplex_table(flink_subdev *subdev, const uint32_t *table) {
+	uint32_t first, last, i, size;
+	int ret = EXIT_SUCCESS;
+
+	if(table == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(!validate_flink_subdev(subdev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&subdev->parent->irq_lock);
+	if(subdev->irq_table == NULL && irq_table_load(subdev) < 0) {
+		pthread_mutex_unlock(&subdev->parent->irq_lock);
+		return EXIT_ERROR;
+	}
+
+	i = 0;
+	while(i < subdev->nof_channels) {
+		if(table[i] == subdev->irq_table[i]) {
+			i++;
+			continue;
+		}
+		first = last = i;
+		for(i = first + 1; i < subdev->nof_channels && i <= last + IRQ_TABLE_MERGE_GAP + 1; i++) {
+			if(table[i] != subdev->irq_table[i]) last = i;
+		}
+		i = last + 1;
+		
+		size = (last - first + 1) * REGISTER_WITH;
+		dbg_print("  --> writing irq %u to %u\n", first, last);
+		if(flink_write_block(subdev, IRQ_TABLE_OFFSET + first * REGISTER_WITH, size, table + first) != size) {
+			free(subdev->irq_table); // state of the registers unknown
+			subdev->irq_table = NULL;
+			libc_error();
+			ret = EXIT_ERROR;
+			break;
+		}
+		memcpy(subdev->irq_table + first, table + first, size);
+	}
+	pthread_mutex_unlock(&subdev->parent->irq_lock);
+	return ret;
+}
+
+/**
+ * @brief Reads the whole multiplexer table in a single transfer.
+ * @param subdev: Flink subdevice.
+ * @param table: Contains the source IRQ for each destination IRQ, one entry per channel of the subdevice.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_get_irq_multiplex_table(flink_subdev *subdev, uint32_t *table) {
+	if(table == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(!validate_flink_subdev(subdev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&subdev->parent->irq_lock);
+	if(irq_table_load(subdev) < 0) {
+		pthread_mutex_unlock(&subdev->parent->irq_lock);
+		return EXIT_ERROR;
+	}
+	memcpy(table, subdev->irq_table, subdev->nof_channels * REGISTER_WITH);
+	pthread_mutex_unlock(&subdev->parent->irq_lock);
+	return EXIT_SUCCESS;
+}
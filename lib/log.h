@@ -15,6 +15,9 @@
 /** @file log.h
  *  @brief Debug utilities.
  *
+ *  If all operations are traced, debug messages are recorded in the
+ *  trace with their format string instead of being printed.
+ *
  *  @author Martin Züger
  */
 
@@ -23,9 +26,11 @@
 
 #include <stdio.h>
 
-#define PRINT_ERRORS_TO_STDERR 1
+#include "trace.h"
+
 #define DEBUG 0
 
-#define dbg_print(fmt, ...)      do { if(DEBUG) { printf("[flinklib] DEBUG: "); printf(fmt, ##__VA_ARGS__); } } while(0)
+#define dbg_print(fmt, ...)      do { if(DEBUG) { if(flink_trace_enabled(FLINK_TRACE_ALL)) flink_trace_record(FLINK_TRACE_OP_DEBUG, -1, 0, 0, fmt); \
+                                                  else { printf("[flinklib] DEBUG: "); printf(fmt, ##__VA_ARGS__); } } } while(0)
 
 #endif // FLINKLIB_LOGGING_H_
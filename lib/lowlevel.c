@@ -29,9 +29,127 @@
 #include "error.h"
 #include "log.h"
 #include "valid.h"
+#include "transport.h"
+#include "stats.h"
+#include "trace.h"
+#include "probes.h"
+#include "record.h"
 
-#include <sys/ioctl.h>
-#include <unistd.h>
+#include <errno.h>
+
+FLINK_PROBE_DEFINE(ioctl);
+FLINK_PROBE_DEFINE(read);
+FLINK_PROBE_DEFINE(write);
+FLINK_PROBE_DEFINE(read_bit);
+FLINK_PROBE_DEFINE(write_bit);
+FLINK_PROBE_DEFINE(read_block);
+FLINK_PROBE_DEFINE(write_block);
+
+#define ANY_PROBE_ENABLED() (FLINK_PROBE_ENABLED(ioctl) || FLINK_PROBE_ENABLED(read) || \
+	FLINK_PROBE_ENABLED(write) || FLINK_PROBE_ENABLED(read_bit) || FLINK_PROBE_ENABLED(write_bit) || \
+	FLINK_PROBE_ENABLED(read_block) || FLINK_PROBE_ENABLED(write_block))
+
+
+/**
+ * @brief Classifies an ioctl command.
+ * @param cmd: IOCTL command.
+ * @param arg: IOCTL arguments.
+ * @param subdev: Contains the id of the accessed subdevice or FLINK_STATS_NO_SUBDEV.
+ * @param offset: Contains the accessed register offset or 0.
+ * @param size: Contains the nof bytes accessed, 1 for bits.
+ * @param data: Contains the data read or written, NULL for other operations.
+ * @param bit: Contains the bit number of bit accesses.
+ * @return flink_op: Operation of the command.
+ */
+static flink_op ioctl_op(int cmd, void* arg, int* subdev, uint32_t* offset, uint32_t* size, void** data, uint8_t* bit) {
+	*subdev = FLINK_STATS_NO_SUBDEV;
+	*offset = 0;
+	*size = 0;
+	*data = NULL;
+	*bit = 0;
+	switch(cmd) {
+		case READ_NOF_SUBDEVICES:
+		case READ_SUBDEVICE_INFO:
+			return FLINK_OP_DEVICE_INFO;
+		case SELECT_SUBDEVICE:
+		case SELECT_SUBDEVICE_EXCL:
+			*subdev = *(uint8_t*)arg;
+			return FLINK_OP_SELECT;
+		case SELECT_AND_READ:
+			*subdev = ((ioctl_container_t*)arg)->subdevice;
+			*offset = ((ioctl_container_t*)arg)->offset;
+			*size = ((ioctl_container_t*)arg)->size;
+			*data = ((ioctl_container_t*)arg)->data;
+			return FLINK_OP_READ;
+		case SELECT_AND_WRITE:
+			*subdev = ((ioctl_container_t*)arg)->subdevice;
+			*offset = ((ioctl_container_t*)arg)->offset;
+			*size = ((ioctl_container_t*)arg)->size;
+			*data = ((ioctl_container_t*)arg)->data;
+			return FLINK_OP_WRITE;
+		case SELECT_AND_READ_BIT:
+			*subdev = ((ioctl_bit_container_t*)arg)->subdevice;
+			*offset = ((ioctl_bit_container_t*)arg)->offset;
+			*size = 1;
+			*data = &((ioctl_bit_container_t*)arg)->value;
+			*bit = ((ioctl_bit_container_t*)arg)->bit;
+			return FLINK_OP_READ_BIT;
+		case SELECT_AND_WRITE_BIT:
+			*subdev = ((ioctl_bit_container_t*)arg)->subdevice;
+			*offset = ((ioctl_bit_container_t*)arg)->offset;
+			*size = 1;
+			*data = &((ioctl_bit_container_t*)arg)->value;
+			*bit = ((ioctl_bit_container_t*)arg)->bit;
+			return FLINK_OP_WRITE_BIT;
+		case REGISTER_IRQ:
+		case UNREGISTER_IRQ:
+		case GET_SIGNAL_OFFSET:
+			return FLINK_OP_IRQ;
+		default:
+			return FLINK_OP_OTHER;
+	}
+}
+
+/**
+ * @brief Start time of an operation, 0 if no statistics, probe, Chrome trace or recording needs it.
+ */
+static inline uint64_t op_start(void) {
+	if(FLINK_STATS || ANY_PROBE_ENABLED() || flink_chrome_trace_active() || flink_record_active()) return flink_time_ns();
+	return 0;
+}
+
+/**
+ * @brief Records a finished operation in the statistics, the probes, the Chrome trace, the recording
+ * and the trace. Sets flink_errno if the operation failed.
+ * @param dev: Flink device handle.
+ * @param op: Operation.
+ * @param subdev: Id of the accessed subdevice or FLINK_STATS_NO_SUBDEV.
+ * @param offset: Accessed register offset.
+ * @param size: Nof bytes accessed.
+ * @param data: Data read or written, NULL for other operations.
+ * @param bit: Bit number of bit accesses.
+ * @param start: Start time as returned by op_start().
+ * @param ret: Return value of the transport.
+ */
+static void op_done(flink_dev* dev, flink_op op, int subdev, uint32_t offset, uint32_t size, const void* data, uint8_t bit, uint64_t start, ssize_t ret) {
+	int error = errno;
+	uint64_t end = start ? flink_time_ns() : 0;
+	
+	flink_stats_record(dev, op, subdev, end - start, ret < 0);
+	switch(op) {
+		case FLINK_OP_READ:        FLINK_PROBE5(read, subdev, offset, size, ret, end - start); break;
+		case FLINK_OP_WRITE:       FLINK_PROBE5(write, subdev, offset, size, ret, end - start); break;
+		case FLINK_OP_READ_BIT:    FLINK_PROBE5(read_bit, subdev, offset, size, ret, end - start); break;
+		case FLINK_OP_WRITE_BIT:   FLINK_PROBE5(write_bit, subdev, offset, size, ret, end - start); break;
+		case FLINK_OP_READ_BLOCK:  FLINK_PROBE5(read_block, subdev, offset, size, ret, end - start); break;
+		case FLINK_OP_WRITE_BLOCK: FLINK_PROBE5(write_block, subdev, offset, size, ret, end - start); break;
+		default: break;
+	}
+	if(start && flink_chrome_trace_active()) flink_chrome_trace_record(op, subdev, offset, size, start, end);
+	if(start && data && ret >= 0 && flink_record_active()) flink_record_op(dev, op, subdev, offset, bit, size, data, start);
+	errno = error;		// recording may have changed it
+	flink_op_done(op, subdev, offset, ret < 0);
+}
 
 
 /**
@@ -42,7 +160,12 @@
  * @return int: IOCTL return value or -1 in case of failure.
  */
 int flink_ioctl(flink_dev* dev, int cmd, void* arg) {
-	int ret;
+	uint32_t offset, size;
+	flink_op op;
+	int ret, subdev;
+	uint64_t start;
+	void* data;
+	uint8_t bit;
 	
 	dbg_print("flink_ioctl '0x%x'\n", cmd);
 	
@@ -51,10 +174,13 @@ int flink_ioctl(flink_dev* dev, int cmd, void* arg) {
 		return EXIT_ERROR;
 	}
 	
-	ret = ioctl(dev->fd, cmd, arg);
-	if(ret < 0) {
-		libc_error();
+	start = op_start();
+	ret = dev->transport->ioctl(dev, cmd, arg);
+	op = ioctl_op(cmd, arg, &subdev, &offset, &size, &data, &bit);
+	if(FLINK_PROBE_ENABLED(ioctl)) {
+		FLINK_PROBE5(ioctl, cmd, subdev, offset, ret, flink_time_ns() - start);
 	}
+	op_done(dev, op, subdev, offset, size, data, bit, start, ret);
 	
 	return ret;
 }
@@ -211,3 +337,71 @@ int flink_write_bit(flink_subdev* subdev, uint32_t offset, uint8_t bit, void* wd
 	
 	return EXIT_SUCCESS;
 }
+
+
+/**
+ * @brief Read a block of consecutive registers from a flink subdevice.
+ * The block is transferred in a single operation of the transport.
+ * @param subdev: Subdevice to read from.
+ * @param offset: Read offset, relative to the subdevice base address.
+ * @param size: Nof bytes to read.
+ * @param rdata: Pointer to a buffer where the read bytes are written to.
+ * @return ssize_t: Nof bytes read from the subdevice or -1 in case of error.
+ */
+ssize_t flink_read_block(flink_subdev* subdev, uint32_t offset, uint32_t size, void* rdata) {
+	ssize_t read_size;
+	uint64_t start;
+	
+	// Check data pointer
+	if(rdata == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	
+	// Check flink subdevice structure
+	if(!validate_flink_subdev(subdev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	
+	start = op_start();
+	read_size = subdev->parent->transport->read_block(subdev, offset, size, rdata);
+	op_done(subdev->parent, FLINK_OP_READ_BLOCK, subdev->id, offset, size, rdata, 0, start, read_size);
+	if(read_size < 0) return EXIT_ERROR;
+	
+	return read_size;
+}
+
+
+/**
+ * @brief Write a block of consecutive registers to a flink subdevice.
+ * The block is transferred in a single operation of the transport.
+ * @param subdev: Subdevice to write to.
+ * @param offset: Write offset, relative to the subdevice base address.
+ * @param size: Nof bytes to write.
+ * @param wdata: Data to write.
+ * @return ssize_t: Nof bytes written or -1 in case of error.
+ */
+ssize_t flink_write_block(flink_subdev* subdev, uint32_t offset, uint32_t size, const void* wdata) {
+	ssize_t write_size;
+	uint64_t start;
+	
+	// Check data pointer
+	if(wdata == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	
+	// Check flink subdevice structure
+	if(!validate_flink_subdev(subdev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	
+	start = op_start();
+	write_size = subdev->parent->transport->write_block(subdev, offset, size, wdata);
+	op_done(subdev->parent, FLINK_OP_WRITE_BLOCK, subdev->id, offset, size, wdata, 0, start, write_size);
+	if(write_size < 0) return EXIT_ERROR;
+	
+	return write_size;
+}
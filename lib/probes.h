@@ -0,0 +1,74 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, USDT probes                           *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file probes.h
+ *  @brief Static user space probes of the provider "flinklib".
+ *
+ *  The probes are available to perf, bpftrace and SystemTap if the
+ *  library is built with FLINK_USDT=1, which requires <sys/sdt.h>.
+ *  Each probe has a semaphore which is nonzero while a tracer is
+ *  attached, arguments only needed by probes are computed only then.
+ *
+ *  Probes and arguments:
+ *  - ioctl(cmd, subdev, offset, ret, duration_ns)
+ *  - read, write, read_bit, write_bit, read_block, write_block(subdev, offset, size, ret, duration_ns)
+ *  - irq_register(irq, signal), irq_unregister(irq, ret)
+ *  - irq_wait(irq, waited_ns, ret)
+ */
+
+#ifndef FLINKLIB_PROBES_H_
+#define FLINKLIB_PROBES_H_
+
+#ifndef FLINK_USDT
+#define FLINK_USDT 0
+#endif
+
+#if FLINK_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define FLINK_PROBE_SEMAPHORE(name) flinklib_##name##_semaphore
+#define FLINK_PROBE_DECLARE(name) \
+	extern unsigned short FLINK_PROBE_SEMAPHORE(name) __attribute__((unused, section(".probes")))
+#define FLINK_PROBE_DEFINE(name) \
+	unsigned short FLINK_PROBE_SEMAPHORE(name) __attribute__((unused, section(".probes"))) = 0
+#define FLINK_PROBE_ENABLED(name)	__builtin_expect(FLINK_PROBE_SEMAPHORE(name) != 0, 0)
+#define FLINK_PROBE2(name, a, b)				STAP_PROBE2(flinklib, name, a, b)
+#define FLINK_PROBE3(name, a, b, c)				STAP_PROBE3(flinklib, name, a, b, c)
+#define FLINK_PROBE5(name, a, b, c, d, e)		STAP_PROBE5(flinklib, name, a, b, c, d, e)
+
+#else
+
+#define FLINK_PROBE_DECLARE(name)				struct flink_probe_unused_##name
+#define FLINK_PROBE_DEFINE(name)				struct flink_probe_unused_##name
+#define FLINK_PROBE_ENABLED(name)				0
+#define FLINK_PROBE2(name, a, b)				do { (void)sizeof(a); (void)sizeof(b); } while(0)
+#define FLINK_PROBE3(name, a, b, c)				do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); } while(0)
+#define FLINK_PROBE5(name, a, b, c, d, e)		do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); (void)sizeof(d); (void)sizeof(e); } while(0)
+
+#endif // FLINK_USDT
+
+FLINK_PROBE_DECLARE(ioctl);
+FLINK_PROBE_DECLARE(read);
+FLINK_PROBE_DECLARE(write);
+FLINK_PROBE_DECLARE(read_bit);
+FLINK_PROBE_DECLARE(write_bit);
+FLINK_PROBE_DECLARE(read_block);
+FLINK_PROBE_DECLARE(write_block);
+FLINK_PROBE_DECLARE(irq_register);
+FLINK_PROBE_DECLARE(irq_unregister);
+FLINK_PROBE_DECLARE(irq_wait);
+
+#endif // FLINKLIB_PROBES_H_
@@ -0,0 +1,207 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, register traffic recording            *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file record.c
+ *  @brief Recording of register accesses to a binary file.
+ *
+ *  Every successful register access is written as a flink_record_entry
+ *  followed by the data read or written. Before the first access of a
+ *  device, an entry announcing the device with the function ids of its
+ *  subdevices is written. The file is replayed with flinkreplay.
+ *
+ *  Recording starts at load time if the environment variable
+ *  FLINK_RECORD names a file, which is closed at exit.
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "error.h"
+#include "trace.h"
+#include "record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+int flink_record_on = 0;
+
+static FILE* file = NULL;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t start_time;
+static uint32_t generation = 0;	/// Incremented by each start
+static uint16_t nof_devices;
+static int write_errno = 0;		/// errno of the write which stopped recording, 0 if none failed
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static void stop_env_record(void) {
+	flink_record_stop();
+}
+
+__attribute__((constructor)) static void record_init(void) {
+	const char* env = getenv("FLINK_RECORD");
+	if(env && *env && flink_record_start(env) == EXIT_SUCCESS) atexit(stop_env_record);
+}
+
+/**
+ * @brief Writes an entry and its data, called with the lock held.
+ */
+static void write_entry(flink_record_entry* e, const void* data) {
+	if(fwrite(e, sizeof(flink_record_entry), 1, file) != 1 || (e->size && fwrite(data, e->size, 1, file) != 1)) {
+		// Stop recording rather than leaving a truncated entry in the middle of the file
+		write_errno = errno ? errno : EIO;
+		__atomic_store_n(&flink_record_on, 0, __ATOMIC_RELAXED);
+	}
+}
+
+/**
+ * @brief Announces a device in the current recording, called with the lock held.
+ */
+static void announce_device(flink_dev* dev) {
+	flink_record_entry e;
+	uint16_t functions[256];
+	flink_subdev* subdev;
+	uint8_t i;
+
+	for(i = 0; i < dev->nof_subdevices; i++) {
+		subdev = flink_get_subdevice_by_id(dev, i);
+		functions[i] = subdev ? subdev->function_id : 0;
+	}
+	memset(&e, 0, sizeof(e));
+	e.time_ns = flink_time_ns() - start_time;
+	e.size = dev->nof_subdevices * sizeof(uint16_t);
+	e.dev = nof_devices;
+	e.op = FLINK_RECORD_OP_DEVICE;
+	e.subdev = dev->nof_subdevices;
+	write_entry(&e, functions);
+
+	dev->record_gen = generation;
+	dev->record_id = nof_devices++;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Library internal methods                                       *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Records a successful register access.
+ * @param dev: Flink device handle.
+ * @param op: Operation, one of the read and write operations.
+ * @param subdev: Subdevice id.
+ * @param offset: Register offset.
+ * @param bit: Bit number of bit accesses.
+ * @param size: Nof bytes of data.
+ * @param data: Data read or written.
+ * @param start_ns: Start of the access.
+ */
+void flink_record_op(flink_dev* dev, flink_op op, uint8_t subdev, uint32_t offset, uint8_t bit, uint32_t size, const void* data, uint64_t start_ns) {
+	flink_record_entry e;
+
+	pthread_mutex_lock(&lock);
+	if(file && flink_record_active()) {
+		if(dev->record_gen != generation) announce_device(dev);
+		memset(&e, 0, sizeof(e));
+		e.time_ns = start_ns > start_time ? start_ns - start_time : 0;
+		e.offset = offset;
+		e.size = size;
+		e.dev = dev->record_id;
+		e.op = op;
+		e.subdev = subdev;
+		e.bit = bit;
+		write_entry(&e, data);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Starts recording all register accesses of all devices to a file.
+ * @param file_name: File to write, replaced if it exists.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_record_start(const char* file_name) {
+	flink_record_header header;
+
+	if(file_name == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&lock);
+	if(file) {
+		pthread_mutex_unlock(&lock);
+		flink_error(FLINK_EBUSY);
+		return EXIT_ERROR;
+	}
+	file = fopen(file_name, "wb");
+	if(file == NULL) {
+		pthread_mutex_unlock(&lock);
+		libc_error();
+		return EXIT_ERROR;
+	}
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FLINK_RECORD_MAGIC, sizeof(header.magic));
+	header.version = FLINK_RECORD_VERSION;
+	fwrite(&header, sizeof(header), 1, file);
+
+	start_time = flink_time_ns();
+	write_errno = 0;
+	generation++;
+	nof_devices = 0;
+	__atomic_store_n(&flink_record_on, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&lock);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Stops recording and closes the file.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_record_stop(void) {
+	int error;
+
+	pthread_mutex_lock(&lock);
+	if(file == NULL) {
+		pthread_mutex_unlock(&lock);
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+	__atomic_store_n(&flink_record_on, 0, __ATOMIC_RELAXED);
+	error = write_errno;
+	if(fclose(file) != 0 && error == 0) error = errno;
+	file = NULL;
+	pthread_mutex_unlock(&lock);
+	// A write error stopped recording before, or the buffered entries could not be written
+	if(error) {
+		errno = error;
+		libc_error();
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, register traffic recording            *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file record.h
+ *  @brief Recording of register accesses to a file.
+ */
+
+#ifndef FLINKLIB_RECORD_H_
+#define FLINKLIB_RECORD_H_
+
+#include "types.h"
+
+extern int flink_record_on;
+
+/**
+ * @brief Checks if register accesses are recorded.
+ */
+static inline int flink_record_active(void) {
+	return __atomic_load_n(&flink_record_on, __ATOMIC_RELAXED);
+}
+
+void flink_record_op(flink_dev* dev, flink_op op, uint8_t subdev, uint32_t offset, uint8_t bit, uint32_t size, const void* data, uint64_t start_ns);
+
+#endif // FLINKLIB_RECORD_H_
@@ -31,6 +31,16 @@
 #include "log.h"
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CALIBRATION_PERCENTILE 5	// percent of the samples ignored at each end of the distribution
+
+static int compare_uint32(const void* a, const void* b) {
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
 
 /**
  * @brief Gets the resolution of the subdevice
@@ -157,3 +167,165 @@ int flink_reflectivesensor_get_lower_level_int(flink_subdev* subdev, uint32_t ch
 	}
 	return EXIT_SUCCESS;
 }
+
+/**
+ * @brief Reads the values of all channels in a single transfer.
+ * @param subdev: Subdevice.
+ * @param values: Array with one entry per channel, contains the digitized values.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_reflectivesensor_get_values(flink_subdev* subdev, uint32_t* values){
+	uint32_t offset, size;
+
+	dbg_print("Get values of all sensor inputs on subdevice %d\n", subdev->id);
+	offset = HEADER_SIZE + SUBHEADER_SIZE + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET;
+	size = subdev->nof_channels * REGISTER_WITH;
+
+	if(flink_read_block(subdev, offset, size, values) != size) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Sets the upper and lower levels of all channels in a single transfer.
+ * @param subdev: Subdevice.
+ * @param upper: Array with one upper level per channel.
+ * @param lower: Array with one lower level per channel.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_reflectivesensor_set_levels(flink_subdev* subdev, const uint32_t* upper, const uint32_t* lower){
+	uint32_t offset, size;
+	uint32_t* levels;
+	ssize_t written;
+
+	if(upper == NULL || lower == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+
+	dbg_print("Set levels of all sensor inputs on subdevice %d\n", subdev->id);
+	offset = HEADER_SIZE + SUBHEADER_SIZE + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + REGISTER_WITH*subdev->nof_channels;
+	size = subdev->nof_channels * REGISTER_WITH;
+
+	// upper and lower level registers are adjacent
+	levels = malloc(2 * size);
+	if(levels == NULL) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	memcpy(levels, upper, size);
+	memcpy(levels + subdev->nof_channels, lower, size);
+	written = flink_write_block(subdev, offset, 2 * size, levels);
+	free(levels);
+
+	if(written != 2 * size) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Reads the upper and lower levels of all channels in a single transfer.
+ * @param subdev: Subdevice.
+ * @param upper: Array with one entry per channel, contains the upper levels.
+ * @param lower: Array with one entry per channel, contains the lower levels.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_reflectivesensor_get_levels(flink_subdev* subdev, uint32_t* upper, uint32_t* lower){
+	uint32_t offset, size;
+	uint32_t* levels;
+	ssize_t read_size;
+
+	if(upper == NULL || lower == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+
+	dbg_print("Get levels of all sensor inputs on subdevice %d\n", subdev->id);
+	offset = HEADER_SIZE + SUBHEADER_SIZE + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + REGISTER_WITH*subdev->nof_channels;
+	size = subdev->nof_channels * REGISTER_WITH;
+
+	levels = malloc(2 * size);
+	if(levels == NULL) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	read_size = flink_read_block(subdev, offset, 2 * size, levels);
+	if(read_size == 2 * size) {
+		memcpy(upper, levels, size);
+		memcpy(lower, levels + subdev->nof_channels, size);
+	}
+	free(levels);
+
+	if(read_size != 2 * size) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Calibrates the interrupt levels of all channels.
+ * All channels are sampled nof_samples times. Per channel the dark and bright
+ * levels are taken from the observed distribution, ignoring outliers at both
+ * ends. The levels are placed symmetrically around the middle of these two,
+ * separated by the hysteresis, and programmed in a single transfer.
+ * @param subdev: Subdevice.
+ * @param nof_samples: Number of samples per channel.
+ * @param interval_us: Time between two samples in us.
+ * @param hysteresis: Distance between upper and lower level in percent of the observed range.
+ * @param upper: Array with one entry per channel, contains the upper levels. May be NULL.
+ * @param lower: Array with one entry per channel, contains the lower levels. May be NULL.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_reflectivesensor_calibrate(flink_subdev* subdev, uint32_t nof_samples, uint32_t interval_us, uint32_t hysteresis, uint32_t* upper, uint32_t* lower){
+	uint32_t n = subdev->nof_channels;
+	uint32_t *samples, *channel_samples, *up, *low;
+	uint32_t i, ch, dark, bright, middle, band;
+	int ret = EXIT_ERROR;
+
+	if(nof_samples == 0 || hysteresis > 100) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+
+	samples = malloc((size_t)nof_samples * n * sizeof(uint32_t));
+	channel_samples = malloc(nof_samples * sizeof(uint32_t));
+	up = malloc(2 * n * sizeof(uint32_t));
+	if(samples == NULL || channel_samples == NULL || up == NULL) {
+		libc_error();
+		goto out;
+	}
+	low = up + n;
+
+	for(i = 0; i < nof_samples; i++) {
+		if(flink_reflectivesensor_get_values(subdev, samples + (size_t)i * n) < 0) goto out;
+		if(interval_us && i + 1 < nof_samples) usleep(interval_us);
+	}
+
+	for(ch = 0; ch < n; ch++) {
+		for(i = 0; i < nof_samples; i++) channel_samples[i] = samples[(size_t)i * n + ch];
+		qsort(channel_samples, nof_samples, sizeof(uint32_t), compare_uint32);
+		dark   = channel_samples[(uint64_t)(nof_samples - 1) * CALIBRATION_PERCENTILE / 100];
+		bright = channel_samples[(uint64_t)(nof_samples - 1) * (100 - CALIBRATION_PERCENTILE) / 100];
+		middle = dark + (bright - dark) / 2;
+		band   = (uint32_t)((uint64_t)(bright - dark) * hysteresis / 200);
+		up[ch]  = middle + band;
+		low[ch] = middle - band;
+		dbg_print("  --> channel %u: range %u..%u, levels %u/%u\n", ch, dark, bright, low[ch], up[ch]);
+	}
+
+	if(flink_reflectivesensor_set_levels(subdev, up, low) < 0) goto out;
+	if(upper) memcpy(upper, up, n * sizeof(uint32_t));
+	if(lower) memcpy(lower, low, n * sizeof(uint32_t));
+	ret = EXIT_SUCCESS;
+
+out:
+	free(up);
+	free(channel_samples);
+	free(samples);
+	return ret;
+}
@@ -0,0 +1,333 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, remote devices                        *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file remote.c
+ *  @brief Transport for devices served by flinkd over a Unix socket.
+ *
+ *  Every operation is sent as a request and waits for its response.
+ *  Threads sharing a device do not wait for each other's responses
+ *  before sending, so their requests are pipelined on the connection.
+ *  As the daemon answers in the order of the requests, each thread
+ *  takes a ticket when sending and reads the response when its ticket
+ *  is due.
+ *
+ *  Interrupts are delivered as signals to the process owning the device
+ *  and are not supported on remote devices.
+ */
+
+#include "flinklib.h"
+#include "flinkioctl.h"
+#include "types.h"
+#include "error.h"
+#include "transport.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#define REMOTE_WAIT_SLOTS	16
+
+typedef struct _remote_conn {
+	int             fd;
+	pthread_mutex_t send_lock;
+	pthread_mutex_t recv_lock;
+	pthread_cond_t  recv_cond[REMOTE_WAIT_SLOTS];	/// Threads wait on the slot of their ticket
+	uint32_t        next_id;		/// Ticket of the next request
+	uint32_t        next_recv;		/// Ticket of the next response
+	int             broken;			/// Set if the connection is out of sync
+} remote_conn;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static int send_all(flink_dev* dev, struct iovec* iov, int cnt) {
+	struct msghdr msg;
+	ssize_t n;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = cnt;
+	while(msg.msg_iovlen) {
+		flink_count_syscall(dev);
+		n = sendmsg(dev->fd, &msg, MSG_NOSIGNAL);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			return EXIT_ERROR;
+		}
+		while(msg.msg_iovlen && (size_t)n >= msg.msg_iov->iov_len) {
+			n -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if(msg.msg_iovlen) {
+			msg.msg_iov->iov_base = (uint8_t*)msg.msg_iov->iov_base + n;
+			msg.msg_iov->iov_len -= n;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+static int recv_all(flink_dev* dev, void* buf, size_t size) {
+	ssize_t n;
+
+	while(size) {
+		flink_count_syscall(dev);
+		n = read(dev->fd, buf, size);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) {
+			if(n == 0) errno = ECONNRESET;
+			return EXIT_ERROR;
+		}
+		buf = (uint8_t*)buf + n;
+		size -= n;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Sends a request and waits for its response.
+ * @param dev: Remote device.
+ * @param req: Request, the id is assigned here.
+ * @param wdata: Data following the request, req->size bytes for writes.
+ * @param rdata: Receives the data of the response.
+ * @param rsize: Size of rdata.
+ * @return int: Result of the request, -1 with errno set in case of failure.
+ */
+static int remote_call(flink_dev* dev, flink_remote_request* req, const void* wdata, void* rdata, uint32_t rsize) {
+	remote_conn* conn = dev->transport_data;
+	flink_remote_response resp;
+	struct iovec iov[2];
+	uint8_t discard[64];
+	uint32_t n, k;
+	int ret = EXIT_SUCCESS;
+
+	iov[0].iov_base = req;
+	iov[0].iov_len = sizeof(*req);
+	iov[1].iov_base = (void*)wdata;
+	iov[1].iov_len = wdata ? req->size : 0;
+
+	pthread_mutex_lock(&conn->send_lock);
+	req->id = conn->next_id++;
+	if(conn->broken || send_all(dev, iov, wdata ? 2 : 1) < 0) ret = EXIT_ERROR;
+	pthread_mutex_unlock(&conn->send_lock);
+
+	pthread_mutex_lock(&conn->recv_lock);
+	if(ret < 0) conn->broken = 1;	// the response of a lost request would never arrive
+	while(!conn->broken && conn->next_recv != req->id) {
+		pthread_cond_wait(&conn->recv_cond[req->id % REMOTE_WAIT_SLOTS], &conn->recv_lock);
+	}
+	if(!conn->broken) {
+		if(recv_all(dev, &resp, sizeof(resp)) < 0 || resp.id != req->id || resp.size > FLINK_REMOTE_MAX_SIZE) {
+			conn->broken = 1;
+		}
+		else {
+			n = resp.size < rsize ? resp.size : rsize;
+			if(recv_all(dev, rdata, n) < 0) conn->broken = 1;
+			for(n = resp.size - n; n && !conn->broken; n -= k) {	// more data than expected
+				k = n < sizeof(discard) ? n : sizeof(discard);
+				if(recv_all(dev, discard, k) < 0) conn->broken = 1;
+			}
+		}
+		conn->next_recv++;
+	}
+	if(conn->broken) {
+		for(n = 0; n < REMOTE_WAIT_SLOTS; n++) pthread_cond_broadcast(&conn->recv_cond[n]);
+		pthread_mutex_unlock(&conn->recv_lock);
+		errno = EPIPE;
+		return EXIT_ERROR;
+	}
+	pthread_cond_broadcast(&conn->recv_cond[conn->next_recv % REMOTE_WAIT_SLOTS]);
+	pthread_mutex_unlock(&conn->recv_lock);
+
+	if(resp.result < 0) {
+		errno = -resp.result;
+		return EXIT_ERROR;
+	}
+	return resp.result;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Transport                                                      *
+ *                                                                 *
+ *******************************************************************/
+
+static int remote_open(flink_dev* dev, const char* path) {
+	struct sockaddr_un addr;
+	remote_conn* conn;
+	int i;
+
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		flink_error(FLINK_EINVALDEV);	// socket name too long
+		return EXIT_ERROR;
+	}
+	conn = calloc(1, sizeof(remote_conn));
+	if(conn == NULL) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	conn->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(conn->fd < 0 || connect(conn->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		libc_error();
+		if(conn->fd >= 0) close(conn->fd);
+		free(conn);
+		return EXIT_ERROR;
+	}
+	pthread_mutex_init(&conn->send_lock, NULL);
+	pthread_mutex_init(&conn->recv_lock, NULL);
+	for(i = 0; i < REMOTE_WAIT_SLOTS; i++) pthread_cond_init(&conn->recv_cond[i], NULL);
+
+	dev->fd = conn->fd;
+	dev->transport_data = conn;
+	return EXIT_SUCCESS;
+}
+
+static void remote_close(flink_dev* dev) {
+	remote_conn* conn = dev->transport_data;
+	int i;
+
+	close(conn->fd);
+	pthread_mutex_destroy(&conn->send_lock);
+	pthread_mutex_destroy(&conn->recv_lock);
+	for(i = 0; i < REMOTE_WAIT_SLOTS; i++) pthread_cond_destroy(&conn->recv_cond[i]);
+	free(conn);
+}
+
+static int remote_ioctl(flink_dev* dev, int cmd, void* arg) {
+	ioctl_container_t* container = arg;
+	ioctl_bit_container_t* bit = arg;
+	flink_subdev* subdev = arg;
+	flink_remote_subdev_info info;
+	flink_remote_request req;
+	uint8_t value;
+	int ret;
+
+	memset(&req, 0, sizeof(req));
+	switch(cmd) {
+		case READ_NOF_SUBDEVICES:
+			req.cmd = FLINK_REMOTE_NOF_SUBDEVICES;
+			ret = remote_call(dev, &req, NULL, NULL, 0);
+			if(ret < 0) return EXIT_ERROR;
+			*(uint8_t*)arg = ret;
+			return EXIT_SUCCESS;
+		case READ_SUBDEVICE_INFO:
+			req.cmd = FLINK_REMOTE_SUBDEVICE_INFO;
+			req.subdev = subdev->id;
+			memset(&info, 0, sizeof(info));
+			if(remote_call(dev, &req, NULL, &info, sizeof(info)) < 0) return EXIT_ERROR;
+			subdev->function_id      = info.function_id;
+			subdev->sub_function_id  = info.sub_function_id;
+			subdev->function_version = info.function_version;
+			subdev->base_addr        = info.base_addr;
+			subdev->mem_size         = info.mem_size;
+			subdev->nof_channels     = info.nof_channels;
+			subdev->unique_id        = info.unique_id;
+			return EXIT_SUCCESS;
+		case SELECT_SUBDEVICE:
+		case SELECT_SUBDEVICE_EXCL:
+			// Requests carry the subdevice, the daemon serializes all accesses
+			if(*(uint8_t*)arg >= dev->nof_subdevices) {
+				errno = EINVAL;
+				return EXIT_ERROR;
+			}
+			return EXIT_SUCCESS;
+		case SELECT_AND_READ:
+			req.cmd = FLINK_REMOTE_READ;
+			req.subdev = container->subdevice;
+			req.offset = container->offset;
+			req.size = container->size;
+			return remote_call(dev, &req, NULL, container->data, container->size);
+		case SELECT_AND_WRITE:
+			req.cmd = FLINK_REMOTE_WRITE;
+			req.subdev = container->subdevice;
+			req.offset = container->offset;
+			req.size = container->size;
+			return remote_call(dev, &req, container->data, NULL, 0);
+		case SELECT_AND_READ_BIT:
+			req.cmd = FLINK_REMOTE_READ_BIT;
+			req.subdev = bit->subdevice;
+			req.offset = bit->offset;
+			req.bit = bit->bit;
+			ret = remote_call(dev, &req, NULL, &value, sizeof(value));
+			if(ret >= 0) bit->value = value;
+			return ret;
+		case SELECT_AND_WRITE_BIT:
+			req.cmd = FLINK_REMOTE_WRITE_BIT;
+			req.subdev = bit->subdevice;
+			req.offset = bit->offset;
+			req.bit = bit->bit;
+			req.value = bit->value;
+			return remote_call(dev, &req, NULL, NULL, 0);
+		case REGISTER_IRQ:
+		case UNREGISTER_IRQ:
+		case GET_SIGNAL_OFFSET:
+			errno = ENOTSUP;
+			return EXIT_ERROR;
+		default:
+			errno = ENOTTY;
+			return EXIT_ERROR;
+	}
+}
+
+static ssize_t remote_read_block(flink_subdev* subdev, uint32_t offset, uint32_t size, void* rdata) {
+	flink_remote_request req;
+
+	if(size > FLINK_REMOTE_MAX_SIZE) {
+		errno = EINVAL;
+		return EXIT_ERROR;
+	}
+	memset(&req, 0, sizeof(req));
+	req.cmd = FLINK_REMOTE_READ_BLOCK;
+	req.subdev = subdev->id;
+	req.offset = offset;
+	req.size = size;
+	return remote_call(subdev->parent, &req, NULL, rdata, size);
+}
+
+static ssize_t remote_write_block(flink_subdev* subdev, uint32_t offset, uint32_t size, const void* wdata) {
+	flink_remote_request req;
+
+	if(size > FLINK_REMOTE_MAX_SIZE) {
+		errno = EINVAL;
+		return EXIT_ERROR;
+	}
+	memset(&req, 0, sizeof(req));
+	req.cmd = FLINK_REMOTE_WRITE_BLOCK;
+	req.subdev = subdev->id;
+	req.offset = offset;
+	req.size = size;
+	return remote_call(subdev->parent, &req, wdata, NULL, 0);
+}
+
+const flink_transport flink_remote_transport = {
+	.prefix      = FLINK_REMOTE_PREFIX,
+	.open        = remote_open,
+	.close       = remote_close,
+	.ioctl       = remote_ioctl,
+	.read_block  = remote_read_block,
+	.write_block = remote_write_block,
+};
@@ -0,0 +1,377 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, simulated devices                     *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file sim.c
+ *  @brief Transport for in-process simulated flink devices.
+ *
+ *  Implements the ioctl commands of the flink kernel module on a
+ *  register file in memory. Every subdevice has its own register file
+ *  starting with the subdevice header. Setting the reset bit in the
+ *  config register restores the reset values of all function registers.
+ *  Every read and write of the register file advances the virtual
+ *  clock of the device by the access time of the design. System calls
+ *  are counted as if the device were a device file, which keeps the
+ *  counts comparable between simulated and real devices.
+ */
+
+#include "flinklib.h"
+#include "flinkioctl.h"
+#include "types.h"
+#include "error.h"
+#include "log.h"
+#include "valid.h"
+#include "transport.h"
+#include "sim.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+
+#define FUNCTION_REGS_OFFSET (HEADER_SIZE + SUBHEADER_SIZE)
+
+static const flink_sim_design* const designs[] = {
+	&flink_sim_bench_design,
+	&flink_sim_base_dev_testing_design,
+};
+#define NOF_DESIGNS (sizeof(designs) / sizeof(designs[0]))
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Fills the headers and reset values of a subdevice register file.
+ */
+static void sim_init_subdev(flink_sim* sim, uint8_t id) {
+	const flink_sim_subdev* desc = &sim->design->subdevices[id];
+	const char* text = sim->design->description;
+	uint32_t i, k, word;
+
+	*flink_sim_reg(sim, id, 0x0) = (uint32_t)desc->function_id << 16 | (uint32_t)desc->sub_function_id << 8 | desc->function_version;
+	*flink_sim_reg(sim, id, 0x4) = desc->mem_size;
+	*flink_sim_reg(sim, id, 0x8) = desc->nof_channels;
+	*flink_sim_reg(sim, id, 0xC) = desc->unique_id;
+	*flink_sim_reg(sim, id, FUNCTION_REGS_OFFSET) = desc->first_value;
+
+	// Description, first character in the most significant byte of a register
+	if(desc->function_id == INFO_DEVICE_ID && text) {
+		for(i = 0; i < INFO_DESC_SIZE; i += REGISTER_WITH) {
+			word = 0;
+			for(k = 0; k < REGISTER_WITH; k++) {
+				word <<= 8;
+				if(*text) word |= (uint8_t)*text++;
+			}
+			*flink_sim_reg(sim, id, FUNCTION_REGS_OFFSET + REGISTER_WITH + i) = word;
+		}
+	}
+}
+
+static int sim_check_access(flink_sim* sim, uint8_t subdev, uint32_t offset, uint32_t size) {
+	if(subdev >= sim->design->nof_subdevices) {
+		errno = EINVAL;
+		return EXIT_ERROR;
+	}
+	if(offset > sim->design->subdevices[subdev].mem_size || size > sim->design->subdevices[subdev].mem_size - offset) {
+		errno = EFAULT;
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Handles a write to the config register.
+ */
+static void sim_config_written(flink_sim* sim, uint8_t subdev) {
+	uint32_t* config = flink_sim_reg(sim, subdev, CONFIG_OFFSET);
+	uint32_t size = sim->design->subdevices[subdev].mem_size;
+
+	if(*config & (1 << RESET_BIT)) {
+		dbg_print("Simulated reset of subdevice %u\n", subdev);
+		memset(sim->mem[subdev] + FUNCTION_REGS_OFFSET, 0, size - FUNCTION_REGS_OFFSET);
+		*flink_sim_reg(sim, subdev, FUNCTION_REGS_OFFSET) = sim->design->subdevices[subdev].first_value;
+		*config &= ~(1 << RESET_BIT);
+		if(sim->design->reset) sim->design->reset(sim, subdev);
+	}
+}
+
+static ssize_t sim_read(flink_sim* sim, uint8_t subdev, uint32_t offset, uint32_t size, void* rdata) {
+	pthread_mutex_lock(&sim->lock);
+	if(sim_check_access(sim, subdev, offset, size) < 0) {
+		pthread_mutex_unlock(&sim->lock);
+		return EXIT_ERROR;
+	}
+	sim->time_ns += sim->design->access_ns;
+	sim->nof_bytes += size;
+	if(sim->design->before_read) sim->design->before_read(sim, subdev, offset, size);
+	memcpy(rdata, sim->mem[subdev] + offset, size);
+	pthread_mutex_unlock(&sim->lock);
+	return size;
+}
+
+static ssize_t sim_write(flink_sim* sim, uint8_t subdev, uint32_t offset, uint32_t size, const void* wdata) {
+	pthread_mutex_lock(&sim->lock);
+	if(sim_check_access(sim, subdev, offset, size) < 0) {
+		pthread_mutex_unlock(&sim->lock);
+		return EXIT_ERROR;
+	}
+	memcpy(sim->mem[subdev] + offset, wdata, size);
+	sim->time_ns += sim->design->access_ns;
+	sim->nof_bytes += size;
+	if(flink_sim_covers(offset, size, CONFIG_OFFSET)) sim_config_written(sim, subdev);
+	if(sim->design->after_write) sim->design->after_write(sim, subdev, offset, size);
+	pthread_mutex_unlock(&sim->lock);
+	return size;
+}
+
+static int sim_rw_bit(flink_sim* sim, ioctl_bit_container_t* arg, int write) {
+	uint32_t reg, mask = 1u << (arg->bit % (REGISTER_WITH * 8));
+
+	if(sim_read(sim, arg->subdevice, arg->offset, REGISTER_WITH, &reg) < 0) return EXIT_ERROR;
+	if(!write) {
+		arg->value = (reg & mask) != 0;
+		return EXIT_SUCCESS;
+	}
+	if(arg->value) reg |= mask;
+	else reg &= ~mask;
+	if(sim_write(sim, arg->subdevice, arg->offset, REGISTER_WITH, &reg) < 0) return EXIT_ERROR;
+	return EXIT_SUCCESS;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Transport                                                      *
+ *                                                                 *
+ *******************************************************************/
+
+static void sim_free(flink_sim* sim) {
+	uint8_t i;
+
+	if(sim->design->cleanup && sim->model) sim->design->cleanup(sim);
+	if(sim->mem) {
+		for(i = 0; i < sim->design->nof_subdevices; i++) free(sim->mem[i]);
+		free(sim->mem);
+	}
+	pthread_mutex_destroy(&sim->lock);
+	free(sim);
+}
+
+static int sim_open(flink_dev* dev, const char* path) {
+	const flink_sim_design* design = NULL;
+	flink_sim* sim;
+	size_t i;
+
+	for(i = 0; i < NOF_DESIGNS; i++) {
+		if(strcmp(designs[i]->name, path) == 0) design = designs[i];
+	}
+	if(design == NULL) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+
+	sim = calloc(1, sizeof(flink_sim));
+	if(sim == NULL) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	sim->design = design;
+	pthread_mutex_init(&sim->lock, NULL);
+	sim->mem = calloc(design->nof_subdevices, sizeof(uint8_t*));
+	if(sim->mem == NULL) {
+		libc_error();
+		sim_free(sim);
+		return EXIT_ERROR;
+	}
+	for(i = 0; i < design->nof_subdevices; i++) {
+		sim->mem[i] = calloc(1, design->subdevices[i].mem_size);
+		if(sim->mem[i] == NULL) {
+			libc_error();
+			sim_free(sim);
+			return EXIT_ERROR;
+		}
+		sim_init_subdev(sim, i);
+	}
+	if(design->init && design->init(sim) < 0) {
+		libc_error();
+		sim_free(sim);
+		return EXIT_ERROR;
+	}
+
+	dev->fd = -1;
+	dev->transport_data = sim;
+	return EXIT_SUCCESS;
+}
+
+static void sim_close(flink_dev* dev) {
+	sim_free(dev->transport_data);
+}
+
+static int sim_ioctl(flink_dev* dev, int cmd, void* arg) {
+	flink_sim* sim = dev->transport_data;
+	ioctl_container_t* container = arg;
+	flink_subdev* subdev = arg;
+	uint32_t base_addr = 0;
+	uint8_t i;
+
+	flink_count_syscall(dev);
+	switch(cmd) {
+		case READ_NOF_SUBDEVICES:
+			*(uint8_t*)arg = sim->design->nof_subdevices;
+			return EXIT_SUCCESS;
+		case READ_SUBDEVICE_INFO:
+			if(subdev->id >= sim->design->nof_subdevices) {
+				errno = EINVAL;
+				return EXIT_ERROR;
+			}
+			for(i = 0; i < subdev->id; i++) base_addr += sim->design->subdevices[i].mem_size;
+			subdev->function_id      = sim->design->subdevices[subdev->id].function_id;
+			subdev->sub_function_id  = sim->design->subdevices[subdev->id].sub_function_id;
+			subdev->function_version = sim->design->subdevices[subdev->id].function_version;
+			subdev->base_addr        = base_addr;
+			subdev->mem_size         = sim->design->subdevices[subdev->id].mem_size;
+			subdev->nof_channels     = sim->design->subdevices[subdev->id].nof_channels;
+			subdev->unique_id        = sim->design->subdevices[subdev->id].unique_id;
+			return EXIT_SUCCESS;
+		case SELECT_SUBDEVICE:
+		case SELECT_SUBDEVICE_EXCL:
+			if(*(uint8_t*)arg >= sim->design->nof_subdevices) {
+				errno = EINVAL;
+				return EXIT_ERROR;
+			}
+			return EXIT_SUCCESS;
+		case SELECT_AND_READ:
+			return sim_read(sim, container->subdevice, container->offset, container->size, container->data);
+		case SELECT_AND_WRITE:
+			return sim_write(sim, container->subdevice, container->offset, container->size, container->data);
+		case SELECT_AND_READ_BIT:
+			return sim_rw_bit(sim, arg, 0);
+		case SELECT_AND_WRITE_BIT:
+			return sim_rw_bit(sim, arg, 1);
+		case REGISTER_IRQ:
+			return SIGRTMIN + *(uint32_t*)container->data;
+		case UNREGISTER_IRQ:
+			return EXIT_SUCCESS;
+		case GET_SIGNAL_OFFSET:
+			*(uint32_t*)container->data = SIGRTMIN;
+			return EXIT_SUCCESS;
+		default:
+			errno = ENOTTY;
+			return EXIT_ERROR;
+	}
+}
+
+/**
+ * @brief Counts the system calls the device file transport needs for a block transfer.
+ */
+static void sim_count_block(flink_subdev* subdev) {
+	flink_dev* dev = subdev->parent;
+
+	pthread_mutex_lock(&dev->block_lock);
+	if(dev->selected != subdev->id) {
+		flink_count_syscall(dev);
+		dev->selected = subdev->id;
+	}
+	flink_count_syscall(dev);
+	pthread_mutex_unlock(&dev->block_lock);
+}
+
+static ssize_t sim_read_block(flink_subdev* subdev, uint32_t offset, uint32_t size, void* rdata) {
+	sim_count_block(subdev);
+	return sim_read(subdev->parent->transport_data, subdev->id, offset, size, rdata);
+}
+
+static ssize_t sim_write_block(flink_subdev* subdev, uint32_t offset, uint32_t size, const void* wdata) {
+	sim_count_block(subdev);
+	return sim_write(subdev->parent->transport_data, subdev->id, offset, size, wdata);
+}
+
+const flink_transport flink_sim_transport = {
+	.prefix      = "sim:",
+	.open        = sim_open,
+	.close       = sim_close,
+	.ioctl       = sim_ioctl,
+	.read_block  = sim_read_block,
+	.write_block = sim_write_block,
+};
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Gets the virtual clock of a simulated device.
+ * Models with timing follow this clock instead of the clock of the host,
+ * so tests of simulated devices measure durations with it.
+ * @param dev: Simulated device.
+ * @param time_ns: Contains the time since the device was opened in ns.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_sim_get_time(flink_dev* dev, uint64_t* time_ns) {
+	flink_sim* sim;
+
+	if(!validate_flink_dev(dev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	if(time_ns == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(dev->transport != &flink_sim_transport) {
+		flink_error(FLINK_ENOTSUPPORTED);
+		return EXIT_ERROR;
+	}
+	sim = dev->transport_data;
+	pthread_mutex_lock(&sim->lock);
+	*time_ns = sim->time_ns;
+	pthread_mutex_unlock(&sim->lock);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Gets the number of bytes transferred to and from the register file of a simulated device.
+ * Together with the number of system calls it measures the traffic an
+ * operation causes, independently of the speed of the host.
+ * @param dev: Simulated device.
+ * @param nof_bytes: Contains the number of bytes since the device was opened.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_sim_get_nof_bytes(flink_dev* dev, uint64_t* nof_bytes) {
+	flink_sim* sim;
+
+	if(!validate_flink_dev(dev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	if(nof_bytes == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(dev->transport != &flink_sim_transport) {
+		flink_error(FLINK_ENOTSUPPORTED);
+		return EXIT_ERROR;
+	}
+	sim = dev->transport_data;
+	pthread_mutex_lock(&sim->lock);
+	*nof_bytes = sim->nof_bytes;
+	pthread_mutex_unlock(&sim->lock);
+	return EXIT_SUCCESS;
+}
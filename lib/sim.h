@@ -0,0 +1,85 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, simulated devices                     *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file sim.h
+ *  @brief In-process simulation of flink devices.
+ *
+ *  A simulated device is a register file built from a design, which
+ *  lists the subdevices and may attach a behavioral model. Without a
+ *  model, registers behave like memory. Designs are opened by name
+ *  with flink_open("sim:<design>"). Models with timing follow the
+ *  virtual clock of the device, which every access to the register
+ *  file advances by the access time of the design. They behave the
+ *  same on every host, however fast or loaded it is.
+ */
+
+#ifndef FLINKLIB_SIM_H_
+#define FLINKLIB_SIM_H_
+
+#include "types.h"
+
+#include <pthread.h>
+
+typedef struct _flink_sim flink_sim;
+
+typedef struct _flink_sim_subdev {
+	uint16_t function_id;
+	uint8_t  sub_function_id;
+	uint8_t  function_version;
+	uint32_t mem_size;			/// Size of the register file in bytes, including the headers
+	uint32_t nof_channels;
+	uint32_t unique_id;
+	uint32_t first_value;		/// Reset value of the first function register (base clock or resolution)
+} flink_sim_subdev;
+
+typedef struct _flink_sim_design {
+	const char*             name;
+	const char*             description;	/// Description of the info subdevices
+	uint32_t                access_ns;		/// Virtual time of an access to the register file
+	uint8_t                 nof_subdevices;
+	const flink_sim_subdev* subdevices;
+	int  (*init)(flink_sim* sim);			/// Creates the model state, may be NULL
+	void (*cleanup)(flink_sim* sim);		/// Frees the model state, may be NULL
+	void (*before_read)(flink_sim* sim, uint8_t subdev, uint32_t offset, uint32_t size);	/// May be NULL
+	void (*after_write)(flink_sim* sim, uint8_t subdev, uint32_t offset, uint32_t size);	/// May be NULL
+	void (*reset)(flink_sim* sim, uint8_t subdev);	/// Called after a subdevice reset, may be NULL
+} flink_sim_design;
+
+struct _flink_sim {
+	const flink_sim_design* design;
+	uint8_t**               mem;		/// Register file of each subdevice
+	void*                   model;		/// State of the behavioral model
+	uint64_t                time_ns;	/// Virtual clock, advanced by each access
+	uint64_t                nof_bytes;	/// Bytes read from and written to the register file
+	pthread_mutex_t         lock;		/// Serializes register accesses and model updates
+};
+
+/**
+ * @brief Register of a subdevice in the register file, no bounds checks.
+ */
+static inline uint32_t* flink_sim_reg(flink_sim* sim, uint8_t subdev, uint32_t offset) {
+	return (uint32_t*)(sim->mem[subdev] + offset);
+}
+
+/**
+ * @brief Checks whether an access covers a register.
+ */
+static inline int flink_sim_covers(uint32_t offset, uint32_t size, uint32_t reg) {
+	return offset <= reg && offset + size > reg;
+}
+
+extern const flink_sim_design flink_sim_bench_design;
+extern const flink_sim_design flink_sim_base_dev_testing_design;
+
+#endif // FLINKLIB_SIM_H_
@@ -0,0 +1,166 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, simulated base device test design     *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file simBaseDevTesting.c
+ *  @brief Behavioral model of the FPGA design baseDevTesting.
+ *
+ *  Simulates the design used by flink_test_base_devices, opened with
+ *  flink_open("sim:baseDeviceTesting"):
+ *  - the outputs of a 128 channel GPIO are looped back to the inputs
+ *    of a second 128 channel GPIO,
+ *  - two 4 channel output GPIOs drive the A and B inputs of a
+ *    quadrature decoder (FQD) with 4 channels,
+ *  - the 4 PWM channels are looped back to a 4 channel input GPIO.
+ *
+ *  The PWM outputs follow the virtual clock of the device, which
+ *  advances by the duration of a local plus bus access per register
+ *  access.
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "sim.h"
+
+#include <stdlib.h>
+
+#define BASE_CLK			33000000	// Hz, local plus bus clock
+#define ACCESS_NS			1000		// ns per register access
+#define NOF_FQD_CHANNELS	4
+#define NOF_PWM_CHANNELS	4
+#define OUT_IO				1			// GPIO subfunction, outputs only
+#define IN_IO				2			// GPIO subfunction, inputs only
+
+#define DIO_DIR_OFFSET		(HEADER_SIZE + SUBHEADER_SIZE + REGISTER_WITH)
+#define PWM_PERIOD_OFFSET	(HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+#define PWM_HIGH_OFFSET		(PWM_PERIOD_OFFSET + NOF_PWM_CHANNELS * REGISTER_WITH)
+#define FQD_COUNT_OFFSET	(HEADER_SIZE + SUBHEADER_SIZE)
+
+enum { INFO, ENC_B_GPIO, ENC_A_GPIO, FQD, PWM, PWM_IN_GPIO, IN_GPIO, OUT_GPIO };
+
+static const flink_sim_subdev subdevices[] = {
+	[INFO]        = { INFO_DEVICE_ID,       0,      1, 0x040,   0, 1, 0        },
+	[ENC_B_GPIO]  = { GPIO_INTERFACE_ID,    OUT_IO, 1, 0x040,   4, 2, BASE_CLK },
+	[ENC_A_GPIO]  = { GPIO_INTERFACE_ID,    OUT_IO, 1, 0x040,   4, 3, BASE_CLK },
+	[FQD]         = { COUNTER_INTERFACE_ID, 0,      1, 0x040,   4, 4, 0        },
+	[PWM]         = { PWM_INTERFACE_ID,     0,      1, 0x080,   4, 5, BASE_CLK },
+	[PWM_IN_GPIO] = { GPIO_INTERFACE_ID,    IN_IO,  1, 0x040,   4, 6, BASE_CLK },
+	[IN_GPIO]     = { GPIO_INTERFACE_ID,    0,      1, 0x400, 128, 7, BASE_CLK },
+	[OUT_GPIO]    = { GPIO_INTERFACE_ID,    0,      1, 0x400, 128, 8, BASE_CLK },
+};
+
+typedef struct _base_dev_model {
+	uint8_t enc_phase[NOF_FQD_CHANNELS];	/// Last quadrature phase seen by the FQD
+} base_dev_model;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static uint32_t dio_words(flink_sim* sim, uint8_t subdev) {
+	return (sim->design->subdevices[subdev].nof_channels - 1) / (REGISTER_WITH * 8) + 1;
+}
+
+static uint32_t* dio_value_reg(flink_sim* sim, uint8_t subdev, uint32_t word) {
+	return flink_sim_reg(sim, subdev, DIO_DIR_OFFSET + (dio_words(sim, subdev) + word) * REGISTER_WITH);
+}
+
+static uint8_t dio_value(flink_sim* sim, uint8_t subdev, uint32_t channel) {
+	return (*dio_value_reg(sim, subdev, channel / (REGISTER_WITH * 8)) >> (channel % (REGISTER_WITH * 8))) & 1;
+}
+
+/**
+ * @brief Quadrature phase of the encoder signals, counting up in forward direction.
+ */
+static uint8_t enc_phase(uint8_t a, uint8_t b) {
+	static const uint8_t phase[4] = { 0, 1, 3, 2 };	// index b << 1 | a
+	return phase[b << 1 | a];
+}
+
+static void update_fqd(flink_sim* sim) {
+	base_dev_model* model = sim->model;
+	uint32_t* count;
+	uint8_t phase, ch;
+
+	for(ch = 0; ch < NOF_FQD_CHANNELS; ch++) {
+		phase = enc_phase(dio_value(sim, ENC_A_GPIO, ch), dio_value(sim, ENC_B_GPIO, ch));
+		count = flink_sim_reg(sim, FQD, FQD_COUNT_OFFSET + ch * REGISTER_WITH);
+		switch((phase - model->enc_phase[ch]) & 3) {
+			case 1: (*count)++; break;
+			case 3: (*count)--; break;
+			default: break;		// no change or a skipped phase, which the FQD ignores
+		}
+		model->enc_phase[ch] = phase;
+	}
+}
+
+static void update_gpio_loopback(flink_sim* sim) {
+	uint32_t w;
+
+	for(w = 0; w < dio_words(sim, IN_GPIO); w++) {
+		*dio_value_reg(sim, IN_GPIO, w) = *dio_value_reg(sim, OUT_GPIO, w) & *flink_sim_reg(sim, OUT_GPIO, DIO_DIR_OFFSET + w * REGISTER_WITH);
+	}
+}
+
+static void update_pwm_loopback(flink_sim* sim) {
+	uint64_t ticks = (sim->time_ns / 1000000000) * BASE_CLK + (sim->time_ns % 1000000000) * BASE_CLK / 1000000000;
+	uint32_t period, hightime, levels = 0;
+	uint8_t ch;
+
+	for(ch = 0; ch < NOF_PWM_CHANNELS; ch++) {
+		period = *flink_sim_reg(sim, PWM, PWM_PERIOD_OFFSET + ch * REGISTER_WITH);
+		hightime = *flink_sim_reg(sim, PWM, PWM_HIGH_OFFSET + ch * REGISTER_WITH);
+		if(period > 0 && ticks % period < hightime) levels |= 1 << ch;
+	}
+	*dio_value_reg(sim, PWM_IN_GPIO, 0) = levels;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Model                                                          *
+ *                                                                 *
+ *******************************************************************/
+
+static int base_dev_init(flink_sim* sim) {
+	sim->model = calloc(1, sizeof(base_dev_model));
+	return sim->model ? EXIT_SUCCESS : EXIT_ERROR;
+}
+
+static void base_dev_cleanup(flink_sim* sim) {
+	free(sim->model);
+}
+
+static void base_dev_before_read(flink_sim* sim, uint8_t subdev, uint32_t offset, uint32_t size) {
+	if(subdev == IN_GPIO) update_gpio_loopback(sim);
+	else if(subdev == PWM_IN_GPIO) update_pwm_loopback(sim);
+}
+
+static void base_dev_after_write(flink_sim* sim, uint8_t subdev, uint32_t offset, uint32_t size) {
+	if(subdev == ENC_A_GPIO || subdev == ENC_B_GPIO) update_fqd(sim);
+}
+
+const flink_sim_design flink_sim_base_dev_testing_design = {
+	.name           = "baseDeviceTesting",
+	.description    = "baseDeviceTesting",
+	.access_ns      = ACCESS_NS,
+	.nof_subdevices = sizeof(subdevices) / sizeof(subdevices[0]),
+	.subdevices     = subdevices,
+	.init           = base_dev_init,
+	.cleanup        = base_dev_cleanup,
+	.before_read    = base_dev_before_read,
+	.after_write    = base_dev_after_write,
+};
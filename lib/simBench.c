@@ -0,0 +1,221 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, simulated bench design                *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file simBench.c
+ *  @brief Simulated design with one subdevice of each function.
+ *
+ *  Opened with flink_open("sim:bench"). Registers behave like memory,
+ *  except for the channels of the stepper motor, which do their steps
+ *  at the top speed set by their prescaler, following the virtual
+ *  clock of the device:
+ *  - setting the start bit in the local config register starts a channel,
+ *  - the reset counter bit clears the steps done of a channel,
+ *  - the atomic set and reset registers change bits of the local config register,
+ *  - the global step reset bit in the config register clears the steps done of all channels.
+ *  Acceleration is not modelled, a channel starts at its top speed.
+ *  The inputs of the reflective sensor follow a triangle wave between
+ *  a dark and a bright value of each channel, also in virtual time.
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "sim.h"
+#include "stepperMotor.h"
+
+#include <stdlib.h>
+
+#define ACCESS_NS			1000		// virtual time of an access
+#define BASE_CLK			100000000	// Hz
+#define NOF_STEPPERS		4
+#define NOF_SENSORS			4
+#define SENSOR_PERIOD_NS	200000		// period of the triangle wave at the sensor inputs
+
+#define SENSOR_VALUE(ch)	(HEADER_SIZE + SUBHEADER_SIZE + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + (ch) * REGISTER_WITH)
+#define STEPPER_REG(reg, ch) (HEADER_SIZE + SUBHEADER_SIZE + STEPPER_MOTOR_FIRST_CONF_OFFSET + ((reg) * NOF_STEPPERS + (ch)) * REGISTER_WITH)
+
+enum { INFO, GPIO, COUNTER, PWM, PPWA, AIN, AOUT, WD, STEPPER, SENSOR, IRQ_MUX };
+
+static const flink_sim_subdev subdevices[] = {
+	[INFO]    = { INFO_DEVICE_ID,               0, 1, 0x040,  0,  0, 0        },
+	[GPIO]    = { GPIO_INTERFACE_ID,            0, 1, 0x100, 32,  1, BASE_CLK },
+	[COUNTER] = { COUNTER_INTERFACE_ID,         0, 1, 0x040,  4,  2, 0        },
+	[PWM]     = { PWM_INTERFACE_ID,             0, 1, 0x080,  4,  3, BASE_CLK },
+	[PPWA]    = { PPWA_INTERFACE_ID,            0, 1, 0x080,  4,  4, BASE_CLK },
+	[AIN]     = { ANALOG_INPUT_INTERFACE_ID,    0, 1, 0x040,  4,  5, 4096     },
+	[AOUT]    = { ANALOG_OUTPUT_INTERFACE_ID,   0, 1, 0x040,  4,  6, 4096     },
+	[WD]      = { WD_INTERFACE_ID,              0, 1, 0x040,  1,  7, BASE_CLK },
+	[STEPPER] = { STEPPER_MOTOR_INTERFACE_ID,   0, 1, 0x100,  NOF_STEPPERS, 8, BASE_CLK },
+	[SENSOR]  = { SENSOR_INTERFACE_ID,          0, 1, 0x080,  NOF_SENSORS, 9, 4096 },
+	[IRQ_MUX] = { IRQ_MULTIPLEXER_INTERFACE_ID, 0, 1, 0x040,  8, 10, 0        },
+};
+
+// Dark and bright value of each sensor input
+static const uint32_t sensor_dark[NOF_SENSORS]   = {  400,  600,  300, 1000 };
+static const uint32_t sensor_bright[NOF_SENSORS] = { 3600, 3000, 4000, 2000 };
+
+typedef struct _stepper_channel {
+	uint32_t config;		/// Local config register
+	uint32_t top;			/// Top speed prescaler
+	uint32_t steps;			/// Steps to do
+	uint32_t done;			/// Steps done up to start_ns
+	uint64_t start_ns;		/// Virtual time the channel was started or last changed
+} stepper_channel;
+
+typedef struct _bench_model {
+	stepper_channel stepper[NOF_STEPPERS];
+} bench_model;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static uint32_t* stepper_reg(flink_sim* sim, uint32_t reg, uint32_t ch) {
+	return flink_sim_reg(sim, STEPPER, STEPPER_REG(reg, ch));
+}
+
+/**
+ * @brief Steps done by a channel up to the current virtual time.
+ */
+static uint32_t stepper_done(flink_sim* sim, stepper_channel* c) {
+	uint64_t ns, ticks, done;
+
+	if(!(c->config & STEPPER_CONF_START) || c->top == 0) return c->done;
+	ns = sim->time_ns - c->start_ns;
+	ticks = (ns / 1000000000) * BASE_CLK + (ns % 1000000000) * BASE_CLK / 1000000000;
+	done = c->done + ticks / c->top;
+	return done < c->steps ? done : c->steps;
+}
+
+/**
+ * @brief Takes over the registers of a channel after a write.
+ * The steps done so far are counted with the previous registers.
+ */
+static void stepper_written(flink_sim* sim, uint32_t ch) {
+	stepper_channel* c = &((bench_model*)sim->model)->stepper[ch];
+	uint32_t* config = stepper_reg(sim, LOCAL_CONF_OFFSET, ch);
+	uint32_t* set = stepper_reg(sim, LOCAL_CONF_SET_ATOMIC_OFFSET, ch);
+	uint32_t* reset = stepper_reg(sim, LOCAL_CONF_RESET_ATOMIC_OFFSET, ch);
+
+	c->done = stepper_done(sim, c);
+	c->start_ns = sim->time_ns;
+
+	*config = (*config | *set) & ~*reset;
+	*set = 0;
+	*reset = 0;
+	if(*config & STEPPER_CONF_RES_COUNTER) c->done = 0;
+	*config &= ~(STEPPER_CONF_RES_COUNTER | STEPPER_CONF_INT_CLEAR);	// self clearing
+
+	c->config = *config;
+	c->top = *stepper_reg(sim, PRESCALER_TOP_OFFSET, ch);
+	c->steps = *stepper_reg(sim, STEPS_TO_DO_OFFSET, ch);
+	*stepper_reg(sim, STEPS_DONE_OFFSET, ch) = c->done;
+}
+
+/**
+ * @brief Value of a sensor input at the current virtual time.
+ * The inputs are a quarter period apart from each other.
+ */
+static uint32_t sensor_value(flink_sim* sim, uint32_t ch) {
+	uint64_t phase = (sim->time_ns + ch * SENSOR_PERIOD_NS / 4) % SENSOR_PERIOD_NS;
+	uint64_t pos = phase < SENSOR_PERIOD_NS / 2 ? phase : SENSOR_PERIOD_NS - phase;
+
+	return sensor_dark[ch] + (uint32_t)((sensor_bright[ch] - sensor_dark[ch]) * pos / (SENSOR_PERIOD_NS / 2));
+}
+
+static void stepper_reset_steps(flink_sim* sim) {
+	bench_model* model = sim->model;
+	uint32_t ch;
+
+	for(ch = 0; ch < NOF_STEPPERS; ch++) {
+		model->stepper[ch].done = 0;
+		model->stepper[ch].start_ns = sim->time_ns;
+		*stepper_reg(sim, STEPS_DONE_OFFSET, ch) = 0;
+	}
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Model                                                          *
+ *                                                                 *
+ *******************************************************************/
+
+static int bench_init(flink_sim* sim) {
+	sim->model = calloc(1, sizeof(bench_model));
+	return sim->model ? EXIT_SUCCESS : EXIT_ERROR;
+}
+
+static void bench_cleanup(flink_sim* sim) {
+	free(sim->model);
+}
+
+static void bench_before_read(flink_sim* sim, uint8_t subdev, uint32_t offset, uint32_t size) {
+	bench_model* model = sim->model;
+	uint32_t ch;
+
+	if(subdev == SENSOR) {
+		for(ch = 0; ch < NOF_SENSORS; ch++) {
+			if(flink_sim_covers(offset, size, SENSOR_VALUE(ch))) *flink_sim_reg(sim, SENSOR, SENSOR_VALUE(ch)) = sensor_value(sim, ch);
+		}
+	}
+	if(subdev != STEPPER) return;
+	for(ch = 0; ch < NOF_STEPPERS; ch++) {
+		if(flink_sim_covers(offset, size, STEPPER_REG(STEPS_DONE_OFFSET, ch))) {
+			*stepper_reg(sim, STEPS_DONE_OFFSET, ch) = stepper_done(sim, &model->stepper[ch]);
+		}
+	}
+}
+
+static void bench_after_write(flink_sim* sim, uint8_t subdev, uint32_t offset, uint32_t size) {
+	uint32_t* config = flink_sim_reg(sim, STEPPER, CONFIG_OFFSET);
+	uint32_t ch, reg;
+
+	if(subdev != STEPPER) return;
+	if(flink_sim_covers(offset, size, CONFIG_OFFSET) && (*config & (1 << GLOBAL_STEP_RESET))) {
+		stepper_reset_steps(sim);
+		*config &= ~(1 << GLOBAL_STEP_RESET);
+	}
+	for(ch = 0; ch < NOF_STEPPERS; ch++) {
+		for(reg = LOCAL_CONF_OFFSET; reg < STEPS_DONE_OFFSET; reg++) {
+			if(flink_sim_covers(offset, size, STEPPER_REG(reg, ch))) {
+				stepper_written(sim, ch);
+				break;
+			}
+		}
+	}
+}
+
+static void bench_reset(flink_sim* sim, uint8_t subdev) {
+	bench_model* model = sim->model;
+	uint32_t ch;
+
+	if(subdev != STEPPER) return;
+	for(ch = 0; ch < NOF_STEPPERS; ch++) model->stepper[ch] = (stepper_channel){ 0 };
+}
+
+const flink_sim_design flink_sim_bench_design = {
+	.name           = "bench",
+	.description    = "simulated register file",
+	.access_ns      = ACCESS_NS,
+	.nof_subdevices = sizeof(subdevices) / sizeof(subdevices[0]),
+	.subdevices     = subdevices,
+	.init           = bench_init,
+	.cleanup        = bench_cleanup,
+	.before_read    = bench_before_read,
+	.after_write    = bench_after_write,
+	.reset          = bench_reset,
+};
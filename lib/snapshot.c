@@ -0,0 +1,258 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, register snapshots                    *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file snapshot.c
+ *  @brief Saving and restoring the writable state of a device.
+ *
+ *  A snapshot holds the configuration and output registers of all
+ *  subdevices whose function layout is known, each range read in a
+ *  single transfer. Measurement registers (analog inputs, counters,
+ *  PPWA), the watchdog and the command registers of stepper motors are
+ *  not part of a snapshot, writing them back would have side effects.
+ *
+ *  A snapshot is tied to the design by the device fingerprint and can
+ *  be restored to any device with the same design. Only registers which
+ *  differ from the snapshot are written.
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "error.h"
+#include "valid.h"
+#include "config.h"
+#include "log.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAPSHOT_BASE	(HEADER_SIZE + SUBHEADER_SIZE)
+
+typedef struct _snapshot_header {
+	char     magic[8];			/// FLINK_SNAPSHOT_MAGIC
+	uint32_t version;			/// FLINK_SNAPSHOT_VERSION
+	uint32_t nof_ranges;		/// Nof register ranges following the header
+	uint64_t fingerprint;		/// Fingerprint of the design
+} snapshot_header;
+
+typedef struct _snapshot_range {
+	uint32_t offset;			/// Offset of the first register
+	uint32_t nof_registers;		/// Nof registers following the range
+	uint8_t  subdev;			/// Subdevice id
+	uint8_t  reserved[3];
+} snapshot_range;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Gets the range of writable registers of a subdevice.
+ * @param subdev: Subdevice.
+ * @param offset: Contains the offset of the first register.
+ * @return uint32_t: Nof registers, 0 if the subdevice has no state to save.
+ */
+static uint32_t writable_range(flink_subdev* subdev, uint32_t* offset) {
+	uint32_t n = subdev->nof_channels;
+	uint32_t words = n ? (n - 1) / (REGISTER_WITH * 8) + 1 : 0;
+	uint32_t nof;
+
+	switch(subdev->function_id) {
+		case GPIO_INTERFACE_ID:				// direction, value, debounce
+			*offset = SNAPSHOT_BASE + 4;
+			nof = 2 * words + n;
+			break;
+		case PWM_INTERFACE_ID:				// period, hightime
+			*offset = SNAPSHOT_BASE + PWM_FIRSTPWM_OFFSET;
+			nof = 2 * n;
+			break;
+		case ANALOG_OUTPUT_INTERFACE_ID:	// value
+			*offset = SNAPSHOT_BASE + ANALOG_OUTPUT_FIRST_VALUE_OFFSET;
+			nof = n;
+			break;
+		case SENSOR_INTERFACE_ID:			// upper and lower level
+			*offset = SNAPSHOT_BASE + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + n * REGISTER_WITH;
+			nof = 2 * n;
+			break;
+		case IRQ_MULTIPLEXER_INTERFACE_ID:	// multiplexer table
+			*offset = SNAPSHOT_BASE;
+			nof = n;
+			break;
+		default:
+			return 0;
+	}
+	if(*offset + nof * REGISTER_WITH > subdev->mem_size) return 0;
+	return nof;
+}
+
+/**
+ * @brief Gets the number of registers at the start of a range to be restored last.
+ * The directions of GPIOs are restored after their values, so that an
+ * output never drives the level of the state before the restore.
+ * @param subdev: Subdevice of the range.
+ * @param range: Range of the snapshot.
+ * @return uint32_t: Nof registers to restore last.
+ */
+static uint32_t restore_last(flink_subdev* subdev, const snapshot_range* range) {
+	uint32_t words = subdev->nof_channels ? (subdev->nof_channels - 1) / (REGISTER_WITH * 8) + 1 : 0;
+
+	if(subdev->function_id != GPIO_INTERFACE_ID || range->offset != SNAPSHOT_BASE + 4 || range->nof_registers <= words) return 0;
+	return words;
+}
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Saves the writable state of all subdevices of a device.
+ * @param dev: Device to save.
+ * @param snapshot: Contains the snapshot, to be released with free().
+ * @param size: Contains the size of the snapshot in bytes.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_snapshot_save(flink_dev* dev, void** snapshot, size_t* size) {
+	snapshot_header* header;
+	snapshot_range* range;
+	uint32_t offset, nof;
+	uint8_t* p;
+	size_t total = sizeof(snapshot_header);
+	int i;
+
+	if(snapshot == NULL || size == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(!validate_flink_dev(dev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	for(i = 0; i < dev->nof_subdevices; i++) {
+		nof = writable_range(&dev->subdevices[i], &offset);
+		if(nof) total += sizeof(snapshot_range) + nof * REGISTER_WITH;
+	}
+	p = malloc(total);
+	if(p == NULL) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+
+	header = (snapshot_header*)p;
+	memcpy(header->magic, FLINK_SNAPSHOT_MAGIC, sizeof(header->magic));
+	header->version = FLINK_SNAPSHOT_VERSION;
+	header->nof_ranges = 0;
+	if(flink_get_fingerprint(dev, &header->fingerprint) < 0) {
+		free(p);
+		return EXIT_ERROR;
+	}
+	*snapshot = p;
+	p += sizeof(snapshot_header);
+
+	for(i = 0; i < dev->nof_subdevices; i++) {
+		nof = writable_range(&dev->subdevices[i], &offset);
+		if(nof == 0) continue;
+		range = (snapshot_range*)p;
+		memset(range, 0, sizeof(snapshot_range));
+		range->offset = offset;
+		range->nof_registers = nof;
+		range->subdev = i;
+		p += sizeof(snapshot_range);
+		if(flink_read_block(&dev->subdevices[i], offset, nof * REGISTER_WITH, p) != nof * REGISTER_WITH) {
+			libc_error();
+			free(*snapshot);
+			*snapshot = NULL;
+			return EXIT_ERROR;
+		}
+		p += nof * REGISTER_WITH;
+		header->nof_ranges++;
+	}
+	*size = total;
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Restores a snapshot to a device with the same design.
+ * Only registers differing from the snapshot are written.
+ * @param dev: Device to restore.
+ * @param snapshot: Snapshot saved by flink_snapshot_save().
+ * @param size: Size of the snapshot in bytes.
+ * @return int: Nof registers written, -1 in case of failure.
+ */
+int flink_snapshot_restore(flink_dev* dev, const void* snapshot, size_t size) {
+	const snapshot_header* header = snapshot;
+	const snapshot_range* range;
+	const uint8_t* p = snapshot;
+	const uint8_t* end = p + size;
+	const uint32_t* value;
+	flink_subdev* subdev;
+	uint32_t i, last;
+	uint64_t fingerprint;
+	int n, written = 0;
+
+	if(snapshot == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(!validate_flink_dev(dev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	if(size < sizeof(snapshot_header) || memcmp(header->magic, FLINK_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+	   header->version != FLINK_SNAPSHOT_VERSION) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+	if(flink_get_fingerprint(dev, &fingerprint) < 0) return EXIT_ERROR;
+	if(fingerprint != header->fingerprint) {
+		flink_error(FLINK_EINVALARG);	// snapshot of another design
+		return EXIT_ERROR;
+	}
+
+	// Check all ranges before writing anything
+	p += sizeof(snapshot_header);
+	for(i = 0; i < header->nof_ranges; i++) {
+		range = (const snapshot_range*)p;
+		if(end - p < (ptrdiff_t)sizeof(snapshot_range) || range->subdev >= dev->nof_subdevices ||
+		   end - p - sizeof(snapshot_range) < (uint64_t)range->nof_registers * REGISTER_WITH ||
+		   (uint64_t)range->offset + (uint64_t)range->nof_registers * REGISTER_WITH > dev->subdevices[range->subdev].mem_size) {
+			flink_error(FLINK_EINVALARG);
+			return EXIT_ERROR;
+		}
+		p += sizeof(snapshot_range) + range->nof_registers * REGISTER_WITH;
+	}
+
+	p = (const uint8_t*)snapshot + sizeof(snapshot_header);
+	for(i = 0; i < header->nof_ranges; i++) {
+		range = (const snapshot_range*)p;
+		value = (const uint32_t*)(p + sizeof(snapshot_range));
+		subdev = &dev->subdevices[range->subdev];
+		last = restore_last(subdev, range);
+		dbg_print("Restoring %u registers at 0x%x on subdevice %u\n", range->nof_registers, range->offset, range->subdev);
+		n = flink_write_changed(subdev, range->offset + last * REGISTER_WITH, range->nof_registers - last, value + last, NULL);
+		if(n < 0) return EXIT_ERROR;
+		written += n;
+		if(last) {
+			n = flink_write_changed(subdev, range->offset, last, value, NULL);
+			if(n < 0) return EXIT_ERROR;
+			written += n;
+		}
+		p += sizeof(snapshot_range) + range->nof_registers * REGISTER_WITH;
+	}
+	return written;
+}
@@ -0,0 +1,455 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, SPI transport                         *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file spi.c
+ *  @brief Transport for flink devices behind spidev, without kernel module.
+ *
+ *  Every access is a frame with chip select asserted: a header with the
+ *  command word (FLINK_SPI_WRITE for writes, and the nof bytes) and the
+ *  byte address in the address space of the device, followed by the
+ *  data for writes, or by a turnaround word and the data clocked in for
+ *  reads. All words are little endian.
+ *
+ *  Block transfers are split into frames of the burst length the device
+ *  accepts, which are packed into as few SPI messages as the message size
+ *  limit of spidev allows, each message is a single system call. The
+ *  subdevices are enumerated by reading the header of one subdevice
+ *  after the other, starting at address 0.
+ *
+ *  Instead of a spidev device file, an endpoint registered with
+ *  flink_spi_register_endpoint() can receive the messages, e.g. a model
+ *  of the FPGA for tests.
+ */
+
+#include "flinklib.h"
+#include "flinkioctl.h"
+#include "types.h"
+#include "error.h"
+#include "log.h"
+#include "transport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+
+#define SPI_MAX_ENDPOINTS	8
+#define SPI_MAX_FRAMES		32			// frames per message
+#define SPI_MAX_MESSAGE		0x10000		// bytes per message, if the endpoint has no limit
+#define SPI_BUFSIZ_FILE		"/sys/module/spidev/parameters/bufsiz"
+#define SPI_READ_OVERHEAD	(FLINK_SPI_HEADER_SIZE + FLINK_SPI_TURNAROUND)
+
+typedef struct _spi_subdev {
+	uint32_t base_addr;
+	uint32_t header[4];		/// Type, memory size, nof channels, unique id
+} spi_subdev;
+
+typedef struct _spi_dev {
+	flink_spi_endpoint endpoint;
+	pthread_mutex_t    lock;		/// Serializes messages and protects the buffers
+	uint8_t*           tx;
+	uint8_t*           rx;
+	uint8_t            nof_subdevices;
+	spi_subdev         subdevices[UINT8_MAX];
+} spi_dev;
+
+typedef struct _spi_endpoint_entry {
+	char               name[32];
+	flink_spi_endpoint endpoint;
+} spi_endpoint_entry;
+
+static spi_endpoint_entry endpoints[SPI_MAX_ENDPOINTS];
+static pthread_mutex_t endpoints_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Sends a message to a spidev device, the frames are separated by chip select.
+ */
+static int spidev_message(void* data, const flink_spi_frame* frames, uint32_t nof_frames) {
+	struct spi_ioc_transfer xfer[SPI_MAX_FRAMES];
+	uint32_t i;
+
+	memset(xfer, 0, sizeof(xfer));
+	for(i = 0; i < nof_frames; i++) {
+		xfer[i].tx_buf = (uintptr_t)frames[i].tx;
+		xfer[i].rx_buf = (uintptr_t)frames[i].rx;
+		xfer[i].len = frames[i].len;
+		xfer[i].cs_change = i + 1 < nof_frames;
+	}
+	return ioctl((int)(intptr_t)data, SPI_IOC_MESSAGE(nof_frames), xfer) < 0 ? EXIT_ERROR : EXIT_SUCCESS;
+}
+
+static uint32_t spidev_bufsiz(void) {
+	unsigned int bufsiz = 4096;	// default of spidev
+	FILE* f = fopen(SPI_BUFSIZ_FILE, "r");
+
+	if(f) {
+		if(fscanf(f, "%u", &bufsiz) != 1) bufsiz = 4096;
+		fclose(f);
+	}
+	return bufsiz;
+}
+
+static void put_header(uint8_t* p, uint32_t cmd, uint32_t addr) {
+	uint32_t i;
+	for(i = 0; i < 4; i++) {
+		p[i] = cmd >> (8 * i);
+		p[4 + i] = addr >> (8 * i);
+	}
+}
+
+/**
+ * @brief Nof data bytes of the next frame, limited by the free space of the message and the burst length.
+ */
+static uint32_t spi_chunk(spi_dev* spi, uint32_t remaining, uint32_t space) {
+	uint32_t chunk = remaining < space ? remaining : space;
+
+	if(spi->endpoint.max_burst && chunk > spi->endpoint.max_burst) chunk = spi->endpoint.max_burst;
+	return chunk;
+}
+
+static int spi_message(flink_dev* dev, const flink_spi_frame* frames, uint32_t nof_frames) {
+	spi_dev* spi = dev->transport_data;
+
+	flink_count_syscall(dev);
+	return spi->endpoint.message(spi->endpoint.data, frames, nof_frames);
+}
+
+/**
+ * @brief Reads from the address space of the device, packing the frames into as few messages as possible.
+ * The lock of the device must be held.
+ */
+static ssize_t spi_read(flink_dev* dev, uint32_t addr, uint32_t size, void* rdata) {
+	spi_dev* spi = dev->transport_data;
+	flink_spi_frame frames[SPI_MAX_FRAMES];
+	uint8_t* dst[SPI_MAX_FRAMES];
+	uint32_t n, pos, used, chunk, done = 0, max = spi->endpoint.max_message;
+
+	while(done < size) {
+		n = 0;
+		used = 0;
+		while(done < size && n < SPI_MAX_FRAMES && max - used > SPI_READ_OVERHEAD) {
+			chunk = spi_chunk(spi, size - done, max - used - SPI_READ_OVERHEAD);
+			pos = used;
+			memset(spi->tx + pos, 0, SPI_READ_OVERHEAD + chunk);
+			put_header(spi->tx + pos, chunk, addr + done);
+			frames[n].tx = spi->tx + pos;
+			frames[n].rx = spi->rx + pos;
+			frames[n].len = SPI_READ_OVERHEAD + chunk;
+			dst[n++] = (uint8_t*)rdata + done;
+			used += SPI_READ_OVERHEAD + chunk;
+			done += chunk;
+		}
+		if(spi_message(dev, frames, n) < 0) return EXIT_ERROR;
+		while(n--) memcpy(dst[n], frames[n].rx + SPI_READ_OVERHEAD, frames[n].len - SPI_READ_OVERHEAD);
+	}
+	return size;
+}
+
+/**
+ * @brief Writes to the address space of the device, packing the frames into as few messages as possible.
+ * The lock of the device must be held.
+ */
+static ssize_t spi_write(flink_dev* dev, uint32_t addr, uint32_t size, const void* wdata) {
+	spi_dev* spi = dev->transport_data;
+	flink_spi_frame frames[SPI_MAX_FRAMES];
+	uint32_t n, used, chunk, done = 0, max = spi->endpoint.max_message;
+
+	while(done < size) {
+		n = 0;
+		used = 0;
+		while(done < size && n < SPI_MAX_FRAMES && max - used > FLINK_SPI_HEADER_SIZE) {
+			chunk = spi_chunk(spi, size - done, max - used - FLINK_SPI_HEADER_SIZE);
+			put_header(spi->tx + used, FLINK_SPI_WRITE | chunk, addr + done);
+			memcpy(spi->tx + used + FLINK_SPI_HEADER_SIZE, (const uint8_t*)wdata + done, chunk);
+			frames[n].tx = spi->tx + used;
+			frames[n].rx = NULL;
+			frames[n++].len = FLINK_SPI_HEADER_SIZE + chunk;
+			used += FLINK_SPI_HEADER_SIZE + chunk;
+			done += chunk;
+		}
+		if(spi_message(dev, frames, n) < 0) return EXIT_ERROR;
+	}
+	return size;
+}
+
+/**
+ * @brief Translates a subdevice access into an address, checking the bounds.
+ */
+static int spi_address(spi_dev* spi, uint8_t subdev, uint32_t offset, uint32_t size, uint32_t* addr) {
+	if(subdev >= spi->nof_subdevices) {
+		errno = EINVAL;
+		return EXIT_ERROR;
+	}
+	if(offset > spi->subdevices[subdev].header[1] || size > spi->subdevices[subdev].header[1] - offset) {
+		errno = EFAULT;
+		return EXIT_ERROR;
+	}
+	*addr = spi->subdevices[subdev].base_addr + offset;
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Reads the headers of all subdevices.
+ */
+static int spi_enumerate(flink_dev* dev) {
+	spi_dev* spi = dev->transport_data;
+	spi_subdev* s;
+	uint32_t addr = 0;
+
+	while(spi->nof_subdevices < UINT8_MAX) {
+		s = &spi->subdevices[spi->nof_subdevices];
+		if(spi_read(dev, addr, sizeof(s->header), s->header) < 0) return EXIT_ERROR;
+		if(s->header[1] < HEADER_SIZE + SUBHEADER_SIZE || s->header[1] % REGISTER_WITH) break;	// end of the subdevices
+		dbg_print("SPI subdevice %u at 0x%x: function 0x%x, size 0x%x\n", spi->nof_subdevices, addr, s->header[0] >> 16, s->header[1]);
+		s->base_addr = addr;
+		spi->nof_subdevices++;
+		if((uint64_t)addr + s->header[1] > UINT32_MAX) break;
+		addr += s->header[1];
+	}
+	return EXIT_SUCCESS;
+}
+
+static int spi_rw_bit(flink_dev* dev, ioctl_bit_container_t* arg, int write) {
+	spi_dev* spi = dev->transport_data;
+	uint32_t addr, reg, mask = 1u << (arg->bit % (REGISTER_WITH * 8));
+	int ret = EXIT_ERROR;
+
+	if(spi_address(spi, arg->subdevice, arg->offset, REGISTER_WITH, &addr) < 0) return EXIT_ERROR;
+	pthread_mutex_lock(&spi->lock);
+	if(spi_read(dev, addr, REGISTER_WITH, &reg) == REGISTER_WITH) {
+		if(!write) {
+			arg->value = (reg & mask) != 0;
+			ret = EXIT_SUCCESS;
+		}
+		else {
+			reg = arg->value ? reg | mask : reg & ~mask;
+			if(spi_write(dev, addr, REGISTER_WITH, &reg) == REGISTER_WITH) ret = EXIT_SUCCESS;
+		}
+	}
+	pthread_mutex_unlock(&spi->lock);
+	return ret;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Transport                                                      *
+ *                                                                 *
+ *******************************************************************/
+
+static void spi_free(spi_dev* spi) {
+	if(spi->endpoint.message == spidev_message) close((int)(intptr_t)spi->endpoint.data);
+	pthread_mutex_destroy(&spi->lock);
+	free(spi->tx);
+	free(spi->rx);
+	free(spi);
+}
+
+static int spi_open(flink_dev* dev, const char* path) {
+	spi_dev* spi;
+	int i, fd;
+
+	spi = calloc(1, sizeof(spi_dev));
+	if(spi == NULL) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&endpoints_lock);
+	for(i = 0; i < SPI_MAX_ENDPOINTS; i++) {
+		if(endpoints[i].endpoint.message && strcmp(endpoints[i].name, path) == 0) spi->endpoint = endpoints[i].endpoint;
+	}
+	pthread_mutex_unlock(&endpoints_lock);
+
+	if(spi->endpoint.message == NULL) {
+		fd = open(path, O_RDWR | O_CLOEXEC);
+		if(fd < 0) {
+			libc_error();
+			free(spi);
+			return EXIT_ERROR;
+		}
+		spi->endpoint.message = spidev_message;
+		spi->endpoint.data = (void*)(intptr_t)fd;
+		spi->endpoint.max_message = spidev_bufsiz();
+	}
+	if(spi->endpoint.max_message == 0 || spi->endpoint.max_message > SPI_MAX_MESSAGE) spi->endpoint.max_message = SPI_MAX_MESSAGE;
+	pthread_mutex_init(&spi->lock, NULL);
+	spi->tx = malloc(spi->endpoint.max_message);
+	spi->rx = malloc(spi->endpoint.max_message);
+	dev->fd = -1;
+	dev->transport_data = spi;
+	if(spi->tx == NULL || spi->rx == NULL || spi->endpoint.max_message <= SPI_READ_OVERHEAD + sizeof(spi->subdevices[0].header)) {
+		if(spi->tx && spi->rx) flink_error(FLINK_EINVALARG);	// messages too small for a subdevice header
+		else libc_error();
+		spi_free(spi);
+		return EXIT_ERROR;
+	}
+	if(spi_enumerate(dev) < 0) {
+		libc_error();
+		spi_free(spi);
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
+
+static void spi_close(flink_dev* dev) {
+	spi_free(dev->transport_data);
+}
+
+static int spi_ioctl(flink_dev* dev, int cmd, void* arg) {
+	spi_dev* spi = dev->transport_data;
+	ioctl_container_t* container = arg;
+	flink_subdev* subdev = arg;
+	spi_subdev* s;
+	uint32_t addr;
+	ssize_t ret;
+
+	switch(cmd) {
+		case READ_NOF_SUBDEVICES:
+			*(uint8_t*)arg = spi->nof_subdevices;
+			return EXIT_SUCCESS;
+		case READ_SUBDEVICE_INFO:
+			if(subdev->id >= spi->nof_subdevices) {
+				errno = EINVAL;
+				return EXIT_ERROR;
+			}
+			s = &spi->subdevices[subdev->id];
+			subdev->function_id      = s->header[0] >> 16;
+			subdev->sub_function_id  = s->header[0] >> 8;
+			subdev->function_version = s->header[0];
+			subdev->base_addr        = s->base_addr;
+			subdev->mem_size         = s->header[1];
+			subdev->nof_channels     = s->header[2];
+			subdev->unique_id        = s->header[3];
+			return EXIT_SUCCESS;
+		case SELECT_SUBDEVICE:
+		case SELECT_SUBDEVICE_EXCL:
+			if(*(uint8_t*)arg >= spi->nof_subdevices) {
+				errno = EINVAL;
+				return EXIT_ERROR;
+			}
+			return EXIT_SUCCESS;
+		case SELECT_AND_READ:
+		case SELECT_AND_WRITE:
+			if(spi_address(spi, container->subdevice, container->offset, container->size, &addr) < 0) return EXIT_ERROR;
+			pthread_mutex_lock(&spi->lock);
+			if(cmd == SELECT_AND_READ) ret = spi_read(dev, addr, container->size, container->data);
+			else ret = spi_write(dev, addr, container->size, container->data);
+			pthread_mutex_unlock(&spi->lock);
+			return ret;
+		case SELECT_AND_READ_BIT:
+			return spi_rw_bit(dev, arg, 0);
+		case SELECT_AND_WRITE_BIT:
+			return spi_rw_bit(dev, arg, 1);
+		case REGISTER_IRQ:
+		case UNREGISTER_IRQ:
+		case GET_SIGNAL_OFFSET:
+			errno = ENOTSUP;
+			return EXIT_ERROR;
+		default:
+			errno = ENOTTY;
+			return EXIT_ERROR;
+	}
+}
+
+static ssize_t spi_read_block(flink_subdev* subdev, uint32_t offset, uint32_t size, void* rdata) {
+	flink_dev* dev = subdev->parent;
+	spi_dev* spi = dev->transport_data;
+	uint32_t addr;
+	ssize_t ret;
+
+	if(spi_address(spi, subdev->id, offset, size, &addr) < 0) return EXIT_ERROR;
+	pthread_mutex_lock(&spi->lock);
+	ret = spi_read(dev, addr, size, rdata);
+	pthread_mutex_unlock(&spi->lock);
+	return ret;
+}
+
+static ssize_t spi_write_block(flink_subdev* subdev, uint32_t offset, uint32_t size, const void* wdata) {
+	flink_dev* dev = subdev->parent;
+	spi_dev* spi = dev->transport_data;
+	uint32_t addr;
+	ssize_t ret;
+
+	if(spi_address(spi, subdev->id, offset, size, &addr) < 0) return EXIT_ERROR;
+	pthread_mutex_lock(&spi->lock);
+	ret = spi_write(dev, addr, size, wdata);
+	pthread_mutex_unlock(&spi->lock);
+	return ret;
+}
+
+const flink_transport flink_spi_transport = {
+	.prefix      = FLINK_SPI_PREFIX,
+	.open        = spi_open,
+	.close       = spi_close,
+	.ioctl       = spi_ioctl,
+	.read_block  = spi_read_block,
+	.write_block = spi_write_block,
+};
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Registers an endpoint receiving the SPI messages of devices opened as "spi:<name>".
+ * @param name: Name of the endpoint.
+ * @param endpoint: Endpoint, copied. NULL removes the endpoint.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_spi_register_endpoint(const char* name, const flink_spi_endpoint* endpoint) {
+	spi_endpoint_entry* free_entry = NULL;
+	int i, ret = EXIT_SUCCESS;
+
+	if(name == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(strlen(name) >= sizeof(endpoints[0].name) || (endpoint && endpoint->message == NULL)) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&endpoints_lock);
+	for(i = 0; i < SPI_MAX_ENDPOINTS; i++) {
+		if(endpoints[i].endpoint.message && strcmp(endpoints[i].name, name) == 0) {
+			memset(&endpoints[i], 0, sizeof(spi_endpoint_entry));
+		}
+		if(free_entry == NULL && endpoints[i].endpoint.message == NULL) free_entry = &endpoints[i];
+	}
+	if(endpoint) {
+		if(free_entry) {
+			strcpy(free_entry->name, name);
+			free_entry->endpoint = *endpoint;
+		}
+		else {
+			flink_error(FLINK_ENOSPACE);	// all endpoints in use
+			ret = EXIT_ERROR;
+		}
+	}
+	pthread_mutex_unlock(&endpoints_lock);
+	return ret;
+}
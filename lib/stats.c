@@ -0,0 +1,262 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, operation statistics                  *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file stats.c
+ *  @brief Counters and latency histograms of device operations.
+ *
+ *  Every thread records into its own block of counters per device, so
+ *  recording takes no locks. The blocks of a device form a list which
+ *  only grows until the device is closed. A snapshot sums up all
+ *  blocks. A reset increments the epoch of the device, blocks of an
+ *  older epoch are ignored by snapshots and cleared by their thread
+ *  on its next operation.
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "error.h"
+#include "valid.h"
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char* const op_names[FLINK_NOF_OPS] = {
+	"device_info",
+	"select",
+	"read",
+	"write",
+	"read_bit",
+	"write_bit",
+	"read_block",
+	"write_block",
+	"irq",
+	"other",
+};
+
+/**
+ * @brief Returns the name of an operation.
+ * @param op: Operation.
+ * @return const char*: Name of the operation.
+ */
+const char* flink_op2str(flink_op op) {
+	if(op >= FLINK_NOF_OPS) return "unknown";
+	return op_names[op];
+}
+
+#if FLINK_STATS
+
+#define CACHE_SIZE 4	// devices per thread with a cached block
+
+struct _flink_stats_block {
+	flink_stats_block* next;
+	pthread_t          owner;
+	uint64_t           epoch;
+	uint8_t            nof_subdevices;
+	flink_op_stats     ops[FLINK_NOF_OPS];
+	flink_op_stats     subdevices[];
+};
+
+static uint64_t next_dev_id = 1;
+
+static __thread struct {
+	uint64_t           dev_id;
+	flink_stats_block* block;
+} cache[CACHE_SIZE];
+static __thread unsigned int cache_next;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static unsigned int bucket(uint64_t ns) {
+	unsigned int b = 63 - __builtin_clzll(ns | 1);
+	return b < FLINK_STATS_BUCKETS ? b : FLINK_STATS_BUCKETS - 1;
+}
+
+/**
+ * @brief Adds a sample, only called by the owner of the counters.
+ */
+static void add_sample(flink_op_stats* s, uint64_t ns, int failed) {
+	__atomic_store_n(&s->count, s->count + 1, __ATOMIC_RELAXED);
+	if(failed) __atomic_store_n(&s->errors, s->errors + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&s->total_ns, s->total_ns + ns, __ATOMIC_RELAXED);
+	if(ns > s->max_ns) __atomic_store_n(&s->max_ns, ns, __ATOMIC_RELAXED);
+	__atomic_store_n(&s->histogram[bucket(ns)], s->histogram[bucket(ns)] + 1, __ATOMIC_RELAXED);
+}
+
+static void clear_stats(flink_op_stats* s) {
+	uint64_t* v = (uint64_t*)s;
+	size_t i;
+
+	for(i = 0; i < sizeof(flink_op_stats) / sizeof(uint64_t); i++) __atomic_store_n(&v[i], 0, __ATOMIC_RELAXED);
+}
+
+static void sum_stats(flink_op_stats* sum, const flink_op_stats* s) {
+	uint64_t max = __atomic_load_n(&s->max_ns, __ATOMIC_RELAXED);
+	unsigned int i;
+
+	sum->count += __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+	sum->errors += __atomic_load_n(&s->errors, __ATOMIC_RELAXED);
+	sum->total_ns += __atomic_load_n(&s->total_ns, __ATOMIC_RELAXED);
+	if(max > sum->max_ns) sum->max_ns = max;
+	for(i = 0; i < FLINK_STATS_BUCKETS; i++) sum->histogram[i] += __atomic_load_n(&s->histogram[i], __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Returns the block of the calling thread for a device, allocates it if needed.
+ * @return flink_stats_block*: Block or NULL if out of memory.
+ */
+static flink_stats_block* get_block(flink_dev* dev) {
+	flink_stats_block* block;
+	unsigned int i;
+
+	for(i = 0; i < CACHE_SIZE; i++) {
+		if(cache[i].dev_id == dev->stats_id && cache[i].block->nof_subdevices >= dev->nof_subdevices) return cache[i].block;
+	}
+
+	// Cache miss, newest blocks are at the head of the list
+	for(block = __atomic_load_n(&dev->stats_blocks, __ATOMIC_ACQUIRE); block; block = block->next) {
+		if(pthread_equal(block->owner, pthread_self())) break;
+	}
+	if(block == NULL || block->nof_subdevices < dev->nof_subdevices) {
+		// Blocks are replaced when the subdevices are known, old ones stay in the list
+		block = calloc(1, sizeof(flink_stats_block) + dev->nof_subdevices * sizeof(flink_op_stats));
+		if(block == NULL) return NULL;
+		block->owner = pthread_self();
+		block->epoch = __atomic_load_n(&dev->stats_epoch, __ATOMIC_ACQUIRE);
+		block->nof_subdevices = dev->nof_subdevices;
+		block->next = __atomic_load_n(&dev->stats_blocks, __ATOMIC_RELAXED);
+		while(!__atomic_compare_exchange_n(&dev->stats_blocks, &block->next, block, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	}
+
+	cache[cache_next].dev_id = dev->stats_id;
+	cache[cache_next].block = block;
+	cache_next = (cache_next + 1) % CACHE_SIZE;
+	return block;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Library internal methods                                       *
+ *                                                                 *
+ *******************************************************************/
+
+void flink_stats_init(flink_dev* dev) {
+	dev->stats_id = __atomic_fetch_add(&next_dev_id, 1, __ATOMIC_RELAXED);
+	dev->stats_blocks = NULL;
+	dev->stats_epoch = 0;
+}
+
+void flink_stats_free(flink_dev* dev) {
+	flink_stats_block* block = dev->stats_blocks;
+	flink_stats_block* next;
+
+	while(block) {
+		next = block->next;
+		free(block);
+		block = next;
+	}
+	dev->stats_blocks = NULL;
+}
+
+/**
+ * @brief Records an operation which took ns nanoseconds.
+ */
+void flink_stats_record(flink_dev* dev, flink_op op, int subdev, uint64_t ns, int failed) {
+	uint64_t epoch = __atomic_load_n(&dev->stats_epoch, __ATOMIC_ACQUIRE);
+	flink_stats_block* block = get_block(dev);
+	uint8_t i;
+
+	if(block == NULL) return;
+	if(block->epoch != epoch) {
+		for(i = 0; i < FLINK_NOF_OPS; i++) clear_stats(&block->ops[i]);
+		for(i = 0; i < block->nof_subdevices; i++) clear_stats(&block->subdevices[i]);
+		__atomic_store_n(&block->epoch, epoch, __ATOMIC_RELEASE);
+	}
+	add_sample(&block->ops[op], ns, failed);
+	if(subdev >= 0 && subdev < block->nof_subdevices) add_sample(&block->subdevices[subdev], ns, failed);
+}
+
+#endif // FLINK_STATS
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Returns the statistics of all operations on a device since it was opened or reset.
+ * @param dev: Flink device handle.
+ * @param ops: Array of FLINK_NOF_OPS entries, gets the statistics per operation.
+ * @param subdevices: Array with an entry per subdevice, gets the statistics per subdevice. May be NULL.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_stats_snapshot(flink_dev* dev, flink_op_stats* ops, flink_op_stats* subdevices) {
+#if FLINK_STATS
+	flink_stats_block* block;
+	uint64_t epoch;
+	uint8_t i;
+
+	if(!validate_flink_dev(dev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	if(ops == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+
+	memset(ops, 0, FLINK_NOF_OPS * sizeof(flink_op_stats));
+	if(subdevices) memset(subdevices, 0, dev->nof_subdevices * sizeof(flink_op_stats));
+	epoch = __atomic_load_n(&dev->stats_epoch, __ATOMIC_ACQUIRE);
+	for(block = __atomic_load_n(&dev->stats_blocks, __ATOMIC_ACQUIRE); block; block = block->next) {
+		if(__atomic_load_n(&block->epoch, __ATOMIC_ACQUIRE) != epoch) continue;
+		for(i = 0; i < FLINK_NOF_OPS; i++) sum_stats(&ops[i], &block->ops[i]);
+		if(subdevices) {
+			for(i = 0; i < block->nof_subdevices && i < dev->nof_subdevices; i++) sum_stats(&subdevices[i], &block->subdevices[i]);
+		}
+	}
+	return EXIT_SUCCESS;
+#else
+	flink_error(FLINK_ENOTSUPPORTED);
+	return EXIT_ERROR;
+#endif
+}
+
+/**
+ * @brief Resets the statistics of a device.
+ * Operations running concurrently to the reset may be lost.
+ * @param dev: Flink device handle.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_stats_reset(flink_dev* dev) {
+#if FLINK_STATS
+	if(!validate_flink_dev(dev)) {
+		flink_error(FLINK_EINVALDEV);
+		return EXIT_ERROR;
+	}
+	__atomic_fetch_add(&dev->stats_epoch, 1, __ATOMIC_ACQ_REL);
+	return EXIT_SUCCESS;
+#else
+	flink_error(FLINK_ENOTSUPPORTED);
+	return EXIT_ERROR;
+#endif
+}
@@ -0,0 +1,49 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, operation statistics                  *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file stats.h
+ *  @brief Recording of operation statistics.
+ *
+ *  The instrumentation is removed by compiling with FLINK_STATS=0,
+ *  which is controlled by the CMake option FLINK_STATS.
+ */
+
+#ifndef FLINKLIB_STATS_H_
+#define FLINKLIB_STATS_H_
+
+#include "types.h"
+
+#ifndef FLINK_STATS
+#define FLINK_STATS 1
+#endif
+
+#define FLINK_STATS_NO_SUBDEV -1
+
+#if FLINK_STATS
+
+typedef struct _flink_stats_block flink_stats_block;
+
+void flink_stats_init(flink_dev* dev);
+void flink_stats_free(flink_dev* dev);
+void flink_stats_record(flink_dev* dev, flink_op op, int subdev, uint64_t ns, int failed);
+
+#else
+
+#define flink_stats_init(dev)                          do { } while(0)
+#define flink_stats_free(dev)                          do { } while(0)
+#define flink_stats_record(dev, op, subdev, ns, failed) do { } while(0)
+
+#endif // FLINK_STATS
+
+#endif // FLINKLIB_STATS_H_
@@ -25,15 +25,7 @@
 #include "types.h"
 #include "error.h"
 #include "log.h"
-
-#define LOCAL_CONF_OFFSET 0              //number of first register with one channel
-#define LOCAL_CONF_SET_ATOMIC_OFFSET 1   //number to set bit(s) atomic with one channel
-#define LOCAL_CONF_RESET_ATOMIC_OFFSET 2 //number to reset bit(s) atomic with one channel
-#define PRESCALER_START_OFFSET 3         //number of first register with one channel
-#define PRESCALER_TOP_OFFSET 4           //number of first register with one channel
-#define ACCELERATION_OFFSET 5            //number of first register with one channel
-#define STEPS_TO_DO_OFFSET 6             //number of first register with one channel
-#define STEPS_DONE_OFFSET 7              //number of first register with one channel
+#include "stepperMotor.h"
 
 // ========================================================================
 //                          private functions
@@ -43,15 +35,11 @@
  * private write function
  */
 int flink_stepperMotor_set(flink_subdev* subdev, uint32_t channel, uint32_t register_offset, uint32_t data) {
-	uint32_t offset_header;
-	uint32_t offset_subdev;
 	uint32_t offset;
 
 	dbg_print(" --> Setting stepperMotor register for channel %d on subdevice %d\n", subdev->id, channel);
 	
-	offset_header = HEADER_SIZE + SUBHEADER_SIZE;
-	offset_subdev = STEPPER_MOTOR_FIRST_CONF_OFFSET + subdev->nof_channels * REGISTER_WITH * register_offset+ REGISTER_WITH * channel;
-	offset = offset_header + offset_subdev;
+	offset = stepper_reg_offset(subdev, channel, register_offset);
 	dbg_print("  --> calculated offset is 0x%x!\n", offset);
 
 	if(flink_write(subdev, offset, REGISTER_WITH, &data) != REGISTER_WITH) {
@@ -66,15 +54,11 @@ int flink_stepperMotor_set(flink_subdev* subdev, uint32_t channel, uint32_t regi
  * private read function
  */
 int flink_stepperMotor_get(flink_subdev* subdev, uint32_t channel, uint32_t register_offset, uint32_t* data) {
-	uint32_t offset_header;
-	uint32_t offset_subdev;
 	uint32_t offset;
 		
 	dbg_print("Reading period value from pwm %d of subdevice %d\n", channel, subdev->id);
 	
-	offset_header = HEADER_SIZE + SUBHEADER_SIZE;
-	offset_subdev = STEPPER_MOTOR_FIRST_CONF_OFFSET + subdev->nof_channels * REGISTER_WITH * register_offset+ REGISTER_WITH * channel;
-	offset = offset_header + offset_subdev;
+	offset = stepper_reg_offset(subdev, channel, register_offset);
 	dbg_print("  --> calculated offset is 0x%x!\n", offset);
 	
 	if(flink_read(subdev, offset, REGISTER_WITH, data) != REGISTER_WITH) {
@@ -0,0 +1,54 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, stepper motor register layout         *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file stepperMotor.h
+ *  @brief Register layout of the subdevice function "stepperMotor".
+ *
+ *  Shared by the register accessors and the move queue.
+ */
+
+#ifndef FLINKLIB_STEPPERMOTOR_H_
+#define FLINKLIB_STEPPERMOTOR_H_
+
+#include "types.h"
+
+#define LOCAL_CONF_OFFSET 0              //number of first register with one channel
+#define LOCAL_CONF_SET_ATOMIC_OFFSET 1   //number to set bit(s) atomic with one channel
+#define LOCAL_CONF_RESET_ATOMIC_OFFSET 2 //number to reset bit(s) atomic with one channel
+#define PRESCALER_START_OFFSET 3         //number of first register with one channel
+#define PRESCALER_TOP_OFFSET 4           //number of first register with one channel
+#define ACCELERATION_OFFSET 5            //number of first register with one channel
+#define STEPS_TO_DO_OFFSET 6             //number of first register with one channel
+#define STEPS_DONE_OFFSET 7              //number of first register with one channel
+
+// local config register bits
+#define STEPPER_CONF_DIRECTION   (1 << 0)
+#define STEPPER_CONF_FULL_STEP   (1 << 1)
+#define STEPPER_CONF_TWO_PHASE   (1 << 2)
+#define STEPPER_CONF_MODE_1      (1 << 3)
+#define STEPPER_CONF_MODE_2      (1 << 4)
+#define STEPPER_CONF_START       (1 << 5)
+#define STEPPER_CONF_RES_COUNTER (1 << 6)
+#define STEPPER_CONF_INT_ENABLE  (1 << 7)
+#define STEPPER_CONF_INT_CLEAR   (1 << 8)
+
+/**
+ * @brief Offset of a channel register relative to the subdevice base address.
+ */
+static inline uint32_t stepper_reg_offset(flink_subdev* subdev, uint32_t channel, uint32_t register_offset) {
+	return HEADER_SIZE + SUBHEADER_SIZE + STEPPER_MOTOR_FIRST_CONF_OFFSET +
+	       subdev->nof_channels * REGISTER_WITH * register_offset + REGISTER_WITH * channel;
+}
+
+#endif // FLINKLIB_STEPPERMOTOR_H_
@@ -0,0 +1,269 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, stepper motor S-curve profiles        *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file stepperMotorProfile.c
+ *  @brief flink userspace library, jerk-limited profiles for "stepperMotor" channels.
+ *
+ *  The stepper subdevice ramps the prescaler linearly from the start
+ *  to the top prescaler by a constant acceleration register. A
+ *  jerk-limited S-curve is approximated by a table of such linear
+ *  segments: the acceleration and deceleration ramps are split into
+ *  a jerk phase, a constant acceleration phase and a second jerk phase,
+ *  each of which is cut into FLINK_STEPPER_PHASE_SEGMENTS segments.
+ *  The segments are executed one after the other by the move queue.
+ *
+ *  The profile is copied to storage of the caller. The most recently
+ *  used tables are kept in a small process wide cache, so a table is
+ *  computed only once while its parameter set is in use.
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "error.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+
+#define FIT_ITERATIONS 48   // bisection steps when the move is too short for the top speed
+#define CACHE_SIZE     16   // cached profiles, the least recently used one is replaced
+
+typedef struct _profile_entry {
+	flink_stepper_profile profile;
+	uint64_t              used;		/// Time of the last use, 0 if the entry is empty
+} profile_entry;
+
+static profile_entry   profile_cache[CACHE_SIZE];
+static uint64_t        profile_clock = 0;
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct _scurve {
+	double v0;		// start speed
+	double v1;		// end speed
+	double jerk;
+	double tj;		// duration of each jerk phase
+	double tc;		// duration of the constant acceleration phase
+} scurve;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static void scurve_plan(scurve* c, double v0, double v1, double acc, double jerk) {
+	double dv = v1 - v0;
+
+	c->v0 = v0;
+	c->v1 = v1;
+	c->jerk = jerk;
+	if(dv <= 0) {
+		c->tj = 0;
+		c->tc = 0;
+	}
+	else if(dv * jerk <= acc * acc) { // acceleration limit is not reached
+		c->tj = sqrt(dv / jerk);
+		c->tc = 0;
+	}
+	else {
+		c->tj = acc / jerk;
+		c->tc = dv / acc - c->tj;
+	}
+}
+
+static double scurve_duration(const scurve* c) {
+	return 2 * c->tj + c->tc;
+}
+
+static double scurve_distance(const scurve* c) {
+	return (c->v0 + c->v1) / 2 * scurve_duration(c); // the ramp is point symmetric
+}
+
+static double scurve_speed(const scurve* c, double t) {
+	double t_end = scurve_duration(c);
+
+	if(t <= c->tj) return c->v0 + c->jerk * t * t / 2;
+	if(t <= c->tj + c->tc) return c->v0 + c->jerk * c->tj * c->tj / 2 + c->jerk * c->tj * (t - c->tj);
+	if(t >= t_end) return c->v1;
+	return c->v1 - c->jerk * (t_end - t) * (t_end - t) / 2;
+}
+
+static uint32_t speed_to_prescaler(uint32_t base_clk, double speed) {
+	double prescaler = base_clk / speed;
+	if(prescaler < 1) return 1;
+	if(prescaler > UINT32_MAX) return UINT32_MAX;
+	return (uint32_t)lround(prescaler);
+}
+
+static void set_segment(flink_stepper_move* seg, uint32_t p_start, uint32_t p_top, uint32_t steps) {
+	uint32_t delta = p_start > p_top ? p_start - p_top : p_top - p_start;
+
+	seg->config = 0;
+	seg->prescaler_start = p_start;
+	seg->prescaler_top = p_top;
+	seg->acceleration = steps ? (delta + steps - 1) / steps : 0;
+	seg->steps = steps;
+}
+
+static int same_params(const flink_stepper_profile_params* a, const flink_stepper_profile_params* b) {
+	return a->base_clk == b->base_clk && a->start_speed == b->start_speed && a->top_speed == b->top_speed &&
+	       a->acceleration == b->acceleration && a->jerk == b->jerk && a->steps == b->steps;
+}
+
+/**
+ * @brief Fills the segment table of a profile.
+ * @return int: Number of segments.
+ */
+static uint32_t build_segments(const flink_stepper_profile_params* p, flink_stepper_move* seg) {
+	double v0 = p->start_speed ? p->start_speed : 1;
+	double v_top = p->top_speed;
+	double lo, hi, t[3 * FLINK_STEPPER_PHASE_SEGMENTS + 1];
+	double phase_start[3], phase_len[3], exact = 0, vm, t_seg = 0;
+	uint32_t ramp_steps = 0, nof_t = 0, n = 0, i, k, steps;
+	int64_t rounded, rounded_prev = 0;
+	scurve c;
+
+	if(v_top < v0) v_top = v0;
+	scurve_plan(&c, v0, v_top, p->acceleration, p->jerk);
+
+	// Lower the top speed until acceleration and deceleration fit into the move
+	if(2 * scurve_distance(&c) > p->steps) {
+		lo = v0;
+		hi = v_top;
+		for(i = 0; i < FIT_ITERATIONS; i++) {
+			vm = (lo + hi) / 2;
+			scurve_plan(&c, v0, vm, p->acceleration, p->jerk);
+			if(2 * scurve_distance(&c) > p->steps) hi = vm;
+			else lo = vm;
+		}
+		scurve_plan(&c, v0, lo, p->acceleration, p->jerk);
+	}
+
+	// Segment boundaries in time, zero length phases are skipped
+	phase_start[0] = 0;             phase_len[0] = c.tj;
+	phase_start[1] = c.tj;          phase_len[1] = c.tc;
+	phase_start[2] = c.tj + c.tc;   phase_len[2] = c.tj;
+	t[nof_t++] = 0;
+	for(i = 0; i < 3; i++) {
+		if(phase_len[i] <= 0) continue;
+		for(k = 1; k <= FLINK_STEPPER_PHASE_SEGMENTS; k++) {
+			t[nof_t++] = phase_start[i] + phase_len[i] * k / FLINK_STEPPER_PHASE_SEGMENTS;
+		}
+	}
+
+	// Acceleration ramp, the speed is quadratic within a phase so Simpson's rule is exact
+	for(i = 1; i < nof_t; i++) {
+		vm = scurve_speed(&c, (t[i - 1] + t[i]) / 2);
+		exact += (scurve_speed(&c, t[i - 1]) + 4 * vm + scurve_speed(&c, t[i])) / 6 * (t[i] - t[i - 1]);
+		rounded = llround(exact);
+		if(2 * (ramp_steps + (rounded - rounded_prev)) > p->steps) break;
+		steps = (uint32_t)(rounded - rounded_prev);
+		if(steps == 0) continue;
+		set_segment(&seg[n++], speed_to_prescaler(p->base_clk, scurve_speed(&c, t_seg)),
+		            speed_to_prescaler(p->base_clk, scurve_speed(&c, t[i])), steps);
+		t_seg = t[i];
+		ramp_steps += steps;
+		rounded_prev = rounded;
+	}
+
+	// Constant speed
+	if(p->steps > 2 * ramp_steps) {
+		k = speed_to_prescaler(p->base_clk, n ? (double)p->base_clk / seg[n - 1].prescaler_top : v0);
+		set_segment(&seg[n++], k, k, p->steps - 2 * ramp_steps);
+	}
+
+	// Deceleration ramp, mirrored acceleration ramp
+	k = n - (p->steps > 2 * ramp_steps);
+	for(i = k; i > 0; i--) {
+		set_segment(&seg[n++], seg[i - 1].prescaler_top, seg[i - 1].prescaler_start, seg[i - 1].steps);
+	}
+	return n;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Gets the jerk-limited S-curve profile for a move.
+ * The profile is computed on first use and taken from the cache while it is in use.
+ * A start speed of 0 is treated as 1 step/s.
+ * @param params: Profile parameters.
+ * @param profile: Gets the profile.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_stepperMotor_profile_get(const flink_stepper_profile_params* params, flink_stepper_profile* profile) {
+	profile_entry* entry;
+	profile_entry* lru;
+	uint32_t i;
+
+	if(params == NULL || profile == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(params->base_clk == 0 || params->top_speed == 0 || params->acceleration == 0 || params->jerk == 0 || params->steps == 0) {
+		flink_error(FLINK_EINVALARG);
+		return EXIT_ERROR;
+	}
+
+	pthread_mutex_lock(&profile_lock);
+	lru = &profile_cache[0];
+	for(i = 0; i < CACHE_SIZE; i++) {
+		entry = &profile_cache[i];
+		if(entry->used && same_params(&entry->profile.params, params)) {
+			entry->used = ++profile_clock;
+			*profile = entry->profile;
+			pthread_mutex_unlock(&profile_lock);
+			return EXIT_SUCCESS;
+		}
+		if(entry->used < lru->used) lru = entry;
+	}
+
+	lru->profile.params = *params;
+	lru->profile.nof_segments = build_segments(params, lru->profile.segments);
+	lru->used = ++profile_clock;
+	dbg_print("Computed stepper profile with %u segments\n", lru->profile.nof_segments);
+	*profile = lru->profile;
+	pthread_mutex_unlock(&profile_lock);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Checks whether the profile for a parameter set is in the cache.
+ * Does not count as a use of the profile. Allows to get the profiles
+ * of a time critical section in advance.
+ * @param params: Profile parameters.
+ * @return int: 1 if the profile is cached, 0 if not, -1 in case of failure.
+ */
+int flink_stepperMotor_profile_cached(const flink_stepper_profile_params* params) {
+	int cached = 0;
+	uint32_t i;
+
+	if(params == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&profile_lock);
+	for(i = 0; i < CACHE_SIZE; i++) {
+		if(profile_cache[i].used && same_params(&profile_cache[i].profile.params, params)) cached = 1;
+	}
+	pthread_mutex_unlock(&profile_lock);
+	return cached;
+}
@@ -0,0 +1,513 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, stepper motor move queue              *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file stepperMotorQueue.c
+ *  @brief flink userspace library, move queue for "stepperMotor" channels.
+ *
+ *  A move queue belongs to one channel of a stepper motor subdevice.
+ *  Moves are executed in stepping mode by a background thread, which
+ *  starts the next move as soon as the running one has completed.
+ *  Completion is detected either by polling the step counter (a few
+ *  back-to-back polls, then an exponentially growing sleep which never
+ *  exceeds half of the estimated remaining move time) or, if an irq
+ *  is given, by waiting for the interrupt signal of that irq.
+ *
+ *  When using interrupts, the irq signal must be blocked in all threads
+ *  of the application. The queue blocks it in the creating thread, so
+ *  create the queue before starting other threads.
+ */
+
+#include "flinklib.h"
+#include "types.h"
+#include "error.h"
+#include "valid.h"
+#include "log.h"
+#include "stepperMotor.h"
+#include "probes.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+
+#define SPIN_POLLS      8          // back-to-back polls before sleeping
+#define POLL_MIN_NS     20000      // first sleep when polling
+#define POLL_MAX_NS     10000000   // longest sleep when polling
+#define IRQ_TIMEOUT_NS  100000000  // fall back to a poll if no irq arrives
+
+FLINK_PROBE_DEFINE(irq_wait);
+
+struct _flink_stepper_queue {
+	flink_subdev*      subdev;
+	uint32_t           channel;
+	uint32_t           base_clk;
+	int                irq;
+	int                signal_nr;
+	uint32_t           offset[STEPS_DONE_OFFSET + 1];	/// Precomputed register offsets of the channel
+	uint32_t           loaded[STEPS_DONE_OFFSET + 1];	/// Last values written to the registers
+	uint8_t            loaded_valid;
+	pthread_t          thread;
+	pthread_mutex_t    lock;
+	pthread_cond_t     pushed;		/// Signalled when a move is pushed or the queue is stopped
+	pthread_cond_t     completed;	/// Signalled when a move has completed or the queue failed
+	flink_stepper_move moves[FLINK_STEPPER_QUEUE_SIZE];
+	uint32_t           head;
+	uint32_t           count;
+	uint64_t           pushed_id;	/// Id of the last pushed move
+	uint64_t           done_id;		/// Id of the last completed move
+	int64_t            position;	/// Absolute position after the last completed move
+	int32_t            active_dir;	/// Direction of the running move (+1, -1 or 0 if idle)
+	uint32_t           active_done;	/// Steps done by the running move at the last poll
+	int                stop;
+	int                error;		/// flink_errno of the worker in case of failure
+	uint64_t           done_ns;		/// Time the last move completed while another one was queued, 0 if none
+	flink_stepper_latency latency;	/// Update latency between queued moves
+};
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static int queue_write(flink_stepper_queue* queue, uint32_t reg, uint32_t value) {
+	if(flink_write(queue->subdev, queue->offset[reg], REGISTER_WITH, &value) != REGISTER_WITH) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	queue->loaded[reg] = value;
+	return EXIT_SUCCESS;
+}
+
+static uint64_t queue_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Writes all registers of a move and starts it.
+ * Speed registers which already hold the requested value are not written again.
+ */
+static int queue_start_move(flink_stepper_queue* queue, const flink_stepper_move* move) {
+	uint32_t config = move->config;
+
+	config &= ~(STEPPER_CONF_MODE_2 | STEPPER_CONF_START | STEPPER_CONF_RES_COUNTER | STEPPER_CONF_INT_CLEAR);
+	config |= STEPPER_CONF_MODE_1;
+	if(queue->irq != FLINK_STEPPER_NO_IRQ) config |= STEPPER_CONF_INT_ENABLE;
+
+	if(queue_write(queue, LOCAL_CONF_OFFSET, STEPPER_CONF_RES_COUNTER) < 0) return EXIT_ERROR;
+	if(!queue->loaded_valid || queue->loaded[PRESCALER_START_OFFSET] != move->prescaler_start) {
+		if(queue_write(queue, PRESCALER_START_OFFSET, move->prescaler_start) < 0) return EXIT_ERROR;
+	}
+	if(!queue->loaded_valid || queue->loaded[PRESCALER_TOP_OFFSET] != move->prescaler_top) {
+		if(queue_write(queue, PRESCALER_TOP_OFFSET, move->prescaler_top) < 0) return EXIT_ERROR;
+	}
+	if(!queue->loaded_valid || queue->loaded[ACCELERATION_OFFSET] != move->acceleration) {
+		if(queue_write(queue, ACCELERATION_OFFSET, move->acceleration) < 0) return EXIT_ERROR;
+	}
+	queue->loaded_valid = 1;
+	if(queue_write(queue, STEPS_TO_DO_OFFSET, move->steps) < 0) return EXIT_ERROR;
+	return queue_write(queue, LOCAL_CONF_OFFSET, config | STEPPER_CONF_START);
+}
+
+/**
+ * @brief Estimated time in ns to do the remaining steps at top speed.
+ */
+static uint64_t queue_remaining_ns(flink_stepper_queue* queue, const flink_stepper_move* move, uint32_t done) {
+	if(queue->base_clk == 0) return POLL_MAX_NS;
+	return (uint64_t)(move->steps - done) * move->prescaler_top * 1000000000ULL / queue->base_clk;
+}
+
+/**
+ * @brief Waits until the running move has done all its steps.
+ * @return int: 0 on completion, 1 if the queue was stopped, -1 in case of failure.
+ */
+static int queue_wait_move(flink_stepper_queue* queue, const flink_stepper_move* move) {
+	uint32_t done = 0;
+	uint32_t spins = 0;
+	uint64_t sleep_ns = POLL_MIN_NS;
+	uint64_t remaining_ns;
+	struct timespec ts;
+	sigset_t set;
+	int stop;
+
+	if(queue->irq != FLINK_STEPPER_NO_IRQ) {
+		sigemptyset(&set);
+		sigaddset(&set, queue->signal_nr);
+	}
+
+	while(1) {
+		if(flink_read(queue->subdev, queue->offset[STEPS_DONE_OFFSET], REGISTER_WITH, &done) != REGISTER_WITH) {
+			libc_error();
+			return EXIT_ERROR;
+		}
+		pthread_mutex_lock(&queue->lock);
+		queue->active_done = done;
+		stop = queue->stop;
+		pthread_mutex_unlock(&queue->lock);
+
+		if(done >= move->steps) return EXIT_SUCCESS;
+		if(stop) return 1;
+
+		if(queue->irq != FLINK_STEPPER_NO_IRQ) {
+			ts.tv_sec  = 0;
+			ts.tv_nsec = IRQ_TIMEOUT_NS;
+			if(FLINK_PROBE_ENABLED(irq_wait)) {
+				uint64_t wait_start = queue_now_ns();
+				int sig = sigtimedwait(&set, NULL, &ts);
+				FLINK_PROBE3(irq_wait, queue->irq, queue_now_ns() - wait_start, sig);
+			}
+			else {
+				sigtimedwait(&set, NULL, &ts);
+			}
+			continue;
+		}
+
+		if(spins < SPIN_POLLS) {
+			spins++;
+			continue;
+		}
+		remaining_ns = queue_remaining_ns(queue, move, done) / 2;
+		if(remaining_ns < sleep_ns) sleep_ns = remaining_ns;
+		if(sleep_ns > 0) {
+			ts.tv_sec  = sleep_ns / 1000000000ULL;
+			ts.tv_nsec = sleep_ns % 1000000000ULL;
+			nanosleep(&ts, NULL);
+		}
+		sleep_ns *= 2;
+		if(sleep_ns < POLL_MIN_NS) sleep_ns = POLL_MIN_NS;
+		if(sleep_ns > POLL_MAX_NS) sleep_ns = POLL_MAX_NS;
+	}
+}
+
+/**
+ * @brief Appends moves to the queue, either all of them or none.
+ */
+static int queue_push(flink_stepper_queue* queue, const flink_stepper_move* moves, uint32_t nof_moves, uint32_t config, uint64_t* move_id) {
+	uint32_t i, slot;
+
+	pthread_mutex_lock(&queue->lock);
+	if(queue->stop) {
+		pthread_mutex_unlock(&queue->lock);
+		flink_error(queue->error ? queue->error : FLINK_EUNKNOWN);
+		return EXIT_ERROR;
+	}
+	if(queue->count + nof_moves > FLINK_STEPPER_QUEUE_SIZE) {
+		pthread_mutex_unlock(&queue->lock);
+		flink_error(FLINK_EQUEUEFULL);
+		return EXIT_ERROR;
+	}
+	for(i = 0; i < nof_moves; i++) {
+		slot = (queue->head + queue->count) % FLINK_STEPPER_QUEUE_SIZE;
+		queue->moves[slot] = moves[i];
+		queue->moves[slot].config = config;
+		queue->count++;
+		queue->pushed_id++;
+	}
+	if(move_id) *move_id = queue->pushed_id;
+	pthread_cond_signal(&queue->pushed);
+	pthread_mutex_unlock(&queue->lock);
+	return EXIT_SUCCESS;
+}
+
+static void* queue_worker(void* arg) {
+	flink_stepper_queue* queue = arg;
+	flink_stepper_move move;
+	int ret;
+
+	pthread_mutex_lock(&queue->lock);
+	while(!queue->stop) {
+		if(queue->count == 0) {
+			pthread_cond_wait(&queue->pushed, &queue->lock);
+			continue;
+		}
+		move = queue->moves[queue->head];
+		queue->active_dir  = (move.config & STEPPER_CONF_DIRECTION) ? 1 : -1;
+		queue->active_done = 0;
+		pthread_mutex_unlock(&queue->lock);
+
+		dbg_print("Starting move %llu on stepper channel %u\n", (unsigned long long)queue->done_id + 1, queue->channel);
+		ret = queue_start_move(queue, &move);
+		if(ret == EXIT_SUCCESS && queue->done_ns) {
+			uint64_t latency = queue_now_ns() - queue->done_ns;
+			pthread_mutex_lock(&queue->lock);
+			if(queue->latency.count == 0 || latency < queue->latency.min_ns) queue->latency.min_ns = latency;
+			if(latency > queue->latency.max_ns) queue->latency.max_ns = latency;
+			queue->latency.total_ns += latency;
+			queue->latency.count++;
+			pthread_mutex_unlock(&queue->lock);
+		}
+		queue->done_ns = 0;
+		if(ret == EXIT_SUCCESS) ret = queue_wait_move(queue, &move);
+		if(ret == EXIT_SUCCESS) queue->done_ns = queue_now_ns();
+		if(ret == EXIT_SUCCESS && queue->irq != FLINK_STEPPER_NO_IRQ) {
+			ret = queue_write(queue, LOCAL_CONF_SET_ATOMIC_OFFSET, STEPPER_CONF_INT_CLEAR);
+		}
+
+		pthread_mutex_lock(&queue->lock);
+		if(ret < 0) {
+			queue->error = flink_errno;
+			queue->stop = 1;
+			pthread_cond_broadcast(&queue->completed);
+			break;
+		}
+		if(ret > 0) break; // stopped during the move
+		queue->position += queue->active_dir * (int64_t)move.steps;
+		queue->active_dir  = 0;
+		queue->active_done = 0;
+		queue->head = (queue->head + 1) % FLINK_STEPPER_QUEUE_SIZE;
+		queue->count--;
+		queue->done_id++;
+		if(queue->count == 0) queue->done_ns = 0; // idle gap, not an update latency
+		pthread_cond_broadcast(&queue->completed);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return NULL;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Creates a move queue for a stepper motor channel and starts its worker thread.
+ * @param subdev: Stepper motor subdevice.
+ * @param channel: Channel number.
+ * @param irq: IRQ raised by the channel on completion, or FLINK_STEPPER_NO_IRQ to poll.
+ * @return flink_stepper_queue*: The queue or NULL in case of error.
+ */
+flink_stepper_queue* flink_stepperMotor_queue_create(flink_subdev* subdev, uint32_t channel, int irq) {
+	flink_stepper_queue* queue;
+	sigset_t set;
+	uint32_t reg;
+	int ret;
+
+	if(subdev == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return NULL;
+	}
+	if(!validate_flink_subdev(subdev)) {
+		flink_error(FLINK_EINVALSUBDEV);
+		return NULL;
+	}
+	if(subdev->function_id != STEPPER_MOTOR_INTERFACE_ID) {
+		flink_error(FLINK_WRONGSUBDEVT);
+		return NULL;
+	}
+	if(channel >= subdev->nof_channels) {
+		flink_error(FLINK_EINVALCHAN);
+		return NULL;
+	}
+
+	queue = calloc(1, sizeof(flink_stepper_queue));
+	if(queue == NULL) {
+		libc_error();
+		return NULL;
+	}
+	queue->subdev  = subdev;
+	queue->channel = channel;
+	queue->irq     = irq;
+	for(reg = 0; reg <= STEPS_DONE_OFFSET; reg++) {
+		queue->offset[reg] = stepper_reg_offset(subdev, channel, reg);
+	}
+
+	if(flink_stepperMotor_get_baseclock(subdev, &queue->base_clk) < 0) {
+		free(queue);
+		return NULL;
+	}
+
+	if(irq != FLINK_STEPPER_NO_IRQ) {
+		queue->signal_nr = flink_register_irq(subdev->parent, irq);
+		if(queue->signal_nr < 0) {
+			free(queue);
+			return NULL;
+		}
+		sigemptyset(&set);
+		sigaddset(&set, queue->signal_nr);
+		pthread_sigmask(SIG_BLOCK, &set, NULL);
+	}
+
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->pushed, NULL);
+	pthread_cond_init(&queue->completed, NULL);
+
+	ret = pthread_create(&queue->thread, NULL, queue_worker, queue);
+	if(ret != 0) {
+		errno = ret;
+		libc_error();
+		if(irq != FLINK_STEPPER_NO_IRQ) flink_unregister_irq(subdev->parent, irq);
+		pthread_cond_destroy(&queue->completed);
+		pthread_cond_destroy(&queue->pushed);
+		pthread_mutex_destroy(&queue->lock);
+		free(queue);
+		return NULL;
+	}
+	return queue;
+}
+
+/**
+ * @brief Stops the worker thread, stops the motor and frees the queue.
+ * @param queue: Move queue.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_stepperMotor_queue_destroy(flink_stepper_queue* queue) {
+	int ret = EXIT_SUCCESS;
+
+	if(queue == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+
+	pthread_mutex_lock(&queue->lock);
+	queue->stop = 1;
+	pthread_cond_broadcast(&queue->pushed);
+	pthread_mutex_unlock(&queue->lock);
+	pthread_join(queue->thread, NULL);
+
+	if(flink_stepperMotor_reset_local_config_reg_bits_atomic(queue->subdev, queue->channel, STEPPER_CONF_START) < 0) {
+		ret = EXIT_ERROR;
+	}
+	if(queue->irq != FLINK_STEPPER_NO_IRQ && flink_unregister_irq(queue->subdev->parent, queue->irq) < 0) {
+		ret = EXIT_ERROR;
+	}
+
+	pthread_cond_destroy(&queue->completed);
+	pthread_cond_destroy(&queue->pushed);
+	pthread_mutex_destroy(&queue->lock);
+	free(queue);
+	return ret;
+}
+
+/**
+ * @brief Appends a move to the queue.
+ * @param queue: Move queue.
+ * @param move: Move to append, executed in stepping mode.
+ * @param move_id: Contains the id of the move, may be NULL.
+ * @return int: 0 on success, -1 in case of failure or if the queue is full.
+ */
+int flink_stepperMotor_queue_push(flink_stepper_queue* queue, const flink_stepper_move* move, uint64_t* move_id) {
+	if(queue == NULL || move == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	return queue_push(queue, move, 1, move->config, move_id);
+}
+
+/**
+ * @brief Appends all segments of an S-curve profile to the queue as one block.
+ * @param queue: Move queue.
+ * @param profile: Profile from flink_stepperMotor_profile_get().
+ * @param config: Local config register used for all segments (direction, step and phase mode).
+ * @param move_id: Contains the id of the last segment, may be NULL.
+ * @return int: 0 on success, -1 in case of failure or if the queue has not enough room.
+ */
+int flink_stepperMotor_queue_push_profile(flink_stepper_queue* queue, const flink_stepper_profile* profile, uint32_t config, uint64_t* move_id) {
+	if(queue == NULL || profile == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	return queue_push(queue, profile->segments, profile->nof_segments, config, move_id);
+}
+
+/**
+ * @brief Waits until a move has completed.
+ * @param queue: Move queue.
+ * @param move_id: Id of the move, 0 waits for all pushed moves.
+ * @param timeout_ms: Timeout in ms, a negative value waits forever.
+ * @return int: 0 on success, -1 in case of failure or on timeout.
+ */
+int flink_stepperMotor_queue_wait(flink_stepper_queue* queue, uint64_t move_id, int timeout_ms) {
+	struct timespec deadline;
+	int ret = 0;
+
+	if(queue == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec  += timeout_ms / 1000;
+	deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+	if(deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&queue->lock);
+	if(move_id == 0) move_id = queue->pushed_id;
+	while(queue->done_id < move_id && !queue->error && ret == 0) {
+		if(timeout_ms < 0) ret = pthread_cond_wait(&queue->completed, &queue->lock);
+		else ret = pthread_cond_timedwait(&queue->completed, &queue->lock, &deadline);
+	}
+	if(queue->done_id >= move_id) ret = 0;
+	else if(queue->error) ret = queue->error;	// flink_errno of the worker
+	else ret = ret == ETIMEDOUT ? FLINK_ETIMEOUT : FLINK_EUNKNOWN;
+	pthread_mutex_unlock(&queue->lock);
+
+	if(ret != 0) {
+		flink_error(ret);
+		return EXIT_ERROR;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Gets the absolute position of the channel.
+ * Completed moves count with their full number of steps, the running
+ * move with the steps done at the last poll. Clockwise moves count positive.
+ * @param queue: Move queue.
+ * @param position: Contains the absolute position in steps.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_stepperMotor_queue_get_position(flink_stepper_queue* queue, int64_t* position) {
+	if(queue == NULL || position == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+	if(!validate_flink_subdev(queue->subdev)) {
+		flink_error(FLINK_EINVALSUBDEV);
+		return EXIT_ERROR;
+	}
+
+	pthread_mutex_lock(&queue->lock);
+	*position = queue->position + queue->active_dir * (int64_t)queue->active_done;
+	pthread_mutex_unlock(&queue->lock);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Gets the update latency between queued moves.
+ * The latency is measured from the poll or irq which detected the completion
+ * of a move up to the write which started the next queued move.
+ * @param queue: Move queue.
+ * @param latency: Contains the latency statistics.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_stepperMotor_queue_get_latency(flink_stepper_queue* queue, flink_stepper_latency* latency) {
+	if(queue == NULL || latency == NULL) {
+		flink_error(FLINK_ENULLPTR);
+		return EXIT_ERROR;
+	}
+
+	pthread_mutex_lock(&queue->lock);
+	*latency = queue->latency;
+	pthread_mutex_unlock(&queue->lock);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, trace ring                            *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file trace.c
+ *  @brief Binary trace of errors and operations.
+ *
+ *  Every thread records into its own ring of fixed size entries, the
+ *  oldest entries are overwritten. A ring has a single writer, which
+ *  publishes an entry by incrementing the head after writing it.
+ *  Entries are only formatted when they are read. Rings of terminated
+ *  threads are kept for the reader and reused by new threads.
+ *
+ *  The level is initialized from the environment variable FLINK_TRACE,
+ *  e.g. FLINK_TRACE=2 records all operations and FLINK_TRACE=0x101
+ *  records errors and prints them to stderr.
+ */
+
+#define _GNU_SOURCE
+#include "flinklib.h"
+#include "error.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#define RING_SIZE	256		// entries, power of two
+#define READ_BATCH	64		// entries formatted per batch by flink_trace_dump()
+
+typedef struct _trace_ring {
+	struct _trace_ring* next;
+	int                 in_use;		/// Owned by a running thread
+	uint32_t            tid;
+	uint64_t            head;		/// Number of entries written
+	uint64_t            tail;		/// Number of entries read, only used by the reader
+	flink_trace_entry   entries[RING_SIZE];
+} trace_ring;
+
+int flink_trace_level = FLINK_TRACE_ERRORS;
+
+static trace_ring* rings = NULL;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t read_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t lost = 0;
+static __thread trace_ring* ring = NULL;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+__attribute__((constructor)) static void trace_init(void) {
+	const char* env = getenv("FLINK_TRACE");
+	if(env) flink_trace_level = strtol(env, NULL, 0);
+}
+
+static void release_ring(void* r) {
+	__atomic_store_n(&((trace_ring*)r)->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void create_ring_key(void) {
+	pthread_key_create(&ring_key, release_ring);
+}
+
+/**
+ * @brief Returns the ring of the calling thread, reusing rings of terminated threads.
+ * @return trace_ring*: Ring or NULL if out of memory.
+ */
+static trace_ring* get_ring(void) {
+	trace_ring* r;
+	int free_ring;
+
+	if(ring) return ring;
+
+	pthread_once(&ring_key_once, create_ring_key);
+	for(r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+		free_ring = 0;
+		if(__atomic_compare_exchange_n(&r->in_use, &free_ring, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
+	}
+	if(r == NULL) {
+		r = calloc(1, sizeof(trace_ring));
+		if(r == NULL) return NULL;
+		r->in_use = 1;
+		r->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+		while(!__atomic_compare_exchange_n(&rings, &r->next, r, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	}
+	r->tid = syscall(SYS_gettid);
+	pthread_setspecific(ring_key, r);
+	ring = r;
+	return r;
+}
+
+static int compare_time(const void* a, const void* b) {
+	const flink_trace_entry* ea = a;
+	const flink_trace_entry* eb = b;
+	return (ea->time_ns > eb->time_ns) - (ea->time_ns < eb->time_ns);
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Library internal methods                                       *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Records an entry in the ring of the calling thread.
+ * @param op: Operation, FLINK_TRACE_OP_ERROR or FLINK_TRACE_OP_DEBUG.
+ * @param subdev: Subdevice id or -1.
+ * @param offset: Register offset.
+ * @param error: errno or flink error, 0 if the operation succeeded.
+ * @param site: Code address where the error was raised or format string of a debug message, may be NULL.
+ */
+void flink_trace_record(uint16_t op, int subdev, uint32_t offset, int error, const void* site) {
+	trace_ring* r = get_ring();
+	flink_trace_entry* e;
+
+	if(r == NULL) return;
+	e = &r->entries[r->head & (RING_SIZE - 1)];
+	e->time_ns = flink_time_ns();
+	e->site = (uintptr_t)site;
+	e->offset = offset;
+	e->error = error;
+	e->tid = r->tid;
+	e->op = op;
+	e->subdev = subdev;
+	__atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+
+	if(error && (__atomic_load_n(&flink_trace_level, __ATOMIC_RELAXED) & FLINK_TRACE_STDERR)) {
+		char line[256];
+		flink_trace_format(e, line, sizeof(line));
+		fprintf(stderr, "%s\n", line);
+	}
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Public methods                                                 *
+ *                                                                 *
+ *******************************************************************/
+
+/**
+ * @brief Sets which entries are recorded in the trace.
+ * @param level: FLINK_TRACE_OFF, FLINK_TRACE_ERRORS or FLINK_TRACE_ALL, optionally or'ed with FLINK_TRACE_STDERR.
+ */
+void flink_trace_set_level(int level) {
+	__atomic_store_n(&flink_trace_level, level, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Returns the trace level.
+ * @return int: Trace level.
+ */
+int flink_trace_get_level(void) {
+	return __atomic_load_n(&flink_trace_level, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Reads the entries recorded since the last read, oldest first.
+ * Entries overwritten before they were read are lost. Of a full ring,
+ * the oldest entry is lost as well, the thread may be overwriting it.
+ * @param entries: Buffer for the entries.
+ * @param max: Size of the buffer in entries.
+ * @return size_t: Number of entries read.
+ */
+size_t flink_trace_read(flink_trace_entry* entries, size_t max) {
+	trace_ring* r;
+	uint64_t head, i;
+	size_t n = 0, k, valid;
+
+	pthread_mutex_lock(&read_lock);
+	for(r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r && n < max; r = r->next) {
+		head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		if(head - r->tail > RING_SIZE) {
+			__atomic_fetch_add(&lost, head - r->tail - RING_SIZE, __ATOMIC_RELAXED);
+			r->tail = head - RING_SIZE;
+		}
+		k = n;
+		for(i = r->tail; i < head && n < max; i++) entries[n++] = r->entries[i & (RING_SIZE - 1)];
+
+		// Drop entries the writer overwrote while they were copied, including the one it may be writing at head
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+		valid = n - k;
+		if(head >= RING_SIZE && r->tail <= head - RING_SIZE) {
+			size_t overwritten = head - RING_SIZE + 1 - r->tail;
+			if(overwritten > valid) overwritten = valid;
+			memmove(&entries[k], &entries[k + overwritten], (valid - overwritten) * sizeof(flink_trace_entry));
+			__atomic_fetch_add(&lost, overwritten, __ATOMIC_RELAXED);
+			n -= overwritten;
+		}
+		r->tail = i;
+	}
+	pthread_mutex_unlock(&read_lock);
+
+	qsort(entries, n, sizeof(flink_trace_entry), compare_time);
+	return n;
+}
+
+/**
+ * @brief Formats a trace entry as a line of text without newline.
+ * @param entry: Entry to format.
+ * @param buf: Buffer for the text.
+ * @param size: Size of the buffer.
+ * @return int: Length of the text as returned by snprintf.
+ */
+int flink_trace_format(const flink_trace_entry* entry, char* buf, size_t size) {
+	const char* op = entry->op < FLINK_NOF_OPS ? flink_op2str(entry->op) : "error";
+	const char* msg;
+	Dl_info info;
+	int n;
+
+	if(entry->op == FLINK_TRACE_OP_DEBUG) {
+		msg = (const char*)(uintptr_t)entry->site;
+		return snprintf(buf, size, "%llu.%09llu [%u] debug %.*s", (unsigned long long)(entry->time_ns / 1000000000),
+		                (unsigned long long)(entry->time_ns % 1000000000), entry->tid, (int)strcspn(msg, "\n"), msg);
+	}
+	n = snprintf(buf, size, "%llu.%09llu [%u] %s", (unsigned long long)(entry->time_ns / 1000000000),
+	             (unsigned long long)(entry->time_ns % 1000000000), entry->tid, op);
+	if(n >= 0 && (size_t)n < size && entry->subdev >= 0) {
+		n += snprintf(buf + n, size - n, " subdev %d offset 0x%x", entry->subdev, entry->offset);
+	}
+	if(n >= 0 && (size_t)n < size && entry->error) {
+		n += snprintf(buf + n, size - n, ": %s", flink_strerror(entry->error));
+	}
+	if(n >= 0 && (size_t)n < size && entry->site) {
+		if(dladdr((void*)(uintptr_t)entry->site, &info) && info.dli_sname) {
+			n += snprintf(buf + n, size - n, " in %s+0x%lx", info.dli_sname, (unsigned long)(entry->site - (uintptr_t)info.dli_saddr));
+		}
+		else {
+			n += snprintf(buf + n, size - n, " at %p", (void*)(uintptr_t)entry->site);
+		}
+	}
+	return n;
+}
+
+/**
+ * @brief Writes all entries recorded since the last read as text to a file.
+ * @param fd: File descriptor to write to.
+ * @return int: 0 on success, -1 in case of failure.
+ */
+int flink_trace_dump(int fd) {
+	flink_trace_entry entries[READ_BATCH];
+	char line[256];
+	uint64_t nof_lost;
+	size_t n, i;
+
+	while((n = flink_trace_read(entries, READ_BATCH)) > 0) {
+		for(i = 0; i < n; i++) {
+			flink_trace_format(&entries[i], line, sizeof(line));
+			if(dprintf(fd, "%s\n", line) < 0) {
+				libc_error();
+				return EXIT_ERROR;
+			}
+		}
+	}
+	nof_lost = __atomic_exchange_n(&lost, 0, __ATOMIC_RELAXED);
+	if(nof_lost) dprintf(fd, "%llu entries lost\n", (unsigned long long)nof_lost);
+	return EXIT_SUCCESS;
+}
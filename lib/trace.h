@@ -0,0 +1,57 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, trace ring                            *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file trace.h
+ *  @brief Recording into the trace ring of the calling thread and
+ *  into the Chrome trace recorder.
+ */
+
+#ifndef FLINKLIB_TRACE_H_
+#define FLINKLIB_TRACE_H_
+
+#include "flinklib.h"
+
+#include <time.h>
+
+extern int flink_trace_level;
+extern int flink_chrome_trace_on;
+
+/**
+ * @brief Current time of CLOCK_MONOTONIC in ns.
+ */
+static inline uint64_t flink_time_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @brief Checks if entries of a level are recorded.
+ */
+static inline int flink_trace_enabled(int level) {
+	return (__atomic_load_n(&flink_trace_level, __ATOMIC_RELAXED) & FLINK_TRACE_LEVEL_MASK) >= level;
+}
+
+void flink_trace_record(uint16_t op, int subdev, uint32_t offset, int error, const void* site);
+
+/**
+ * @brief Checks if the Chrome trace recorder is running.
+ */
+static inline int flink_chrome_trace_active(void) {
+	return __atomic_load_n(&flink_chrome_trace_on, __ATOMIC_RELAXED);
+}
+
+void flink_chrome_trace_record(flink_op op, int subdev, uint32_t offset, uint32_t size, uint64_t start_ns, uint64_t end_ns);
+
+#endif // FLINKLIB_TRACE_H_
@@ -0,0 +1,51 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, transports                            *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file transport.h
+ *  @brief Transports carrying the register traffic of a flink device.
+ *
+ *  All operations of the library end up in the ioctl function of the
+ *  transport of a device. flink_open() selects the transport by a
+ *  prefix of the file name, e.g. "sim:bench". File names without a
+ *  known prefix are opened as flink device files.
+ */
+
+#ifndef FLINKLIB_TRANSPORT_H_
+#define FLINKLIB_TRANSPORT_H_
+
+#include "types.h"
+
+typedef struct _flink_transport {
+	const char* prefix;		/// File name prefix selecting the transport, NULL for the default
+	int     (*open)(flink_dev* dev, const char* path);
+	void    (*close)(flink_dev* dev);
+	int     (*ioctl)(flink_dev* dev, int cmd, void* arg);
+	ssize_t (*read_block)(flink_subdev* subdev, uint32_t offset, uint32_t size, void* rdata);
+	ssize_t (*write_block)(flink_subdev* subdev, uint32_t offset, uint32_t size, const void* wdata);
+} flink_transport;
+
+extern const flink_transport flink_chardev_transport;
+extern const flink_transport flink_sim_transport;
+extern const flink_transport flink_remote_transport;
+extern const flink_transport flink_spi_transport;
+extern const flink_transport flink_uio_transport;
+
+/**
+ * @brief Counts a system call issued on behalf of a device.
+ */
+static inline void flink_count_syscall(flink_dev* dev) {
+	__atomic_fetch_add(&dev->nof_syscalls, 1, __ATOMIC_RELAXED);
+}
+
+#endif // FLINKLIB_TRANSPORT_H_
@@ -25,10 +25,30 @@
 #include "stdint.h"
 #include "flinklib.h"
 
+#include <pthread.h>
+
+struct _flink_transport;
+struct _flink_stats_block;
+struct _flink_custom_map;
+
 struct _flink_dev {
 	int            fd;					/// File descriptor of open flink device file
+	const struct _flink_transport* transport;	/// Transport carrying the register traffic
+	void*          transport_data;		/// Private data of the transport
+	uint64_t       nof_syscalls;		/// Number of system calls issued by the transport
 	uint8_t        nof_subdevices;		/// Number of subdevices
 	flink_subdev*  subdevices;			/// Linked list of all subdevices of a device
+	int            selected;			/// Subdevice selected for block transfers, -1 if unknown
+	pthread_mutex_t block_lock;			/// Serializes subdevice selection and block transfers
+	pthread_mutex_t irq_lock;			/// Serializes accesses to the irq multiplexer tables and their caches
+	int            info_subdev;			/// Id of the info subdevice whose description is cached, -1 if none
+	char           info_desc[INFO_DESC_SIZE];	/// Cached description of the info subdevice
+	uint64_t       fingerprint;			/// Cached device fingerprint, 0 if not yet computed
+	uint64_t       stats_id;			/// Identifies the device in the statistics caches of the threads
+	uint64_t       stats_epoch;			/// Incremented by each reset of the statistics
+	struct _flink_stats_block* stats_blocks;	/// Statistics of each thread, newest first
+	uint32_t       record_gen;			/// Recording the device was announced in, 0 if none
+	uint16_t       record_id;			/// Index of the device in that recording
 };
 
 struct _flink_subdev {
@@ -41,6 +61,8 @@ struct _flink_subdev {
 	uint32_t       nof_channels;		/// Number of channels
 	uint32_t       unique_id;			/// Unique id, must be unique for a certain subdevice
 	flink_dev*     parent;				/// The device this subdevice belongs to
+	uint32_t*      irq_table;			/// Cached irq multiplexer table, NULL if not yet read
+	struct _flink_custom_map* custom;	/// Register map of a custom subdevice, NULL if not yet bound
 };
 
 #endif // FLINKLIB_TYPES_H_
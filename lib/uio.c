@@ -0,0 +1,449 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, UIO transport                         *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file uio.c
+ *  @brief Transport for flink devices exposed by Linux UIO, without kernel module.
+ *
+ *  Maps the first memory region of the UIO device and enumerates the
+ *  subdevices by reading the header of one subdevice after the other,
+ *  starting at address 0. Register accesses are 32 bit loads and stores
+ *  to the mapping, no system calls are involved. A full barrier after
+ *  each read and before each write orders the accesses of the device
+ *  against the other memory accesses of the program.
+ *
+ *  The interrupt of the UIO device is read by a thread, started when the
+ *  first irq is registered, which sends the signal of every registered
+ *  irq to the process. As UIO has a single interrupt, the receiver has
+ *  to check the state of its subdevice.
+ *
+ *  For simulation, the device file can be a regular file holding the
+ *  register space. Interrupts are then read from the FIFO of the same
+ *  name with the suffix UIO_IRQ_SUFFIX, if it exists, one 32 bit
+ *  interrupt count per interrupt like from a UIO device.
+ */
+
+#include "flinklib.h"
+#include "flinkioctl.h"
+#include "types.h"
+#include "error.h"
+#include "log.h"
+#include "transport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define UIO_IRQ_SUFFIX		".irq"
+#define UIO_MAP_SIZE_FILE	"/sys/class/uio/%s/maps/map0/size"
+#define UIO_MAX_IRQ			64
+
+#define uio_barrier()		__sync_synchronize()
+
+typedef struct _uio_subdev {
+	uint32_t base_addr;
+	uint32_t header[4];		/// Type, memory size, nof channels, unique id
+} uio_subdev;
+
+typedef struct _uio_dev {
+	volatile uint32_t* regs;
+	size_t             size;			/// Size of the mapping
+	int                irq_fd;			/// UIO device or interrupt FIFO, -1 without interrupts
+	int                irq_enable;		/// Interrupt has to be enabled again after each interrupt
+	int                stop_fd;			/// Wakes the interrupt thread to terminate
+	pthread_t          irq_thread;
+	int                irq_running;
+	uint64_t           irq_mask;		/// Registered irqs
+	pthread_mutex_t    lock;			/// Serializes read-modify-write accesses and the interrupt setup
+	uint8_t            nof_subdevices;
+	uio_subdev         subdevices[UINT8_MAX];
+} uio_dev;
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Internal (private) methods                                     *
+ *                                                                 *
+ *******************************************************************/
+
+static void uio_load(uio_dev* uio, uint32_t addr, uint32_t size, void* rdata) {
+	volatile uint32_t* reg = uio->regs + addr / REGISTER_WITH;
+	uint8_t* dst = rdata;
+	uint32_t value;
+
+	for(; size >= REGISTER_WITH; size -= REGISTER_WITH, dst += REGISTER_WITH) {
+		value = *reg++;
+		memcpy(dst, &value, REGISTER_WITH);
+	}
+	if(size) {
+		value = *reg;
+		memcpy(dst, &value, size);
+	}
+	uio_barrier();
+}
+
+/**
+ * @brief Stores into the mapping, a partial last register is merged with its current value under the lock of the device.
+ */
+static void uio_store(uio_dev* uio, uint32_t addr, uint32_t size, const void* wdata) {
+	volatile uint32_t* reg = uio->regs + addr / REGISTER_WITH;
+	const uint8_t* src = wdata;
+	uint32_t value;
+
+	uio_barrier();
+	for(; size >= REGISTER_WITH; size -= REGISTER_WITH, src += REGISTER_WITH) {
+		memcpy(&value, src, REGISTER_WITH);
+		*reg++ = value;
+	}
+	if(size) {
+		pthread_mutex_lock(&uio->lock);
+		value = *reg;
+		memcpy(&value, src, size);
+		*reg = value;
+		pthread_mutex_unlock(&uio->lock);
+	}
+}
+
+/**
+ * @brief Translates a subdevice access into an address, checking the bounds and the alignment.
+ */
+static int uio_address(uio_dev* uio, uint8_t subdev, uint32_t offset, uint32_t size, uint32_t* addr) {
+	if(subdev >= uio->nof_subdevices || offset % REGISTER_WITH) {
+		errno = EINVAL;
+		return EXIT_ERROR;
+	}
+	if(offset > uio->subdevices[subdev].header[1] || size > uio->subdevices[subdev].header[1] - offset) {
+		errno = EFAULT;
+		return EXIT_ERROR;
+	}
+	*addr = uio->subdevices[subdev].base_addr + offset;
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Reads the headers of all subdevices from the mapping.
+ */
+static void uio_enumerate(uio_dev* uio) {
+	uio_subdev* s;
+	uint32_t addr = 0;
+
+	while(uio->nof_subdevices < UINT8_MAX && addr + sizeof(s->header) <= uio->size) {
+		s = &uio->subdevices[uio->nof_subdevices];
+		uio_load(uio, addr, sizeof(s->header), s->header);
+		if(s->header[1] < HEADER_SIZE + SUBHEADER_SIZE || s->header[1] % REGISTER_WITH || s->header[1] > uio->size - addr) break;	// end of the subdevices
+		dbg_print("UIO subdevice %u at 0x%x: function 0x%x, size 0x%x\n", uio->nof_subdevices, addr, s->header[0] >> 16, s->header[1]);
+		s->base_addr = addr;
+		uio->nof_subdevices++;
+		addr += s->header[1];
+	}
+}
+
+/**
+ * @brief Size of the first memory region of a UIO device.
+ */
+static int uio_map_size(const char* path, size_t* size) {
+	char name[64], file[128];
+	unsigned long long value;
+	FILE* f;
+	int ret = EXIT_ERROR;
+
+	snprintf(name, sizeof(name), "%s", path);
+	snprintf(file, sizeof(file), UIO_MAP_SIZE_FILE, basename(name));
+	f = fopen(file, "r");
+	if(f == NULL) return EXIT_ERROR;
+	if(fscanf(f, "%llx", &value) == 1) {
+		*size = value;
+		ret = EXIT_SUCCESS;
+	}
+	else errno = ENODEV;
+	fclose(f);
+	return ret;
+}
+
+/**
+ * @brief Waits for interrupts and sends the signals of the registered irqs.
+ */
+static void* uio_irq_thread(void* arg) {
+	uio_dev* uio = arg;
+	struct pollfd fds[2] = { { uio->irq_fd, POLLIN, 0 }, { uio->stop_fd, POLLIN, 0 } };
+	uint32_t count, enable = 1;
+	uint64_t mask;
+	int irq;
+
+	while(1) {
+		if(poll(fds, 2, -1) < 0) {
+			if(errno == EINTR) continue;
+			break;
+		}
+		if(fds[1].revents) break;
+		if(!(fds[0].revents & POLLIN)) break;	// device gone
+		if(read(uio->irq_fd, &count, sizeof(count)) != sizeof(count)) {
+			if(errno == EINTR || errno == EAGAIN) continue;
+			break;
+		}
+		if(uio->irq_enable && write(uio->irq_fd, &enable, sizeof(enable)) != sizeof(enable)) break;
+		mask = __atomic_load_n(&uio->irq_mask, __ATOMIC_RELAXED);
+		for(irq = 0; mask; irq++, mask >>= 1) {
+			if(mask & 1) kill(getpid(), SIGRTMIN + irq);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Starts the interrupt thread, all signals are blocked in the thread.
+ * The lock of the device must be held.
+ */
+static int uio_irq_start(uio_dev* uio) {
+	sigset_t set, old;
+	uint32_t enable = 1;
+	int ret;
+
+	if(uio->irq_running) return EXIT_SUCCESS;
+	if(uio->irq_fd < 0) {
+		errno = ENOTSUP;
+		return EXIT_ERROR;
+	}
+	uio->stop_fd = eventfd(0, EFD_CLOEXEC);
+	if(uio->stop_fd < 0) return EXIT_ERROR;
+	if(uio->irq_enable && write(uio->irq_fd, &enable, sizeof(enable)) != sizeof(enable)) {
+		close(uio->stop_fd);
+		return EXIT_ERROR;
+	}
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	ret = pthread_create(&uio->irq_thread, NULL, uio_irq_thread, uio);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if(ret) {
+		close(uio->stop_fd);
+		errno = ret;
+		return EXIT_ERROR;
+	}
+	uio->irq_running = 1;
+	return EXIT_SUCCESS;
+}
+
+static int uio_irq(uio_dev* uio, uint32_t irq, int enable) {
+	int ret = EXIT_SUCCESS;
+
+	if(irq >= UIO_MAX_IRQ || SIGRTMIN + (int)irq > SIGRTMAX) {
+		errno = EINVAL;
+		return EXIT_ERROR;
+	}
+	pthread_mutex_lock(&uio->lock);
+	if(enable) {
+		ret = uio_irq_start(uio);
+		if(ret == EXIT_SUCCESS) {
+			__atomic_or_fetch(&uio->irq_mask, (uint64_t)1 << irq, __ATOMIC_RELAXED);
+			ret = SIGRTMIN + irq;
+		}
+	}
+	else __atomic_and_fetch(&uio->irq_mask, ~((uint64_t)1 << irq), __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&uio->lock);
+	return ret;
+}
+
+static int uio_rw_bit(uio_dev* uio, ioctl_bit_container_t* arg, int write) {
+	uint32_t addr, reg, mask = 1u << (arg->bit % (REGISTER_WITH * 8));
+
+	if(uio_address(uio, arg->subdevice, arg->offset, REGISTER_WITH, &addr) < 0) return EXIT_ERROR;
+	if(!write) {
+		uio_load(uio, addr, REGISTER_WITH, &reg);
+		arg->value = (reg & mask) != 0;
+		return EXIT_SUCCESS;
+	}
+	pthread_mutex_lock(&uio->lock);
+	uio_load(uio, addr, REGISTER_WITH, &reg);
+	reg = arg->value ? reg | mask : reg & ~mask;
+	uio_store(uio, addr, REGISTER_WITH, &reg);
+	pthread_mutex_unlock(&uio->lock);
+	return EXIT_SUCCESS;
+}
+
+
+/*******************************************************************
+ *                                                                 *
+ *  Transport                                                      *
+ *                                                                 *
+ *******************************************************************/
+
+static void uio_free(uio_dev* uio) {
+	uint64_t stop = 1;
+
+	if(uio->irq_running) {
+		if(write(uio->stop_fd, &stop, sizeof(stop)) == sizeof(stop)) pthread_join(uio->irq_thread, NULL);
+		else pthread_detach(uio->irq_thread);
+		close(uio->stop_fd);
+	}
+	if(uio->irq_fd >= 0) close(uio->irq_fd);
+	if(uio->regs) munmap((void*)uio->regs, uio->size);
+	pthread_mutex_destroy(&uio->lock);
+	free(uio);
+}
+
+static int uio_open(flink_dev* dev, const char* path) {
+	char irq_path[PATH_MAX];
+	struct stat st;
+	uio_dev* uio;
+	void* map;
+	int fd;
+
+	uio = calloc(1, sizeof(uio_dev));
+	if(uio == NULL) {
+		libc_error();
+		return EXIT_ERROR;
+	}
+	pthread_mutex_init(&uio->lock, NULL);
+	uio->irq_fd = -1;
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if(fd < 0 || fstat(fd, &st) < 0) {
+		libc_error();
+		if(fd >= 0) close(fd);
+		uio_free(uio);
+		return EXIT_ERROR;
+	}
+	if(S_ISCHR(st.st_mode)) {
+		if(uio_map_size(path, &uio->size) < 0) {
+			libc_error();
+			close(fd);
+			uio_free(uio);
+			return EXIT_ERROR;
+		}
+		uio->irq_fd = fd;
+		uio->irq_enable = 1;
+	}
+	else {	// register space simulated by a file
+		uio->size = st.st_size;
+		snprintf(irq_path, sizeof(irq_path), "%s" UIO_IRQ_SUFFIX, path);
+		if(stat(irq_path, &st) == 0 && S_ISFIFO(st.st_mode)) uio->irq_fd = open(irq_path, O_RDWR | O_NONBLOCK | O_CLOEXEC);	// keeps a writer, no hangup
+	}
+	uio->size &= ~(size_t)(REGISTER_WITH - 1);
+	if(uio->size == 0 || uio->size > UINT32_MAX) {
+		flink_error(FLINK_EINVALARG);	// no register space
+		if(uio->irq_fd != fd) close(fd);
+		uio_free(uio);
+		return EXIT_ERROR;
+	}
+	map = mmap(NULL, uio->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);	// offset 0 selects map0 of a UIO device
+	if(uio->irq_fd != fd) close(fd);
+	if(map == MAP_FAILED) {
+		libc_error();
+		uio_free(uio);
+		return EXIT_ERROR;
+	}
+	uio->regs = map;
+	uio_enumerate(uio);
+
+	dev->fd = -1;
+	dev->transport_data = uio;
+	return EXIT_SUCCESS;
+}
+
+static void uio_close(flink_dev* dev) {
+	uio_free(dev->transport_data);
+}
+
+static int uio_ioctl(flink_dev* dev, int cmd, void* arg) {
+	uio_dev* uio = dev->transport_data;
+	ioctl_container_t* container = arg;
+	flink_subdev* subdev = arg;
+	uio_subdev* s;
+	uint32_t addr;
+
+	switch(cmd) {
+		case READ_NOF_SUBDEVICES:
+			*(uint8_t*)arg = uio->nof_subdevices;
+			return EXIT_SUCCESS;
+		case READ_SUBDEVICE_INFO:
+			if(subdev->id >= uio->nof_subdevices) {
+				errno = EINVAL;
+				return EXIT_ERROR;
+			}
+			s = &uio->subdevices[subdev->id];
+			subdev->function_id      = s->header[0] >> 16;
+			subdev->sub_function_id  = s->header[0] >> 8;
+			subdev->function_version = s->header[0];
+			subdev->base_addr        = s->base_addr;
+			subdev->mem_size         = s->header[1];
+			subdev->nof_channels     = s->header[2];
+			subdev->unique_id        = s->header[3];
+			return EXIT_SUCCESS;
+		case SELECT_SUBDEVICE:
+		case SELECT_SUBDEVICE_EXCL:
+			if(*(uint8_t*)arg >= uio->nof_subdevices) {
+				errno = EINVAL;
+				return EXIT_ERROR;
+			}
+			return EXIT_SUCCESS;
+		case SELECT_AND_READ:
+			if(uio_address(uio, container->subdevice, container->offset, container->size, &addr) < 0) return EXIT_ERROR;
+			uio_load(uio, addr, container->size, container->data);
+			return container->size;
+		case SELECT_AND_WRITE:
+			if(uio_address(uio, container->subdevice, container->offset, container->size, &addr) < 0) return EXIT_ERROR;
+			uio_store(uio, addr, container->size, container->data);
+			return container->size;
+		case SELECT_AND_READ_BIT:
+			return uio_rw_bit(uio, arg, 0);
+		case SELECT_AND_WRITE_BIT:
+			return uio_rw_bit(uio, arg, 1);
+		case REGISTER_IRQ:
+			return uio_irq(uio, *(uint32_t*)container->data, 1);
+		case UNREGISTER_IRQ:
+			return uio_irq(uio, *(uint32_t*)container->data, 0);
+		case GET_SIGNAL_OFFSET:
+			*(uint32_t*)container->data = SIGRTMIN;
+			return EXIT_SUCCESS;
+		default:
+			errno = ENOTTY;
+			return EXIT_ERROR;
+	}
+}
+
+static ssize_t uio_read_block(flink_subdev* subdev, uint32_t offset, uint32_t size, void* rdata) {
+	uio_dev* uio = subdev->parent->transport_data;
+	uint32_t addr;
+
+	if(uio_address(uio, subdev->id, offset, size, &addr) < 0) return EXIT_ERROR;
+	uio_load(uio, addr, size, rdata);
+	return size;
+}
+
+static ssize_t uio_write_block(flink_subdev* subdev, uint32_t offset, uint32_t size, const void* wdata) {
+	uio_dev* uio = subdev->parent->transport_data;
+	uint32_t addr;
+
+	if(uio_address(uio, subdev->id, offset, size, &addr) < 0) return EXIT_ERROR;
+	uio_store(uio, addr, size, wdata);
+	return size;
+}
+
+const flink_transport flink_uio_transport = {
+	.prefix      = FLINK_UIO_PREFIX,
+	.open        = uio_open,
+	.close       = uio_close,
+	.ioctl       = uio_ioctl,
+	.read_block  = uio_read_block,
+	.write_block = uio_write_block,
+};
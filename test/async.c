@@ -0,0 +1,173 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, asynchronous request test             *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file async.c
+ *  @brief Checks asynchronous requests on the simulated device sim:bench.
+ *
+ *  Holds the I/O thread in a callback while requests are queued, then
+ *  checks the order of completion: control requests before bulk
+ *  requests, requests of a subdevice in the order of submission. Also
+ *  checks the merging of contiguous reads, the completion list with its
+ *  eventfd, waiting for a request and failed requests.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define PWM_BASE      (HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+#define AOUT_BASE     (HEADER_SIZE + SUBHEADER_SIZE + ANALOG_OUTPUT_FIRST_VALUE_OFFSET)
+#define NOF_BULK      8
+
+static int gate[2];					// pipe holding the I/O thread
+static int held[2];					// pipe signaling the I/O thread is held
+static int order[2 * NOF_BULK + 2];	// tags in the order of completion
+static int nof_completed = 0;
+
+static void hold(flink_async_request* request, void* arg) {
+	char c;
+	CHECK(write(held[1], "x", 1) == 1 && read(gate[0], &c, 1) == 1, "hold the I/O thread");
+	flink_async_release(request);
+}
+
+// Holds the I/O thread with a request of a subdevice not used otherwise
+static void hold_thread(flink_async* async, flink_subdev* subdev) {
+	uint32_t value;
+	char c;
+	CHECK(flink_async_read(async, subdev, 0, REGISTER_WITH, &value, FLINK_ASYNC_CONTROL, hold, NULL) != NULL && read(held[0], &c, 1) == 1, "I/O thread not held");
+}
+
+static void release(flink_async_request* request, void* arg) {
+	flink_async_release(request);
+}
+
+static void record(flink_async_request* request, void* arg) {
+	CHECK(flink_async_get_result(request) >= 0, "request %d failed", (int)(intptr_t)arg);
+	order[nof_completed++] = (int)(intptr_t)arg;
+	flink_async_release(request);
+}
+
+int main(void) {
+	flink_dev*           dev;
+	flink_subdev*        pwm;
+	flink_subdev*        aout;
+	flink_subdev*        gpio;
+	flink_async*         async;
+	flink_async_request* request;
+	flink_async_request* requests[NOF_BULK];
+	uint32_t             regs[NOF_BULK], value, i;
+	uint8_t              bit = 0;
+	struct pollfd        pfd;
+	uint64_t             events;
+	int64_t              blocks;
+	int                  pos_control, nof_listed;
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL || pipe(gate) < 0 || pipe(held) < 0) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	pwm = flink_get_subdevice_by_unique_id(dev, 3);
+	aout = flink_get_subdevice_by_unique_id(dev, 6);
+	gpio = flink_get_subdevice_by_unique_id(dev, 1);
+	async = flink_async_create(dev);
+	if(pwm == NULL || aout == NULL || gpio == NULL || async == NULL) {
+		fprintf(stderr, "FAILED: can't create queue\n");
+		return 1;
+	}
+
+	// Bulk requests of two subdevices and a control request, queued while the I/O thread is held
+	hold_thread(async, gpio);
+	for(i = 0; i < NOF_BULK; i++) {
+		CHECK(flink_async_read(async, pwm, PWM_BASE, REGISTER_WITH, &regs[i], FLINK_ASYNC_BULK, record, (void*)(intptr_t)(i + 1)) != NULL, "bulk pwm");
+		CHECK(flink_async_read(async, aout, AOUT_BASE, REGISTER_WITH, &value, FLINK_ASYNC_BULK, record, (void*)(intptr_t)(100 + i)) != NULL, "bulk aout");
+	}
+	CHECK(flink_async_write_bit(async, pwm, PWM_BASE, 31, 1, FLINK_ASYNC_CONTROL, record, (void*)0) != NULL, "control");
+	request = flink_async_read(async, aout, AOUT_BASE, REGISTER_WITH, &value, FLINK_ASYNC_BULK, release, NULL);
+	CHECK(request && flink_async_wait(request) < 0 && flink_get_errno() == FLINK_EINVALARG, "wait for a request with a callback");
+	CHECK(write(gate[1], "x", 1) == 1, "release");
+	request = flink_async_read_bit(async, pwm, PWM_BASE, 31, &bit, FLINK_ASYNC_BULK, NULL, NULL);
+	CHECK(request && flink_async_wait(request) == 0 && bit == 1, "wait");
+	CHECK(request && flink_async_done(request) == 1, "done");
+	CHECK(flink_async_release(request) == 0, "release request");
+	request = flink_async_read(async, aout, AOUT_BASE, REGISTER_WITH, &value, FLINK_ASYNC_BULK, NULL, NULL);	// after the other aout requests
+	CHECK(request && flink_async_wait(request) == REGISTER_WITH, "wait aout");
+	flink_async_release(request);
+
+	CHECK(nof_completed == 2 * NOF_BULK + 1, "%d callbacks", nof_completed);
+	for(pos_control = 0; pos_control < nof_completed && order[pos_control] != 0; pos_control++);
+	CHECK(pos_control == 0, "control request completed at %d", pos_control);
+	for(i = 1, value = 0; i < (uint32_t)nof_completed; i++) {
+		if(order[i] > 0 && order[i] < 100) CHECK(order[i] == (int)++value, "pwm requests out of order");
+	}
+	CHECK(value == NOF_BULK, "%u pwm requests", value);
+	CHECK(regs[0] & 1u << 31, "bulk reads after the control write");
+
+	// Contiguous reads are merged into a block transfer
+	for(i = 0; i < NOF_BULK; i++) CHECK(flink_pwm_set_period(pwm, i % 4, 1000 + i) == 0, "pwm period");
+	memset(regs, 0, sizeof(regs));
+	blocks = check_nof_ops(dev, FLINK_OP_READ_BLOCK);
+	hold_thread(async, gpio);
+	for(i = 0; i < NOF_BULK; i++) {
+		requests[i] = flink_async_read(async, pwm, PWM_BASE + i * REGISTER_WITH, REGISTER_WITH, &regs[i], FLINK_ASYNC_BULK, NULL, NULL);
+		CHECK(requests[i] != NULL, "read %u", i);
+	}
+	CHECK(flink_async_get_result(requests[0]) < 0 && flink_get_errno() == FLINK_EBUSY, "result of a queued request");
+	CHECK(flink_async_release(requests[0]) < 0 && flink_get_errno() == FLINK_EBUSY, "release of a queued request");
+	CHECK(write(gate[1], "x", 1) == 1, "release");
+
+	// Completion list signaled by the eventfd
+	nof_listed = 0;
+	pfd.fd = flink_async_get_fd(async);
+	pfd.events = POLLIN;
+	while(nof_listed < NOF_BULK && poll(&pfd, 1, 1000) == 1) {
+		CHECK(read(pfd.fd, &events, sizeof(events)) == sizeof(events), "eventfd");
+		while((request = flink_async_get_completed(async))) {
+			CHECK(request == requests[nof_listed], "completion order");
+			CHECK(flink_async_get_result(request) == REGISTER_WITH, "result");
+			flink_async_release(request);
+			nof_listed++;
+		}
+	}
+	CHECK(nof_listed == NOF_BULK, "%d completed requests listed", nof_listed);
+	for(i = 0; i < 4; i++) CHECK(regs[i] == 1004 + i, "merged read %u", i);
+	if(blocks >= 0) {	// statistics enabled
+		blocks = check_nof_ops(dev, FLINK_OP_READ_BLOCK) - blocks;
+		CHECK(blocks == 2, "%lld block transfers", (long long)blocks);
+	}
+
+	// Failed requests
+	request = flink_async_read(async, pwm, flink_subdevice_get_memsize(pwm), REGISTER_WITH, &value, FLINK_ASYNC_CONTROL, NULL, NULL);
+	CHECK(request && flink_async_wait(request) < 0, "read beyond the subdevice");
+	flink_async_release(request);
+	CHECK(flink_async_read(async, pwm, PWM_BASE, REGISTER_WITH, &value, FLINK_ASYNC_NOF_PRIORITIES, NULL, NULL) == NULL &&
+	      flink_get_errno() == FLINK_EINVALARG, "invalid priority");
+
+	// Queued requests are executed before the queue is destroyed
+	nof_completed = 0;
+	for(i = 0; i < NOF_BULK; i++) flink_async_write(async, aout, AOUT_BASE, REGISTER_WITH, &i, FLINK_ASYNC_BULK, record, (void*)(intptr_t)1);
+	CHECK(flink_async_destroy(async) == 0 && nof_completed == NOF_BULK, "destroy");
+	CHECK(flink_read(aout, AOUT_BASE, REGISTER_WITH, &value) == REGISTER_WITH && value == NOF_BULK - 1, "last write");
+
+	flink_close(dev);
+	return check_result("Asynchronous request test");
+}
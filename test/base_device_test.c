@@ -60,9 +60,11 @@ int testFQD();
 int testGPIODevice();
 int testPWMDevice();
 int testRatio(float ratio,uint32_t period,int channel);
+void getTime(struct timeval* time);
 
 
 flink_dev* dev;
+bool simulated = false;
 flink_subdev* enc_a_gpio_device;
 flink_subdev* enc_b_gpio_device;
 
@@ -98,6 +100,7 @@ int main(int argc, char* argv[]) {
 		}
 	}
 	printf("FLink Base Device Testing\n");
+	simulated = (strncmp(dev_name, "sim:", 4) == 0);
 	
 	//get flink device
 	dev = flink_open(dev_name);
@@ -274,7 +277,7 @@ int testFQD(){
 				nrOfError++;			
 			}
 		}
-		usleep(100);
+		if(!simulated) usleep(100);
 	}
 
 	if(nrOfError != 0){
@@ -292,7 +295,7 @@ int testFQD(){
 				nrOfError++;			
 			}
 		}
-		usleep(100);
+		if(!simulated) usleep(100);
 	}
 
 	if(nrOfError != 0){
@@ -608,14 +611,14 @@ int testRatio(float ratio_desired,uint32_t desired_period, int channel){
 	uint8_t numberOfEdges = 0;
 	int error = 0;
 	int timeout = 0;
-	gettimeofday(&old,NULL);
+	getTime(&old);
 	flink_dio_get_value(in_gpio_device, channel, &oldvalue);
 	while(running && timeout < PWM_TIMEOUT){
 		timeout++;
 		flink_dio_get_value(in_gpio_device, channel, &value);
 			if(oldvalue != value){//edge detected
 				numberOfEdges++;
-				gettimeofday(&time,NULL);
+				getTime(&time);
 				if(numberOfEdges > 1){
 					unsigned long long deltaT= (time.tv_usec + 1000000 *time.tv_sec) -(old.tv_usec + 1000000 *old.tv_sec);
 					float ratio = deltaT/period_us;
@@ -625,7 +628,7 @@ int testRatio(float ratio_desired,uint32_t desired_period, int channel){
 					}	
 				}
 				if(numberOfEdges == 1){
-					gettimeofday(&periodTime,NULL);				
+					getTime(&periodTime);				
 				}
 				if(numberOfEdges == 3){
 					unsigned long long deltaT= (time.tv_usec + 1000000 *time.tv_sec) -(periodTime.tv_usec + 1000000 *periodTime.tv_sec);
@@ -656,6 +659,18 @@ int testRatio(float ratio_desired,uint32_t desired_period, int channel){
 
 
 
+//simulated devices run on their own clock, which only advances with register accesses
+void getTime(struct timeval* time){
+	uint64_t time_ns;
+	if(simulated && flink_sim_get_time(dev, &time_ns) == 0){
+		time->tv_sec = time_ns / 1000000000;
+		time->tv_usec = (time_ns % 1000000000) / 1000;
+		return;
+	}
+	gettimeofday(time,NULL);
+}
+
+
 int testInfoDevice(flink_dev* dev,int unique_id, char* designDescriptor,int descriptorLength){
 	char str[INFO_DESC_SIZE];
 	char descriptor[descriptorLength + 1];
@@ -0,0 +1,1080 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, microbenchmarks                       *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file bench.c
+ *  @brief Measures time and system calls per operation of the library.
+ *
+ *  Every function of the device, low level and subdevice operations and
+ *  of the function modules in flinklib.h is measured, except for
+ *  flink_perror(), which only prints, and flink_counter_set_mode(),
+ *  which is not implemented. The C++ layer of flinklib.hpp is measured
+ *  through the functions it calls, the layouts of flinklayout.hpp are
+ *  constant offsets. Getters of the subdevice header are measured
+ *  together, as are the getters of a process image.
+ *  flink_close() is measured together with flink_open(),
+ *  flink_image_close() with the creation or opening of the image,
+ *  flink_async_destroy() with flink_async_create(), the removal of an
+ *  SPI endpoint or a custom driver together with its registration, the
+ *  destruction of a custom plan with its creation, the stop of a Chrome
+ *  trace or a recording together with its start and
+ *  flink_stepperMotor_queue_wait() together with a push. Asynchronous
+ *  requests are measured from their submission until they are taken
+ *  back by flink_async_wait() or flink_async_get_completed() and
+ *  released, including the handover to the I/O thread. Reading the
+ *  trace is measured on a trace which is mostly empty. A configuration
+ *  file and a snapshot are applied with the registers already in their
+ *  state, so they write nothing.
+ *
+ *  Every benchmark runs on the first subdevice of its function and on
+ *  its channel 0. Setters write back the value read before the
+ *  measurement. Benchmarks which change the state of the hardware, and
+ *  the getters of the simulation, only run on simulated devices. The
+ *  results are printed as JSON.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <time.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+#include <flinkioctl.h>
+
+#define DEFAULT_DEV        "sim:bench"
+#define DEFAULT_ITERATIONS 100000
+#define MAX_DEVICES        8
+#define ANY_FUNCTION       0xFFFF
+#define NO_SUBDEVICE       0xFFFE
+#define IMAGE_VALUES       4
+#define CUSTOM_UNUSED_ID   0x100	// function id of the driver of the registration benchmark
+
+typedef struct _bench_ctx {
+	const char*   dev_name;
+	flink_dev*    dev;
+	flink_subdev* subdev;
+	uint32_t      value;
+	uint32_t*     buf;
+	uint32_t*     buf2;
+	char          desc[INFO_DESC_SIZE];
+	flink_stepper_queue*        queue;		/// Queue of the stepper benchmarks, destroyed after the benchmark
+	flink_stepper_profile       profile;
+	flink_stepper_profile_params params;
+	uint64_t      syscalls;	/// Syscalls on handles other than dev, counted by the benchmark
+	int           null_fd;	/// /dev/null for the trace dump, 0 if not open
+	char          config_file[64];	/// Configuration file of the config benchmark, empty if not written
+	void*         snapshot;	/// Snapshot of the restore benchmark, released after the benchmark
+	size_t        snapshot_size;
+	char          image_name[64];	/// Process image of the image benchmarks
+	flink_image*  image;		/// Created image, closed after the benchmark
+	flink_image*  reader;		/// Opened image, closed after the benchmark
+	flink_async*  async;		/// Queue of the asynchronous benchmarks, destroyed after the benchmark
+	flink_async_request* request;	/// Completed request of the asynchronous benchmarks, released after the benchmark
+	int           custom_reg;	/// Period register of the custom driver of the PWM
+	flink_custom_plan* plan;	/// Plan of the custom benchmarks, destroyed after the benchmark
+} bench_ctx;
+
+typedef struct _bench {
+	const char* name;
+	uint16_t    function_id;	/// Function of the subdevice, ANY_FUNCTION or NO_SUBDEVICE
+	int         destructive;	/// Changes the state of the hardware or needs a simulation, only run on simulated devices
+	int (*setup)(bench_ctx* ctx);	/// Returns 1 to skip the benchmark, may be NULL
+	int (*run)(bench_ctx* ctx);
+} bench;
+
+static int setup_config(bench_ctx* ctx) {
+	return flink_read(ctx->subdev, CONFIG_OFFSET, REGISTER_WITH, &ctx->value) == REGISTER_WITH ? 0 : -1;
+}
+
+static int setup_function_regs(bench_ctx* ctx) {
+	uint32_t size = flink_subdevice_get_memsize(ctx->subdev) - HEADER_SIZE - SUBHEADER_SIZE;
+	return flink_read_block(ctx->subdev, HEADER_SIZE + SUBHEADER_SIZE, size, ctx->buf) == size ? 0 : -1;
+}
+
+// Device
+
+static int run_open_close(bench_ctx* ctx) {
+	flink_dev* dev = flink_open(ctx->dev_name);
+	if(dev == NULL) return -1;
+	ctx->syscalls += flink_get_nof_syscalls(dev);	// syscalls of closing the handle are not counted
+	flink_close(dev);
+	return 0;
+}
+
+static int run_ioctl(bench_ctx* ctx) {
+	uint8_t nof_subdevices;
+	return flink_ioctl(ctx->dev, READ_NOF_SUBDEVICES, &nof_subdevices);
+}
+
+static int run_get_nof_syscalls(bench_ctx* ctx) {
+	return flink_get_nof_syscalls(ctx->dev) ? 0 : -1;
+}
+
+static int run_get_errno(bench_ctx* ctx) {
+	return flink_strerror(flink_get_errno()) ? 0 : -1;
+}
+
+static int run_get_nof_subdevices(bench_ctx* ctx) {
+	return flink_get_nof_subdevices(ctx->dev) > 0 ? 0 : -1;
+}
+
+static int run_get_subdevice_by_id(bench_ctx* ctx) {
+	return flink_get_subdevice_by_id(ctx->dev, 0) ? 0 : -1;
+}
+
+static int run_get_subdevice_by_unique_id(bench_ctx* ctx) {
+	return flink_get_subdevice_by_unique_id(ctx->dev, ctx->value) ? 0 : -1;
+}
+
+static int setup_unique_id(bench_ctx* ctx) {
+	ctx->value = flink_subdevice_get_unique_id(flink_get_subdevice_by_id(ctx->dev, flink_get_nof_subdevices(ctx->dev) - 1));
+	return 0;
+}
+
+static int run_get_fingerprint(bench_ctx* ctx) {
+	uint64_t fingerprint;
+	return flink_get_fingerprint(ctx->dev, &fingerprint);
+}
+
+static int run_stats_snapshot(bench_ctx* ctx) {
+	flink_op_stats ops[FLINK_NOF_OPS];
+	return flink_stats_snapshot(ctx->dev, ops, NULL);
+}
+
+// Skips the statistics if the library is built with FLINK_STATS=OFF
+static int setup_stats(bench_ctx* ctx) {
+	if(run_stats_snapshot(ctx) == 0) return 0;
+	return flink_get_errno() == FLINK_ENOTSUPPORTED ? 1 : -1;
+}
+
+static int run_stats_reset(bench_ctx* ctx) {
+	return flink_stats_reset(ctx->dev);
+}
+
+static int run_op2str(bench_ctx* ctx) {
+	return flink_op2str(FLINK_OP_READ) ? 0 : -1;
+}
+
+static int run_trace_level(bench_ctx* ctx) {
+	flink_trace_set_level(flink_trace_get_level());
+	return 0;
+}
+
+static int run_trace_read(bench_ctx* ctx) {
+	flink_trace_entry entry;
+	flink_trace_read(&entry, 1);
+	return 0;
+}
+
+static int run_trace_format(bench_ctx* ctx) {
+	flink_trace_entry entry = { .time_ns = 1, .op = FLINK_OP_READ, .error = FLINK_EINVALCHAN };
+	return flink_trace_format(&entry, ctx->desc, sizeof(ctx->desc)) > 0 ? 0 : -1;
+}
+
+static int setup_trace_dump(bench_ctx* ctx) {
+	if(ctx->null_fd == 0) ctx->null_fd = open("/dev/null", O_WRONLY);
+	return ctx->null_fd > 0 ? 0 : -1;
+}
+
+static int run_trace_dump(bench_ctx* ctx) {
+	return flink_trace_dump(ctx->null_fd);
+}
+
+static int run_chrome_trace(bench_ctx* ctx) {
+	if(flink_chrome_trace_start(1) < 0) return -1;
+	return flink_chrome_trace_stop(NULL);
+}
+
+static int run_record(bench_ctx* ctx) {
+	if(flink_record_start("/dev/null") < 0) return -1;
+	return flink_record_stop();
+}
+
+static int run_sim_get_time(bench_ctx* ctx) {
+	uint64_t time_ns;
+	return flink_sim_get_time(ctx->dev, &time_ns);
+}
+
+static int run_sim_get_nof_bytes(bench_ctx* ctx) {
+	uint64_t nof_bytes;
+	return flink_sim_get_nof_bytes(ctx->dev, &nof_bytes);
+}
+
+static int setup_config_file(bench_ctx* ctx) {
+	FILE* file;
+	int ok;
+
+	if(flink_pwm_get_period(ctx->subdev, 0, &ctx->value) < 0) return -1;
+	snprintf(ctx->config_file, sizeof(ctx->config_file), "/tmp/flinkbench.%d.conf", (int)getpid());
+	file = fopen(ctx->config_file, "w");
+	if(file == NULL) return 1;
+	ok = fprintf(file, "subdevice %u\nperiod 0 %u\n", flink_subdevice_get_unique_id(ctx->subdev), ctx->value) > 0;
+	return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+static int run_config_apply(bench_ctx* ctx) {
+	return flink_config_apply(ctx->dev, ctx->config_file, NULL);
+}
+
+static int run_snapshot_save(bench_ctx* ctx) {
+	free(ctx->snapshot);
+	ctx->snapshot = NULL;
+	return flink_snapshot_save(ctx->dev, &ctx->snapshot, &ctx->snapshot_size);
+}
+
+static int run_snapshot_restore(bench_ctx* ctx) {
+	return flink_snapshot_restore(ctx->dev, ctx->snapshot, ctx->snapshot_size);
+}
+
+static int run_image_create_close(bench_ctx* ctx) {
+	flink_image* image = flink_image_create(ctx->image_name, IMAGE_VALUES, 16);
+	if(image == NULL) return -1;
+	return flink_image_close(image);
+}
+
+static int setup_image(bench_ctx* ctx) {
+	uint32_t values[IMAGE_VALUES] = { 0 };
+
+	ctx->image = flink_image_create(ctx->image_name, IMAGE_VALUES, 16);
+	if(ctx->image == NULL) return 1;	// no shared memory
+	return flink_image_publish(ctx->image, values);
+}
+
+static int setup_image_reader(bench_ctx* ctx) {
+	int ret = setup_image(ctx);
+	if(ret != 0) return ret;
+	ctx->reader = flink_image_open(ctx->image_name);
+	return ctx->reader ? 0 : -1;
+}
+
+static int run_image_publish(bench_ctx* ctx) {
+	uint32_t values[IMAGE_VALUES] = { 1, 2, 3, 4 };
+	return flink_image_publish(ctx->image, values);
+}
+
+static int run_image_publish_registers(bench_ctx* ctx) {
+	return flink_image_publish_registers(ctx->image, ctx->subdev, HEADER_SIZE + SUBHEADER_SIZE);
+}
+
+static int run_image_open_close(bench_ctx* ctx) {
+	flink_image* image = flink_image_open(ctx->image_name);
+	if(image == NULL) return -1;
+	return flink_image_close(image);
+}
+
+static int run_image_getters(bench_ctx* ctx) {
+	ctx->value = flink_image_get_nof_values(ctx->reader) + flink_image_get_history(ctx->reader) + (uint32_t)flink_image_get_head(ctx->reader);
+	return 0;
+}
+
+static int run_image_get_sample(bench_ctx* ctx) {
+	uint64_t index = flink_image_get_head(ctx->reader) - 1;
+	const flink_image_sample* s = flink_image_get_sample(ctx->reader, index);
+	if(s == NULL) return -1;
+	ctx->value = s->values[0];
+	return flink_image_sample_valid(ctx->reader, s, index) ? 0 : -1;
+}
+
+static int run_image_read(bench_ctx* ctx) {
+	uint32_t values[IMAGE_VALUES];
+	return flink_image_read(ctx->reader, flink_image_get_head(ctx->reader) - 1, values, NULL);
+}
+
+static int spi_message(void* data, const flink_spi_frame* frames, uint32_t nof_frames) {
+	return -1;
+}
+
+static int run_spi_register_endpoint(bench_ctx* ctx) {
+	flink_spi_endpoint endpoint = { spi_message, NULL, 0, 0 };
+
+	if(flink_spi_register_endpoint("flinkbench", &endpoint) < 0) return -1;
+	return flink_spi_register_endpoint("flinkbench", NULL);
+}
+
+// Low level operations
+
+static int run_read(bench_ctx* ctx) {
+	return flink_read(ctx->subdev, STATUS_OFFSET, REGISTER_WITH, &ctx->value) == REGISTER_WITH ? 0 : -1;
+}
+
+static int run_write(bench_ctx* ctx) {
+	return flink_write(ctx->subdev, CONFIG_OFFSET, REGISTER_WITH, &ctx->value) == REGISTER_WITH ? 0 : -1;
+}
+
+static int run_read_bit(bench_ctx* ctx) {
+	uint8_t bit;
+	return flink_read_bit(ctx->subdev, STATUS_OFFSET, 0, &bit);
+}
+
+static int run_write_bit(bench_ctx* ctx) {
+	uint8_t bit = 0;
+	return flink_write_bit(ctx->subdev, CONFIG_OFFSET, RESET_BIT, &bit);
+}
+
+static int run_read_block(bench_ctx* ctx) {
+	return flink_read_block(ctx->subdev, 0, HEADER_SIZE + SUBHEADER_SIZE, ctx->buf) == HEADER_SIZE + SUBHEADER_SIZE ? 0 : -1;
+}
+
+static int run_write_block(bench_ctx* ctx) {
+	uint32_t size = flink_subdevice_get_memsize(ctx->subdev) - HEADER_SIZE - SUBHEADER_SIZE;
+	return flink_write_block(ctx->subdev, HEADER_SIZE + SUBHEADER_SIZE, size, ctx->buf) == size ? 0 : -1;
+}
+
+// Asynchronous requests
+
+static int run_async_create_destroy(bench_ctx* ctx) {
+	flink_async* async = flink_async_create(ctx->dev);
+	if(async == NULL) return -1;
+	return flink_async_destroy(async);
+}
+
+static int setup_async(bench_ctx* ctx) {
+	ctx->async = flink_async_create(ctx->dev);
+	return ctx->async ? 0 : -1;
+}
+
+static int setup_async_config(bench_ctx* ctx) {
+	return setup_config(ctx) < 0 ? -1 : setup_async(ctx);
+}
+
+static int setup_async_request(bench_ctx* ctx) {
+	if(setup_async(ctx) < 0) return -1;
+	ctx->request = flink_async_read(ctx->async, ctx->subdev, STATUS_OFFSET, REGISTER_WITH, &ctx->value, FLINK_ASYNC_CONTROL, NULL, NULL);
+	return ctx->request && flink_async_wait(ctx->request) == REGISTER_WITH ? 0 : -1;
+}
+
+// Waits for a request and releases it
+static int async_complete(flink_async_request* request, ssize_t result) {
+	int ret;
+
+	if(request == NULL) return -1;
+	ret = flink_async_wait(request) == result ? 0 : -1;
+	return flink_async_release(request) < 0 ? -1 : ret;
+}
+
+static int run_async_get_fd(bench_ctx* ctx) {
+	return flink_async_get_fd(ctx->async);
+}
+
+static int run_async_read(bench_ctx* ctx) {
+	return async_complete(flink_async_read(ctx->async, ctx->subdev, STATUS_OFFSET, REGISTER_WITH, &ctx->value, FLINK_ASYNC_CONTROL, NULL, NULL),
+	                      REGISTER_WITH);
+}
+
+static int run_async_write(bench_ctx* ctx) {
+	return async_complete(flink_async_write(ctx->async, ctx->subdev, CONFIG_OFFSET, REGISTER_WITH, &ctx->value, FLINK_ASYNC_CONTROL, NULL, NULL),
+	                      REGISTER_WITH);
+}
+
+static int run_async_read_bit(bench_ctx* ctx) {
+	uint8_t bit;
+	return async_complete(flink_async_read_bit(ctx->async, ctx->subdev, STATUS_OFFSET, 0, &bit, FLINK_ASYNC_CONTROL, NULL, NULL), 0);
+}
+
+static int run_async_write_bit(bench_ctx* ctx) {
+	return async_complete(flink_async_write_bit(ctx->async, ctx->subdev, CONFIG_OFFSET, RESET_BIT, 0, FLINK_ASYNC_CONTROL, NULL, NULL), 0);
+}
+
+static int run_async_get_completed(bench_ctx* ctx) {
+	flink_async_request* request;
+
+	if(flink_async_read(ctx->async, ctx->subdev, STATUS_OFFSET, REGISTER_WITH, &ctx->value, FLINK_ASYNC_BULK, NULL, NULL) == NULL) return -1;
+	while((request = flink_async_get_completed(ctx->async)) == NULL);
+	return flink_async_release(request);
+}
+
+static int run_async_done_get_result(bench_ctx* ctx) {
+	return flink_async_done(ctx->request) == 1 && flink_async_get_result(ctx->request) == REGISTER_WITH ? 0 : -1;
+}
+
+// Subdevice operations
+
+static int run_subdevice_getters(bench_ctx* ctx) {
+	flink_subdev* s = ctx->subdev;
+	return flink_subdevice_get_id(s) + flink_subdevice_get_function(s) + flink_subdevice_get_subfunction(s) +
+	       flink_subdevice_get_function_version(s) + flink_subdevice_get_baseaddr(s) + flink_subdevice_get_memsize(s) +
+	       flink_subdevice_get_nofchannels(s) + flink_subdevice_get_unique_id(s) ? 0 : -1;
+}
+
+static int run_subdevice_id2str(bench_ctx* ctx) {
+	return flink_subdevice_id2str(flink_subdevice_get_function(ctx->subdev)) ? 0 : -1;
+}
+
+static int run_subdevice_select(bench_ctx* ctx) {
+	return flink_subdevice_select(ctx->subdev, 0);
+}
+
+static int run_subdevice_reset(bench_ctx* ctx) {
+	return flink_subdevice_reset(ctx->subdev);
+}
+
+// Info
+
+static int run_info_description(bench_ctx* ctx) {
+	return flink_info_get_description(ctx->subdev, ctx->desc);
+}
+
+// Analog input and output
+
+static int run_ain_resolution(bench_ctx* ctx) {
+	return flink_analog_in_get_resolution(ctx->subdev, &ctx->value);
+}
+
+static int run_ain_value(bench_ctx* ctx) {
+	return flink_analog_in_get_value(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_aout_resolution(bench_ctx* ctx) {
+	return flink_analog_out_get_resolution(ctx->subdev, &ctx->value);
+}
+
+static int run_aout_value(bench_ctx* ctx) {
+	return flink_analog_out_set_value(ctx->subdev, 0, 0);
+}
+
+// Digital I/O
+
+static int run_dio_baseclock(bench_ctx* ctx) {
+	return flink_dio_get_baseclock(ctx->subdev, &ctx->value);
+}
+
+static int run_dio_get_value(bench_ctx* ctx) {
+	uint8_t value;
+	return flink_dio_get_value(ctx->subdev, 0, &value);
+}
+
+static int run_dio_set_value(bench_ctx* ctx) {
+	return flink_dio_set_value(ctx->subdev, 0, 0);
+}
+
+static int run_dio_set_direction(bench_ctx* ctx) {
+	return flink_dio_set_direction(ctx->subdev, 0, FLINK_INPUT);
+}
+
+static int run_dio_get_debounce(bench_ctx* ctx) {
+	return flink_dio_get_debounce(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_dio_set_debounce(bench_ctx* ctx) {
+	return flink_dio_set_debounce(ctx->subdev, 0, ctx->value);
+}
+
+// Counter
+
+static int run_counter_count(bench_ctx* ctx) {
+	return flink_counter_get_count(ctx->subdev, 0, &ctx->value);
+}
+
+// PWM and PPWA
+
+static int run_pwm_baseclock(bench_ctx* ctx) {
+	return flink_pwm_get_baseclock(ctx->subdev, &ctx->value);
+}
+
+static int run_pwm_get_period(bench_ctx* ctx) {
+	return flink_pwm_get_period(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_pwm_set_period(bench_ctx* ctx) {
+	return flink_pwm_set_period(ctx->subdev, 0, ctx->value);
+}
+
+static int run_pwm_get_hightime(bench_ctx* ctx) {
+	return flink_pwm_get_hightime(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_pwm_set_hightime(bench_ctx* ctx) {
+	return flink_pwm_set_hightime(ctx->subdev, 0, ctx->value);
+}
+
+static int run_ppwa_baseclock(bench_ctx* ctx) {
+	return flink_ppwa_get_baseclock(ctx->subdev, &ctx->value);
+}
+
+static int run_ppwa_period(bench_ctx* ctx) {
+	return flink_ppwa_get_period(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_ppwa_hightime(bench_ctx* ctx) {
+	return flink_ppwa_get_hightime(ctx->subdev, 0, &ctx->value);
+}
+
+// Watchdog
+
+static int run_wd_baseclock(bench_ctx* ctx) {
+	return flink_wd_get_baseclock(ctx->subdev, &ctx->value);
+}
+
+static int run_wd_status(bench_ctx* ctx) {
+	uint8_t status;
+	return flink_wd_get_status(ctx->subdev, &status);
+}
+
+static int run_wd_counter(bench_ctx* ctx) {
+	return flink_wd_set_counter(ctx->subdev, 0);
+}
+
+static int run_wd_arm(bench_ctx* ctx) {
+	return flink_wd_arm(ctx->subdev);
+}
+
+// Stepper motor
+
+static int run_stepper_baseclock(bench_ctx* ctx) {
+	return flink_stepperMotor_get_baseclock(ctx->subdev, &ctx->value);
+}
+
+static int run_stepper_get_config(bench_ctx* ctx) {
+	return flink_stepperMotor_get_local_config_reg(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_stepper_set_config(bench_ctx* ctx) {
+	return flink_stepperMotor_set_local_config_reg(ctx->subdev, 0, ctx->value);
+}
+
+static int run_stepper_set_bits(bench_ctx* ctx) {
+	return flink_stepperMotor_set_local_config_reg_bits_atomic(ctx->subdev, 0, 0);
+}
+
+static int run_stepper_reset_bits(bench_ctx* ctx) {
+	return flink_stepperMotor_reset_local_config_reg_bits_atomic(ctx->subdev, 0, 0);
+}
+
+static int run_stepper_get_prescaler_start(bench_ctx* ctx) {
+	return flink_stepperMotor_get_prescaler_start(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_stepper_set_prescaler_start(bench_ctx* ctx) {
+	return flink_stepperMotor_set_prescaler_start(ctx->subdev, 0, ctx->value);
+}
+
+static int run_stepper_get_prescaler_top(bench_ctx* ctx) {
+	return flink_stepperMotor_get_prescaler_top(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_stepper_set_prescaler_top(bench_ctx* ctx) {
+	return flink_stepperMotor_set_prescaler_top(ctx->subdev, 0, ctx->value);
+}
+
+static int run_stepper_get_acceleration(bench_ctx* ctx) {
+	return flink_stepperMotor_get_acceleration(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_stepper_set_acceleration(bench_ctx* ctx) {
+	return flink_stepperMotor_set_acceleration(ctx->subdev, 0, ctx->value);
+}
+
+static int run_stepper_get_steps_to_do(bench_ctx* ctx) {
+	return flink_stepperMotor_get_steps_to_do(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_stepper_set_steps_to_do(bench_ctx* ctx) {
+	return flink_stepperMotor_set_steps_to_do(ctx->subdev, 0, ctx->value);
+}
+
+static int run_stepper_steps_done(bench_ctx* ctx) {
+	return flink_stepperMotor_get_steps_have_done(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_stepper_global_step_reset(bench_ctx* ctx) {
+	return flink_steppermotor_global_step_reset(ctx->subdev);
+}
+
+static int run_stepper_queue_create_destroy(bench_ctx* ctx) {
+	flink_stepper_queue* queue = flink_stepperMotor_queue_create(ctx->subdev, 0, FLINK_STEPPER_NO_IRQ);
+	if(queue == NULL) return -1;
+	return flink_stepperMotor_queue_destroy(queue);
+}
+
+// Profile of a short move up to a step per us
+static int setup_stepper_profile(bench_ctx* ctx) {
+	ctx->params = (flink_stepper_profile_params){ 0 };
+	if(flink_stepperMotor_get_baseclock(ctx->subdev, &ctx->params.base_clk) < 0) return -1;
+	ctx->params.start_speed  = 500000;
+	ctx->params.top_speed    = 1000000;
+	ctx->params.acceleration = 4000000000U;
+	ctx->params.jerk         = 4000000000U;
+	ctx->params.steps        = 16;
+	return flink_stepperMotor_profile_get(&ctx->params, &ctx->profile);
+}
+
+static int setup_stepper_queue(bench_ctx* ctx) {
+	if(setup_stepper_profile(ctx) < 0) return -1;
+	ctx->queue = flink_stepperMotor_queue_create(ctx->subdev, 0, FLINK_STEPPER_NO_IRQ);
+	return ctx->queue ? 0 : -1;
+}
+
+static int run_stepper_queue_push_wait(bench_ctx* ctx) {
+	flink_stepper_move move = { 0, 1000, 100, 0, 1 };
+	uint64_t id;
+
+	if(flink_stepperMotor_queue_push(ctx->queue, &move, &id) < 0) return -1;
+	return flink_stepperMotor_queue_wait(ctx->queue, id, -1);
+}
+
+static int run_stepper_queue_push_profile(bench_ctx* ctx) {
+	uint64_t id;
+
+	if(flink_stepperMotor_queue_push_profile(ctx->queue, &ctx->profile, 0, &id) < 0) return -1;
+	return flink_stepperMotor_queue_wait(ctx->queue, id, -1);
+}
+
+static int run_stepper_queue_position(bench_ctx* ctx) {
+	int64_t position;
+	return flink_stepperMotor_queue_get_position(ctx->queue, &position);
+}
+
+static int run_stepper_queue_latency(bench_ctx* ctx) {
+	flink_stepper_latency latency;
+	return flink_stepperMotor_queue_get_latency(ctx->queue, &latency);
+}
+
+static int run_stepper_profile_get(bench_ctx* ctx) {
+	return flink_stepperMotor_profile_get(&ctx->params, &ctx->profile);
+}
+
+static int run_stepper_profile_cached(bench_ctx* ctx) {
+	return flink_stepperMotor_profile_cached(&ctx->params) == 1 ? 0 : -1;
+}
+
+// Reflective sensor
+
+static int run_sensor_resolution(bench_ctx* ctx) {
+	return flink_reflectivesensor_get_resolution(ctx->subdev, &ctx->value);
+}
+
+static int run_sensor_value(bench_ctx* ctx) {
+	return flink_reflectivesensor_get_value(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_sensor_get_upper(bench_ctx* ctx) {
+	return flink_reflectivesensor_get_upper_level_int(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_sensor_set_upper(bench_ctx* ctx) {
+	return flink_reflectivesensor_set_upper_level_int(ctx->subdev, 0, ctx->value);
+}
+
+static int run_sensor_get_lower(bench_ctx* ctx) {
+	return flink_reflectivesensor_get_lower_level_int(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_sensor_set_lower(bench_ctx* ctx) {
+	return flink_reflectivesensor_set_lower_level_int(ctx->subdev, 0, ctx->value);
+}
+
+static int run_sensor_values(bench_ctx* ctx) {
+	return flink_reflectivesensor_get_values(ctx->subdev, ctx->buf);
+}
+
+static int setup_sensor_levels(bench_ctx* ctx) {
+	return flink_reflectivesensor_get_levels(ctx->subdev, ctx->buf, ctx->buf2);
+}
+
+static int run_sensor_set_levels(bench_ctx* ctx) {
+	return flink_reflectivesensor_set_levels(ctx->subdev, ctx->buf, ctx->buf2);
+}
+
+static int run_sensor_calibrate(bench_ctx* ctx) {
+	return flink_reflectivesensor_calibrate(ctx->subdev, 1, 0, 0, NULL, NULL);
+}
+
+// Interrupts
+
+static int run_irq_register_unregister(bench_ctx* ctx) {
+	if(flink_register_irq(ctx->dev, 0) < 0) return -1;
+	return flink_unregister_irq(ctx->dev, 0);
+}
+
+static int run_irq_signal_offset(bench_ctx* ctx) {
+	return flink_get_signal_offset(ctx->dev, &ctx->value);
+}
+
+static int run_irq_get_multiplex(bench_ctx* ctx) {
+	return flink_get_irq_multiplex(ctx->subdev, 0, &ctx->value);
+}
+
+static int run_irq_set_multiplex(bench_ctx* ctx) {
+	return flink_set_irq_multiplex(ctx->subdev, 0, ctx->value);
+}
+
+static int setup_irq_table(bench_ctx* ctx) {
+	return flink_get_irq_multiplex_table(ctx->subdev, ctx->buf);
+}
+
+static int run_irq_set_table(bench_ctx* ctx) {
+	return flink_set_irq_multiplex_table(ctx->subdev, ctx->buf);
+}
+
+// Custom subdevices, a driver describing the PWM
+
+static const flink_register custom_pwm_registers[] = {
+	{ "base_clock", 0,              0,             FLINK_REG_READ },
+	{ "period",     REGISTER_WITH,  REGISTER_WITH, FLINK_REG_RW   },
+	{ "hightime",   FLINK_REG_NEXT, REGISTER_WITH, FLINK_REG_RW   },
+};
+
+static const flink_driver custom_pwm_driver = {
+	"bench", PWM_INTERFACE_ID, 0, sizeof(custom_pwm_registers) / sizeof(custom_pwm_registers[0]), custom_pwm_registers
+};
+
+static int run_custom_register_unregister(bench_ctx* ctx) {
+	flink_driver driver = custom_pwm_driver;
+
+	driver.function_id = CUSTOM_UNUSED_ID;
+	if(flink_custom_register_driver(&driver) < 0) return -1;
+	return flink_custom_unregister_driver(CUSTOM_UNUSED_ID, 0);
+}
+
+static int setup_custom(bench_ctx* ctx) {
+	if(flink_subdevice_get_subfunction(ctx->subdev) != custom_pwm_driver.sub_function_id) return 1;
+	if(flink_custom_register_driver(&custom_pwm_driver) < 0) return -1;
+	ctx->custom_reg = flink_custom_get_register(ctx->subdev, "period");
+	if(ctx->custom_reg < 0) return -1;
+	return flink_custom_read(ctx->subdev, ctx->custom_reg, 0, &ctx->value);
+}
+
+static int setup_custom_plan(bench_ctx* ctx) {
+	int regs[] = { 1, 2 };	// period and hightime
+	int ret = setup_custom(ctx);
+
+	if(ret != 0) return ret;
+	ctx->plan = flink_custom_plan_create(ctx->subdev, regs, 2);
+	return ctx->plan ? 0 : -1;
+}
+
+static int run_custom_get_register(bench_ctx* ctx) {
+	return flink_custom_get_register(ctx->subdev, "hightime") < 0 ? -1 : 0;
+}
+
+static int run_custom_read(bench_ctx* ctx) {
+	return flink_custom_read(ctx->subdev, ctx->custom_reg, 0, &ctx->value);
+}
+
+static int run_custom_write(bench_ctx* ctx) {
+	return flink_custom_write(ctx->subdev, ctx->custom_reg, 0, ctx->value);
+}
+
+static int run_custom_plan_create_destroy(bench_ctx* ctx) {
+	int regs[] = { 1, 2 };
+	flink_custom_plan* plan = flink_custom_plan_create(ctx->subdev, regs, 2);
+	if(plan == NULL) return -1;
+	return flink_custom_plan_destroy(plan);
+}
+
+static int run_custom_plan_get_nof_values(bench_ctx* ctx) {
+	return flink_custom_plan_get_nof_values(ctx->plan) == 2 * flink_subdevice_get_nofchannels(ctx->subdev) ? 0 : -1;
+}
+
+static int run_custom_plan_read(bench_ctx* ctx) {
+	return flink_custom_plan_read(ctx->plan, ctx->buf);
+}
+
+static const bench benches[] = {
+	{ "open_close",                   NO_SUBDEVICE,                 0, NULL,                    run_open_close },
+	{ "ioctl",                        NO_SUBDEVICE,                 0, NULL,                    run_ioctl },
+	{ "get_nof_syscalls",             NO_SUBDEVICE,                 0, NULL,                    run_get_nof_syscalls },
+	{ "get_errno",                    NO_SUBDEVICE,                 0, NULL,                    run_get_errno },
+	{ "get_nof_subdevices",           NO_SUBDEVICE,                 0, NULL,                    run_get_nof_subdevices },
+	{ "get_subdevice_by_id",          NO_SUBDEVICE,                 0, NULL,                    run_get_subdevice_by_id },
+	{ "get_subdevice_by_unique_id",   NO_SUBDEVICE,                 0, setup_unique_id,         run_get_subdevice_by_unique_id },
+	{ "get_fingerprint",              NO_SUBDEVICE,                 0, NULL,                    run_get_fingerprint },
+	{ "stats_snapshot",               NO_SUBDEVICE,                 0, setup_stats,             run_stats_snapshot },
+	{ "stats_reset",                  NO_SUBDEVICE,                 0, setup_stats,             run_stats_reset },
+	{ "op2str",                       NO_SUBDEVICE,                 0, NULL,                    run_op2str },
+	{ "trace_level",                  NO_SUBDEVICE,                 0, NULL,                    run_trace_level },
+	{ "trace_read",                   NO_SUBDEVICE,                 0, NULL,                    run_trace_read },
+	{ "trace_format",                 NO_SUBDEVICE,                 0, NULL,                    run_trace_format },
+	{ "trace_dump",                   NO_SUBDEVICE,                 0, setup_trace_dump,        run_trace_dump },
+	{ "chrome_trace_start_stop",      NO_SUBDEVICE,                 0, NULL,                    run_chrome_trace },
+	{ "record_start_stop",            NO_SUBDEVICE,                 0, NULL,                    run_record },
+	{ "snapshot_save",                NO_SUBDEVICE,                 0, NULL,                    run_snapshot_save },
+	{ "snapshot_restore",             NO_SUBDEVICE,                 0, run_snapshot_save,       run_snapshot_restore },
+	{ "image_create_close",           NO_SUBDEVICE,                 0, NULL,                    run_image_create_close },
+	{ "image_publish",                NO_SUBDEVICE,                 0, setup_image,             run_image_publish },
+	{ "image_publish_registers",      PWM_INTERFACE_ID,             0, setup_image,             run_image_publish_registers },
+	{ "image_open_close",             NO_SUBDEVICE,                 0, setup_image,             run_image_open_close },
+	{ "image_getters",                NO_SUBDEVICE,                 0, setup_image_reader,      run_image_getters },
+	{ "image_get_sample",             NO_SUBDEVICE,                 0, setup_image_reader,      run_image_get_sample },
+	{ "image_read",                   NO_SUBDEVICE,                 0, setup_image_reader,      run_image_read },
+	{ "spi_register_endpoint",        NO_SUBDEVICE,                 0, NULL,                    run_spi_register_endpoint },
+	{ "sim_get_time",                 NO_SUBDEVICE,                 1, NULL,                    run_sim_get_time },
+	{ "sim_get_nof_bytes",            NO_SUBDEVICE,                 1, NULL,                    run_sim_get_nof_bytes },
+	{ "read",                         ANY_FUNCTION,                 0, NULL,                    run_read },
+	{ "write",                        ANY_FUNCTION,                 0, setup_config,            run_write },
+	{ "read_bit",                     ANY_FUNCTION,                 0, NULL,                    run_read_bit },
+	{ "write_bit",                    ANY_FUNCTION,                 0, NULL,                    run_write_bit },
+	{ "read_block",                   ANY_FUNCTION,                 0, NULL,                    run_read_block },
+	{ "write_block",                  ANY_FUNCTION,                 1, setup_function_regs,     run_write_block },
+	{ "async_create_destroy",         NO_SUBDEVICE,                 0, NULL,                    run_async_create_destroy },
+	{ "async_get_fd",                 NO_SUBDEVICE,                 0, setup_async,             run_async_get_fd },
+	{ "async_read",                   ANY_FUNCTION,                 0, setup_async,             run_async_read },
+	{ "async_write",                  ANY_FUNCTION,                 0, setup_async_config,      run_async_write },
+	{ "async_read_bit",               ANY_FUNCTION,                 0, setup_async,             run_async_read_bit },
+	{ "async_write_bit",              ANY_FUNCTION,                 0, setup_async,             run_async_write_bit },
+	{ "async_get_completed",          ANY_FUNCTION,                 0, setup_async,             run_async_get_completed },
+	{ "async_done_get_result",        ANY_FUNCTION,                 0, setup_async_request,     run_async_done_get_result },
+	{ "subdevice_getters",            ANY_FUNCTION,                 0, NULL,                    run_subdevice_getters },
+	{ "subdevice_id2str",             ANY_FUNCTION,                 0, NULL,                    run_subdevice_id2str },
+	{ "subdevice_select",             ANY_FUNCTION,                 0, NULL,                    run_subdevice_select },
+	{ "subdevice_reset",              ANY_FUNCTION,                 1, NULL,                    run_subdevice_reset },
+	{ "info_get_description",         INFO_DEVICE_ID,               0, NULL,                    run_info_description },
+	{ "analog_in_get_resolution",     ANALOG_INPUT_INTERFACE_ID,    0, NULL,                    run_ain_resolution },
+	{ "analog_in_get_value",          ANALOG_INPUT_INTERFACE_ID,    0, NULL,                    run_ain_value },
+	{ "analog_out_get_resolution",    ANALOG_OUTPUT_INTERFACE_ID,   0, NULL,                    run_aout_resolution },
+	{ "analog_out_set_value",         ANALOG_OUTPUT_INTERFACE_ID,   1, NULL,                    run_aout_value },
+	{ "dio_get_baseclock",            GPIO_INTERFACE_ID,            0, NULL,                    run_dio_baseclock },
+	{ "dio_get_value",                GPIO_INTERFACE_ID,            0, NULL,                    run_dio_get_value },
+	{ "dio_set_value",                GPIO_INTERFACE_ID,            1, NULL,                    run_dio_set_value },
+	{ "dio_set_direction",            GPIO_INTERFACE_ID,            1, NULL,                    run_dio_set_direction },
+	{ "dio_get_debounce",             GPIO_INTERFACE_ID,            0, NULL,                    run_dio_get_debounce },
+	{ "dio_set_debounce",             GPIO_INTERFACE_ID,            0, run_dio_get_debounce,    run_dio_set_debounce },
+	{ "counter_get_count",            COUNTER_INTERFACE_ID,         0, NULL,                    run_counter_count },
+	{ "pwm_get_baseclock",            PWM_INTERFACE_ID,             0, NULL,                    run_pwm_baseclock },
+	{ "pwm_get_period",               PWM_INTERFACE_ID,             0, NULL,                    run_pwm_get_period },
+	{ "pwm_set_period",               PWM_INTERFACE_ID,             0, run_pwm_get_period,      run_pwm_set_period },
+	{ "pwm_get_hightime",             PWM_INTERFACE_ID,             0, NULL,                    run_pwm_get_hightime },
+	{ "pwm_set_hightime",             PWM_INTERFACE_ID,             0, run_pwm_get_hightime,    run_pwm_set_hightime },
+	{ "config_apply",                 PWM_INTERFACE_ID,             0, setup_config_file,       run_config_apply },
+	{ "ppwa_get_baseclock",           PPWA_INTERFACE_ID,            0, NULL,                    run_ppwa_baseclock },
+	{ "ppwa_get_period",              PPWA_INTERFACE_ID,            0, NULL,                    run_ppwa_period },
+	{ "ppwa_get_hightime",            PPWA_INTERFACE_ID,            0, NULL,                    run_ppwa_hightime },
+	{ "wd_get_baseclock",             WD_INTERFACE_ID,              0, NULL,                    run_wd_baseclock },
+	{ "wd_get_status",                WD_INTERFACE_ID,              0, NULL,                    run_wd_status },
+	{ "wd_set_counter",               WD_INTERFACE_ID,              1, NULL,                    run_wd_counter },
+	{ "wd_arm",                       WD_INTERFACE_ID,              1, NULL,                    run_wd_arm },
+	{ "stepper_get_baseclock",        STEPPER_MOTOR_INTERFACE_ID,   0, NULL,                    run_stepper_baseclock },
+	{ "stepper_get_config",           STEPPER_MOTOR_INTERFACE_ID,   0, NULL,                    run_stepper_get_config },
+	{ "stepper_set_config",           STEPPER_MOTOR_INTERFACE_ID,   0, run_stepper_get_config,  run_stepper_set_config },
+	{ "stepper_set_config_bits",      STEPPER_MOTOR_INTERFACE_ID,   0, NULL,                    run_stepper_set_bits },
+	{ "stepper_reset_config_bits",    STEPPER_MOTOR_INTERFACE_ID,   0, NULL,                    run_stepper_reset_bits },
+	{ "stepper_get_prescaler_start",  STEPPER_MOTOR_INTERFACE_ID,   0, NULL,                    run_stepper_get_prescaler_start },
+	{ "stepper_set_prescaler_start",  STEPPER_MOTOR_INTERFACE_ID,   0, run_stepper_get_prescaler_start, run_stepper_set_prescaler_start },
+	{ "stepper_get_prescaler_top",    STEPPER_MOTOR_INTERFACE_ID,   0, NULL,                    run_stepper_get_prescaler_top },
+	{ "stepper_set_prescaler_top",    STEPPER_MOTOR_INTERFACE_ID,   0, run_stepper_get_prescaler_top, run_stepper_set_prescaler_top },
+	{ "stepper_get_acceleration",     STEPPER_MOTOR_INTERFACE_ID,   0, NULL,                    run_stepper_get_acceleration },
+	{ "stepper_set_acceleration",     STEPPER_MOTOR_INTERFACE_ID,   0, run_stepper_get_acceleration, run_stepper_set_acceleration },
+	{ "stepper_get_steps_to_do",      STEPPER_MOTOR_INTERFACE_ID,   0, NULL,                    run_stepper_get_steps_to_do },
+	{ "stepper_set_steps_to_do",      STEPPER_MOTOR_INTERFACE_ID,   0, run_stepper_get_steps_to_do, run_stepper_set_steps_to_do },
+	{ "stepper_get_steps_have_done",  STEPPER_MOTOR_INTERFACE_ID,   0, NULL,                    run_stepper_steps_done },
+	{ "stepper_global_step_reset",    STEPPER_MOTOR_INTERFACE_ID,   1, NULL,                    run_stepper_global_step_reset },
+	{ "stepper_queue_create_destroy", STEPPER_MOTOR_INTERFACE_ID,   1, NULL,                    run_stepper_queue_create_destroy },
+	{ "stepper_queue_push_wait",      STEPPER_MOTOR_INTERFACE_ID,   1, setup_stepper_queue,     run_stepper_queue_push_wait },
+	{ "stepper_queue_push_profile",   STEPPER_MOTOR_INTERFACE_ID,   1, setup_stepper_queue,     run_stepper_queue_push_profile },
+	{ "stepper_queue_get_position",   STEPPER_MOTOR_INTERFACE_ID,   1, setup_stepper_queue,     run_stepper_queue_position },
+	{ "stepper_queue_get_latency",    STEPPER_MOTOR_INTERFACE_ID,   1, setup_stepper_queue,     run_stepper_queue_latency },
+	{ "stepper_profile_get",          STEPPER_MOTOR_INTERFACE_ID,   0, setup_stepper_profile,   run_stepper_profile_get },
+	{ "stepper_profile_cached",       STEPPER_MOTOR_INTERFACE_ID,   0, setup_stepper_profile,   run_stepper_profile_cached },
+	{ "sensor_get_resolution",        SENSOR_INTERFACE_ID,          0, NULL,                    run_sensor_resolution },
+	{ "sensor_get_value",             SENSOR_INTERFACE_ID,          0, NULL,                    run_sensor_value },
+	{ "sensor_get_upper_level",       SENSOR_INTERFACE_ID,          0, NULL,                    run_sensor_get_upper },
+	{ "sensor_set_upper_level",       SENSOR_INTERFACE_ID,          0, run_sensor_get_upper,    run_sensor_set_upper },
+	{ "sensor_get_lower_level",       SENSOR_INTERFACE_ID,          0, NULL,                    run_sensor_get_lower },
+	{ "sensor_set_lower_level",       SENSOR_INTERFACE_ID,          0, run_sensor_get_lower,    run_sensor_set_lower },
+	{ "sensor_get_values",            SENSOR_INTERFACE_ID,          0, NULL,                    run_sensor_values },
+	{ "sensor_get_levels",            SENSOR_INTERFACE_ID,          0, NULL,                    setup_sensor_levels },
+	{ "sensor_set_levels",            SENSOR_INTERFACE_ID,          0, setup_sensor_levels,     run_sensor_set_levels },
+	{ "sensor_calibrate",             SENSOR_INTERFACE_ID,          1, NULL,                    run_sensor_calibrate },
+	{ "irq_register_unregister",      NO_SUBDEVICE,                 1, NULL,                    run_irq_register_unregister },
+	{ "irq_get_signal_offset",        NO_SUBDEVICE,                 0, NULL,                    run_irq_signal_offset },
+	{ "irq_get_multiplex",            IRQ_MULTIPLEXER_INTERFACE_ID, 0, NULL,                    run_irq_get_multiplex },
+	{ "irq_set_multiplex",            IRQ_MULTIPLEXER_INTERFACE_ID, 0, run_irq_get_multiplex,   run_irq_set_multiplex },
+	{ "irq_get_multiplex_table",      IRQ_MULTIPLEXER_INTERFACE_ID, 0, NULL,                    setup_irq_table },
+	{ "irq_set_multiplex_table",      IRQ_MULTIPLEXER_INTERFACE_ID, 0, setup_irq_table,         run_irq_set_table },
+	{ "custom_register_unregister",   NO_SUBDEVICE,                 0, NULL,                    run_custom_register_unregister },
+	{ "custom_get_register",          PWM_INTERFACE_ID,             0, setup_custom,            run_custom_get_register },
+	{ "custom_read",                  PWM_INTERFACE_ID,             0, setup_custom,            run_custom_read },
+	{ "custom_write",                 PWM_INTERFACE_ID,             0, setup_custom,            run_custom_write },
+	{ "custom_plan_create_destroy",   PWM_INTERFACE_ID,             0, setup_custom,            run_custom_plan_create_destroy },
+	{ "custom_plan_get_nof_values",   PWM_INTERFACE_ID,             0, setup_custom_plan,       run_custom_plan_get_nof_values },
+	{ "custom_plan_read",             PWM_INTERFACE_ID,             0, setup_custom_plan,       run_custom_plan_read },
+};
+#define NOF_BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static flink_subdev* find_subdev(flink_dev* dev, uint16_t function_id) {
+	int i, n = flink_get_nof_subdevices(dev);
+
+	for(i = 0; i < n; i++) {
+		flink_subdev* subdev = flink_get_subdevice_by_id(dev, i);
+		if(function_id == ANY_FUNCTION || flink_subdevice_get_function(subdev) == function_id) return subdev;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Measures a benchmark after warming up.
+ * @return int: 0 on success, 1 if the setup skipped the benchmark, -1 in case of failure.
+ */
+static int measure(bench_ctx* ctx, const bench* b, uint32_t iterations, uint64_t* ns, uint64_t* syscalls) {
+	uint64_t t0, sc0;
+	uint32_t i;
+	int ret;
+
+	ret = b->setup ? b->setup(ctx) : 0;
+	if(ret != 0) return ret;
+
+	// Warm up caches and the transport
+	for(i = 0; i < iterations / 10 + 1; i++) {
+		if(b->run(ctx) < 0) return -1;
+	}
+
+	ctx->syscalls = 0;
+	sc0 = flink_get_nof_syscalls(ctx->dev);
+	t0 = now_ns();
+	for(i = 0; i < iterations; i++) {
+		if(b->run(ctx) < 0) return -1;
+	}
+	*ns = now_ns() - t0;
+	*syscalls = flink_get_nof_syscalls(ctx->dev) + ctx->syscalls - sc0;
+	return 0;
+}
+
+/**
+ * @brief Runs a benchmark and prints its result.
+ * @return int: 0 if the benchmark ran, 1 if it was skipped, -1 in case of failure.
+ */
+static int run_bench(bench_ctx* ctx, const bench* b, uint32_t iterations, int first) {
+	uint64_t ns = 0, syscalls = 0;
+	int simulated = strncmp(ctx->dev_name, "sim:", 4) == 0;
+	int ret;
+
+	ctx->subdev = NULL;
+	if(b->function_id != NO_SUBDEVICE) {
+		ctx->subdev = find_subdev(ctx->dev, b->function_id);
+		if(ctx->subdev == NULL) return 1;
+	}
+	if(b->destructive && !simulated) return 1;
+
+	if(ctx->subdev) {
+		free(ctx->buf);
+		free(ctx->buf2);
+		ctx->buf = calloc(1, flink_subdevice_get_memsize(ctx->subdev) + HEADER_SIZE + SUBHEADER_SIZE);
+		ctx->buf2 = calloc(1, flink_subdevice_get_memsize(ctx->subdev) + HEADER_SIZE + SUBHEADER_SIZE);
+		if(ctx->buf == NULL || ctx->buf2 == NULL) return -1;
+	}
+	ret = measure(ctx, b, iterations, &ns, &syscalls);
+	if(ctx->queue) {
+		flink_stepperMotor_queue_destroy(ctx->queue);
+		ctx->queue = NULL;
+	}
+	free(ctx->snapshot);
+	ctx->snapshot = NULL;
+	if(ctx->reader) {
+		flink_image_close(ctx->reader);
+		ctx->reader = NULL;
+	}
+	if(ctx->image) {
+		flink_image_close(ctx->image);
+		ctx->image = NULL;
+	}
+	if(ctx->request) {
+		flink_async_release(ctx->request);
+		ctx->request = NULL;
+	}
+	if(ctx->async) {
+		flink_async_destroy(ctx->async);
+		ctx->async = NULL;
+	}
+	if(ctx->plan) {
+		flink_custom_plan_destroy(ctx->plan);
+		ctx->plan = NULL;
+	}
+	if(ret != 0) return ret;
+
+	printf("%s\n      {\"name\": \"%s\", \"subdevice\": %d, \"ns_per_op\": %.1f, \"syscalls_per_op\": %.2f}",
+	       first ? "" : ",", b->name, ctx->subdev ? flink_subdevice_get_id(ctx->subdev) : -1,
+	       (double)ns / iterations, (double)syscalls / iterations);
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	const char* dev_names[MAX_DEVICES];
+	int nof_devs = 0;
+	uint32_t iterations = DEFAULT_ITERATIONS;
+	bench_ctx ctx;
+	size_t k;
+	int c, d, ret, first, printed = 0, error = 0;
+
+	/* Compute command line arguments */
+	while((c = getopt(argc, argv, "d:n:")) != -1) {
+		switch(c) {
+			case 'd': // device, may be repeated
+				if(nof_devs == MAX_DEVICES) {
+					fprintf(stderr, "At most %u devices can be benchmarked.\n", MAX_DEVICES);
+					return -1;
+				}
+				dev_names[nof_devs++] = optarg;
+				break;
+			case 'n': // iterations
+				iterations = strtoul(optarg, NULL, 0);
+				if(iterations == 0) {
+					fprintf(stderr, "Number of iterations must be greater than zero.\n");
+					return -1;
+				}
+				break;
+			case '?':
+				if(optopt == 'd' || optopt == 'n') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+				else if(isprint(optopt)) fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+				return -1;
+			default:
+				abort();
+		}
+	}
+	if(nof_devs == 0) dev_names[nof_devs++] = DEFAULT_DEV;
+
+	printf("[");
+	for(d = 0; d < nof_devs; d++) {
+		memset(&ctx, 0, sizeof(ctx));
+		ctx.dev_name = dev_names[d];
+		snprintf(ctx.image_name, sizeof(ctx.image_name), "/flinkbench.%d", (int)getpid());
+		ctx.dev = flink_open(ctx.dev_name);
+		if(ctx.dev == NULL) {
+			fprintf(stderr, "Failed to open device %s!\n", ctx.dev_name);
+			error = 1;
+			continue;
+		}
+
+		printf("%s\n  {\"device\": \"%s\", \"iterations\": %u, \"results\": [", printed++ ? "," : "", ctx.dev_name, iterations);
+		first = 1;
+		for(k = 0; k < NOF_BENCHES; k++) {
+			ret = run_bench(&ctx, &benches[k], iterations, first);
+			if(ret < 0) {
+				fprintf(stderr, "Benchmark %s failed on device %s!\n", benches[k].name, ctx.dev_name);
+				error = 1;
+			}
+			else if(ret == 0) first = 0;
+		}
+		printf("\n  ]}");
+
+		free(ctx.buf);
+		free(ctx.buf2);
+		if(ctx.null_fd > 0) close(ctx.null_fd);
+		if(ctx.config_file[0]) unlink(ctx.config_file);
+		flink_close(ctx.dev);
+	}
+	printf("\n]\n");
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
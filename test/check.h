@@ -0,0 +1,60 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, test checks                           *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file check.h
+ *  @brief Checks of the tests registered with ctest.
+ *
+ *  CHECK() prints a message for a failed condition and counts it, so
+ *  a test runs all its checks and fails at the end if one failed:
+ *
+ *      CHECK(value == 1, "value %u", value);
+ *      ...
+ *      return check_result("Stepper queue test");
+ *
+ *  check_nof_ops() counts the operations of a device, so a test can
+ *  check the transfers of a call also when the library is built
+ *  without statistics, in which case it returns -1.
+ */
+
+#ifndef FLINK_TEST_CHECK_H_
+#define FLINK_TEST_CHECK_H_
+
+#include <stdio.h>
+
+#include <flinklib.h>
+
+static int failed = 0;
+
+#define CHECK(cond, ...) do { if(!(cond)) { fprintf(stderr, "FAILED: " __VA_ARGS__); fprintf(stderr, "\n"); failed++; } } while(0)
+
+/**
+ * @brief Exit status of a test, prints that it passed if no check failed.
+ */
+static inline int check_result(const char* test) {
+	if(failed) return 1;
+	printf("%s passed\n", test);
+	return 0;
+}
+
+/**
+ * @brief Nof operations of a type done on a device, -1 if the library collects no statistics.
+ */
+static inline int64_t check_nof_ops(flink_dev* dev, flink_op op) {
+	flink_op_stats ops[FLINK_NOF_OPS];
+
+	if(flink_stats_snapshot(dev, ops, NULL) < 0) return -1;
+	return (int64_t)ops[op].count;
+}
+
+#endif // FLINK_TEST_CHECK_H_
@@ -0,0 +1,234 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, Chrome trace test                     *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file chrome_trace.c
+ *  @brief Checks Chrome traces of the simulated device sim:bench.
+ *
+ *  Records the accesses of two threads and checks that the file is
+ *  valid JSON with an event per access, that events beyond the maximum
+ *  are dropped and reported, and that starting and stopping are
+ *  rejected when the recorder is in the wrong state.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define PWM_BASE      (HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+#define NOF_THREADS   2
+#define NOF_READS     50
+#define MAX_EVENTS    1000
+
+// Minimal JSON syntax check, returns the position after the value or NULL
+static const char* json_value(const char* p);
+
+static const char* json_space(const char* p) {
+	while(isspace((unsigned char)*p)) p++;
+	return p;
+}
+
+static const char* json_string(const char* p) {
+	if(*p++ != '"') return NULL;
+	while(*p && *p != '"') {
+		if(*p == '\\' && !*++p) return NULL;
+		if((unsigned char)*p < 0x20) return NULL;
+		p++;
+	}
+	return *p == '"' ? p + 1 : NULL;
+}
+
+static const char* json_number(const char* p) {
+	const char* start;
+
+	if(*p == '-') p++;
+	if(*p == '0') p++;
+	else if(isdigit((unsigned char)*p)) while(isdigit((unsigned char)*p)) p++;
+	else return NULL;
+	if(*p == '.') {
+		start = ++p;
+		while(isdigit((unsigned char)*p)) p++;
+		if(p == start) return NULL;
+	}
+	if(*p == 'e' || *p == 'E') {
+		p++;
+		if(*p == '+' || *p == '-') p++;
+		start = p;
+		while(isdigit((unsigned char)*p)) p++;
+		if(p == start) return NULL;
+	}
+	return p;
+}
+
+static const char* json_list(const char* p, char close, int members) {
+	p = json_space(p + 1);
+	if(*p == close) return p + 1;
+	while(p) {
+		if(members) {
+			p = json_string(p);
+			if(p == NULL) return NULL;
+			p = json_space(p);
+			if(*p++ != ':') return NULL;
+		}
+		p = json_value(p);
+		if(p == NULL) return NULL;
+		p = json_space(p);
+		if(*p == close) return p + 1;
+		if(*p++ != ',') return NULL;
+	}
+	return NULL;
+}
+
+static const char* json_value(const char* p) {
+	p = json_space(p);
+	switch(*p) {
+		case '{': return json_list(p, '}', 1);
+		case '[': return json_list(p, ']', 0);
+		case '"': return json_string(p);
+		case 't': return strncmp(p, "true", 4) ? NULL : p + 4;
+		case 'f': return strncmp(p, "false", 5) ? NULL : p + 5;
+		case 'n': return strncmp(p, "null", 4) ? NULL : p + 4;
+		default:  return json_number(p);
+	}
+}
+
+// Reads a whole file, the caller frees the text
+static char* read_file(const char* file_name) {
+	FILE* file = fopen(file_name, "r");
+	char* text = NULL;
+	long size;
+
+	if(file == NULL) return NULL;
+	if(fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+		text = malloc(size + 1);
+		if(text && fread(text, 1, size, file) != (size_t)size) {
+			free(text);
+			text = NULL;
+		}
+		if(text) text[size] = '\0';
+	}
+	fclose(file);
+	return text;
+}
+
+// Counts the occurrences of a pattern
+static int count(const char* text, const char* pattern) {
+	int n = 0;
+
+	while((text = strstr(text, pattern)) != NULL) {
+		n++;
+		text += strlen(pattern);
+	}
+	return n;
+}
+
+// Checks that a trace is valid JSON and returns its text, NULL if it is not
+static char* check_trace(const char* file_name) {
+	char* text = read_file(file_name);
+	const char* end;
+
+	CHECK(text != NULL, "can't read %s", file_name);
+	if(text == NULL) return NULL;
+	end = json_value(text);
+	CHECK(end != NULL && *json_space(end) == '\0', "invalid JSON at %ld", end ? (long)(end - text) : -1L);
+	if(end == NULL || *json_space(end) != '\0') {
+		free(text);
+		return NULL;
+	}
+	return text;
+}
+
+static void* work(void* arg) {
+	flink_subdev* pwm = arg;
+	uint32_t value;
+	int i;
+
+	for(i = 0; i < NOF_READS; i++) flink_read(pwm, PWM_BASE, REGISTER_WITH, &value);
+	return NULL;
+}
+
+int main(void) {
+	flink_dev*    dev;
+	flink_subdev* pwm;
+	pthread_t     threads[NOF_THREADS];
+	char          file_name[64], args[64];
+	char*         text;
+	uint32_t      value;
+	int           i;
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	pwm = flink_get_subdevice_by_unique_id(dev, 3);
+	snprintf(file_name, sizeof(file_name), "/tmp/flink_test_chrome_trace.%d.json", (int)getpid());
+	snprintf(args, sizeof(args), "\"args\":{\"subdev\":%d,\"offset\":%u,\"size\":%u}", flink_subdevice_get_id(pwm), PWM_BASE, REGISTER_WITH);
+
+	// Wrong states
+	CHECK(flink_chrome_trace_stop(file_name) < 0 && flink_get_errno() == FLINK_EINVALARG, "stop without start");
+	CHECK(flink_chrome_trace_start(0) < 0 && flink_get_errno() == FLINK_EINVALARG, "start without events");
+
+	// Two threads and a write, an event per access
+	CHECK(flink_chrome_trace_start(MAX_EVENTS) == 0, "start");
+	CHECK(flink_chrome_trace_start(MAX_EVENTS) < 0 && flink_get_errno() == FLINK_EBUSY, "started twice");
+	for(i = 0; i < NOF_THREADS; i++) pthread_create(&threads[i], NULL, work, pwm);
+	for(i = 0; i < NOF_THREADS; i++) pthread_join(threads[i], NULL);
+	value = 1000;
+	CHECK(flink_write(pwm, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH, "write");
+	CHECK(flink_chrome_trace_stop(file_name) == 0, "stop");
+	text = check_trace(file_name);
+	if(text) {
+		CHECK(count(text, "\"ph\":\"X\"") == NOF_THREADS * NOF_READS + 1, "%d events", count(text, "\"ph\":\"X\""));
+		CHECK(count(text, "\"name\":\"read\"") == NOF_THREADS * NOF_READS && count(text, "\"name\":\"write\"") == 1, "event names");
+		CHECK(count(text, args) == NOF_THREADS * NOF_READS + 1, "event arguments");
+		CHECK(strstr(text, "\"dropped_events\":0") != NULL, "dropped events");
+		free(text);
+	}
+
+	// Events beyond the maximum, dropped
+	CHECK(flink_chrome_trace_start(10) == 0, "start");
+	for(i = 0; i < 25; i++) flink_read(pwm, PWM_BASE, REGISTER_WITH, &value);
+	CHECK(flink_chrome_trace_stop(file_name) == 0, "stop");
+	text = check_trace(file_name);
+	if(text) {
+		CHECK(count(text, "\"ph\":\"X\"") == 10, "%d events of 10", count(text, "\"ph\":\"X\""));
+		CHECK(strstr(text, "\"dropped_events\":15") != NULL, "dropped events");
+		free(text);
+	}
+
+	// Nothing recorded and discarded
+	CHECK(flink_chrome_trace_start(10) == 0, "start");
+	CHECK(flink_chrome_trace_stop(file_name) == 0, "stop");
+	text = check_trace(file_name);
+	if(text) {
+		CHECK(count(text, "\"ph\":\"X\"") == 0, "events without accesses");
+		free(text);
+	}
+	unlink(file_name);
+	CHECK(flink_chrome_trace_start(10) == 0 && flink_chrome_trace_stop(NULL) == 0, "discard");
+	CHECK(access(file_name, F_OK) != 0, "file written on discard");
+	CHECK(flink_chrome_trace_stop(NULL) < 0, "stopped twice");
+
+	flink_close(dev);
+	return check_result("Chrome trace test");
+}
@@ -0,0 +1,136 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, configuration test                    *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file config.c
+ *  @brief Checks configuration files applied to the simulated device sim:bench.
+ *
+ *  Applies configuration files and checks the register contents, the
+ *  number of registers written, that applying a file again writes
+ *  nothing, that registers which are not configured are never
+ *  rewritten, that the cached irq multiplexer table follows the file
+ *  and that an invalid file is reported with its line and error code
+ *  and writes nothing.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define NOF_IRQS      8
+
+static int write_file(const char* file_name, const char* content) {
+	FILE* file = fopen(file_name, "w");
+	int ok;
+
+	if(file == NULL) return -1;
+	ok = fputs(content, file) >= 0;
+	return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+int main(void) {
+	flink_dev*    dev;
+	flink_subdev* gpio;
+	flink_subdev* pwm;
+	flink_subdev* sensor;
+	flink_subdev* irq_mux;
+	char          file_name[64];
+	uint32_t      value, line, table[NOF_IRQS];
+	uint8_t       bit;
+	int           written;
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	gpio = flink_get_subdevice_by_unique_id(dev, 1);
+	pwm = flink_get_subdevice_by_unique_id(dev, 3);
+	sensor = flink_get_subdevice_by_unique_id(dev, 9);
+	irq_mux = flink_get_subdevice_by_unique_id(dev, 10);
+	snprintf(file_name, sizeof(file_name), "/tmp/flink_test_config.%d", (int)getpid());
+
+	// Configuration of several subdevices, applied twice
+	CHECK(write_file(file_name,
+		"# test configuration\n"
+		"subdevice 0x1\n"
+		"direction 0 out\n"
+		"value 0 1\n"
+		"debounce 4 100\n"
+		"subdevice 0x3\n"
+		"period 0 1000\n"
+		"hightime 0 250\n"
+		"subdevice 0x9\n"
+		"upper 1 3000\n"
+		"lower 1 1000\n") == 0, "write file");
+	written = flink_config_apply(dev, file_name, &line);
+	CHECK(written == 7, "%d registers written", written);
+	CHECK(flink_dio_get_value(gpio, 0, &bit) == 0 && bit == 1, "gpio value");
+	CHECK(flink_read(gpio, HEADER_SIZE + SUBHEADER_SIZE + REGISTER_WITH, REGISTER_WITH, &value) == REGISTER_WITH && value == 1, "gpio direction");
+	CHECK(flink_pwm_get_period(pwm, 0, &value) == 0 && value == 1000, "pwm period");
+	CHECK(flink_pwm_get_hightime(pwm, 0, &value) == 0 && value == 250, "pwm hightime");
+	CHECK(flink_read(sensor, HEADER_SIZE + SUBHEADER_SIZE + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + (flink_subdevice_get_nofchannels(sensor) + 1) * REGISTER_WITH,
+	                 REGISTER_WITH, &value) == REGISTER_WITH && value == 3000, "sensor upper level");
+	written = flink_config_apply(dev, file_name, &line);
+	CHECK(written == 0, "%d registers written again", written);
+
+	// Registers which are not configured are not rewritten to merge runs, fully configured ones are
+	CHECK(write_file(file_name,
+		"subdevice 0x1\n"
+		"direction 1 out\n"		// value register in between not configured
+		"debounce 0 7\n"
+		"subdevice 0x3\n"
+		"period 0 2000\n"
+		"period 1 0\n"			// unchanged
+		"period 2 3000\n") == 0, "write file");
+	written = flink_config_apply(dev, file_name, &line);
+	CHECK(written == 2 + 3, "%d registers written without the gpio value register", written);
+	CHECK(flink_read(gpio, HEADER_SIZE + SUBHEADER_SIZE + REGISTER_WITH, REGISTER_WITH, &value) == REGISTER_WITH && value == 3, "gpio direction");
+	CHECK(flink_dio_get_value(gpio, 0, &bit) == 0 && bit == 1, "gpio value kept");
+	CHECK(flink_pwm_get_period(pwm, 2, &value) == 0 && value == 3000, "pwm period");
+	CHECK(flink_config_apply(dev, file_name, &line) == 0, "registers written again");
+
+	// Multiplexer table written by the file, the cached table follows
+	CHECK(flink_get_irq_multiplex_table(irq_mux, table) == 0, "get irq table");
+	CHECK(write_file(file_name,
+		"subdevice 0xa\n"
+		"irq 2 5\n") == 0, "write file");
+	CHECK(flink_config_apply(dev, file_name, &line) == 1, "irq multiplexer");
+	CHECK(flink_get_irq_multiplex(irq_mux, 2, &value) == 0 && value == 5, "irq 2 routed to %u", value);
+	CHECK(flink_set_irq_multiplex_table(irq_mux, table) == 0, "restore irq table");
+	CHECK(flink_get_irq_multiplex(irq_mux, 2, &value) == 0 && value == table[2], "irq 2 not restored, cached table stale");
+
+	// Invalid file, nothing written
+	CHECK(write_file(file_name,
+		"subdevice 0x3\n"
+		"period 0 4000\n"
+		"period 9 1000\n"		// channel out of range
+		"hightime 0 1\n") == 0, "write file");
+	CHECK(flink_config_apply(dev, file_name, &line) < 0 && line == 3 && flink_get_errno() == FLINK_EINVALCHAN, "invalid channel, line %u", line);
+	CHECK(flink_pwm_get_period(pwm, 0, &value) == 0 && value == 2000, "nothing written");
+	CHECK(write_file(file_name, "period 0 4000\n") == 0, "write file");
+	CHECK(flink_config_apply(dev, file_name, NULL) < 0 && flink_get_errno() == FLINK_EINVALARG, "no subdevice selected");
+	CHECK(write_file(file_name, "subdevice 0x3\nspeed 0 1\n") == 0, "write file");
+	CHECK(flink_config_apply(dev, file_name, &line) < 0 && line == 2 && flink_get_errno() == FLINK_EINVALARG, "unknown statement, line %u", line);
+	CHECK(flink_config_apply(dev, "/nonexistent/flink.conf", &line) < 0 && line == 0, "missing file");
+
+	flink_close(dev);
+	unlink(file_name);
+	return check_result("Configuration test");
+}
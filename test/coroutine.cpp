@@ -0,0 +1,174 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, C++ coroutine test                    *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file coroutine.cpp
+ *  @brief Checks the C++ coroutine layer on the simulated device sim:bench.
+ *
+ *  Runs several coroutines accessing the PWM subdevice and checks that
+ *  the operations issued within one tick of the executor are executed
+ *  in one transaction with merged transfers, that nested tasks return
+ *  their values, that transfers are executed in the order of submission
+ *  and each of several writes to a register reaches the device, and that
+ *  failed operations throw.
+ */
+
+#include <cstdio>
+
+#include <flinklib.hpp>
+#include <flinklayout.hpp>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define PWM_BASE      (HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+#define NOF_CHANNELS  4
+
+// Sets the period of a channel and reads it back
+static flink::Task<uint32_t> set_period(flink::Subdevice pwm, uint32_t channel, uint32_t period) {
+	co_await pwm.write(PWM_BASE + channel * REGISTER_WITH, period);
+	co_return co_await pwm.read(PWM_BASE + channel * REGISTER_WITH);
+}
+
+static flink::Task<> channel(flink::Subdevice pwm, uint32_t channel, uint32_t* result) {
+	*result = co_await set_period(pwm, channel, 1000 + channel);
+}
+
+// Operations created before awaiting them are executed together
+static flink::Task<> sum_periods(flink::Subdevice pwm, uint32_t* sum) {
+	auto a = pwm.read(PWM_BASE), b = pwm.read(PWM_BASE + REGISTER_WITH);
+	auto c = pwm.read(PWM_BASE + 2 * REGISTER_WITH), d = pwm.read(PWM_BASE + 3 * REGISTER_WITH);
+	*sum = co_await a + co_await b + co_await c + co_await d;
+}
+
+static flink::Task<> bits(flink::Subdevice pwm, bool* bit) {
+	co_await pwm.write_bit(PWM_BASE, 31, true);
+	*bit = co_await pwm.read_bit(PWM_BASE, 31);
+	co_await pwm.write_bit(PWM_BASE, 31, false);
+}
+
+// Starting a move of channel 0 after setting it up, the writes must not be reordered by their offsets
+static flink::Task<> start_move(flink::Subdevice stepper) {
+	flink::layout::StepperMotor<> layout(stepper.nof_channels());
+	auto steps = stepper.write(layout.reg(0, layout.steps_to_do), 100);
+	auto start = stepper.write(layout.reg(0, layout.local_conf), 1);
+	co_await steps;
+	co_await start;
+}
+
+// Writes of contiguous registers in descending order, two of them to the same register
+static flink::Task<> write_descending(flink::Subdevice pwm) {
+	auto a = pwm.write(PWM_BASE + 2 * REGISTER_WITH, 3000), b = pwm.write(PWM_BASE + REGISTER_WITH, 2000);
+	auto c = pwm.write(PWM_BASE, 1), d = pwm.write(PWM_BASE, 1000);
+	co_await a;
+	co_await b;
+	co_await c;
+	co_await d;
+}
+
+// Two writes to the same register, both executed
+static flink::Task<> write_twice(flink::Subdevice pwm) {
+	auto a = pwm.write(PWM_BASE + REGISTER_WITH, 1), b = pwm.write(PWM_BASE + REGISTER_WITH, 2000);
+	co_await a;
+	co_await b;
+}
+
+static flink::Task<> beyond(flink::Subdevice pwm) {
+	co_await pwm.read(pwm.mem_size());
+}
+
+int main() {
+	try {
+		flink::Device dev(DESIGN);
+		flink::Subdevice pwm = dev.subdevice_by_unique_id(3);
+		flink::Executor executor;
+		uint32_t results[NOF_CHANNELS] = { }, sum = 0;
+		bool bit = false;
+
+		// The writes of all channels in one transfer, the reads in another one
+		for(uint32_t i = 0; i < NOF_CHANNELS; i++) executor.spawn(channel(pwm, i, &results[i]));
+		executor.run();
+		for(uint32_t i = 0; i < NOF_CHANNELS; i++) CHECK(results[i] == 1000 + i, "channel %u: %u", i, results[i]);
+		CHECK(executor.nof_transactions() == 2 && executor.nof_transfers() == 2, "%llu transactions, %llu transfers",
+		      (unsigned long long)executor.nof_transactions(), (unsigned long long)executor.nof_transfers());
+
+		executor.spawn(sum_periods(pwm, &sum));
+		executor.run();
+		CHECK(sum == 4006 && executor.nof_transactions() == 3 && executor.nof_transfers() == 3, "sum %u", sum);
+
+		executor.spawn(bits(pwm, &bit));
+		executor.run();
+		CHECK(bit, "bit");
+
+		// Transfers in the order of submission
+		flink::Subdevice stepper = dev.subdevice_by_unique_id(8);
+		flink::layout::StepperMotor<> layout(stepper.nof_channels());
+		flink_trace_entry entries[64];
+		flink_trace_read(entries, 64);	// discard older entries
+		flink_trace_set_level(FLINK_TRACE_ALL);
+		executor.spawn(start_move(stepper));
+		executor.run();
+		flink_trace_set_level(FLINK_TRACE_ERRORS);
+		size_t n = flink_trace_read(entries, 64), writes = 0;
+		for(size_t i = 0; i < n; i++) {
+			if(entries[i].op != FLINK_OP_WRITE_BLOCK || entries[i].subdev != stepper.id()) continue;
+			CHECK(entries[i].offset == (writes ? layout.reg(0, layout.local_conf) : layout.reg(0, layout.steps_to_do)), "write %zu at 0x%x", writes, entries[i].offset);
+			writes++;
+		}
+		CHECK(writes == 2, "%zu writes", writes);
+
+		uint64_t transfers = executor.nof_transfers();
+		executor.spawn(write_descending(pwm));
+		executor.run();
+		CHECK(executor.nof_transfers() == transfers + 2, "%llu transfers", (unsigned long long)(executor.nof_transfers() - transfers));
+		CHECK(pwm.read(PWM_BASE).await_resume() == 1000 && pwm.read(PWM_BASE + 2 * REGISTER_WITH).await_resume() == 3000, "descending writes");
+
+		// A repeated write reaches the device twice
+		flink_trace_read(entries, 64);
+		flink_trace_set_level(FLINK_TRACE_ALL);
+		executor.spawn(write_twice(pwm));
+		executor.run();
+		flink_trace_set_level(FLINK_TRACE_ERRORS);
+		n = flink_trace_read(entries, 64);
+		writes = 0;
+		for(size_t i = 0; i < n; i++) {
+			if(entries[i].op == FLINK_OP_WRITE_BLOCK && entries[i].subdev == pwm.id() && entries[i].offset == PWM_BASE + REGISTER_WITH) writes++;
+		}
+		CHECK(writes == 2, "%zu writes of the repeated register", writes);
+		CHECK(pwm.read(PWM_BASE + REGISTER_WITH).await_resume() == 2000, "last write");
+
+		// Without executor, operations are executed immediately
+		CHECK(pwm.read(PWM_BASE).await_resume() == 1000, "immediate read");
+
+		// Failures are thrown to the awaiting coroutine and from run()
+		executor.spawn(beyond(pwm));
+		try {
+			executor.run();
+			CHECK(false, "no exception");
+		}
+		catch(const flink::Error& e) {
+			CHECK(e.code() != 0, "error code");
+		}
+	}
+	catch(const std::exception& e) {
+		fprintf(stderr, "FAILED: %s\n", e.what());
+		return 1;
+	}
+	try {
+		flink::Device dev("sim:none");
+		CHECK(false, "opened unknown device");
+	}
+	catch(const flink::Error&) { }
+
+	return check_result("C++ coroutine test");
+}
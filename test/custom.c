@@ -0,0 +1,155 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, custom subdevice test                 *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file custom.c
+ *  @brief Checks custom subdevice drivers on the simulated device sim:bench.
+ *
+ *  Registers drivers describing the GPIO and PWM functions of sim:bench
+ *  and checks the accesses through the drivers against the built-in
+ *  functions, the checks of the register maps and the number of block
+ *  transfers of a plan.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define NOF_CHANNELS  4
+#define MAX_DRIVERS   16
+#define UNUSED_ID     0x100	// first function id of the drivers filling the registry
+
+static const flink_register pwm_registers[] = {
+	{ "base_clock", 0,              0,             FLINK_REG_READ  },
+	{ "period",     REGISTER_WITH,  REGISTER_WITH, FLINK_REG_RW    },
+	{ "hightime",   FLINK_REG_NEXT, REGISTER_WITH, FLINK_REG_RW    },
+};
+
+static const flink_register gpio_registers[] = {
+	{ "base_clock", 0,              0,             FLINK_REG_READ                  },
+	{ "direction",  REGISTER_WITH,  0,             FLINK_REG_RW | FLINK_REG_BITS   },
+	{ "value",      FLINK_REG_NEXT, 0,             FLINK_REG_RW | FLINK_REG_BITS   },
+	{ "debounce",   FLINK_REG_NEXT, REGISTER_WITH, FLINK_REG_RW                    },
+};
+
+static const flink_register beyond_registers[] = {
+	{ "value",      0x100,          REGISTER_WITH, FLINK_REG_READ  },
+};
+
+static const flink_register invalid_registers[] = {
+	{ "value",      2,              REGISTER_WITH, FLINK_REG_READ  },
+};
+
+int main(void) {
+	flink_dev*         dev;
+	flink_subdev*      pwm;
+	flink_subdev*      gpio;
+	flink_subdev*      counter;
+	flink_custom_plan* plan;
+	flink_driver       driver;
+	uint32_t           value, values[2 * 32 + 1], i;
+	uint8_t            bit;
+	int64_t            blocks;
+	int                base_clock, period, hightime, direction, gpio_value, debounce, regs[4];
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	pwm = flink_get_subdevice_by_unique_id(dev, 3);
+	gpio = flink_get_subdevice_by_unique_id(dev, 1);
+	counter = flink_get_subdevice_by_unique_id(dev, 2);
+
+	// Registration
+	driver = (flink_driver){ "pwm", PWM_INTERFACE_ID, 0, sizeof(pwm_registers) / sizeof(pwm_registers[0]), pwm_registers };
+	CHECK(flink_custom_register_driver(&driver) == 0, "register pwm");
+	driver = (flink_driver){ "gpio", GPIO_INTERFACE_ID, 0, sizeof(gpio_registers) / sizeof(gpio_registers[0]), gpio_registers };
+	CHECK(flink_custom_register_driver(&driver) == 0, "register gpio");
+	driver = (flink_driver){ "invalid", COUNTER_INTERFACE_ID, 0, 1, invalid_registers };
+	CHECK(flink_custom_register_driver(&driver) < 0 && flink_get_errno() == FLINK_EINVALARG, "unaligned register");
+	CHECK(flink_custom_get_register(counter, "value") < 0 && flink_get_errno() == FLINK_WRONGSUBDEVT, "no driver");
+	driver = (flink_driver){ "beyond", COUNTER_INTERFACE_ID, 0, 1, beyond_registers };
+	CHECK(flink_custom_register_driver(&driver) == 0, "register counter");
+	CHECK(flink_custom_get_register(counter, "value") < 0 && flink_get_errno() == FLINK_EINVALARG, "register beyond the subdevice");
+	CHECK(flink_custom_unregister_driver(COUNTER_INTERFACE_ID, 0) == 0, "unregister");
+	CHECK(flink_custom_unregister_driver(COUNTER_INTERFACE_ID, 0) < 0 && flink_get_errno() == FLINK_ENOTAVAIL, "unregister twice");
+
+	// Full registry, two entries are taken by the pwm and gpio drivers
+	for(i = 0; i < MAX_DRIVERS - 2; i++) {
+		driver = (flink_driver){ "unused", UNUSED_ID + i, 0, 1, pwm_registers };
+		CHECK(flink_custom_register_driver(&driver) == 0, "register driver %u", i);
+	}
+	driver = (flink_driver){ "unused", UNUSED_ID + i, 0, 1, pwm_registers };
+	CHECK(flink_custom_register_driver(&driver) < 0 && flink_get_errno() == FLINK_ENOSPACE, "register to a full registry");
+	for(i = 0; i < MAX_DRIVERS - 2; i++) CHECK(flink_custom_unregister_driver(UNUSED_ID + i, 0) == 0, "unregister driver %u", i);
+
+	base_clock = flink_custom_get_register(pwm, "base_clock");
+	period = flink_custom_get_register(pwm, "period");
+	hightime = flink_custom_get_register(pwm, "hightime");
+	direction = flink_custom_get_register(gpio, "direction");
+	gpio_value = flink_custom_get_register(gpio, "value");
+	debounce = flink_custom_get_register(gpio, "debounce");
+	CHECK(base_clock == 0 && period == 1 && hightime == 2 && direction == 1 && gpio_value == 2 && debounce == 3, "lookup");
+	CHECK(flink_custom_get_register(pwm, "duty") < 0 && flink_get_errno() == FLINK_ENOTAVAIL, "unknown register");
+
+	// Accesses against the built-in functions
+	CHECK(flink_custom_read(pwm, base_clock, 0, &value) == 0 && value == 100000000, "base clock");
+	CHECK(flink_custom_write(pwm, base_clock, 0, 1) < 0 && flink_get_errno() == FLINK_ENOTPERMITTED, "read-only register");
+	CHECK(flink_custom_read(pwm, base_clock, 1, &value) < 0, "channel of a common register");
+	CHECK(flink_custom_read(pwm, period, NOF_CHANNELS, &value) < 0 && flink_get_errno() == FLINK_EINVALCHAN, "channel out of range");
+	CHECK(flink_custom_read(pwm, 3, 0, &value) < 0 && flink_get_errno() == FLINK_EINVALARG, "unknown register index");
+	for(i = 0; i < NOF_CHANNELS; i++) {
+		CHECK(flink_custom_write(pwm, period, i, 1000 + i) == 0 && flink_pwm_get_period(pwm, i, &value) == 0 && value == 1000 + i, "period %u", i);
+		CHECK(flink_pwm_set_hightime(pwm, i, 500 + i) == 0 && flink_custom_read(pwm, hightime, i, &value) == 0 && value == 500 + i, "hightime %u", i);
+	}
+	CHECK(flink_custom_write(gpio, direction, 31, 1) == 0 && flink_custom_write(gpio, gpio_value, 31, 1) == 0, "gpio set");
+	CHECK(flink_dio_get_value(gpio, 31, &bit) == 0 && bit == 1, "gpio value");
+	CHECK(flink_dio_set_value(gpio, 31, 0) == 0 && flink_custom_read(gpio, gpio_value, 31, &value) == 0 && value == 0, "gpio get");
+	CHECK(flink_dio_set_debounce(gpio, 7, 77) == 0 && flink_custom_read(gpio, debounce, 7, &value) == 0 && value == 77, "gpio debounce");
+
+	// Plans, contiguous registers in one transfer
+	regs[0] = hightime;
+	regs[1] = period;
+	blocks = check_nof_ops(dev, FLINK_OP_READ_BLOCK);
+	plan = flink_custom_plan_create(pwm, regs, 2);
+	CHECK(plan && flink_custom_plan_get_nof_values(plan) == 2 * NOF_CHANNELS, "pwm plan");
+	CHECK(plan && flink_custom_plan_read(plan, values) == 0, "pwm plan read");
+	for(i = 0; i < NOF_CHANNELS; i++) CHECK(values[i] == 500 + i && values[NOF_CHANNELS + i] == 1000 + i, "pwm plan value %u", i);
+	if(blocks >= 0) {	// statistics enabled
+		blocks = check_nof_ops(dev, FLINK_OP_READ_BLOCK) - blocks;
+		CHECK(blocks == 1, "%lld block transfers", (long long)blocks);
+	}
+	flink_custom_plan_destroy(plan);
+
+	regs[0] = gpio_value;
+	regs[1] = base_clock;
+	regs[2] = debounce;
+	CHECK(flink_custom_write(gpio, gpio_value, 3, 1) == 0, "gpio set");
+	plan = flink_custom_plan_create(gpio, regs, 3);
+	CHECK(plan && flink_custom_plan_get_nof_values(plan) == 32 + 1 + 32, "gpio plan");
+	CHECK(plan && flink_custom_plan_read(plan, values) == 0, "gpio plan read");
+	CHECK(values[3] == 1 && values[31] == 0 && values[32] == 100000000 && values[33 + 7] == 77, "gpio plan values");
+	flink_custom_plan_destroy(plan);
+	regs[0] = period;
+	regs[1] = 3;
+	CHECK(flink_custom_plan_create(pwm, regs, 2) == NULL && flink_get_errno() == FLINK_EINVALARG, "plan with an invalid register");
+
+	flink_close(dev);
+	return check_result("Custom subdevice test");
+}
@@ -0,0 +1,165 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, process image test                    *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file image.c
+ *  @brief Checks process images shared between processes.
+ *
+ *  Publishes samples and registers of the simulated device sim:bench
+ *  and reads them back in place and as copies. Checks that samples
+ *  overwritten while they are used are detected, that only the creator
+ *  publishes and that a reader in another process never gets a torn
+ *  sample while the creator keeps publishing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define PWM_BASE      (HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+#define NOF_VALUES    4
+#define HISTORY       8
+#define NOF_SAMPLES   2000000	// published while another process reads
+
+static uint64_t now_ns(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// Publishes a sample whose values all hold its index
+static int publish(flink_image* image, uint64_t index) {
+	uint32_t values[NOF_VALUES], i;
+
+	for(i = 0; i < NOF_VALUES; i++) values[i] = (uint32_t)index;
+	return flink_image_publish(image, values);
+}
+
+// Reads the latest samples until the last one, returns the number of torn samples or -1 in case of failure
+static int read_concurrently(const char* name, int ready) {
+	flink_image* image = flink_image_open(name);
+	uint32_t values[NOF_VALUES], i;
+	uint64_t head;
+	int torn = 0, ok;
+
+	if(image == NULL) return -1;
+	if(write(ready, "r", 1) != 1) torn = -1;	// publishing starts
+	close(ready);
+	do {
+		head = flink_image_get_head(image);
+		if(head == 0 || flink_image_read(image, head - 1, values, NULL) != 0) continue;
+		ok = values[0] == (uint32_t)(head - 1);
+		for(i = 1; i < NOF_VALUES; i++) ok &= values[i] == values[0];
+		if(!ok) torn++;
+	} while(head < NOF_SAMPLES);
+	flink_image_close(image);
+	return torn;
+}
+
+int main(void) {
+	flink_dev*                dev;
+	flink_subdev*             pwm;
+	flink_image*              image;
+	flink_image*              reader;
+	const flink_image_sample* sample;
+	char                      name[64];
+	uint32_t                  values[NOF_VALUES], i;
+	uint64_t                  index, time_ns, before;
+	pid_t                     pid;
+	int                       status, ready[2];
+	char                      c;
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	pwm = flink_get_subdevice_by_unique_id(dev, 3);
+	snprintf(name, sizeof(name), "/flink_test_image.%d", (int)getpid());
+
+	CHECK(flink_image_create(name, 0, HISTORY) == NULL && flink_get_errno() == FLINK_EINVALARG, "image without values");
+	CHECK(flink_image_create(name, NOF_VALUES, 0) == NULL && flink_get_errno() == FLINK_EINVALARG, "image without history");
+	image = flink_image_create(name, NOF_VALUES, HISTORY);
+	CHECK(image != NULL, "create");
+	if(image == NULL) {
+		flink_close(dev);
+		return 1;
+	}
+	reader = flink_image_open(name);
+	CHECK(reader != NULL, "open");
+	if(reader == NULL) {
+		flink_image_close(image);
+		flink_close(dev);
+		return 1;
+	}
+	CHECK(flink_image_get_nof_values(reader) == NOF_VALUES && flink_image_get_history(reader) == HISTORY, "size of the image");
+	CHECK(flink_image_get_head(reader) == 0 && flink_image_read(reader, 0, values, NULL) < 0, "sample before publishing");
+
+	// Published values and registers
+	before = now_ns();
+	CHECK(publish(image, 0) == 0, "publish");
+	CHECK(flink_image_get_head(reader) == 1, "head");
+	CHECK(flink_image_read(reader, 0, values, &time_ns) == 0 && values[0] == 0 && values[NOF_VALUES - 1] == 0, "read");
+	CHECK(time_ns >= before && time_ns <= now_ns(), "time of the sample");
+	for(i = 0; i < NOF_VALUES; i++) CHECK(flink_pwm_set_period(pwm, i, 1000 + i) == 0, "pwm period %u", i);
+	CHECK(flink_image_publish_registers(image, pwm, PWM_BASE) == 0, "publish registers");
+	CHECK(flink_image_read(reader, 1, values, NULL) == 0 && values[0] == 1000 && values[NOF_VALUES - 1] == 1000 + NOF_VALUES - 1, "registers");
+
+	// Overwritten in place, no longer available
+	sample = flink_image_get_sample(reader, 1);
+	CHECK(sample && sample->values[1] == 1001 && flink_image_sample_valid(reader, sample, 1), "sample in place");
+	for(index = 2; index < 2 + HISTORY; index++) CHECK(publish(image, index) == 0, "publish %llu", (unsigned long long)index);
+	CHECK(sample && !flink_image_sample_valid(reader, sample, 1), "overwritten sample not detected");
+	CHECK(flink_image_get_sample(reader, 1) == NULL, "overwritten sample");
+	CHECK(flink_image_read(reader, 1, values, NULL) < 0 && flink_get_errno() == FLINK_ENOTAVAIL, "read of an overwritten sample");
+	index = flink_image_get_head(reader) - 1;
+	CHECK(flink_image_read(reader, index - (HISTORY - 1), values, NULL) == 0 && values[0] == index - (HISTORY - 1), "oldest sample kept");
+
+	// Only the creator publishes
+	CHECK(flink_image_publish(reader, values) < 0 && flink_get_errno() == FLINK_ENOTPERMITTED, "publish by a reader");
+	CHECK(flink_image_close(reader) == 0, "close reader");
+
+	// Another process reading while publishing
+	pid = pipe(ready) == 0 ? fork() : -1;
+	if(pid == 0) {
+		close(ready[0]);
+		_exit(read_concurrently(name, ready[1]) == 0 ? 0 : 1);
+	}
+	CHECK(pid > 0, "fork");
+	if(pid > 0) {
+		close(ready[1]);
+		CHECK(read(ready[0], &c, 1) == 1, "reader not ready");
+		close(ready[0]);
+	}
+	for(index = flink_image_get_head(image); pid > 0 && index < NOF_SAMPLES; index++) publish(image, index);
+	CHECK(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0, "torn samples read by another process");
+
+	// Removed with its creator
+	CHECK(flink_image_close(image) == 0, "close");
+	CHECK(flink_image_open(name) == NULL && flink_get_errno() == ENOENT, "open of a removed image");
+	CHECK(flink_image_open(NULL) == NULL && flink_get_errno() == FLINK_ENULLPTR, "open without a name");
+
+	flink_close(dev);
+	return check_result("Process image test");
+}
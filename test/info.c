@@ -0,0 +1,101 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, info and fingerprint test             *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file info.c
+ *  @brief Checks the description and the fingerprint of the simulated designs.
+ *
+ *  Reads the description of the info subdevice of sim:bench, which must
+ *  take a single block transfer and be served from the device handle
+ *  afterwards, also when the registers change. Checks that the fingerprint
+ *  stays the same for a design and across opening it again, and that
+ *  sim:baseDeviceTesting has another one.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define DESCRIPTION   "simulated register file"
+#define OTHER_DESIGN  "sim:baseDeviceTesting"
+#define DESC_BASE     (HEADER_SIZE + SUBHEADER_SIZE + REGISTER_WITH)
+
+// Returns the fingerprint of a design, 0 in case of failure
+static uint64_t design_fingerprint(const char* design) {
+	flink_dev* dev = flink_open(design);
+	uint64_t fingerprint = 0;
+
+	if(dev == NULL) return 0;
+	if(flink_get_fingerprint(dev, &fingerprint) != 0) fingerprint = 0;
+	flink_close(dev);
+	return fingerprint;
+}
+
+int main(void) {
+	flink_dev*     dev;
+	flink_subdev*  info;
+	char           desc[INFO_DESC_SIZE + 1] = { 0 }, again[INFO_DESC_SIZE + 1] = { 0 };
+	uint64_t       fingerprint = 0, second = 0, syscalls;
+	uint32_t       value;
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	info = flink_get_subdevice_by_id(dev, 0);
+	CHECK(info && flink_subdevice_get_function(info) == INFO_DEVICE_ID, "info subdevice");
+	if(info == NULL) {
+		flink_close(dev);
+		return 1;
+	}
+
+	// Description, read once with a selection and a block transfer
+	syscalls = flink_get_nof_syscalls(dev);
+	CHECK(flink_info_get_description(info, desc) == 0, "description");
+	CHECK(strcmp(desc, DESCRIPTION) == 0, "description \"%s\"", desc);
+	CHECK(flink_get_nof_syscalls(dev) - syscalls == 2, "%llu system calls to read the description",
+	      (unsigned long long)(flink_get_nof_syscalls(dev) - syscalls));
+	syscalls = flink_get_nof_syscalls(dev);
+	CHECK(flink_info_get_description(info, again) == 0 && memcmp(desc, again, INFO_DESC_SIZE) == 0, "cached description");
+	CHECK(flink_info_get_description(info, NULL) < 0, "description without buffer");
+
+	// Fingerprint, computed once
+	CHECK(flink_get_fingerprint(dev, &fingerprint) == 0 && fingerprint != 0, "fingerprint");
+	CHECK(flink_get_fingerprint(dev, &second) == 0 && second == fingerprint, "fingerprint changed");
+	CHECK(flink_get_nof_syscalls(dev) == syscalls, "%llu system calls after the description was cached",
+	      (unsigned long long)(flink_get_nof_syscalls(dev) - syscalls));
+	CHECK(flink_get_fingerprint(dev, NULL) < 0 && flink_get_fingerprint(NULL, &second) < 0, "invalid arguments");
+
+	// Registers changed behind the cache, the handle keeps the description it read
+	value = 0x41414141;
+	CHECK(flink_write(info, DESC_BASE, REGISTER_WITH, &value) == REGISTER_WITH, "write description");
+	CHECK(flink_info_get_description(info, again) == 0 && strcmp(again, DESCRIPTION) == 0, "description \"%s\" after a write", again);
+	CHECK(flink_get_fingerprint(dev, &second) == 0 && second == fingerprint, "fingerprint after a write");
+	flink_close(dev);
+
+	// Same design opened again
+	second = design_fingerprint(DESIGN);
+	CHECK(second == fingerprint, "fingerprint %llx of %s opened again, %llx before", (unsigned long long)second, DESIGN, (unsigned long long)fingerprint);
+
+	// Another design
+	second = design_fingerprint(OTHER_DESIGN);
+	CHECK(second != 0 && second != fingerprint, "fingerprint %llx of %s", (unsigned long long)second, OTHER_DESIGN);
+
+	return check_result("Info and fingerprint test");
+}
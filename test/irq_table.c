@@ -0,0 +1,145 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, irq multiplexer table test            *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file irq_table.c
+ *  @brief Checks programming the irq multiplexer table of the simulated device sim:bench.
+ *
+ *  Writes multiplexer tables and checks the registers, the readback and
+ *  that only changed runs are written, merged across small gaps. Checks
+ *  that single entries keep the cached table consistent, also when
+ *  several threads program the table at once.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define TABLE_BASE    (HEADER_SIZE + SUBHEADER_SIZE)
+#define NOF_IRQS      8
+#define NOF_ROUNDS    1000
+
+typedef struct _worker {
+	flink_subdev* irq;
+	uint32_t      channel;
+	int           errors;
+} worker;
+
+// Routes its own channel and reads the whole table back
+static void* work(void* arg) {
+	worker* w = arg;
+	uint32_t table[NOF_IRQS], i;
+
+	for(i = 0; i < NOF_ROUNDS; i++) {
+		if(flink_set_irq_multiplex(w->irq, w->channel, w->channel << 16 | i) != 0) w->errors++;
+		if(flink_get_irq_multiplex_table(w->irq, table) != 0 || table[w->channel] != (w->channel << 16 | i)) w->errors++;
+	}
+	return NULL;
+}
+
+// Programs a table and returns the number of block transfers written, -1 in case of failure
+static int set_table(flink_dev* dev, flink_subdev* irq, const uint32_t* table) {
+	uint64_t syscalls;
+	uint32_t value;
+
+	// Selected by a block transfer, each further one is a single system call
+	if(flink_read_block(irq, TABLE_BASE, REGISTER_WITH, &value) != REGISTER_WITH) return -1;
+	syscalls = flink_get_nof_syscalls(dev);
+	if(flink_set_irq_multiplex_table(irq, table) != 0) return -1;
+	return (int)(flink_get_nof_syscalls(dev) - syscalls);
+}
+
+// Checks the registers against a table
+static int registers_equal(flink_subdev* irq, const uint32_t* table) {
+	uint32_t value, i;
+
+	for(i = 0; i < NOF_IRQS; i++) {
+		if(flink_read(irq, TABLE_BASE + i * REGISTER_WITH, REGISTER_WITH, &value) != REGISTER_WITH || value != table[i]) return 0;
+	}
+	return 1;
+}
+
+int main(void) {
+	flink_dev*    dev;
+	flink_subdev* irq;
+	pthread_t     threads[NOF_IRQS];
+	worker        workers[NOF_IRQS];
+	uint32_t      table[NOF_IRQS] = { 0 }, readback[NOF_IRQS], value, i;
+	int           n;
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	irq = flink_get_subdevice_by_unique_id(dev, 10);
+	CHECK(irq && flink_subdevice_get_nofchannels(irq) == NOF_IRQS, "irq multiplexer");
+	if(irq == NULL) {
+		flink_close(dev);
+		return 1;
+	}
+
+	// Readback of the reset state, nothing to write
+	CHECK(flink_get_irq_multiplex_table(irq, readback) == 0 && memcmp(readback, table, sizeof(table)) == 0, "reset table");
+	CHECK(set_table(dev, irq, table) == 0, "unchanged table written");
+
+	// Changed runs, merged across up to two unchanged entries
+	table[1] = 11;
+	table[2] = 12;
+	CHECK((n = set_table(dev, irq, table)) == 1, "%d transfers of a run", n);
+	table[0] = 20;
+	table[3] = 23;
+	CHECK((n = set_table(dev, irq, table)) == 1, "%d transfers of a run with a gap of two", n);
+	table[0] = 30;
+	table[4] = 34;
+	table[7] = 37;
+	CHECK((n = set_table(dev, irq, table)) == 2, "%d transfers of runs with gaps of three and two", n);
+	CHECK(registers_equal(irq, table), "registers");
+	CHECK(flink_get_irq_multiplex_table(irq, readback) == 0 && memcmp(readback, table, sizeof(table)) == 0, "readback");
+
+	// Single entries update the cached table
+	table[5] = 45;
+	CHECK(flink_set_irq_multiplex(irq, 5, table[5]) == 0, "single entry");
+	CHECK(set_table(dev, irq, table) == 0, "table written after a single entry");
+
+	// Registers changed behind the cache are read back
+	value = 99;
+	CHECK(flink_write(irq, TABLE_BASE + 7 * REGISTER_WITH, REGISTER_WITH, &value) == REGISTER_WITH, "write register");
+	CHECK(flink_get_irq_multiplex_table(irq, readback) == 0 && readback[7] == 99, "readback of a register changed behind the cache");
+	CHECK((n = set_table(dev, irq, table)) == 1 && registers_equal(irq, table), "%d transfers restoring the register", n);
+
+	// Threads programming their own entry, the cached table must follow
+	for(i = 0; i < NOF_IRQS; i++) {
+		workers[i] = (worker){ irq, i, 0 };
+		pthread_create(&threads[i], NULL, work, &workers[i]);
+	}
+	for(i = 0; i < NOF_IRQS; i++) {
+		pthread_join(threads[i], NULL);
+		CHECK(workers[i].errors == 0, "thread %u: %d errors", i, workers[i].errors);
+		table[i] = i << 16 | (NOF_ROUNDS - 1);
+	}
+	CHECK(registers_equal(irq, table), "registers after the threads");
+	CHECK(set_table(dev, irq, table) == 0, "cached table differs from the registers");
+
+	// Invalid arguments
+	CHECK(flink_set_irq_multiplex_table(irq, NULL) < 0 && flink_get_irq_multiplex_table(irq, NULL) < 0, "table without buffer");
+
+	flink_close(dev);
+	return check_result("Irq multiplexer table test");
+}
@@ -0,0 +1,201 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, C++ register layout test              *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file layout.cpp
+ *  @brief Checks the C++ register layouts against the C functions on the simulated device sim:bench.
+ *
+ *  The simulated device is a plain register file: a value set by a C
+ *  function must be found at the offset of the layout and a value
+ *  written to the offset of the layout must be returned by the C
+ *  function. The compile-time layouts are checked against the dynamic
+ *  ones built from the number of channels of the subdevices. Registers
+ *  handled by the models of sim:bench are checked by their effect: the
+ *  reset bits, the atomic set and reset registers of the stepper motor
+ *  and the steps done of a channel run for a few accesses. The inputs
+ *  of the reflective sensor change with every access, a value read at
+ *  the offset of the layout must be close to the one of the C function.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <flinklayout.hpp>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN         "sim:bench"
+#define STEPPER_START  (1 << 5)	// start bit of the local config register
+#define SENSOR_SLOPE   50		// change of a sensor input of sim:bench during an access at most
+
+using namespace flink::layout;
+
+static uint32_t get(flink_subdev* subdev, uint32_t offset) {
+	uint32_t value = 0xdeadbeef;
+	flink_read(subdev, offset, REGISTER_WITH, &value);
+	return value;
+}
+
+static void put(flink_subdev* subdev, uint32_t offset, uint32_t value) {
+	CHECK(flink_write(subdev, offset, REGISTER_WITH, &value) == REGISTER_WITH, "write at 0x%x", offset);
+}
+
+static bool get_bit(flink_subdev* subdev, Bit bit) {
+	return get(subdev, bit.offset) >> bit.bit & 1;
+}
+
+// Offsets resolved at compile time for the channels of sim:bench
+static_assert(Gpio<32>{}.debounce(31) == 0x20 + 4 * (1 + 2 + 31), "gpio");
+static_assert(StepperMotor<4>{}.reg(3, StepperMotor<4>::steps_done) + REGISTER_WITH <= 0x100, "stepper motor");
+
+int main() {
+	flink_dev*    dev;
+	flink_subdev* subdev;
+	uint32_t      value, n, ch, regs[INFO_DESC_SIZE / REGISTER_WITH];
+	uint8_t       bit;
+	char          desc[INFO_DESC_SIZE], raw_desc[INFO_DESC_SIZE];
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+
+	// Header
+	for(uint8_t id = 0; id < flink_get_nof_subdevices(dev); id++) {
+		subdev = flink_get_subdevice_by_id(dev, id);
+		CHECK(get(subdev, Header::type()) >> 16 == flink_subdevice_get_function(subdev), "subdevice %u: type", id);
+		CHECK(get(subdev, Header::mem_size()) == flink_subdevice_get_memsize(subdev), "subdevice %u: mem size", id);
+		CHECK(get(subdev, Header::nof_channels()) == flink_subdevice_get_nofchannels(subdev), "subdevice %u: nof channels", id);
+		CHECK(get(subdev, Header::unique_id()) == flink_subdevice_get_unique_id(subdev), "subdevice %u: unique id", id);
+	}
+
+	// Info, first character in the most significant byte of a register
+	subdev = flink_get_subdevice_by_unique_id(dev, 0);
+	CHECK(flink_info_get_description(subdev, desc) == 0, "description");
+	CHECK(flink_read_block(subdev, Info::description(), Info::description_size(), regs) == Info::description_size(), "raw description");
+	for(uint32_t i = 0; i < INFO_DESC_SIZE; i++) raw_desc[i] = (char)(regs[i / REGISTER_WITH] >> (8 * (REGISTER_WITH - 1 - i % REGISTER_WITH)));
+	CHECK(memcmp(desc, raw_desc, INFO_DESC_SIZE) == 0, "info description");
+
+	// GPIO
+	subdev = flink_get_subdevice_by_unique_id(dev, 1);
+	n = flink_subdevice_get_nofchannels(subdev);
+	Gpio<> gpio(n);
+	CHECK(gpio.debounce(n - 1) == Gpio<32>{}.debounce(31) && gpio.value(5).offset == Gpio<32>{}.value(5).offset, "gpio compile-time layout");
+	CHECK(flink_dio_get_baseclock(subdev, &value) == 0 && value == get(subdev, gpio.base_clock()), "gpio base clock");
+	for(ch = 0; ch < n; ch += 7) {
+		CHECK(flink_dio_set_direction(subdev, ch, FLINK_OUTPUT) == 0 && get_bit(subdev, gpio.direction(ch)), "gpio %u direction", ch);
+		CHECK(flink_dio_set_value(subdev, ch, 1) == 0 && get_bit(subdev, gpio.value(ch)), "gpio %u value", ch);
+		CHECK(flink_dio_set_value(subdev, ch, 0) == 0 && !get_bit(subdev, gpio.value(ch)), "gpio %u value", ch);
+		CHECK(flink_dio_set_debounce(subdev, ch, 100 + ch) == 0 && get(subdev, gpio.debounce(ch)) == 100 + ch, "gpio %u debounce", ch);
+	}
+
+	// Counter
+	subdev = flink_get_subdevice_by_unique_id(dev, 2);
+	Counter<> counter(flink_subdevice_get_nofchannels(subdev));
+	for(ch = 0; ch < counter.nof_channels(); ch++) {
+		put(subdev, counter.count(ch), 200 + ch);
+		CHECK(flink_counter_get_count(subdev, ch, &value) == 0 && value == 200 + ch, "counter %u", ch);
+	}
+
+	// PWM
+	subdev = flink_get_subdevice_by_unique_id(dev, 3);
+	Pwm<> pwm(flink_subdevice_get_nofchannels(subdev));
+	CHECK(pwm.hightime(3) == Pwm<4>{}.hightime(3), "pwm compile-time layout");
+	CHECK(flink_pwm_get_baseclock(subdev, &value) == 0 && value == get(subdev, pwm.base_clock()), "pwm base clock");
+	for(ch = 0; ch < pwm.nof_channels(); ch++) {
+		CHECK(flink_pwm_set_period(subdev, ch, 300 + ch) == 0 && get(subdev, pwm.period(ch)) == 300 + ch, "pwm %u period", ch);
+		CHECK(flink_pwm_set_hightime(subdev, ch, 400 + ch) == 0 && get(subdev, pwm.hightime(ch)) == 400 + ch, "pwm %u hightime", ch);
+	}
+
+	// PPWA
+	subdev = flink_get_subdevice_by_unique_id(dev, 4);
+	Ppwa<> ppwa(flink_subdevice_get_nofchannels(subdev));
+	put(subdev, ppwa.base_clock(), 12345);
+	CHECK(flink_ppwa_get_baseclock(subdev, &value) == 0 && value == 12345, "ppwa base clock");
+	for(ch = 0; ch < ppwa.nof_channels(); ch++) {
+		put(subdev, ppwa.period(ch), 500 + ch);
+		put(subdev, ppwa.hightime(ch), 600 + ch);
+		CHECK(flink_ppwa_get_period(subdev, ch, &value) == 0 && value == 500 + ch, "ppwa %u period", ch);
+		CHECK(flink_ppwa_get_hightime(subdev, ch, &value) == 0 && value == 600 + ch, "ppwa %u hightime", ch);
+	}
+
+	// Analog input and output
+	subdev = flink_get_subdevice_by_unique_id(dev, 5);
+	CHECK(flink_analog_in_get_resolution(subdev, &value) == 0 && value == get(subdev, AnalogInput<>::resolution()), "ain resolution");
+	for(ch = 0; ch < flink_subdevice_get_nofchannels(subdev); ch++) {
+		put(subdev, AnalogInput<4>::value(ch), 700 + ch);
+		CHECK(flink_analog_in_get_value(subdev, ch, &value) == 0 && value == 700 + ch, "ain %u", ch);
+	}
+	subdev = flink_get_subdevice_by_unique_id(dev, 6);
+	CHECK(flink_analog_out_get_resolution(subdev, &value) == 0 && value == get(subdev, AnalogOutput<>::resolution()), "aout resolution");
+	for(ch = 0; ch < flink_subdevice_get_nofchannels(subdev); ch++) {
+		CHECK(flink_analog_out_set_value(subdev, ch, 800 + ch) == 0 && get(subdev, AnalogOutput<4>::value(ch)) == 800 + ch, "aout %u", ch);
+	}
+
+	// Watchdog
+	subdev = flink_get_subdevice_by_unique_id(dev, 7);
+	put(subdev, Watchdog::base_clock(), 54321);
+	CHECK(flink_wd_get_baseclock(subdev, &value) == 0 && value == 54321, "wd base clock");
+	CHECK(flink_wd_set_counter(subdev, 900) == 0 && get(subdev, Watchdog::counter()) == 900, "wd counter");
+	CHECK(flink_wd_arm(subdev) == 0 && get(subdev, Watchdog::counter()) == 0, "wd arm");	// same bit as the reset of the simulated subdevice
+	put(subdev, Watchdog::status().offset, 1u << Watchdog::status().bit);
+	CHECK(flink_wd_get_status(subdev, &bit) == 0 && bit == 1, "wd status");
+
+	// Stepper motor
+	subdev = flink_get_subdevice_by_unique_id(dev, 8);
+	StepperMotor<> stepper(flink_subdevice_get_nofchannels(subdev));
+	using Reg = StepperMotor<>::Register;
+	CHECK(flink_stepperMotor_get_baseclock(subdev, &value) == 0 && value == get(subdev, stepper.base_clock()), "stepper base clock");
+	for(ch = 0; ch < stepper.nof_channels(); ch++) {
+		CHECK(flink_stepperMotor_set_local_config_reg(subdev, ch, 0x10 + ch) == 0 && get(subdev, stepper.reg(ch, Reg::local_conf)) == 0x10 + ch, "stepper %u config", ch);
+		CHECK(flink_stepperMotor_set_prescaler_start(subdev, ch, 0x40 + ch) == 0 && get(subdev, stepper.reg(ch, Reg::prescaler_start)) == 0x40 + ch, "stepper %u prescaler start", ch);
+		CHECK(flink_stepperMotor_set_prescaler_top(subdev, ch, 0x50 + ch) == 0 && get(subdev, stepper.reg(ch, Reg::prescaler_top)) == 0x50 + ch, "stepper %u prescaler top", ch);
+		CHECK(flink_stepperMotor_set_acceleration(subdev, ch, 0x60 + ch) == 0 && get(subdev, stepper.reg(ch, Reg::acceleration)) == 0x60 + ch, "stepper %u acceleration", ch);
+		CHECK(flink_stepperMotor_set_steps_to_do(subdev, ch, 0x70 + ch) == 0 && get(subdev, stepper.reg(ch, Reg::steps_to_do)) == 0x70 + ch, "stepper %u steps to do", ch);
+		CHECK(flink_stepperMotor_set_local_config_reg_bits_atomic(subdev, ch, STEPPER_START) == 0 &&
+		      get(subdev, stepper.reg(ch, Reg::local_conf)) == ((0x10 + ch) | STEPPER_START), "stepper %u set", ch);
+		CHECK(flink_stepperMotor_reset_local_config_reg_bits_atomic(subdev, ch, STEPPER_START) == 0 &&
+		      get(subdev, stepper.reg(ch, Reg::local_conf)) == 0x10 + ch, "stepper %u reset", ch);
+		CHECK(flink_stepperMotor_get_steps_have_done(subdev, ch, &value) == 0 && value > 0 && value == get(subdev, stepper.reg(ch, Reg::steps_done)),
+		      "stepper %u steps done", ch);
+	}
+	CHECK(flink_steppermotor_global_step_reset(subdev) == 0 && !get_bit(subdev, stepper.global_step_reset()) &&
+	      get(subdev, stepper.reg(0, Reg::steps_done)) == 0, "stepper global reset");
+
+	// Reflective sensor
+	subdev = flink_get_subdevice_by_unique_id(dev, 9);
+	ReflectiveSensor<> sensor(flink_subdevice_get_nofchannels(subdev));
+	CHECK(flink_reflectivesensor_get_resolution(subdev, &value) == 0 && value == get(subdev, sensor.resolution()), "sensor resolution");
+	for(ch = 0; ch < sensor.nof_channels(); ch++) {
+		n = get(subdev, sensor.value(ch));
+		CHECK(flink_reflectivesensor_get_value(subdev, ch, &value) == 0 && std::abs((int)value - (int)n) <= SENSOR_SLOPE, "sensor %u value", ch);
+		CHECK(flink_reflectivesensor_set_upper_level_int(subdev, ch, 1100 + ch) == 0 && get(subdev, sensor.upper_level(ch)) == 1100 + ch, "sensor %u upper level", ch);
+		CHECK(flink_reflectivesensor_set_lower_level_int(subdev, ch, 1200 + ch) == 0 && get(subdev, sensor.lower_level(ch)) == 1200 + ch, "sensor %u lower level", ch);
+	}
+
+	// Interrupt multiplexer
+	subdev = flink_get_subdevice_by_unique_id(dev, 10);
+	IrqMultiplexer<> irqmux(flink_subdevice_get_nofchannels(subdev));
+	for(ch = 0; ch < irqmux.nof_channels(); ch++) {
+		CHECK(flink_set_irq_multiplex(subdev, ch, 7 - ch) == 0 && get(subdev, irqmux.entry(ch)) == 7 - ch, "irq multiplexer %u", ch);
+	}
+
+	// Reset bit of the header, cleared by the simulated subdevice together with its registers
+	CHECK(flink_subdevice_reset(subdev) == 0 && !get_bit(subdev, Header::reset()) && get(subdev, irqmux.entry(1)) == 0, "reset");
+
+	flink_close(dev);
+	return check_result("C++ register layout test");
+}
@@ -0,0 +1,321 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, performance regression test           *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file perf_gate.c
+ *  @brief Checks the cost of hot paths against a budget file.
+ *
+ *  Counts the system calls, the bytes transferred to and from the
+ *  register file and the user space instructions per operation of a
+ *  hot path. System calls and bytes don't depend on the host, so they
+ *  must not exceed their budget at all. Bytes are only counted on
+ *  simulated devices. Instructions are counted where the hardware
+ *  performance counters are accessible and may exceed their budget by
+ *  the tolerance. A path of which no budget can be checked is skipped
+ *  with exit status 77 instead of passing.
+ *
+ *  Budget file lines: <path> <syscalls/op> <bytes/op> <instructions/op>,
+ *  where a value of '-' disables the check. Lines starting with '#' are
+ *  comments. Option -u prints the measured values in this format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#define DEFAULT_DEV        "sim:bench"
+#define DEFAULT_ITERATIONS 10000
+#define DEFAULT_TOLERANCE  10		// percent, instructions only
+#define NO_BUDGET          -1.0
+#define EXIT_SKIP          77		// SKIP_RETURN_CODE of the ctest entries
+
+typedef struct _perf_path {
+	const char* name;
+	uint16_t    function_id;
+	int (*run)(flink_subdev* subdev, uint32_t* buf);
+} perf_path;
+
+typedef struct _perf_budget {
+	double syscalls;
+	double bytes;
+	double instructions;
+} perf_budget;
+
+static int run_read(flink_subdev* subdev, uint32_t* buf) {
+	return flink_read(subdev, STATUS_OFFSET, REGISTER_WITH, buf) == REGISTER_WITH ? 0 : -1;
+}
+
+static int run_write(flink_subdev* subdev, uint32_t* buf) {
+	return flink_write(subdev, HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET, REGISTER_WITH, buf) == REGISTER_WITH ? 0 : -1;
+}
+
+static int run_dio_set_value(flink_subdev* subdev, uint32_t* buf) {
+	return flink_dio_set_value(subdev, 0, 1);
+}
+
+static int run_dio_get_value(flink_subdev* subdev, uint32_t* buf) {
+	return flink_dio_get_value(subdev, 0, (uint8_t*)buf);
+}
+
+static int run_pwm_set_period(flink_subdev* subdev, uint32_t* buf) {
+	return flink_pwm_set_period(subdev, 0, 1000);
+}
+
+static int run_read_block(flink_subdev* subdev, uint32_t* buf) {
+	return flink_read_block(subdev, 0, HEADER_SIZE + SUBHEADER_SIZE, buf) == HEADER_SIZE + SUBHEADER_SIZE ? 0 : -1;
+}
+
+static int run_sensor_get_values(flink_subdev* subdev, uint32_t* buf) {
+	return flink_reflectivesensor_get_values(subdev, buf);
+}
+
+static const perf_path paths[] = {
+	{ "read",              PWM_INTERFACE_ID,    run_read },
+	{ "write",             PWM_INTERFACE_ID,    run_write },
+	{ "dio_set_value",     GPIO_INTERFACE_ID,   run_dio_set_value },
+	{ "dio_get_value",     GPIO_INTERFACE_ID,   run_dio_get_value },
+	{ "pwm_set_period",    PWM_INTERFACE_ID,    run_pwm_set_period },
+	{ "read_block",        PWM_INTERFACE_ID,    run_read_block },
+	{ "sensor_get_values", SENSOR_INTERFACE_ID, run_sensor_get_values },
+};
+#define NOF_PATHS (sizeof(paths) / sizeof(paths[0]))
+
+/**
+ * @brief Opens a counter for the user space instructions of this thread.
+ * @return int: File descriptor of the counter, -1 if not available.
+ */
+static int open_instruction_counter(void) {
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static double parse_budget(const char* value) {
+	return strcmp(value, "-") ? strtod(value, NULL) : NO_BUDGET;
+}
+
+/**
+ * @brief Looks up the budget of a path.
+ * @return int: 0 on success, -1 if the budget file can't be read or has no entry for the path.
+ */
+static int read_budget(const char* file_name, const char* path, perf_budget* budget) {
+	char line[256], name[64], sc[32], bytes[32], ins[32];
+	FILE* file = fopen(file_name, "r");
+	int found = 0;
+
+	if(file == NULL) {
+		perror(file_name);
+		return -1;
+	}
+	while(!found && fgets(line, sizeof(line), file)) {
+		if(line[0] == '#' || sscanf(line, "%63s %31s %31s %31s", name, sc, bytes, ins) != 4) continue;
+		if(strcmp(name, path) != 0) continue;
+		budget->syscalls = parse_budget(sc);
+		budget->bytes = parse_budget(bytes);
+		budget->instructions = parse_budget(ins);
+		found = 1;
+	}
+	fclose(file);
+	if(!found) fprintf(stderr, "No budget for path %s in %s.\n", path, file_name);
+	return found ? 0 : -1;
+}
+
+/**
+ * @brief Compares a measurement with its budget.
+ * @return int: 1 if checked, 0 if there is no budget or measurement, -1 if the budget is exceeded.
+ */
+static int check(const char* what, double measured, double budget, double tolerance) {
+	if(measured == NO_BUDGET) {
+		printf("  %-14s not measurable on this host\n", what);
+		return 0;
+	}
+	if(budget == NO_BUDGET) {
+		printf("  %-14s %10.2f/op (no budget)\n", what, measured);
+		return 0;
+	}
+	if(measured > budget * (1.0 + tolerance / 100.0)) {
+		if(tolerance > 0) printf("  %-14s %10.2f/op exceeds budget %.2f by more than %.0f%%\n", what, measured, budget, tolerance);
+		else printf("  %-14s %10.2f/op exceeds budget %.2f\n", what, measured, budget);
+		return -1;
+	}
+	printf("  %-14s %10.2f/op (budget %.2f)\n", what, measured, budget);
+	return 1;
+}
+
+static void print_value(double value, const char* format) {
+	if(value == NO_BUDGET) printf(" %8s", "-");
+	else printf(format, value);
+}
+
+int main(int argc, char* argv[]) {
+	const char* dev_name = DEFAULT_DEV;
+	const char* budget_file = NULL;
+	const char* only = NULL;
+	uint32_t iterations = DEFAULT_ITERATIONS, i;
+	double tolerance = DEFAULT_TOLERANCE;
+	double syscalls, bytes, instructions;
+	perf_budget budget;
+	uint64_t sc0, bytes0, bytes1, nof_instructions;
+	int update = 0, counter, ran = 0, checked = 0, error = 0;
+	uint32_t* buf;
+	flink_dev* dev;
+	flink_subdev* subdev;
+	size_t k;
+	int c, s, n, r;
+
+	/* Compute command line arguments */
+	while((c = getopt(argc, argv, "d:b:t:p:n:u")) != -1) {
+		switch(c) {
+			case 'd': // device
+				dev_name = optarg;
+				break;
+			case 'b': // budget file
+				budget_file = optarg;
+				break;
+			case 't': // tolerance of instructions in percent
+				tolerance = strtod(optarg, NULL);
+				break;
+			case 'p': // only this path
+				only = optarg;
+				break;
+			case 'n': // iterations
+				iterations = strtoul(optarg, NULL, 0);
+				break;
+			case 'u': // print measurements as budget file
+				update = 1;
+				break;
+			case '?':
+				if(strchr("dbtpn", optopt)) fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+				else if(isprint(optopt)) fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+				return -1;
+			default:
+				abort();
+		}
+	}
+	if((budget_file == NULL && !update) || iterations == 0) {
+		fprintf(stderr, "Usage: %s -b budget_file [-d device] [-t tolerance] [-p path] [-n iterations] [-u]\n", argv[0]);
+		return -1;
+	}
+
+	dev = flink_open(dev_name);
+	if(dev == NULL) {
+		fprintf(stderr, "Failed to open device %s!\n", dev_name);
+		return -1;
+	}
+	counter = open_instruction_counter();
+	if(counter < 0 && !update) printf("Instruction counter not available.\n");
+	if(update) printf("# path syscalls/op bytes/op instructions/op, measured on %s\n", dev_name);
+
+	for(k = 0; k < NOF_PATHS; k++) {
+		if(only && strcmp(only, paths[k].name) != 0) continue;
+		ran = 1;
+
+		subdev = NULL;
+		n = flink_get_nof_subdevices(dev);
+		for(s = 0; s < n && subdev == NULL; s++) {
+			if(flink_subdevice_get_function(flink_get_subdevice_by_id(dev, s)) == paths[k].function_id) subdev = flink_get_subdevice_by_id(dev, s);
+		}
+		if(subdev == NULL) {
+			fprintf(stderr, "Device %s has no subdevice for path %s!\n", dev_name, paths[k].name);
+			error = 1;
+			continue;
+		}
+		buf = calloc(1, flink_subdevice_get_memsize(subdev));
+		if(buf == NULL) {
+			perror("calloc");
+			return -1;
+		}
+
+		// Warm up, then measure
+		for(i = 0; i < iterations / 10 + 1; i++) paths[k].run(subdev, buf);
+		sc0 = flink_get_nof_syscalls(dev);
+		bytes0 = 0;
+		if(flink_sim_get_nof_bytes(dev, &bytes0) != 0) bytes0 = UINT64_MAX;	// not a simulated device
+		if(counter >= 0) {
+			ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+			ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+		}
+		for(i = 0; i < iterations; i++) {
+			if(paths[k].run(subdev, buf) < 0) break;
+		}
+		if(counter >= 0) ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+		syscalls = (double)(flink_get_nof_syscalls(dev) - sc0) / iterations;
+		bytes = NO_BUDGET;
+		if(bytes0 != UINT64_MAX && flink_sim_get_nof_bytes(dev, &bytes1) == 0) bytes = (double)(bytes1 - bytes0) / iterations;
+		free(buf);
+		if(i < iterations) {
+			fprintf(stderr, "Path %s failed!\n", paths[k].name);
+			error = 1;
+			continue;
+		}
+
+		instructions = NO_BUDGET;
+		if(counter >= 0 && read(counter, &nof_instructions, sizeof(nof_instructions)) == sizeof(nof_instructions)) {
+			instructions = (double)nof_instructions / iterations;
+		}
+
+		if(update) {
+			printf("%-20s", paths[k].name);
+			print_value(syscalls, " %8.2f");
+			print_value(bytes, " %8.2f");
+			print_value(instructions, " %8.0f");
+			printf("\n");
+			continue;
+		}
+
+		printf("%s:\n", paths[k].name);
+		if(read_budget(budget_file, paths[k].name, &budget) < 0) {
+			error = 1;
+			continue;
+		}
+		r = check("syscalls", syscalls, budget.syscalls, 0);
+		if(r < 0) error = 1;
+		else checked += r;
+		r = check("bytes", bytes, budget.bytes, 0);
+		if(r < 0) error = 1;
+		else checked += r;
+		r = check("instructions", instructions, budget.instructions, tolerance);
+		if(r < 0) error = 1;
+		else checked += r;
+	}
+
+	if(!ran) {
+		fprintf(stderr, "Unknown path %s!\n", only);
+		error = 1;
+	}
+	if(counter >= 0) close(counter);
+	flink_close(dev);
+	if(error) return EXIT_FAILURE;
+	if(!update && checked == 0) {
+		printf("Skipped: no budget can be checked on %s on this host.\n", dev_name);
+		return EXIT_SKIP;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, reflective sensor test                *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file reflective_sensor.c
+ *  @brief Checks the block transfers and the calibration of the reflective sensor of sim:bench.
+ *
+ *  The inputs of the simulated sensor follow a triangle wave between
+ *  a dark and a bright value of each channel. Checks that the levels
+ *  of all channels are set and read in one transfer each, and that
+ *  the calibration places the levels around the middle of the range
+ *  of each channel, separated by the requested hysteresis.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define NOF_CHANNELS  4
+#define SAMPLES       1000
+#define HYSTERESIS    20		// percent of the range
+
+// Dark and bright value of each input of the model
+static const uint32_t dark[NOF_CHANNELS]   = {  400,  600,  300, 1000 };
+static const uint32_t bright[NOF_CHANNELS] = { 3600, 3000, 4000, 2000 };
+
+int main(void) {
+	flink_dev*    dev;
+	flink_subdev* sensor;
+	uint32_t      upper[NOF_CHANNELS], lower[NOF_CHANNELS], up[NOF_CHANNELS], low[NOF_CHANNELS], values[NOF_CHANNELS];
+	uint32_t      ch, value, range, band;
+	uint64_t      syscalls;
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	sensor = flink_get_subdevice_by_unique_id(dev, 9);
+	CHECK(flink_subdevice_get_nofchannels(sensor) == NOF_CHANNELS, "%u channels", flink_subdevice_get_nofchannels(sensor));
+	CHECK(flink_reflectivesensor_get_resolution(sensor, &value) == 0 && value == 4096, "resolution %u", value);
+
+	// Invalid arguments
+	CHECK(flink_read_block(sensor, 0, 4, NULL) < 0 && flink_get_errno() == FLINK_ENULLPTR, "block read without buffer");
+	CHECK(flink_read_block(sensor, 0x080, 4, &value) < 0, "block read beyond the subdevice");
+	CHECK(flink_reflectivesensor_set_levels(sensor, NULL, lower) < 0 && flink_get_errno() == FLINK_ENULLPTR, "set levels without upper levels");
+	CHECK(flink_reflectivesensor_calibrate(sensor, 0, 0, HYSTERESIS, NULL, NULL) < 0 && flink_get_errno() == FLINK_EINVALARG, "calibrate without samples");
+	CHECK(flink_reflectivesensor_calibrate(sensor, SAMPLES, 0, 101, NULL, NULL) < 0 && flink_get_errno() == FLINK_EINVALARG, "hysteresis above 100%%");
+
+	// Levels of all channels in one transfer each, the selection is kept
+	for(ch = 0; ch < NOF_CHANNELS; ch++) {
+		upper[ch] = 3000 + ch;
+		lower[ch] = 1000 + ch;
+	}
+	syscalls = flink_get_nof_syscalls(dev);
+	CHECK(flink_reflectivesensor_set_levels(sensor, upper, lower) == 0, "set levels");
+	CHECK(flink_get_nof_syscalls(dev) - syscalls <= 2, "set levels: %llu system calls", (unsigned long long)(flink_get_nof_syscalls(dev) - syscalls));
+	syscalls = flink_get_nof_syscalls(dev);
+	CHECK(flink_reflectivesensor_get_levels(sensor, up, low) == 0, "get levels");
+	CHECK(flink_get_nof_syscalls(dev) - syscalls == 1, "get levels: %llu system calls", (unsigned long long)(flink_get_nof_syscalls(dev) - syscalls));
+	for(ch = 0; ch < NOF_CHANNELS; ch++) {
+		CHECK(up[ch] == upper[ch] && low[ch] == lower[ch], "channel %u: levels %u/%u", ch, low[ch], up[ch]);
+		CHECK(flink_reflectivesensor_get_upper_level_int(sensor, ch, &value) == 0 && value == upper[ch], "channel %u: upper level %u", ch, value);
+		CHECK(flink_reflectivesensor_get_lower_level_int(sensor, ch, &value) == 0 && value == lower[ch], "channel %u: lower level %u", ch, value);
+	}
+
+	// Values of all channels
+	CHECK(flink_reflectivesensor_get_values(sensor, values) == 0, "get values");
+	for(ch = 0; ch < NOF_CHANNELS; ch++) {
+		CHECK(values[ch] >= dark[ch] && values[ch] <= bright[ch], "channel %u: value %u out of range", ch, values[ch]);
+	}
+
+	// Calibration, 5th and 95th percentile of a uniform distribution
+	CHECK(flink_reflectivesensor_calibrate(sensor, SAMPLES, 0, HYSTERESIS, upper, lower) == 0, "calibrate");
+	CHECK(flink_reflectivesensor_get_levels(sensor, up, low) == 0, "get calibrated levels");
+	for(ch = 0; ch < NOF_CHANNELS; ch++) {
+		range = bright[ch] - dark[ch];
+		band = range * 90 / 100 * HYSTERESIS / 100;
+		CHECK(up[ch] == upper[ch] && low[ch] == lower[ch], "channel %u: levels %u/%u not programmed", ch, lower[ch], upper[ch]);
+		CHECK(abs((int)(upper[ch] + lower[ch]) / 2 - (int)(dark[ch] + bright[ch]) / 2) <= (int)range / 100,
+		      "channel %u: levels %u/%u not around the middle", ch, lower[ch], upper[ch]);
+		CHECK(abs((int)(upper[ch] - lower[ch]) - (int)band) <= (int)range / 50,
+		      "channel %u: hysteresis %u, expected %u", ch, upper[ch] - lower[ch], band);
+	}
+
+	flink_close(dev);
+	return check_result("Reflective sensor test");
+}
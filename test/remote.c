@@ -0,0 +1,245 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, remote device test                    *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file remote.c
+ *  @brief Checks remote devices against a simulated device served by flinkd.
+ *
+ *  Starts flinkd on a temporary socket with the simulated device
+ *  sim:bench and compares the subdevices seen by a client with a local
+ *  instance of the design. Then checks all kinds of register accesses,
+ *  concurrent accesses of several threads and clients, malformed and
+ *  pipelined requests of a raw client and the shutdown of the daemon.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define NOF_THREADS   4
+#define NOF_ROUNDS    2000
+#define PWM_BASE      (HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+#define NOF_PIPELINED 20000	// block reads of a client not reading its responses meanwhile, more than MAX_OUTPUT of flinkd
+
+typedef struct _worker {
+	flink_dev* dev;
+	uint32_t   channel;
+	int        errors;
+} worker;
+
+// Each thread writes its own PWM channel and reads all channels in one block
+static void* work(void* arg) {
+	worker* w = arg;
+	flink_subdev* pwm = flink_get_subdevice_by_unique_id(w->dev, 3);
+	uint32_t i, value, regs[NOF_THREADS];
+
+	for(i = 0; i < NOF_ROUNDS; i++) {
+		value = w->channel << 24 | i;
+		if(flink_write(pwm, PWM_BASE + w->channel * REGISTER_WITH, REGISTER_WITH, &value) != REGISTER_WITH) w->errors++;
+		if(flink_read_block(pwm, PWM_BASE, sizeof(regs), regs) != sizeof(regs) || regs[w->channel] != value) w->errors++;
+	}
+	return NULL;
+}
+
+// Raw connection to the daemon, bypassing the checks of the library
+static int connect_raw(const char* socket_name) {
+	struct sockaddr_un addr;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_name, sizeof(addr.sun_path) - 1);
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int send_request(int fd, uint32_t id, uint8_t cmd, uint8_t subdev, uint32_t offset, uint32_t size) {
+	flink_remote_request r = { id, cmd, subdev, 0, 0, offset, size };
+	return send(fd, &r, sizeof(r), MSG_NOSIGNAL) == sizeof(r) ? 0 : -1;
+}
+
+// Receives a response, its data is discarded
+static int receive_response(int fd, flink_remote_response* resp) {
+	static uint8_t data[FLINK_REMOTE_MAX_SIZE];
+	if(recv(fd, resp, sizeof(*resp), MSG_WAITALL) != sizeof(*resp) || resp->size > sizeof(data)) return -1;
+	if(resp->size && recv(fd, data, resp->size, MSG_WAITALL) != (ssize_t)resp->size) return -1;
+	return 0;
+}
+
+static flink_dev* connect_daemon(const char* name) {
+	flink_dev* dev = NULL;
+	int i;
+
+	for(i = 0; i < 200 && dev == NULL; i++) {	// wait for the daemon to listen
+		dev = flink_open(name);
+		if(dev == NULL) usleep(10000);
+	}
+	return dev;
+}
+
+int main(int argc, char* argv[]) {
+	flink_dev*    local;
+	flink_dev*    dev;
+	flink_dev*    dev2;
+	flink_subdev* a;
+	flink_subdev* b;
+	flink_remote_response resp;
+	pthread_t     threads[NOF_THREADS];
+	worker        workers[NOF_THREADS];
+	char          socket_name[64];
+	char          dev_name[160];
+	char*         daemon = NULL;
+	uint32_t      regs[8], value, i;
+	uint8_t       bit;
+	pid_t         pid;
+	int           status, fd;
+
+	int c;
+	while((c = getopt(argc, argv, "x:")) != -1) {
+		switch(c) {
+			case 'x': // flinkd executable
+				daemon = optarg;
+				break;
+			case '?':
+				if(optopt == 'x') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+				else if(isprint(optopt)) fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+				return -1;
+			default:
+				abort();
+		}
+	}
+	if(daemon == NULL) {
+		fprintf(stderr, "Usage: %s -x flinkd\n", argv[0]);
+		return -1;
+	}
+
+	snprintf(socket_name, sizeof(socket_name), "/tmp/flink_test_remote.%d", (int)getpid());
+	snprintf(dev_name, sizeof(dev_name), "%s%s", FLINK_REMOTE_PREFIX, socket_name);
+	pid = fork();
+	if(pid == 0) {
+		execl(daemon, daemon, "-d", DESIGN, "-s", socket_name, (char*)NULL);
+		_exit(127);
+	}
+
+	local = flink_open(DESIGN);
+	dev = connect_daemon(dev_name);
+	if(local == NULL || dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s or %s\n", DESIGN, dev_name);
+		kill(pid, SIGTERM);
+		return 1;
+	}
+
+	// Socket name longer than a socket address holds
+	snprintf(dev_name, sizeof(dev_name), "%s/tmp/%0120d", FLINK_REMOTE_PREFIX, 0);
+	CHECK(flink_open(dev_name) == NULL && flink_get_errno() == FLINK_EINVALDEV, "socket name too long");
+	snprintf(dev_name, sizeof(dev_name), "%s%s", FLINK_REMOTE_PREFIX, socket_name);
+
+	// Same subdevices as a local instance
+	CHECK(flink_get_nof_subdevices(dev) == flink_get_nof_subdevices(local), "nof subdevices");
+	for(i = 0; i < (uint32_t)flink_get_nof_subdevices(local); i++) {
+		a = flink_get_subdevice_by_id(local, i);
+		b = flink_get_subdevice_by_id(dev, i);
+		CHECK(b && flink_subdevice_get_function(a) == flink_subdevice_get_function(b) &&
+		      flink_subdevice_get_memsize(a) == flink_subdevice_get_memsize(b) &&
+		      flink_subdevice_get_baseaddr(a) == flink_subdevice_get_baseaddr(b) &&
+		      flink_subdevice_get_nofchannels(a) == flink_subdevice_get_nofchannels(b) &&
+		      flink_subdevice_get_unique_id(a) == flink_subdevice_get_unique_id(b), "subdevice %u differs", i);
+	}
+
+	// Register accesses
+	b = flink_get_subdevice_by_unique_id(dev, 3);
+	value = 12345;
+	CHECK(flink_write(b, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH, "write");
+	value = 0;
+	CHECK(flink_read(b, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH && value == 12345, "read");
+	for(i = 0; i < 8; i++) regs[i] = i * 3;
+	CHECK(flink_write_block(b, PWM_BASE, sizeof(regs), regs) == sizeof(regs), "write block");
+	memset(regs, 0, sizeof(regs));
+	CHECK(flink_read_block(b, PWM_BASE, sizeof(regs), regs) == sizeof(regs) && regs[7] == 21, "read block");
+	CHECK(flink_pwm_set_period(b, 1, 999) == 0 && flink_pwm_get_period(b, 1, &value) == 0 && value == 999, "pwm period");
+	bit = 1;
+	CHECK(flink_write_bit(b, PWM_BASE, 31, &bit) == 0, "write bit");
+	bit = 0;
+	CHECK(flink_read_bit(b, PWM_BASE, 31, &bit) == 0 && bit == 1, "read bit");
+	CHECK(flink_read(b, flink_subdevice_get_memsize(b), REGISTER_WITH, &value) < 0, "read beyond the subdevice");
+	CHECK(flink_register_irq(dev, 0) < 0, "interrupts are not supported remotely");
+
+	// Threads sharing a connection and a second client
+	dev2 = connect_daemon(dev_name);
+	CHECK(dev2 != NULL, "second client");
+	for(i = 0; i < NOF_THREADS; i++) {
+		workers[i].dev = i % 2 || dev2 == NULL ? dev : dev2;
+		workers[i].channel = i;
+		workers[i].errors = 0;
+		pthread_create(&threads[i], NULL, work, &workers[i]);
+	}
+	for(i = 0; i < NOF_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		CHECK(workers[i].errors == 0, "%d errors in thread %u", workers[i].errors, i);
+	}
+	if(dev2) flink_close(dev2);
+
+	// Malformed requests are answered with an error, the daemon keeps serving
+	fd = connect_raw(socket_name);
+	CHECK(fd >= 0, "raw client");
+	if(fd >= 0) {
+		value = flink_get_nof_subdevices(local);
+		CHECK(send_request(fd, 1, FLINK_REMOTE_READ, value, PWM_BASE, REGISTER_WITH) == 0 && receive_response(fd, &resp) == 0 &&
+		      resp.id == 1 && resp.result == -EINVAL, "subdevice id == nof subdevices");
+		CHECK(send_request(fd, 2, FLINK_REMOTE_READ_BIT, UINT8_MAX, 0, 0) == 0 && receive_response(fd, &resp) == 0 &&
+		      resp.id == 2 && resp.result == -EINVAL, "subdevice id out of range");
+
+		// Pipelined block reads are all answered, although the responses are not read meanwhile
+		a = flink_get_subdevice_by_unique_id(dev, 1);
+		for(i = 0; i < NOF_PIPELINED; i++) {
+			if(send_request(fd, 100 + i, FLINK_REMOTE_READ_BLOCK, flink_subdevice_get_id(a), 0, flink_subdevice_get_memsize(a)) < 0) break;
+		}
+		CHECK(i == NOF_PIPELINED, "pipelined requests");
+		CHECK(flink_read(b, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH, "other client while responses are pending");
+		for(i = 0; i < NOF_PIPELINED; i++) {
+			if(receive_response(fd, &resp) < 0 || resp.id != 100 + i || resp.result != (int32_t)flink_subdevice_get_memsize(a)) break;
+		}
+		CHECK(i == NOF_PIPELINED, "%u of %u pipelined responses", i, NOF_PIPELINED);
+		close(fd);
+	}
+	CHECK(flink_read(b, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH, "daemon alive");
+	flink_close(dev);
+	flink_close(local);
+
+	// Shutdown removes the socket
+	kill(pid, SIGTERM);
+	CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0, "daemon exit");
+	CHECK(access(socket_name, F_OK) < 0, "socket removed");
+
+	return check_result("Remote device test");
+}
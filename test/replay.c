@@ -0,0 +1,198 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, record and replay test                *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file replay.c
+ *  @brief Records accesses of several threads and replays them with flinkreplay.
+ *
+ *  Records the accesses of several threads to the simulated device
+ *  sim:bench, whose entries are not in order of their start, and
+ *  appends an entry started before the first one. The recording must
+ *  replay in original timing, sped up, without waiting for the entry out of
+ *  order. Recordings with an entry of an invalid subdevice or with a
+ *  device entry whose size doesn't match its subdevices must be rejected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define NOF_THREADS   4
+#define NOF_ROUNDS    500
+#define PWM_BASE      (HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+#define TIMEOUT       20	// s, replaying must not wait for an entry out of order
+
+typedef struct _worker {
+	flink_dev* dev;
+	uint32_t   channel;
+	int        errors;
+} worker;
+
+// Each thread writes its own PWM channel and reads it back
+static void* work(void* arg) {
+	worker* w = arg;
+	flink_subdev* pwm = flink_get_subdevice_by_unique_id(w->dev, 3);
+	uint32_t i, value;
+
+	for(i = 0; i < NOF_ROUNDS; i++) {
+		value = w->channel << 24 | i;
+		if(flink_write(pwm, PWM_BASE + w->channel * REGISTER_WITH, REGISTER_WITH, &value) != REGISTER_WITH) w->errors++;
+		if(flink_read(pwm, PWM_BASE + w->channel * REGISTER_WITH, REGISTER_WITH, &value) != REGISTER_WITH) w->errors++;
+	}
+	return NULL;
+}
+
+// Appends an entry with size bytes of zeros to a recording
+static int append(const char* file_name, const flink_record_entry* e) {
+	uint8_t data[64] = { 0 };
+	FILE* file;
+	int ok;
+
+	file = fopen(file_name, "ab");
+	if(file == NULL) return -1;
+	ok = fwrite(e, sizeof(*e), 1, file) == 1 && (e->size == 0 || fwrite(data, e->size, 1, file) == 1);
+	return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+// Appends a read of a PWM period to a recording
+static int append_entry(const char* file_name, uint64_t time_ns, uint8_t subdev) {
+	flink_record_entry e;
+
+	memset(&e, 0, sizeof(e));
+	e.time_ns = time_ns;
+	e.offset = PWM_BASE;
+	e.size = REGISTER_WITH;
+	e.op = FLINK_OP_READ;
+	e.subdev = subdev;
+	return append(file_name, &e);
+}
+
+// Appends an entry announcing a device with nof_subdevices subdevices and size bytes of function ids
+static int append_device(const char* file_name, uint8_t nof_subdevices, uint32_t size) {
+	flink_record_entry e;
+
+	memset(&e, 0, sizeof(e));
+	e.size = size;
+	e.op = FLINK_RECORD_OP_DEVICE;
+	e.subdev = nof_subdevices;
+	return append(file_name, &e);
+}
+
+// Replays a recording in original timing sped up by a factor of 2, returns the exit status of flinkreplay or -1 if it was killed
+static int replay(const char* replayer, const char* file_name) {
+	pid_t pid;
+	int status, fd;
+
+	pid = fork();
+	if(pid == 0) {
+		fd = open("/dev/null", O_WRONLY);
+		if(fd >= 0) dup2(fd, STDOUT_FILENO);
+		alarm(TIMEOUT);
+		execl(replayer, replayer, "-d", DESIGN, "-f", file_name, "-s", "2", (char*)NULL);
+		_exit(127);
+	}
+	if(pid < 0 || waitpid(pid, &status, 0) != pid) return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int main(int argc, char* argv[]) {
+	flink_dev*    dev;
+	pthread_t     threads[NOF_THREADS];
+	worker        workers[NOF_THREADS];
+	char          file_name[64];
+	char*         replayer = NULL;
+	uint32_t      i;
+	int           status;
+	struct stat   st;
+	off_t         size = 0;
+
+	int c;
+	while((c = getopt(argc, argv, "x:")) != -1) {
+		switch(c) {
+			case 'x': // flinkreplay executable
+				replayer = optarg;
+				break;
+			case '?':
+				if(optopt == 'x') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+				else if(isprint(optopt)) fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+				return -1;
+			default:
+				abort();
+		}
+	}
+	if(replayer == NULL) {
+		fprintf(stderr, "Usage: %s -x flinkreplay\n", argv[0]);
+		return -1;
+	}
+	snprintf(file_name, sizeof(file_name), "/tmp/flink_test_replay.%d", (int)getpid());
+
+	// Record several threads, the first access starts some time after the start of the recording
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	CHECK(flink_record_stop() < 0 && flink_get_errno() == FLINK_EINVALARG, "stop without start");
+	if(flink_record_start(file_name) != 0) {
+		fprintf(stderr, "FAILED: can't record to %s\n", file_name);
+		flink_close(dev);
+		return 1;
+	}
+	CHECK(flink_record_start(file_name) < 0 && flink_get_errno() == FLINK_EBUSY, "started twice");
+	usleep(10000);
+	for(i = 0; i < NOF_THREADS; i++) {
+		workers[i] = (worker){ dev, i, 0 };
+		pthread_create(&threads[i], NULL, work, &workers[i]);
+	}
+	for(i = 0; i < NOF_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		CHECK(workers[i].errors == 0, "thread %u: %d errors", i, workers[i].errors);
+	}
+	CHECK(flink_record_stop() == 0, "record stop");
+
+	// Entry started before the first one
+	CHECK(append_entry(file_name, 0, 3) == 0, "append entry out of order");
+	status = replay(replayer, file_name);
+	CHECK(status == 0, "replay of entries out of order, exit status %d", status);
+	CHECK(stat(file_name, &st) == 0, "size of %s", file_name);
+	size = st.st_size;
+
+	// Device entry of more subdevices than function ids
+	CHECK(append_device(file_name, 4, 2 * sizeof(uint16_t)) == 0, "append invalid device entry");
+	status = replay(replayer, file_name);
+	CHECK(status > 0, "replay of an invalid device entry, exit status %d", status);
+
+	// Entry of a subdevice the device does not have
+	if(truncate(file_name, size) != 0) CHECK(0, "truncate %s", file_name);
+	CHECK(append_entry(file_name, 0, flink_get_nof_subdevices(dev)) == 0, "append entry of an invalid subdevice");
+	status = replay(replayer, file_name);
+	CHECK(status > 0, "replay of an invalid subdevice, exit status %d", status);
+
+	flink_close(dev);
+	unlink(file_name);
+	return check_result("Record and replay test");
+}
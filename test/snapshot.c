@@ -0,0 +1,125 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, snapshot test                         *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file snapshot.c
+ *  @brief Checks saving and restoring the state of the simulated device sim:bench.
+ *
+ *  Saves a snapshot, modifies the device and restores the snapshot.
+ *  Checks the restored registers, the number of registers written, the
+ *  order of the GPIO writes (values before directions) and that invalid
+ *  snapshots, and snapshots of another design, are rejected without
+ *  writing anything.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define OTHER_DESIGN  "sim:baseDeviceTesting"
+#define GPIO_BASE     (HEADER_SIZE + SUBHEADER_SIZE)
+#define MAX_ENTRIES   256
+
+int main(void) {
+	flink_dev*        dev;
+	flink_dev*        other;
+	flink_subdev*     gpio;
+	flink_subdev*     pwm;
+	flink_trace_entry entries[MAX_ENTRIES];
+	void*             snapshot = NULL;
+	uint8_t*          copy;
+	size_t            size = 0, n, i;
+	uint32_t          value;
+	uint8_t           bit;
+	int               written, direction_write = -1, value_write = -1;
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	gpio = flink_get_subdevice_by_unique_id(dev, 1);
+	pwm = flink_get_subdevice_by_unique_id(dev, 3);
+
+	// State to save, GPIO 5 an output driving high
+	CHECK(flink_dio_set_direction(gpio, 5, FLINK_OUTPUT) == 0 && flink_dio_set_value(gpio, 5, 1) == 0, "gpio set");
+	CHECK(flink_dio_set_debounce(gpio, 2, 20) == 0, "gpio debounce");
+	CHECK(flink_pwm_set_period(pwm, 1, 1000) == 0 && flink_pwm_set_hightime(pwm, 1, 400) == 0, "pwm set");
+	CHECK(flink_snapshot_save(dev, &snapshot, &size) == 0 && snapshot && size > 0, "save");
+	if(snapshot == NULL) {
+		flink_close(dev);
+		return 1;
+	}
+
+	// Invalid arguments
+	CHECK(flink_snapshot_save(dev, NULL, &size) < 0 && flink_get_errno() == FLINK_ENULLPTR, "save without buffer");
+	CHECK(flink_snapshot_restore(dev, NULL, size) < 0 && flink_get_errno() == FLINK_ENULLPTR, "restore without snapshot");
+
+	// Nothing to restore on the unmodified device
+	CHECK(flink_snapshot_restore(dev, snapshot, size) == 0, "restore unmodified");
+
+	// Modify, GPIO 5 an input now
+	CHECK(flink_dio_set_value(gpio, 5, 0) == 0 && flink_dio_set_direction(gpio, 5, FLINK_INPUT) == 0, "gpio modify");
+	CHECK(flink_dio_set_debounce(gpio, 2, 0) == 0, "gpio debounce modify");
+	CHECK(flink_pwm_set_hightime(pwm, 1, 100) == 0, "pwm modify");
+
+	flink_trace_read(entries, MAX_ENTRIES);	// discard older entries
+	flink_trace_set_level(FLINK_TRACE_ALL);
+	written = flink_snapshot_restore(dev, snapshot, size);
+	flink_trace_set_level(FLINK_TRACE_ERRORS);
+	CHECK(written == 6, "%d registers restored", written);	// direction, value merged with debounce 0 to 2, hightime
+	CHECK(flink_dio_get_value(gpio, 5, &bit) == 0 && bit == 1, "gpio value restored");
+	CHECK(flink_read(gpio, GPIO_BASE + REGISTER_WITH, REGISTER_WITH, &value) == REGISTER_WITH && (value & 1u << 5), "gpio direction restored");
+	CHECK(flink_pwm_get_hightime(pwm, 1, &value) == 0 && value == 400, "pwm hightime restored");
+	CHECK(flink_pwm_get_period(pwm, 1, &value) == 0 && value == 1000, "pwm period kept");
+
+	// The GPIO value is written before the direction
+	n = flink_trace_read(entries, MAX_ENTRIES);
+	for(i = 0; i < n; i++) {
+		if(entries[i].subdev != flink_subdevice_get_id(gpio) || (entries[i].op != FLINK_OP_WRITE_BLOCK && entries[i].op != FLINK_OP_WRITE)) continue;
+		if(entries[i].offset == GPIO_BASE + REGISTER_WITH && direction_write < 0) direction_write = i;
+		if(entries[i].offset == GPIO_BASE + 2 * REGISTER_WITH && value_write < 0) value_write = i;
+	}
+	CHECK(value_write >= 0 && direction_write > value_write, "gpio value written at %d, direction at %d", value_write, direction_write);
+	CHECK(flink_snapshot_restore(dev, snapshot, size) == 0, "restore again");
+
+	// Invalid snapshots
+	CHECK(flink_snapshot_restore(dev, snapshot, size / 2) < 0 && flink_get_errno() == FLINK_EINVALARG, "truncated snapshot");
+	copy = malloc(size);
+	if(copy) {
+		memcpy(copy, snapshot, size);
+		copy[0] ^= 0xFF;
+		CHECK(flink_snapshot_restore(dev, copy, size) < 0 && flink_get_errno() == FLINK_EINVALARG, "invalid magic");
+		free(copy);
+	}
+	CHECK(flink_dio_set_direction(gpio, 5, FLINK_INPUT) == 0, "gpio modify");
+	CHECK(flink_snapshot_restore(dev, snapshot, sizeof(uint32_t)) < 0 && flink_get_errno() == FLINK_EINVALARG, "too small");
+	CHECK(flink_read(gpio, GPIO_BASE + REGISTER_WITH, REGISTER_WITH, &value) == REGISTER_WITH && !(value & 1u << 5), "nothing written");
+
+	other = flink_open(OTHER_DESIGN);
+	CHECK(other != NULL, "can't open %s", OTHER_DESIGN);
+	if(other) {
+		CHECK(flink_snapshot_restore(other, snapshot, size) < 0 && flink_get_errno() == FLINK_EINVALARG, "snapshot of another design");
+		flink_close(other);
+	}
+
+	free(snapshot);
+	flink_close(dev);
+	return check_result("Snapshot test");
+}
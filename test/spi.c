@@ -0,0 +1,204 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, SPI transport test                    *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file spi.c
+ *  @brief Checks the SPI transport against a model of the device.
+ *
+ *  The model is registered as SPI endpoint and decodes the frames of
+ *  each message into accesses of an in-memory address space holding an
+ *  info, a GPIO and a PWM subdevice. Checks the enumeration of the
+ *  subdevices, all kinds of register accesses and that block transfers
+ *  are split into bursts packed into as few messages as possible, and
+ *  the errors of registering endpoints.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define ENDPOINT      "model"
+#define MEM_SIZE      0x400
+#define MAX_MESSAGE   128
+#define MAX_BURST     32
+#define GPIO_ADDR     0x40
+#define PWM_ADDR      0x140
+#define PWM_BASE      (HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+
+typedef struct _model {
+	uint8_t  mem[MEM_SIZE];
+	uint32_t nof_messages;
+	uint32_t nof_frames;
+} model;
+
+static uint32_t get_word(const uint8_t* p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put_word(uint8_t* p, uint32_t value) {
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
+
+static void put_header(model* m, uint32_t addr, uint16_t function, uint32_t mem_size, uint32_t nof_channels, uint32_t unique_id) {
+	put_word(m->mem + addr, (uint32_t)function << 16 | 1);
+	put_word(m->mem + addr + 4, mem_size);
+	put_word(m->mem + addr + 8, nof_channels);
+	put_word(m->mem + addr + 12, unique_id);
+}
+
+// Decodes the frames of a message like the SPI slave of the FPGA
+static int message(void* data, const flink_spi_frame* frames, uint32_t nof_frames) {
+	model* m = data;
+	uint32_t i, cmd, addr, size, total = 0;
+
+	m->nof_messages++;
+	for(i = 0; i < nof_frames; i++) {
+		total += frames[i].len;
+		if(frames[i].len < FLINK_SPI_HEADER_SIZE || total > MAX_MESSAGE) {
+			errno = EMSGSIZE;
+			return -1;
+		}
+		m->nof_frames++;
+		cmd = get_word(frames[i].tx);
+		addr = get_word(frames[i].tx + 4);
+		size = cmd & ~FLINK_SPI_WRITE;
+		if(size > MAX_BURST || addr > MEM_SIZE || size > MEM_SIZE - addr) {
+			errno = EIO;
+			return -1;
+		}
+		if(cmd & FLINK_SPI_WRITE) {
+			if(frames[i].len != FLINK_SPI_HEADER_SIZE + size) {
+				errno = EPROTO;
+				return -1;
+			}
+			memcpy(m->mem + addr, frames[i].tx + FLINK_SPI_HEADER_SIZE, size);
+		}
+		else {
+			if(frames[i].rx == NULL || frames[i].len != FLINK_SPI_HEADER_SIZE + FLINK_SPI_TURNAROUND + size) {
+				errno = EPROTO;
+				return -1;
+			}
+			memset(frames[i].rx, 0, FLINK_SPI_HEADER_SIZE + FLINK_SPI_TURNAROUND);
+			memcpy(frames[i].rx + FLINK_SPI_HEADER_SIZE + FLINK_SPI_TURNAROUND, m->mem + addr, size);
+		}
+	}
+	return 0;
+}
+
+int main(void) {
+	static model       m;
+	flink_spi_endpoint endpoint = { message, &m, MAX_MESSAGE, MAX_BURST };
+	flink_spi_endpoint invalid = { NULL, &m, MAX_MESSAGE, MAX_BURST };
+	char               name[64];
+	flink_dev*         dev;
+	flink_subdev*      gpio;
+	flink_subdev*      pwm;
+	uint32_t           regs[48], value, i, nof_messages, nof_frames;
+	int                ret;
+	uint8_t            bit;
+
+	put_header(&m, 0, INFO_DEVICE_ID, GPIO_ADDR, 0, 0);
+	put_header(&m, GPIO_ADDR, GPIO_INTERFACE_ID, PWM_ADDR - GPIO_ADDR, 32, 1);
+	put_header(&m, PWM_ADDR, PWM_INTERFACE_ID, 0x80, 4, 3);
+	put_word(m.mem + PWM_ADDR + HEADER_SIZE + SUBHEADER_SIZE + PWM_BASECLK_OFFSET, 100000000);
+
+	CHECK(flink_spi_register_endpoint(ENDPOINT, &endpoint) == 0, "register endpoint");
+	dev = flink_open(FLINK_SPI_PREFIX ENDPOINT);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", FLINK_SPI_PREFIX ENDPOINT);
+		return 1;
+	}
+
+	// Enumeration
+	CHECK(flink_get_nof_subdevices(dev) == 3, "nof subdevices");
+	gpio = flink_get_subdevice_by_unique_id(dev, 1);
+	pwm = flink_get_subdevice_by_unique_id(dev, 3);
+	CHECK(gpio && flink_subdevice_get_function(gpio) == GPIO_INTERFACE_ID && flink_subdevice_get_baseaddr(gpio) == GPIO_ADDR &&
+	      flink_subdevice_get_memsize(gpio) == PWM_ADDR - GPIO_ADDR && flink_subdevice_get_nofchannels(gpio) == 32, "gpio subdevice");
+	CHECK(pwm && flink_subdevice_get_function(pwm) == PWM_INTERFACE_ID && flink_subdevice_get_baseaddr(pwm) == PWM_ADDR &&
+	      flink_subdevice_get_nofchannels(pwm) == 4, "pwm subdevice");
+	if(gpio == NULL || pwm == NULL) return 1;
+
+	// Register accesses
+	value = 12345;
+	CHECK(flink_write(pwm, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH && get_word(m.mem + PWM_ADDR + PWM_BASE) == 12345, "write");
+	value = 0;
+	CHECK(flink_read(pwm, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH && value == 12345, "read");
+	CHECK(flink_pwm_set_period(pwm, 2, 999) == 0 && flink_pwm_get_period(pwm, 2, &value) == 0 && value == 999, "pwm period");
+	CHECK(flink_pwm_get_baseclock(pwm, &value) == 0 && value == 100000000, "pwm base clock");
+	bit = 1;
+	CHECK(flink_write_bit(pwm, PWM_BASE, 31, &bit) == 0 && get_word(m.mem + PWM_ADDR + PWM_BASE) == (12345 | 1u << 31), "write bit");
+	bit = 0;
+	CHECK(flink_read_bit(pwm, PWM_BASE, 31, &bit) == 0 && bit == 1, "read bit");
+	CHECK(flink_dio_set_direction(gpio, 5, FLINK_OUTPUT) == 0 && flink_dio_set_value(gpio, 5, 1) == 0, "gpio set");
+	bit = 0;
+	CHECK(flink_dio_get_value(gpio, 5, &bit) == 0 && bit == 1, "gpio get");
+	CHECK(flink_read(pwm, flink_subdevice_get_memsize(pwm), REGISTER_WITH, &value) < 0, "read beyond the subdevice");
+	CHECK(flink_register_irq(dev, 0) < 0, "interrupts are not supported");
+
+	// A block takes a single frame as long as it fits into a message
+	for(i = 0; i < 8; i++) regs[i] = i * 3;
+	nof_messages = m.nof_messages;
+	CHECK(flink_write_block(pwm, PWM_BASE, 8 * REGISTER_WITH, regs) == 8 * REGISTER_WITH, "write block");
+	memset(regs, 0, sizeof(regs));
+	CHECK(flink_read_block(pwm, PWM_BASE, 8 * REGISTER_WITH, regs) == 8 * REGISTER_WITH && regs[7] == 21, "read block");
+	CHECK(m.nof_messages - nof_messages == 2, "%u messages for two blocks", m.nof_messages - nof_messages);
+
+	// Larger blocks are split into bursts filling up the messages
+	for(i = 0; i < 48; i++) regs[i] = i;
+	nof_messages = m.nof_messages;
+	nof_frames = m.nof_frames;
+	CHECK(flink_write_block(gpio, HEADER_SIZE + SUBHEADER_SIZE, sizeof(regs), regs) == sizeof(regs), "write large block");
+	CHECK(m.nof_messages - nof_messages == 2 && m.nof_frames - nof_frames == 6, "%u messages with %u frames for a large write",
+	      m.nof_messages - nof_messages, m.nof_frames - nof_frames);
+	memset(regs, 0, sizeof(regs));
+	nof_messages = m.nof_messages;
+	nof_frames = m.nof_frames;
+	CHECK(flink_read_block(gpio, HEADER_SIZE + SUBHEADER_SIZE, sizeof(regs), regs) == sizeof(regs) && regs[0] == 0 && regs[47] == 47, "read large block");
+	CHECK(m.nof_messages - nof_messages == 3 && m.nof_frames - nof_frames == 7, "%u messages with %u frames for a large read",
+	      m.nof_messages - nof_messages, m.nof_frames - nof_frames);
+	CHECK(flink_read_block(gpio, HEADER_SIZE + SUBHEADER_SIZE, flink_subdevice_get_memsize(gpio), regs) < 0, "block beyond the subdevice");
+
+	flink_close(dev);
+
+	// Unknown endpoints are taken as spidev device files
+	CHECK(flink_spi_register_endpoint(ENDPOINT, NULL) == 0, "remove endpoint");
+	CHECK(flink_open(FLINK_SPI_PREFIX ENDPOINT) == NULL, "removed endpoint");
+
+	// Invalid endpoints, a limited number of them
+	CHECK(flink_spi_register_endpoint(NULL, &endpoint) < 0 && flink_get_errno() == FLINK_ENULLPTR, "endpoint without name");
+	CHECK(flink_spi_register_endpoint(ENDPOINT, &invalid) < 0 && flink_get_errno() == FLINK_EINVALARG, "endpoint without message function");
+	memset(name, 'x', sizeof(name) - 1);
+	name[sizeof(name) - 1] = '\0';
+	CHECK(flink_spi_register_endpoint(name, &endpoint) < 0 && flink_get_errno() == FLINK_EINVALARG, "endpoint name too long");
+	for(i = 0, ret = 0; i < 64 && ret == 0; i++) {
+		snprintf(name, sizeof(name), ENDPOINT "%u", i);
+		ret = flink_spi_register_endpoint(name, &endpoint);
+	}
+	CHECK(ret < 0 && flink_get_errno() == FLINK_ENOSPACE, "%u endpoints registered", i);
+	while(i--) {
+		snprintf(name, sizeof(name), ENDPOINT "%u", i);
+		flink_spi_register_endpoint(name, NULL);
+	}
+
+	return check_result("SPI transport test");
+}
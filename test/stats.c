@@ -0,0 +1,183 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, statistics test                       *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file stats.c
+ *  @brief Checks the operation statistics of the simulated device sim:bench.
+ *
+ *  Counts accesses of the main thread and of a second thread per
+ *  operation and per subdevice, checks the errors, the latency
+ *  histograms and that a reset starts a new epoch for all threads,
+ *  including a thread which recorded before the reset. If the library
+ *  was built without statistics, both calls must fail.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define PWM_BASE      (HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+#define NOF_READS     100
+#define NOF_WRITES    50
+
+typedef struct _worker {
+	flink_subdev*   pwm;
+	int             reads;
+	int             errors;
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+	int             round;		// rounds requested by the main thread
+	int             done;		// rounds finished by the worker
+} worker;
+
+// Reads a PWM period per round, waits for the main thread in between
+static void* work(void* arg) {
+	worker* w = arg;
+	uint32_t value;
+	int round, i;
+
+	for(round = 1; round <= 2; round++) {
+		pthread_mutex_lock(&w->lock);
+		while(w->round < round) pthread_cond_wait(&w->cond, &w->lock);
+		pthread_mutex_unlock(&w->lock);
+		for(i = 0; i < w->reads; i++) {
+			if(flink_read(w->pwm, PWM_BASE, REGISTER_WITH, &value) != REGISTER_WITH) w->errors++;
+		}
+		pthread_mutex_lock(&w->lock);
+		w->done = round;
+		pthread_cond_broadcast(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+	}
+	return NULL;
+}
+
+// Lets the worker run a round and waits for it
+static void run_round(worker* w, int round) {
+	pthread_mutex_lock(&w->lock);
+	w->round = round;
+	pthread_cond_broadcast(&w->cond);
+	while(w->done < round) pthread_cond_wait(&w->cond, &w->lock);
+	pthread_mutex_unlock(&w->lock);
+}
+
+// Checks the sums of a histogram and the latencies against the count
+static void check_latencies(const flink_op_stats* s, const char* name) {
+	uint64_t sum = 0;
+	int i;
+
+	for(i = 0; i < FLINK_STATS_BUCKETS; i++) sum += s->histogram[i];
+	CHECK(sum == s->count, "%s: histogram sums to %llu of %llu", name, (unsigned long long)sum, (unsigned long long)s->count);
+	CHECK(s->max_ns <= s->total_ns, "%s: maximum latency above the total", name);
+	CHECK(s->count == 0 || s->total_ns > 0, "%s: no latency", name);
+}
+
+int main(void) {
+	flink_dev*     dev;
+	flink_subdev*  pwm;
+	flink_subdev*  gpio;
+	flink_op_stats ops[FLINK_NOF_OPS];
+	flink_op_stats* subdevices;
+	pthread_t      thread;
+	worker         w;
+	uint32_t       value;
+	uint8_t        nof_subdevices, pwm_id, gpio_id;
+	int            i;
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	pwm = flink_get_subdevice_by_unique_id(dev, 3);
+	gpio = flink_get_subdevice_by_unique_id(dev, 1);
+	pwm_id = flink_subdevice_get_id(pwm);
+	gpio_id = flink_subdevice_get_id(gpio);
+	nof_subdevices = flink_get_nof_subdevices(dev);
+	subdevices = calloc(nof_subdevices, sizeof(flink_op_stats));
+	if(subdevices == NULL) {
+		flink_close(dev);
+		return 1;
+	}
+
+	if(flink_stats_snapshot(dev, ops, subdevices) != 0) {	// statistics compiled out
+		CHECK(flink_stats_reset(dev) != 0, "reset without statistics");
+		free(subdevices);
+		flink_close(dev);
+		return check_result("Statistics test without statistics");
+	}
+	CHECK(ops[FLINK_OP_DEVICE_INFO].count > 0, "device info read at open not counted");
+
+	// Counts of the main thread since the reset
+	CHECK(flink_stats_reset(dev) == 0, "reset");
+	for(i = 0; i < NOF_READS; i++) CHECK(flink_read(pwm, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH, "read %d", i);
+	for(i = 0; i < NOF_WRITES; i++) {
+		value = i;
+		CHECK(flink_write(gpio, HEADER_SIZE + SUBHEADER_SIZE + 2 * REGISTER_WITH, REGISTER_WITH, &value) == REGISTER_WITH, "write %d", i);
+	}
+	CHECK(flink_read(pwm, 0x10000, REGISTER_WITH, &value) < 0, "read beyond the subdevice");
+	CHECK(flink_stats_snapshot(dev, ops, subdevices) == 0, "snapshot");
+	CHECK(ops[FLINK_OP_READ].count == NOF_READS + 1 && ops[FLINK_OP_READ].errors == 1, "%llu reads, %llu errors",
+	      (unsigned long long)ops[FLINK_OP_READ].count, (unsigned long long)ops[FLINK_OP_READ].errors);
+	CHECK(ops[FLINK_OP_WRITE].count == NOF_WRITES && ops[FLINK_OP_WRITE].errors == 0, "%llu writes", (unsigned long long)ops[FLINK_OP_WRITE].count);
+	CHECK(ops[FLINK_OP_DEVICE_INFO].count == 0 && ops[FLINK_OP_READ_BLOCK].count == 0, "operations of the previous epoch");
+	CHECK(subdevices[pwm_id].count == NOF_READS + 1 && subdevices[pwm_id].errors == 1, "%llu pwm accesses", (unsigned long long)subdevices[pwm_id].count);
+	CHECK(subdevices[gpio_id].count == NOF_WRITES, "%llu gpio accesses", (unsigned long long)subdevices[gpio_id].count);
+	for(i = 0; i < FLINK_NOF_OPS; i++) check_latencies(&ops[i], flink_op2str(i));
+	check_latencies(&subdevices[pwm_id], "pwm");
+
+	// A second thread, counted with the main thread
+	memset(&w, 0, sizeof(w));
+	w.pwm = pwm;
+	w.reads = NOF_READS;
+	pthread_mutex_init(&w.lock, NULL);
+	pthread_cond_init(&w.cond, NULL);
+	if(pthread_create(&thread, NULL, work, &w) != 0) {
+		fprintf(stderr, "FAILED: can't start thread\n");
+		free(subdevices);
+		flink_close(dev);
+		return 1;
+	}
+	run_round(&w, 1);
+	CHECK(flink_stats_snapshot(dev, ops, NULL) == 0, "snapshot");
+	CHECK(ops[FLINK_OP_READ].count == 2 * NOF_READS + 1, "%llu reads of both threads", (unsigned long long)ops[FLINK_OP_READ].count);
+
+	// Reset, the thread's counters of the old epoch are neither reported nor added to
+	CHECK(flink_stats_reset(dev) == 0, "reset");
+	CHECK(flink_stats_snapshot(dev, ops, subdevices) == 0, "snapshot");
+	for(i = 0; i < FLINK_NOF_OPS; i++) CHECK(ops[i].count == 0, "%s counted after the reset", flink_op2str(i));
+	for(i = 0; i < nof_subdevices; i++) CHECK(subdevices[i].count == 0, "subdevice %d counted after the reset", i);
+	run_round(&w, 2);
+	pthread_join(thread, NULL);
+	CHECK(w.errors == 0, "%d errors of the thread", w.errors);
+	CHECK(flink_stats_snapshot(dev, ops, subdevices) == 0, "snapshot");
+	CHECK(ops[FLINK_OP_READ].count == NOF_READS && ops[FLINK_OP_READ].errors == 0, "%llu reads after the reset", (unsigned long long)ops[FLINK_OP_READ].count);
+	CHECK(subdevices[pwm_id].count == NOF_READS, "%llu pwm accesses after the reset", (unsigned long long)subdevices[pwm_id].count);
+	check_latencies(&ops[FLINK_OP_READ], "read");
+
+	// Invalid arguments
+	CHECK(flink_stats_snapshot(dev, NULL, NULL) < 0, "snapshot without array");
+	CHECK(flink_stats_snapshot(NULL, ops, NULL) < 0 && flink_stats_reset(NULL) < 0, "invalid device");
+
+	pthread_mutex_destroy(&w.lock);
+	pthread_cond_destroy(&w.cond);
+	free(subdevices);
+	flink_close(dev);
+	return check_result("Statistics test");
+}
@@ -0,0 +1,150 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, stepper motor S-curve profile test    *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file stepper_profile.c
+ *  @brief Checks the S-curve profile tables and their cache.
+ *
+ *  Checks the shape of the segment tables of long and short moves,
+ *  that the cache keeps the most recently used tables and replaces
+ *  the least recently used one, and that two profiles pushed to the
+ *  move queue of the simulated device sim:bench reach their position.
+ */
+
+#include <stdio.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define CHANNEL       2
+#define CACHE_SIZE    16
+
+static flink_stepper_profile_params params(uint32_t steps) {
+	flink_stepper_profile_params p = { 0 };
+
+	p.base_clk     = 100000000;
+	p.start_speed  = 10000;
+	p.top_speed    = 100000;		// prescaler 1000, reached after 5500 steps
+	p.acceleration = 1000000;
+	p.jerk         = 100000000;
+	p.steps        = steps;
+	return p;
+}
+
+// Profile of a move that does a step every few accesses of sim:bench
+static flink_stepper_profile_params queued_params(uint32_t steps) {
+	flink_stepper_profile_params p = params(steps);
+
+	p.start_speed  = 100000;
+	p.top_speed    = 1000000;
+	p.acceleration = 4000000000U;
+	p.jerk         = 4000000000U;
+	return p;
+}
+
+// Shape of the table: length, mirrored deceleration, accelerating ramp
+static void check_shape(const flink_stepper_profile* profile, const char* name) {
+	uint32_t i, n = profile->nof_segments, sum = 0;
+	const flink_stepper_move* s = profile->segments;
+
+	CHECK(n > 0 && n <= FLINK_STEPPER_PROFILE_SEGMENTS, "%s: %u segments", name, n);
+	if(n == 0 || n > FLINK_STEPPER_PROFILE_SEGMENTS) return;
+	for(i = 0; i < n; i++) sum += s[i].steps;
+	CHECK(sum == profile->params.steps, "%s: %u steps, expected %u", name, sum, profile->params.steps);
+	for(i = 0; i < n / 2; i++) {
+		CHECK(s[n - 1 - i].prescaler_start == s[i].prescaler_top && s[n - 1 - i].prescaler_top == s[i].prescaler_start &&
+		      s[n - 1 - i].steps == s[i].steps, "%s: segment %u not mirrored", name, n - 1 - i);
+		CHECK(s[i].prescaler_top <= s[i].prescaler_start, "%s: segment %u decelerates", name, i);
+		if(i > 0) CHECK(s[i].prescaler_start == s[i - 1].prescaler_top, "%s: segment %u not continuous", name, i);
+	}
+}
+
+int main(void) {
+	flink_stepper_profile_params p, bad;
+	flink_stepper_profile        profile, other;
+	flink_dev*                   dev;
+	flink_subdev*                stepper;
+	flink_stepper_queue*         queue;
+	flink_stepper_latency        latency;
+	int64_t                      position;
+	uint32_t                     i;
+
+	// Invalid parameters
+	p = params(20000);
+	CHECK(flink_stepperMotor_profile_get(NULL, &profile) < 0 && flink_get_errno() == FLINK_ENULLPTR, "profile without parameters");
+	CHECK(flink_stepperMotor_profile_get(&p, NULL) < 0 && flink_get_errno() == FLINK_ENULLPTR, "profile without buffer");
+	bad = p; bad.steps = 0;
+	CHECK(flink_stepperMotor_profile_get(&bad, &profile) < 0 && flink_get_errno() == FLINK_EINVALARG, "move without steps");
+	bad = p; bad.jerk = 0;
+	CHECK(flink_stepperMotor_profile_get(&bad, &profile) < 0 && flink_get_errno() == FLINK_EINVALARG, "profile without jerk");
+	CHECK(flink_stepperMotor_profile_cached(NULL) < 0, "cached without parameters");
+
+	// Long move reaches the top speed, short moves don't
+	CHECK(flink_stepperMotor_profile_get(&p, &profile) == 0, "long profile");
+	check_shape(&profile, "long move");
+	CHECK(profile.nof_segments % 2 == 1 && profile.segments[profile.nof_segments / 2].prescaler_top == 1000, "long move: no constant top speed");
+	p = params(20);
+	CHECK(flink_stepperMotor_profile_get(&p, &other) == 0, "short profile");
+	check_shape(&other, "short move");
+	CHECK(other.segments[0].prescaler_start == profile.segments[0].prescaler_start, "short move: start speed");
+	for(i = 0; i < other.nof_segments; i++) CHECK(other.segments[i].prescaler_top > 1000, "short move: reaches top speed");
+
+	// Cache, the least recently used profile is replaced
+	for(i = 0; i < CACHE_SIZE; i++) {
+		p = params(20000 + i);
+		CHECK(flink_stepperMotor_profile_get(&p, &profile) == 0, "profile %u", i);
+	}
+	for(i = 0; i < CACHE_SIZE; i++) {
+		p = params(20000 + i);
+		CHECK(flink_stepperMotor_profile_cached(&p) == 1, "profile %u not cached", i);
+	}
+	p = params(20000);
+	CHECK(flink_stepperMotor_profile_get(&p, &profile) == 0 && profile.params.steps == 20000, "use of profile 0");
+	p = params(30000);
+	CHECK(flink_stepperMotor_profile_get(&p, &profile) == 0, "profile %u", CACHE_SIZE);
+	p = params(20001);
+	CHECK(flink_stepperMotor_profile_cached(&p) == 0, "least recently used profile still cached");
+	p = params(20000);
+	CHECK(flink_stepperMotor_profile_cached(&p) == 1, "recently used profile replaced");
+	p = params(30000);
+	CHECK(flink_stepperMotor_profile_cached(&p) == 1, "new profile not cached");
+
+	// Two profiles back to back on the queue
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	stepper = flink_get_subdevice_by_unique_id(dev, 8);
+	queue = flink_stepperMotor_queue_create(stepper, CHANNEL, FLINK_STEPPER_NO_IRQ);
+	CHECK(queue != NULL, "create");
+	if(queue != NULL) {
+		p = queued_params(300);
+		CHECK(flink_stepperMotor_profile_get(&p, &profile) == 0, "first queued profile");
+		p = queued_params(200);
+		CHECK(flink_stepperMotor_profile_get(&p, &other) == 0, "second queued profile");
+		CHECK(flink_stepperMotor_queue_push_profile(queue, NULL, 1, NULL) < 0 && flink_get_errno() == FLINK_ENULLPTR, "push without profile");
+		CHECK(flink_stepperMotor_queue_push_profile(queue, &profile, 1, NULL) == 0, "push first profile");
+		CHECK(flink_stepperMotor_queue_push_profile(queue, &other, 0, NULL) == 0, "push second profile");
+		CHECK(flink_stepperMotor_queue_wait(queue, 0, -1) == 0, "wait for the profiles");
+		CHECK(flink_stepperMotor_queue_get_position(queue, &position) == 0 && position == 100, "position %lld, expected 100", (long long)position);
+		CHECK(flink_stepperMotor_queue_get_latency(queue, &latency) == 0 &&
+		      latency.count == profile.nof_segments + other.nof_segments - 1, "%llu transitions", (unsigned long long)latency.count);
+		CHECK(flink_stepperMotor_queue_destroy(queue) == 0, "destroy");
+	}
+	flink_close(dev);
+	return check_result("Stepper profile test");
+}
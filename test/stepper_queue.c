@@ -0,0 +1,109 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, stepper motor move queue test         *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file stepper_queue.c
+ *  @brief Checks the move queue of a stepper channel of the simulated device sim:bench.
+ *
+ *  The first move is pushed with a stalled prescaler, so the queue
+ *  fills up and waits time out. Setting the prescaler releases the
+ *  channel, which then does a step per register access. Checks that
+ *  all moves complete, the position they reach and that the channel
+ *  is stopped when the queue is destroyed.
+ */
+
+#include <stdio.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define CHANNEL       1
+#define STALLED       0xFFFFFFFF	// prescaler of a step every 43 s
+#define TOP           100			// prescaler of a step per us, the time of an access
+#define START_BIT     (1 << 5)
+
+// Move i of the queue, every third one counterclockwise
+static flink_stepper_move move(uint32_t i) {
+	flink_stepper_move m = { 0 };
+
+	m.config          = i % 3 ? 1 : 0;	// direction
+	m.prescaler_start = 1000;
+	m.prescaler_top   = i == 0 ? STALLED : TOP;
+	m.steps           = 10 + i;
+	return m;
+}
+
+int main(void) {
+	flink_dev*           dev;
+	flink_subdev*        stepper;
+	flink_stepper_queue* queue;
+	flink_stepper_move   m;
+	uint64_t             id, first_id = 0;
+	int64_t              position, expected = 0;
+	uint32_t             i, config;
+
+	dev = flink_open(DESIGN);
+	if(dev == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		return 1;
+	}
+	stepper = flink_get_subdevice_by_unique_id(dev, 8);
+
+	// Invalid arguments
+	CHECK(flink_stepperMotor_queue_create(flink_get_subdevice_by_unique_id(dev, 1), 0, FLINK_STEPPER_NO_IRQ) == NULL &&
+	      flink_get_errno() == FLINK_WRONGSUBDEVT, "queue of a gpio");
+	CHECK(flink_stepperMotor_queue_create(stepper, 4, FLINK_STEPPER_NO_IRQ) == NULL && flink_get_errno() == FLINK_EINVALCHAN, "channel 4");
+	queue = flink_stepperMotor_queue_create(stepper, CHANNEL, FLINK_STEPPER_NO_IRQ);
+	CHECK(queue != NULL, "create");
+	if(queue == NULL) {
+		flink_close(dev);
+		return 1;
+	}
+	CHECK(flink_stepperMotor_queue_push(queue, NULL, NULL) < 0 && flink_get_errno() == FLINK_ENULLPTR, "push without move");
+	CHECK(flink_stepperMotor_queue_get_position(queue, NULL) < 0, "position without buffer");
+
+	// Stalled first move, the running move counts
+	for(i = 0; i < FLINK_STEPPER_QUEUE_SIZE; i++) {
+		m = move(i);
+		CHECK(flink_stepperMotor_queue_push(queue, &m, &id) == 0 && id == i + 1, "push %u", i);
+		if(i == 0) first_id = id;
+		expected += m.config ? m.steps : -(int64_t)m.steps;
+	}
+	m = move(i);
+	CHECK(flink_stepperMotor_queue_push(queue, &m, NULL) < 0 && flink_get_errno() == FLINK_EQUEUEFULL, "push to a full queue");
+	CHECK(flink_stepperMotor_queue_wait(queue, first_id, 20) < 0 && flink_get_errno() == FLINK_ETIMEOUT, "wait for the stalled move");
+	CHECK(flink_stepperMotor_queue_get_position(queue, &position) == 0 && position == 0, "position %lld of the stalled move", (long long)position);
+	CHECK(flink_stepperMotor_get_local_config_reg(stepper, CHANNEL, &config) == 0 && (config & START_BIT), "stalled move not started");
+
+	// Released, all moves complete
+	CHECK(flink_stepperMotor_set_prescaler_top(stepper, CHANNEL, TOP) == 0, "release");
+	CHECK(flink_stepperMotor_queue_wait(queue, first_id, -1) == 0, "wait for the first move");
+	m = move(i);
+	CHECK(flink_stepperMotor_queue_push(queue, &m, NULL) == 0, "push after the first move");
+	expected += m.config ? m.steps : -(int64_t)m.steps;
+	CHECK(flink_stepperMotor_queue_wait(queue, 0, -1) == 0, "wait for all moves");
+	CHECK(flink_stepperMotor_queue_get_position(queue, &position) == 0 && position == expected,
+	      "position %lld, expected %lld", (long long)position, (long long)expected);
+	CHECK(flink_stepperMotor_get_steps_have_done(stepper, CHANNEL, &config) == 0 && config == move(i).steps, "steps done of the last move");
+
+	// Stopped on destruction
+	CHECK(flink_stepperMotor_queue_destroy(queue) == 0, "destroy");
+	CHECK(flink_stepperMotor_get_local_config_reg(stepper, CHANNEL, &config) == 0 && !(config & START_BIT), "channel still started");
+	CHECK(flink_stepperMotor_queue_destroy(NULL) < 0, "destroy without queue");
+
+	flink_close(dev);
+	return check_result("Stepper queue test");
+}
@@ -0,0 +1,139 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, trace test                            *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file trace.c
+ *  @brief Checks the trace of the simulated device sim:bench.
+ *
+ *  Checks that failed operations are recorded once by default and
+ *  successful ones only when all operations are traced, that errors
+ *  raised by the library are recorded with their code address, that
+ *  entries are read once and in order and that of an overflowed ring
+ *  the newest entries are read while the others, including the oldest
+ *  entry of the full ring, are counted as lost.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define DESIGN        "sim:bench"
+#define PWM_BASE      (HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+#define INVALID       0x10000	// offset beyond the subdevice
+#define RING_SIZE     256		// entries of the ring of a thread, as in lib/trace.c
+#define NOF_WRITES    (RING_SIZE + 44)
+#define MAX_ENTRIES   (2 * RING_SIZE)
+
+// Returns the number of lost entries reported by flink_trace_dump, -1 in case of failure
+static long read_lost(void) {
+	char file_name[64], line[256];
+	long nof_lost = 0;
+	FILE* file;
+	int fd;
+
+	snprintf(file_name, sizeof(file_name), "/tmp/flink_test_trace.XXXXXX");
+	fd = mkstemp(file_name);
+	if(fd < 0) return -1;
+	unlink(file_name);
+	if(flink_trace_dump(fd) != 0 || lseek(fd, 0, SEEK_SET) != 0 || (file = fdopen(fd, "r")) == NULL) {
+		close(fd);
+		return -1;
+	}
+	while(fgets(line, sizeof(line), file)) sscanf(line, "%ld entries lost", &nof_lost);
+	fclose(file);
+	return nof_lost;
+}
+
+int main(void) {
+	flink_dev*         dev;
+	flink_subdev*      pwm;
+	flink_trace_entry* entries;
+	uint32_t           value;
+	size_t             n, i;
+	int                pwm_id, in_order;
+
+	entries = malloc(MAX_ENTRIES * sizeof(flink_trace_entry));
+	dev = flink_open(DESIGN);
+	if(dev == NULL || entries == NULL) {
+		fprintf(stderr, "FAILED: can't open %s\n", DESIGN);
+		free(entries);
+		return 1;
+	}
+	pwm = flink_get_subdevice_by_unique_id(dev, 3);
+	pwm_id = flink_subdevice_get_id(pwm);
+	CHECK(flink_trace_get_level() == FLINK_TRACE_ERRORS, "default level %d", flink_trace_get_level());
+	flink_trace_read(entries, MAX_ENTRIES);	// discard entries of opening the device
+	CHECK(read_lost() == 0, "entries lost at open");
+
+	// Errors only, a single entry per failed operation
+	CHECK(flink_read(pwm, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH, "read");
+	CHECK(flink_read(pwm, INVALID, REGISTER_WITH, &value) < 0, "read beyond the subdevice");
+	CHECK(flink_read_block(pwm, INVALID, REGISTER_WITH, &value) < 0, "block read beyond the subdevice");
+	n = flink_trace_read(entries, MAX_ENTRIES);
+	CHECK(n == 2, "%zu entries of two failed operations", n);
+	for(i = 0; i < n; i++) {
+		CHECK(entries[i].error != 0 && entries[i].site == 0 && entries[i].subdev == pwm_id && entries[i].offset == INVALID,
+		      "entry %zu: op %u subdevice %d offset 0x%x", i, entries[i].op, entries[i].subdev, entries[i].offset);
+	}
+	CHECK(n == 2 && entries[0].op == FLINK_OP_READ && entries[1].op == FLINK_OP_READ_BLOCK, "operations of the entries");
+	CHECK(n == 2 && entries[1].time_ns >= entries[0].time_ns, "entries out of order");
+	CHECK(flink_trace_read(entries, MAX_ENTRIES) == 0, "entries read twice");
+
+	// Error raised by the library, recorded where it was raised
+	CHECK(flink_read(pwm, PWM_BASE, REGISTER_WITH, NULL) < 0, "read without buffer");
+	n = flink_trace_read(entries, MAX_ENTRIES);
+	CHECK(n == 1 && entries[0].op == FLINK_TRACE_OP_ERROR && entries[0].error == FLINK_ENULLPTR && entries[0].site != 0, "%zu entries of a raised error", n);
+	CHECK(flink_reflectivesensor_get_values(flink_get_subdevice_by_unique_id(dev, 9), NULL) < 0 && flink_get_errno() == FLINK_ENULLPTR,
+	      "error passed up by the sensor, error %d", flink_get_errno());
+	n = flink_trace_read(entries, MAX_ENTRIES);
+	CHECK(n == 1 && entries[0].error == FLINK_ENULLPTR, "%zu entries of an error passed up", n);
+
+	// Nothing while off
+	flink_trace_set_level(FLINK_TRACE_OFF);
+	CHECK(flink_read(pwm, INVALID, REGISTER_WITH, &value) < 0, "read beyond the subdevice");
+	CHECK(flink_trace_read(entries, MAX_ENTRIES) == 0, "entries traced while off");
+
+	// All operations, read in parts
+	flink_trace_set_level(FLINK_TRACE_ALL);
+	for(i = 0; i < 10; i++) CHECK(flink_read(pwm, PWM_BASE + (i % 4) * REGISTER_WITH, REGISTER_WITH, &value) == REGISTER_WITH, "read %zu", i);
+	CHECK(flink_trace_read(entries, 4) == 4, "first part");
+	CHECK(entries[0].op == FLINK_OP_READ && entries[0].offset == PWM_BASE && entries[0].error == 0, "first entry");
+	n = flink_trace_read(entries, MAX_ENTRIES);
+	CHECK(n == 6 && entries[0].offset == PWM_BASE && entries[1].offset == PWM_BASE + REGISTER_WITH, "%zu entries in the second part", n);
+	CHECK(read_lost() == 0, "entries lost without overflow");
+
+	// Overflow, the newest entries but the oldest of the full ring are read
+	for(i = 0; i < NOF_WRITES; i++) {
+		value = i;
+		CHECK(flink_write(pwm, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH, "write %zu", i);
+	}
+	flink_trace_set_level(FLINK_TRACE_ERRORS);
+	n = flink_trace_read(entries, MAX_ENTRIES);
+	CHECK(n == RING_SIZE - 1, "%zu entries read of a full ring", n);
+	in_order = 1;
+	for(i = 1; i < n; i++) in_order &= entries[i].time_ns >= entries[i - 1].time_ns;
+	CHECK(in_order, "entries out of order");
+	CHECK(n > 0 && entries[n - 1].op == FLINK_OP_WRITE, "newest entry");
+	CHECK(read_lost() == NOF_WRITES - (RING_SIZE - 1), "lost entries");
+	CHECK(read_lost() == 0, "lost entries reported twice");
+
+	flink_close(dev);
+	free(entries);
+	return check_result("Trace test");
+}
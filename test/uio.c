@@ -0,0 +1,166 @@
+/*******************************************************************
+ *   _________     _____      _____    ____  _____    ___  ____    *
+ *  |_   ___  |  |_   _|     |_   _|  |_   \|_   _|  |_  ||_  _|   *
+ *    | |_  \_|    | |         | |      |   \ | |      | |_/ /     *
+ *    |  _|        | |   _     | |      | |\ \| |      |  __'.     *
+ *   _| |_        _| |__/ |   _| |_    _| |_\   |_    _| |  \ \_   *
+ *  |_____|      |________|  |_____|  |_____|\____|  |____||____|  *
+ *                                                                 *
+ *******************************************************************
+ *                                                                 *
+ *  flink userspace library, UIO transport test                    *
+ *                                                                 *
+ *******************************************************************/
+
+/** @file uio.c
+ *  @brief Checks the UIO transport against a file simulating the register space.
+ *
+ *  Writes the headers of an info, a GPIO and a PWM subdevice to a
+ *  temporary file, opens it through the UIO transport and checks the
+ *  enumeration of the subdevices and all kinds of register accesses
+ *  against the content of the file. Interrupts are raised by writing to
+ *  the interrupt FIFO next to the file. An empty file is rejected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <flinklib.h>
+#include <flink_funcid.h>
+
+#include "check.h"
+
+#define MEM_SIZE      0x400
+#define GPIO_ADDR     0x40
+#define PWM_ADDR      0x140
+#define PWM_BASE      (HEADER_SIZE + SUBHEADER_SIZE + PWM_FIRSTPWM_OFFSET)
+#define IRQ           2
+
+static uint32_t mem[MEM_SIZE / REGISTER_WITH];
+
+static void put_header(uint32_t addr, uint16_t function, uint32_t mem_size, uint32_t nof_channels, uint32_t unique_id) {
+	mem[addr / REGISTER_WITH]     = (uint32_t)function << 16 | 1;
+	mem[addr / REGISTER_WITH + 1] = mem_size;
+	mem[addr / REGISTER_WITH + 2] = nof_channels;
+	mem[addr / REGISTER_WITH + 3] = unique_id;
+}
+
+// Register of the simulated device, as seen in the file
+static uint32_t reg(int fd, uint32_t addr) {
+	uint32_t value = 0;
+	if(pread(fd, &value, sizeof(value), addr) != sizeof(value)) return 0xdeadbeef;
+	return value;
+}
+
+static int wait_irq(int signal_nr) {
+	struct timespec ts = { 1, 0 };
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, signal_nr);
+	return sigtimedwait(&set, NULL, &ts) == signal_nr;
+}
+
+int main(void) {
+	char          file_name[64], irq_name[80], dev_name[80];
+	flink_dev*    dev;
+	flink_subdev* gpio;
+	flink_subdev* pwm;
+	uint32_t      regs[48], value, i, count = 1;
+	uint8_t       bit;
+	sigset_t      set;
+	int           fd, irq_fd, signal_nr;
+
+	put_header(0, INFO_DEVICE_ID, GPIO_ADDR, 0, 0);
+	put_header(GPIO_ADDR, GPIO_INTERFACE_ID, PWM_ADDR - GPIO_ADDR, 32, 1);
+	put_header(PWM_ADDR, PWM_INTERFACE_ID, 0x80, 4, 3);
+	mem[(PWM_ADDR + HEADER_SIZE + SUBHEADER_SIZE + PWM_BASECLK_OFFSET) / REGISTER_WITH] = 100000000;
+
+	snprintf(file_name, sizeof(file_name), "/tmp/flink_test_uio.%d", (int)getpid());
+	snprintf(irq_name, sizeof(irq_name), "%s.irq", file_name);
+	snprintf(dev_name, sizeof(dev_name), "%s%s", FLINK_UIO_PREFIX, file_name);
+	fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if(fd < 0 || write(fd, mem, sizeof(mem)) != sizeof(mem) || mkfifo(irq_name, 0600) < 0) {
+		fprintf(stderr, "FAILED: can't create %s\n", file_name);
+		return 1;
+	}
+
+	// The irq signal is blocked in all threads and received with sigtimedwait
+	sigemptyset(&set);
+	sigaddset(&set, SIGRTMIN + IRQ);
+	sigprocmask(SIG_BLOCK, &set, NULL);
+
+	dev = flink_open(dev_name);
+	irq_fd = open(irq_name, O_WRONLY | O_NONBLOCK);
+	if(dev == NULL || irq_fd < 0) {
+		fprintf(stderr, "FAILED: can't open %s\n", dev_name);
+		unlink(file_name);
+		unlink(irq_name);
+		return 1;
+	}
+
+	// Enumeration
+	CHECK(flink_get_nof_subdevices(dev) == 3, "nof subdevices");
+	gpio = flink_get_subdevice_by_unique_id(dev, 1);
+	pwm = flink_get_subdevice_by_unique_id(dev, 3);
+	CHECK(gpio && flink_subdevice_get_function(gpio) == GPIO_INTERFACE_ID && flink_subdevice_get_baseaddr(gpio) == GPIO_ADDR &&
+	      flink_subdevice_get_memsize(gpio) == PWM_ADDR - GPIO_ADDR && flink_subdevice_get_nofchannels(gpio) == 32, "gpio subdevice");
+	CHECK(pwm && flink_subdevice_get_function(pwm) == PWM_INTERFACE_ID && flink_subdevice_get_baseaddr(pwm) == PWM_ADDR &&
+	      flink_subdevice_get_nofchannels(pwm) == 4, "pwm subdevice");
+
+	if(gpio && pwm) {
+		// Register accesses
+		value = 12345;
+		CHECK(flink_write(pwm, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH && reg(fd, PWM_ADDR + PWM_BASE) == 12345, "write");
+		value = 0;
+		CHECK(flink_read(pwm, PWM_BASE, REGISTER_WITH, &value) == REGISTER_WITH && value == 12345, "read");
+		CHECK(flink_pwm_set_period(pwm, 2, 999) == 0 && reg(fd, PWM_ADDR + PWM_BASE + 2 * REGISTER_WITH) == 999, "pwm period");
+		CHECK(flink_pwm_get_baseclock(pwm, &value) == 0 && value == 100000000, "pwm base clock");
+		bit = 1;
+		CHECK(flink_write_bit(pwm, PWM_BASE, 31, &bit) == 0 && reg(fd, PWM_ADDR + PWM_BASE) == (12345 | 1u << 31), "write bit");
+		bit = 0;
+		CHECK(flink_read_bit(pwm, PWM_BASE, 31, &bit) == 0 && bit == 1, "read bit");
+		CHECK(flink_dio_set_direction(gpio, 5, FLINK_OUTPUT) == 0 && flink_dio_set_value(gpio, 5, 1) == 0, "gpio set");
+		bit = 0;
+		CHECK(flink_dio_get_value(gpio, 5, &bit) == 0 && bit == 1, "gpio get");
+		CHECK(flink_read(pwm, flink_subdevice_get_memsize(pwm), REGISTER_WITH, &value) < 0, "read beyond the subdevice");
+
+		// Blocks
+		for(i = 0; i < 48; i++) regs[i] = i;
+		CHECK(flink_write_block(gpio, HEADER_SIZE + SUBHEADER_SIZE, sizeof(regs), regs) == sizeof(regs) &&
+		      reg(fd, GPIO_ADDR + HEADER_SIZE + SUBHEADER_SIZE + 47 * REGISTER_WITH) == 47, "write block");
+		memset(regs, 0, sizeof(regs));
+		CHECK(flink_read_block(gpio, HEADER_SIZE + SUBHEADER_SIZE, sizeof(regs), regs) == sizeof(regs) && regs[1] == 1 && regs[47] == 47, "read block");
+		CHECK(flink_read_block(gpio, HEADER_SIZE + SUBHEADER_SIZE, flink_subdevice_get_memsize(gpio), regs) < 0, "block beyond the subdevice");
+	}
+
+	// Interrupts
+	signal_nr = flink_register_irq(dev, IRQ);
+	CHECK(signal_nr == SIGRTMIN + IRQ, "register irq");
+	CHECK(write(irq_fd, &count, sizeof(count)) == sizeof(count) && wait_irq(signal_nr), "irq signal");
+	count++;
+	CHECK(write(irq_fd, &count, sizeof(count)) == sizeof(count) && wait_irq(signal_nr), "second irq signal");
+	CHECK(flink_unregister_irq(dev, IRQ) == 0, "unregister irq");
+	count++;
+	CHECK(write(irq_fd, &count, sizeof(count)) == sizeof(count) && !wait_irq(signal_nr), "no signal after unregistering");
+
+	flink_close(dev);
+	close(irq_fd);
+	close(fd);
+	unlink(irq_name);
+
+	// No register space
+	fd = open(file_name, O_RDWR | O_TRUNC);
+	CHECK(fd >= 0 && flink_open(dev_name) == NULL && flink_get_errno() == FLINK_EINVALARG, "empty file");
+	if(fd >= 0) close(fd);
+	unlink(file_name);
+
+	return check_result("UIO transport test");
+}
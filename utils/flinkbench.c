@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <flinklib.h>
+
+#define EOPEN     -1
+#define ESUBDEVID -2
+#define EPARAM    -5
+#define ERUN      -6
+
+#define DEFAULT_DEV        "/dev/flink0"
+#define DEFAULT_OFFSET     (HEADER_SIZE + SUBHEADER_SIZE)
+#define DEFAULT_BLOCK_SIZE 64
+#define MAX_SUBDEVICES     256
+#define MAX_THREADS        256
+#define SUB_BUCKETS        16	// per power of two, about 6% resolution
+#define NOF_BUCKETS        (SUB_BUCKETS + 60 * SUB_BUCKETS)
+
+typedef enum _workload {
+	WL_READ, WL_WRITE, WL_MIX, WL_READ_BIT, WL_WRITE_BIT, WL_READ_BLOCK, WL_WRITE_BLOCK, NOF_WORKLOADS
+} workload;
+
+static const char* workload_names[NOF_WORKLOADS] = {
+	"read", "write", "mix", "read_bit", "write_bit", "read_block", "write_block"
+};
+
+typedef struct _target {
+	flink_subdev* subdev;
+	uint32_t      size;		/// Bytes per operation
+	uint8_t*      data;		/// Values read before the run, written back by writes
+} target;
+
+typedef struct _worker {
+	pthread_t thread;
+	uint32_t  index;
+	uint64_t  ops;
+	uint64_t  bytes;
+	uint64_t  errors;
+	uint64_t  max_ns;
+	uint64_t  histogram[NOF_BUCKETS];
+} worker;
+
+static workload          wl = WL_READ;
+static uint32_t          offset = DEFAULT_OFFSET;
+static target            targets[MAX_SUBDEVICES];
+static uint32_t          nof_targets = 0;
+static volatile bool     stop = false;
+static pthread_barrier_t barrier;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t bucket(uint64_t ns) {
+	uint32_t e;
+	if(ns < SUB_BUCKETS) return ns;
+	e = 63 - __builtin_clzll(ns);	// >= 4
+	return SUB_BUCKETS + (e - 4) * SUB_BUCKETS + ((ns >> (e - 4)) & (SUB_BUCKETS - 1));
+}
+
+static double bucket_value(uint32_t b) {
+	uint32_t e, m;
+	if(b < SUB_BUCKETS) return b;
+	e = (b - SUB_BUCKETS) / SUB_BUCKETS + 4;
+	m = (b - SUB_BUCKETS) % SUB_BUCKETS;
+	return (double)((SUB_BUCKETS + m) << (e - 4)) + ((1ULL << (e - 4)) - 1) / 2.0;
+}
+
+static double percentile(const uint64_t* histogram, uint64_t count, double p) {
+	uint64_t rank = (uint64_t)(count * p / 100.0), sum = 0;
+	uint32_t b;
+	for(b = 0; b < NOF_BUCKETS; b++) {
+		sum += histogram[b];
+		if(sum > rank) return bucket_value(b);
+	}
+	return 0;
+}
+
+static ssize_t run_op(target* t, uint64_t i) {
+	uint8_t bit;
+	switch(wl) {
+		case WL_READ:
+			return flink_read(t->subdev, offset, REGISTER_WITH, t->data);
+		case WL_WRITE:
+			return flink_write(t->subdev, offset, REGISTER_WITH, t->data);
+		case WL_MIX:
+			if(i & 1) return flink_write(t->subdev, offset, REGISTER_WITH, t->data);
+			return flink_read(t->subdev, offset, REGISTER_WITH, t->data);
+		case WL_READ_BIT:
+			return flink_read_bit(t->subdev, offset, 0, &bit) == 0 ? REGISTER_WITH : -1;
+		case WL_WRITE_BIT:
+			bit = t->data[0] & 1;
+			return flink_write_bit(t->subdev, offset, 0, &bit) == 0 ? REGISTER_WITH : -1;
+		case WL_READ_BLOCK:
+			return flink_read_block(t->subdev, offset, t->size, t->data);
+		case WL_WRITE_BLOCK:
+			return flink_write_block(t->subdev, offset, t->size, t->data);
+		default:
+			return -1;
+	}
+}
+
+static void* run_worker(void* arg) {
+	worker* w = arg;
+	target* t;
+	uint64_t i, start, ns;
+	ssize_t ret;
+
+	pthread_barrier_wait(&barrier);
+	for(i = 0; !stop; i++) {
+		// Threads start on different subdevices and cycle through all of them
+		t = &targets[(w->index + i) % nof_targets];
+		start = now_ns();
+		ret = run_op(t, i);
+		ns = now_ns() - start;
+		if(ret < 0) {
+			w->errors++;
+			continue;
+		}
+		w->ops++;
+		w->bytes += ret;
+		w->histogram[bucket(ns)]++;
+		if(ns > w->max_ns) w->max_ns = ns;
+	}
+	return NULL;
+}
+
+static int run(uint32_t nof_threads, double duration, worker* workers, double* ops_per_s, double base) {
+	static uint64_t histogram[NOF_BUCKETS];
+	uint64_t ops = 0, bytes = 0, errors = 0, max_ns = 0, start, elapsed;
+	struct timespec ts;
+	uint32_t i, b;
+
+	memset(workers, 0, nof_threads * sizeof(worker));
+	memset(histogram, 0, sizeof(histogram));
+	stop = false;
+	pthread_barrier_init(&barrier, NULL, nof_threads + 1);
+	for(i = 0; i < nof_threads; i++) {
+		workers[i].index = i;
+		if(pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]) != 0) {
+			fprintf(stderr, "Failed to create thread %u!\n", i);
+			exit(ERUN);
+		}
+	}
+	pthread_barrier_wait(&barrier);
+	start = now_ns();
+	ts.tv_sec = (time_t)duration;
+	ts.tv_nsec = (long)((duration - ts.tv_sec) * 1e9);
+	nanosleep(&ts, NULL);
+	stop = true;
+	for(i = 0; i < nof_threads; i++) pthread_join(workers[i].thread, NULL);
+	elapsed = now_ns() - start;
+	pthread_barrier_destroy(&barrier);
+
+	for(i = 0; i < nof_threads; i++) {
+		ops += workers[i].ops;
+		bytes += workers[i].bytes;
+		errors += workers[i].errors;
+		if(workers[i].max_ns > max_ns) max_ns = workers[i].max_ns;
+		for(b = 0; b < NOF_BUCKETS; b++) histogram[b] += workers[i].histogram[b];
+	}
+	*ops_per_s = ops * 1e9 / elapsed;
+	printf("%7u %12.0f %9.2f %9.2f %9.2f %9.2f %9.2f", nof_threads, *ops_per_s, bytes * 1e3 / elapsed,
+	       percentile(histogram, ops, 50) / 1e3, percentile(histogram, ops, 99) / 1e3,
+	       percentile(histogram, ops, 99.9) / 1e3, max_ns / 1e3);
+	// Speedup relative to the first run, which has a single thread unless -f is given
+	if(base > 0) printf(" %7.2f", *ops_per_s / base);
+	else printf(" %7s", nof_threads == 1 ? "1.00" : "-");
+	if(errors) printf("  %llu errors", (unsigned long long)errors);
+	printf("\n");
+	return errors && ops == 0 ? -1 : 0;
+}
+
+static int add_target(flink_dev* dev, uint8_t id, uint32_t block_size) {
+	flink_subdev* subdev = flink_get_subdevice_by_id(dev, id);
+	uint32_t memsize, size;
+	bool block = (wl == WL_READ_BLOCK || wl == WL_WRITE_BLOCK);
+
+	if(subdev == NULL || nof_targets >= MAX_SUBDEVICES) {
+		fprintf(stderr, "Illegal subdevice id %u!\n", id);
+		return ESUBDEVID;
+	}
+	memsize = flink_subdevice_get_memsize(subdev);
+	size = block ? block_size : REGISTER_WITH;
+	if(offset + size > memsize) {
+		if(!block || offset + REGISTER_WITH > memsize) {
+			fprintf(stderr, "Subdevice %u has only %u bytes, skipping it.\n", id, memsize);
+			return 0;
+		}
+		size = (memsize - offset) & ~(REGISTER_WITH - 1);
+	}
+	targets[nof_targets].subdev = subdev;
+	targets[nof_targets].size = size;
+	targets[nof_targets].data = calloc(1, size);
+	if(targets[nof_targets].data == NULL) return ERUN;
+
+	// Writes store the current values again
+	if(block) {
+		if(flink_read_block(subdev, offset, size, targets[nof_targets].data) != size) {
+			fprintf(stderr, "Reading subdevice %u failed!\n", id);
+			return ERUN;
+		}
+	}
+	else if(flink_read(subdev, offset, REGISTER_WITH, targets[nof_targets].data) != REGISTER_WITH) {
+		fprintf(stderr, "Reading subdevice %u failed!\n", id);
+		return ERUN;
+	}
+	nof_targets++;
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	flink_dev* dev;
+	worker*    workers;
+	char*      dev_name = DEFAULT_DEV;
+	char*      subdevs = NULL;
+	char*      tok;
+	char*      end;
+	long       id;
+	uint32_t   max_threads = 1;
+	uint32_t   block_size = DEFAULT_BLOCK_SIZE;
+	uint32_t   n;
+	double     duration = 1.0;
+	double     ops_per_s, base = 0;
+	bool       fixed = false;
+	int        nof_subdevices, error = 0;
+
+	// Error message if long dashes (en dash) are used
+	int i;
+	for (i=0; i < argc; i++) {
+		 if ((argv[i][0] == 226) && (argv[i][1] == 128) && (argv[i][2] == 147)) {
+			fprintf(stderr, "Error: Invalid arguments. En dashes are used.\n");
+			return -1;
+		 }
+	}
+
+	/* Compute command line arguments */
+	int c;
+	while((c = getopt(argc, argv, "d:s:w:o:b:t:fD:")) != -1) {
+		switch(c) {
+			case 'd': // device file
+				dev_name = optarg;
+				break;
+			case 's': // comma separated subdevice ids
+				subdevs = optarg;
+				break;
+			case 'w': // workload
+				for(n = 0; n < NOF_WORKLOADS && strcmp(optarg, workload_names[n]) != 0; n++);
+				if(n == NOF_WORKLOADS) {
+					fprintf(stderr, "Unknown workload '%s'!\n", optarg);
+					return EPARAM;
+				}
+				wl = n;
+				break;
+			case 'o': // register offset
+				offset = strtoul(optarg, NULL, 0);
+				break;
+			case 'b': // block size
+				block_size = strtoul(optarg, NULL, 0);
+				break;
+			case 't': // threads
+				max_threads = atoi(optarg);
+				break;
+			case 'f': // only run with the given number of threads
+				fixed = true;
+				break;
+			case 'D': // duration of a run in seconds
+				duration = atof(optarg);
+				break;
+			case '?':
+				if(isprint(optopt)) fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+				return -1;
+			default:
+				abort();
+		}
+	}
+	if(max_threads < 1 || max_threads > MAX_THREADS || duration <= 0 || block_size < REGISTER_WITH || (block_size % REGISTER_WITH) != 0) {
+		fprintf(stderr, "Invalid number of threads, duration or block size!\n");
+		return EPARAM;
+	}
+
+	// Open flink device
+	dev = flink_open(dev_name);
+	if(dev == NULL) {
+		fprintf(stderr, "Failed to open device %s!\n", dev_name);
+		return EOPEN;
+	}
+
+	// Select the subdevices, all except the info subdevice by default
+	if(subdevs) {
+		for(tok = strtok(subdevs, ","); tok && error == 0; tok = strtok(NULL, ",")) {
+			id = strtol(tok, &end, 0);
+			if(*tok == '\0' || *end != '\0' || id < 0 || id > UINT8_MAX) {
+				fprintf(stderr, "Illegal subdevice id %s!\n", tok);
+				error = ESUBDEVID;
+			}
+			else error = add_target(dev, id, block_size);
+		}
+	}
+	else {
+		nof_subdevices = flink_get_nof_subdevices(dev);
+		for(i = 0; i < nof_subdevices && error == 0; i++) {
+			if(flink_subdevice_get_function(flink_get_subdevice_by_id(dev, i)) == INFO_DEVICE_ID) continue;
+			error = add_target(dev, i, block_size);
+		}
+	}
+	if(error == 0 && nof_targets == 0) {
+		fprintf(stderr, "No subdevice to run on!\n");
+		error = ESUBDEVID;
+	}
+	if(error) {
+		flink_close(dev);
+		return error;
+	}
+
+	workers = calloc(max_threads, sizeof(worker));
+	if(workers == NULL) {
+		flink_close(dev);
+		return ERUN;
+	}
+
+	printf("%s on %u subdevice(s) of %s, offset 0x%x, %.1f s per run\n", workload_names[wl], nof_targets, dev_name, offset, duration);
+	printf("%7s %12s %9s %9s %9s %9s %9s %7s\n", "threads", "ops/s", "MB/s", "p50 us", "p99 us", "p99.9 us", "max us", "scaling");
+	for(n = fixed ? max_threads : 1; n <= max_threads && error == 0; n = (n < max_threads && n * 2 > max_threads) ? max_threads : n * 2) {
+		error = run(n, duration, workers, &ops_per_s, base);
+		if(base == 0 && n == 1) base = ops_per_s;
+		if(n == max_threads) break;
+	}
+
+	// Close flink device
+	free(workers);
+	flink_close(dev);
+
+	return error ? ERUN : EXIT_SUCCESS;
+}
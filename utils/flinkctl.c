@@ -0,0 +1,452 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include <flinklib.h>
+
+#define EOPEN     -1
+#define ESUBDEVID -2
+#define EREAD     -3
+#define EWRITE    -4
+#define EPARAM    -5
+
+#define DEFAULT_DEV "/dev/flink0"
+#define MAX_ARGS    16
+#define MAX_BATCH   64	// registers per block transfer
+
+// Consecutive register writes collected into one block transfer
+typedef struct _batch {
+	flink_subdev* subdev;
+	uint32_t      offset;
+	uint32_t      nof_values;
+	uint32_t      values[MAX_BATCH];
+	int           first_line;	/// Command of the first and the last queued register
+	int           last_line;
+} batch;
+
+static flink_dev* dev = NULL;
+static batch      pending;
+static bool       verbose = false;
+static uint64_t   nof_commands = 0;
+static uint64_t   nof_transfers = 0;
+static int        line_nr = 0;		// current command
+static int        failed_first, failed_last;	// commands of a failed command or batch
+
+/**
+ * @brief Writes the pending registers in a single transfer.
+ */
+static int flush(void) {
+	uint32_t size = pending.nof_values * REGISTER_WITH;
+	ssize_t ret;
+
+	if(pending.nof_values == 0) return 0;
+	if(verbose) fprintf(stderr, "write subdev %u offset 0x%x, %u register(s)\n", flink_subdevice_get_id(pending.subdev), pending.offset, pending.nof_values);
+	if(pending.nof_values == 1) ret = flink_write(pending.subdev, pending.offset, REGISTER_WITH, pending.values);
+	else ret = flink_write_block(pending.subdev, pending.offset, size, pending.values);
+	pending.nof_values = 0;
+	nof_transfers++;
+	if(ret != size) {
+		// The failed writes were queued by earlier commands
+		failed_first = pending.first_line;
+		failed_last = pending.last_line;
+		return EWRITE;
+	}
+	return 0;
+}
+
+/**
+ * @brief Queues a register write, adjacent to the pending ones or after flushing them.
+ */
+static int queue_write(flink_subdev* subdev, uint32_t offset, uint32_t value) {
+	int error;
+
+	if(pending.nof_values > 0 && (pending.subdev != subdev || offset != pending.offset + pending.nof_values * REGISTER_WITH || pending.nof_values == MAX_BATCH)) {
+		error = flush();
+		if(error) return error;
+	}
+	if(pending.nof_values == 0) {
+		pending.subdev = subdev;
+		pending.offset = offset;
+		pending.first_line = line_nr;
+	}
+	pending.last_line = line_nr;
+	pending.values[pending.nof_values++] = value;
+	return 0;
+}
+
+static bool parse_number(const char* s, uint32_t* value) {
+	char* end;
+	if(s == NULL) return false;
+	*value = strtoul(s, &end, 0);
+	return *s != '\0' && *end == '\0';
+}
+
+static flink_subdev* get_subdev(const char* s, uint16_t function) {
+	flink_subdev* subdev;
+	uint32_t id;
+
+	if(!parse_number(s, &id) || id > UINT8_MAX || (subdev = flink_get_subdevice_by_id(dev, id)) == NULL) {
+		fprintf(stderr, "Illegal subdevice id %s!\n", s ? s : "");
+		return NULL;
+	}
+	if(function != 0xFFFF && flink_subdevice_get_function(subdev) != function) {
+		fprintf(stderr, "Subdevice with id %u has wrong function, check subdevice id!\n", id);
+		return NULL;
+	}
+	return subdev;
+}
+
+static bool valid_channel(flink_subdev* subdev, bool has_ch, uint32_t ch) {
+	if(!has_ch) return false;
+	if(ch >= flink_subdevice_get_nofchannels(subdev)) {
+		fprintf(stderr, "Illegal channel %u!\n", ch);
+		return false;
+	}
+	return true;
+}
+
+static int cmd_open(int argc, char* argv[]) {
+	flink_dev* new_dev;
+	if(argc != 2) return EPARAM;
+	new_dev = flink_open(argv[1]);
+	if(new_dev == NULL) {
+		fprintf(stderr, "Failed to open device %s!\n", argv[1]);
+		return EOPEN;
+	}
+	if(dev) flink_close(dev);
+	dev = new_dev;
+	return 0;
+}
+
+static int cmd_read(flink_subdev* subdev, int argc, char* argv[]) {
+	uint32_t offset, count = 1, i;
+	uint32_t* values;
+
+	if(argc < 3 || argc > 4 || !parse_number(argv[2], &offset) || (argc == 4 && (!parse_number(argv[3], &count) || count == 0))) return EPARAM;
+	values = malloc(count * REGISTER_WITH);
+	if(values == NULL) return EREAD;
+	if(flink_read_block(subdev, offset, count * REGISTER_WITH, values) != count * REGISTER_WITH) {
+		free(values);
+		return EREAD;
+	}
+	nof_transfers++;
+	for(i = 0; i < count; i++) printf("0x%04x: 0x%08x\n", offset + i * REGISTER_WITH, values[i]);
+	free(values);
+	return 0;
+}
+
+static int cmd_write(flink_subdev* subdev, int argc, char* argv[]) {
+	uint32_t offset, value;
+	int i, error;
+
+	if(argc < 4 || !parse_number(argv[2], &offset)) return EPARAM;
+	for(i = 3; i < argc; i++) {
+		if(!parse_number(argv[i], &value)) return EPARAM;
+		error = queue_write(subdev, offset, value);
+		if(error) return error;
+		offset += REGISTER_WITH;
+	}
+	return 0;
+}
+
+/**
+ * @brief Runs a command of a function module, see doc/utils.md.
+ * Setters of single registers are queued, the offsets follow the register layout used by the library.
+ */
+static int cmd_module(const char* module, int argc, char* argv[]) {
+	flink_subdev* subdev;
+	const char*   op = argc > 2 ? argv[2] : "";
+	uint32_t      ch = 0, value = 0, nof_channels, base = HEADER_SIZE + SUBHEADER_SIZE;
+	uint8_t       bit;
+	bool          has_ch = argc > 3 && parse_number(argv[3], &ch);
+	bool          has_value = argc > 4 && parse_number(argv[4], &value);
+	int           ret = -1;
+
+	if(strcmp(module, "dio") == 0) {
+		if((subdev = get_subdev(argv[1], GPIO_INTERFACE_ID)) == NULL) return ESUBDEVID;
+		nof_channels = flink_subdevice_get_nofchannels(subdev);
+		if(strcmp(op, "dir") == 0 && valid_channel(subdev, has_ch, ch) && argc == 5) {
+			if((ret = flush())) return ret;
+			ret = flink_dio_set_direction(subdev, ch, strcmp(argv[4], "out") == 0 || strcmp(argv[4], "1") == 0);
+		}
+		else if(strcmp(op, "set") == 0 && valid_channel(subdev, has_ch, ch) && has_value) {
+			if((ret = flush())) return ret;
+			ret = flink_dio_set_value(subdev, ch, value != 0);
+		}
+		else if(strcmp(op, "get") == 0 && valid_channel(subdev, has_ch, ch)) {
+			if((ret = flush())) return ret;
+			if((ret = flink_dio_get_value(subdev, ch, &bit)) == 0) printf("%u\n", bit);
+		}
+		else if(strcmp(op, "debounce") == 0 && valid_channel(subdev, has_ch, ch) && has_value) {
+			return queue_write(subdev, base + 4 + ((nof_channels - 1) / (REGISTER_WITH * 8) + 1) * REGISTER_WITH * 2 + ch * REGISTER_WITH, value);
+		}
+		else return EPARAM;
+	}
+	else if(strcmp(module, "pwm") == 0) {
+		if((subdev = get_subdev(argv[1], PWM_INTERFACE_ID)) == NULL) return ESUBDEVID;
+		nof_channels = flink_subdevice_get_nofchannels(subdev);
+		if(strcmp(op, "period") == 0 && valid_channel(subdev, has_ch, ch) && has_value) {
+			return queue_write(subdev, base + PWM_FIRSTPWM_OFFSET + ch * REGISTER_WITH, value);
+		}
+		else if(strcmp(op, "hightime") == 0 && valid_channel(subdev, has_ch, ch) && has_value) {
+			return queue_write(subdev, base + PWM_FIRSTPWM_OFFSET + (nof_channels + ch) * REGISTER_WITH, value);
+		}
+		else if(strcmp(op, "get") == 0 && valid_channel(subdev, has_ch, ch)) {
+			uint32_t period, hightime;
+			if((ret = flush())) return ret;
+			if((ret = flink_pwm_get_period(subdev, ch, &period)) == 0 && (ret = flink_pwm_get_hightime(subdev, ch, &hightime)) == 0) {
+				printf("%u %u\n", period, hightime);
+			}
+		}
+		else return EPARAM;
+	}
+	else if(strcmp(module, "aout") == 0) {
+		if((subdev = get_subdev(argv[1], ANALOG_OUTPUT_INTERFACE_ID)) == NULL) return ESUBDEVID;
+		if(strcmp(op, "set") == 0 && valid_channel(subdev, has_ch, ch) && has_value) {
+			return queue_write(subdev, base + ANALOG_OUTPUT_FIRST_VALUE_OFFSET + ch * REGISTER_WITH, value);
+		}
+		else return EPARAM;
+	}
+	else if(strcmp(module, "sensor") == 0) {
+		if((subdev = get_subdev(argv[1], SENSOR_INTERFACE_ID)) == NULL) return ESUBDEVID;
+		nof_channels = flink_subdevice_get_nofchannels(subdev);
+		if(strcmp(op, "upper") == 0 && valid_channel(subdev, has_ch, ch) && has_value) {
+			return queue_write(subdev, base + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + (nof_channels + ch) * REGISTER_WITH, value);
+		}
+		else if(strcmp(op, "lower") == 0 && valid_channel(subdev, has_ch, ch) && has_value) {
+			return queue_write(subdev, base + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET + (2 * nof_channels + ch) * REGISTER_WITH, value);
+		}
+		else if(strcmp(op, "get") == 0 && valid_channel(subdev, has_ch, ch)) {
+			if((ret = flush())) return ret;
+			if((ret = flink_reflectivesensor_get_value(subdev, ch, &value)) == 0) printf("%u\n", value);
+		}
+		else return EPARAM;
+	}
+	else if(strcmp(module, "wd") == 0) {
+		if((subdev = get_subdev(argv[1], WD_INTERFACE_ID)) == NULL) return ESUBDEVID;
+		if(strcmp(op, "counter") == 0 && argc == 4 && parse_number(argv[3], &value)) {
+			return queue_write(subdev, base + REGISTER_WITH, value);
+		}
+		if((ret = flush())) return ret;
+		if(strcmp(op, "arm") == 0) ret = flink_wd_arm(subdev);
+		else if(strcmp(op, "status") == 0) {
+			if((ret = flink_wd_get_status(subdev, &bit)) == 0) printf("%u\n", bit);
+		}
+		else return EPARAM;
+	}
+	else {
+		// Modules without setters
+		if((ret = flush())) return ret;
+		if(strcmp(module, "ain") == 0 && strcmp(op, "get") == 0) {
+			if((subdev = get_subdev(argv[1], ANALOG_INPUT_INTERFACE_ID)) == NULL) return ESUBDEVID;
+			if(!valid_channel(subdev, has_ch, ch)) return EPARAM;
+			if((ret = flink_analog_in_get_value(subdev, ch, &value)) == 0) printf("%u\n", value);
+		}
+		else if(strcmp(module, "counter") == 0 && strcmp(op, "get") == 0) {
+			if((subdev = get_subdev(argv[1], COUNTER_INTERFACE_ID)) == NULL) return ESUBDEVID;
+			if(!valid_channel(subdev, has_ch, ch)) return EPARAM;
+			if((ret = flink_counter_get_count(subdev, ch, &value)) == 0) printf("%u\n", value);
+		}
+		else if(strcmp(module, "counter") == 0 && strcmp(op, "mode") == 0 && argc == 4 && parse_number(argv[3], &value)) {
+			if((subdev = get_subdev(argv[1], COUNTER_INTERFACE_ID)) == NULL) return ESUBDEVID;
+			ret = flink_counter_set_mode(subdev, value);
+		}
+		else if(strcmp(module, "ppwa") == 0 && strcmp(op, "get") == 0) {
+			uint32_t period, hightime;
+			if((subdev = get_subdev(argv[1], PPWA_INTERFACE_ID)) == NULL) return ESUBDEVID;
+			if(!valid_channel(subdev, has_ch, ch)) return EPARAM;
+			if((ret = flink_ppwa_get_period(subdev, ch, &period)) == 0 && (ret = flink_ppwa_get_hightime(subdev, ch, &hightime)) == 0) {
+				printf("%u %u\n", period, hightime);
+			}
+		}
+		else if(strcmp(module, "irqmux") == 0 && argc == 4 && parse_number(argv[2], &ch) && parse_number(argv[3], &value)) {
+			if((subdev = get_subdev(argv[1], IRQ_MULTIPLEXER_INTERFACE_ID)) == NULL) return ESUBDEVID;
+			if(!valid_channel(subdev, true, ch)) return EPARAM;
+			ret = flink_set_irq_multiplex(subdev, ch, value);
+		}
+		else return EPARAM;
+	}
+	nof_transfers++;
+	return ret == 0 ? 0 : EWRITE;
+}
+
+/**
+ * @brief Parses and runs a command line.
+ * @return int: 0 on success, error code otherwise.
+ */
+static int run_command(char* line) {
+	char*         argv[MAX_ARGS];
+	char*         save;
+	char*         tok;
+	int           argc = 0, error;
+	uint32_t      value;
+	flink_subdev* subdev;
+	struct timespec ts;
+
+	tok = strchr(line, '#');
+	if(tok) *tok = '\0';
+	for(tok = strtok_r(line, " \t\r\n", &save); tok && argc < MAX_ARGS; tok = strtok_r(NULL, " \t\r\n", &save)) argv[argc++] = tok;
+	if(argc == 0) return 0;
+	nof_commands++;
+
+	if(strcmp(argv[0], "open") == 0) {
+		if((error = flush())) return error;
+		return cmd_open(argc, argv);
+	}
+	if(dev == NULL) {
+		fprintf(stderr, "No device open!\n");
+		return EOPEN;
+	}
+	if(strcmp(argv[0], "sleep") == 0) {
+		if(argc != 2 || !parse_number(argv[1], &value)) return EPARAM;
+		if((error = flush())) return error;
+		ts.tv_sec = value / 1000;
+		ts.tv_nsec = (value % 1000) * 1000000L;
+		nanosleep(&ts, NULL);
+		return 0;
+	}
+	if(strcmp(argv[0], "flush") == 0) return flush();
+	if(strcmp(argv[0], "read") == 0 || strcmp(argv[0], "write") == 0 || strcmp(argv[0], "reset") == 0 || strcmp(argv[0], "info") == 0) {
+		if((subdev = get_subdev(argc > 1 ? argv[1] : NULL, 0xFFFF)) == NULL) return ESUBDEVID;
+		if(strcmp(argv[0], "write") == 0) return cmd_write(subdev, argc, argv);
+		if((error = flush())) return error;
+		if(strcmp(argv[0], "read") == 0) return cmd_read(subdev, argc, argv);
+		nof_transfers++;
+		if(strcmp(argv[0], "reset") == 0) return flink_subdevice_reset(subdev) == 0 ? 0 : EWRITE;
+		else {
+			char desc[INFO_DESC_SIZE];
+			if(flink_info_get_description(subdev, desc) != 0) return EREAD;
+			printf("%s\n", desc);
+			return 0;
+		}
+	}
+	if(argc < 2) return EPARAM;
+	return cmd_module(argv[0], argc, argv);
+}
+
+/**
+ * @brief Reports failed commands, a failed batch covers the commands which queued its registers.
+ * @param commands: Commands given as arguments, NULL for lines of a script or stdin.
+ * @param first: Number of the first failed command, starting at 1.
+ * @param last: Number of the last failed command.
+ */
+static void report_failure(char* commands[], int first, int last) {
+	if(commands && first == last) fprintf(stderr, "Command %d '%s' failed!\n", first, commands[first - 1]);
+	else if(commands) fprintf(stderr, "Commands %d to %d failed!\n", first, last);
+	else if(first == last) fprintf(stderr, "Line %d failed!\n", first);
+	else fprintf(stderr, "Lines %d to %d failed!\n", first, last);
+}
+
+int main(int argc, char* argv[]) {
+	FILE*  file = stdin;
+	char*  dev_name = DEFAULT_DEV;
+	char*  script = NULL;
+	char*  line = NULL;
+	size_t line_size = 0;
+	char*  arg;
+	bool   keep_going = false;
+	int    error = 0, result = EXIT_SUCCESS;
+	struct timespec start, end;
+
+	// Error message if long dashes (en dash) are used
+	int i;
+	for (i=0; i < argc; i++) {
+		 if ((argv[i][0] == 226) && (argv[i][1] == 128) && (argv[i][2] == 147)) {
+			fprintf(stderr, "Error: Invalid arguments. En dashes are used.\n");
+			return -1;
+		 }
+	}
+
+	/* Compute command line arguments */
+	int c;
+	while((c = getopt(argc, argv, "d:f:kv")) != -1) {
+		switch(c) {
+			case 'd': // device file
+				dev_name = optarg;
+				break;
+			case 'f': // command script
+				script = optarg;
+				break;
+			case 'k': // keep going after errors
+				keep_going = true;
+				break;
+			case 'v': // verbose
+				verbose = true;
+				break;
+			case '?':
+				if(optopt == 'd' || optopt == 'f') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+				else if(isprint(optopt)) fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+				return -1;
+			default:
+				abort();
+		}
+	}
+
+	// Open flink device
+	dev = flink_open(dev_name);
+	if(dev == NULL) {
+		fprintf(stderr, "Failed to open device %s!\n", dev_name);
+		return EOPEN;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// Commands are taken from the arguments, the script or stdin
+	if(optind < argc) {
+		for(i = optind; i < argc && (error == 0 || keep_going); i++) {
+			line_nr++;
+			failed_first = failed_last = line_nr;
+			arg = strdup(argv[i]);		// the command is split in place
+			error = arg ? run_command(arg) : EPARAM;
+			free(arg);
+			if(error) {
+				report_failure(argv + optind, failed_first, failed_last);
+				result = error;
+			}
+		}
+	}
+	else {
+		if(script) {
+			file = fopen(script, "r");
+			if(file == NULL) {
+				fprintf(stderr, "Failed to open script %s!\n", script);
+				flink_close(dev);
+				return EOPEN;
+			}
+		}
+		while((error == 0 || keep_going) && getline(&line, &line_size, file) != -1) {
+			line_nr++;
+			failed_first = failed_last = line_nr;
+			error = run_command(line);
+			if(error) {
+				report_failure(NULL, failed_first, failed_last);
+				result = error;
+			}
+		}
+		free(line);
+		if(file != stdin) fclose(file);
+	}
+	if(result == EXIT_SUCCESS || keep_going) {
+		error = flush();
+		if(error) {
+			report_failure(optind < argc ? argv + optind : NULL, failed_first, failed_last);
+			result = error;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if(verbose) {
+		fprintf(stderr, "%llu commands in %llu transfers, %.3f ms\n", (unsigned long long)nof_commands, (unsigned long long)nof_transfers,
+		        (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+	}
+
+	// Close flink device
+	flink_close(dev);
+
+	return result;
+}
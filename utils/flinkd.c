@@ -0,0 +1,421 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <flinklib.h>
+
+#define EOPEN     -1
+#define ESUBDEVID -2
+#define EREAD     -3
+#define EWRITE    -4
+#define EPARAM    -5
+
+#define DEFAULT_DEV    "/dev/flink0"
+#define DEFAULT_SOCKET "/run/flinkd.sock"
+#define MAX_CLIENTS    64
+#define READ_CHUNK     0x10000
+#define MAX_PENDING    0x100000	// received bytes per client at most, reading pauses above
+#define MAX_OUTPUT     0x400000	// unsent response bytes per client at most, requests wait above
+
+typedef struct _client {
+	int      fd;
+	bool     closed;
+	uint8_t* in;			// received bytes not yet handled
+	size_t   in_len, in_cap, in_used;
+	uint8_t* out;			// responses not yet sent
+	size_t   out_len, out_cap;
+} client;
+
+typedef struct _request {
+	client*                     c;
+	flink_remote_request        r;		// copied, requests in the receive buffer may be unaligned
+	const uint8_t*              data;
+	bool                        valid;	// access within the subdevice, may be merged
+} request;
+
+static volatile sig_atomic_t stop = 0;
+static flink_dev* dev;
+static uint8_t    nof_subdevices;
+static uint8_t    buf[FLINK_REMOTE_MAX_SIZE];
+static uint64_t   nof_requests = 0, nof_transfers = 0;
+
+static void on_signal(int sig) {
+	stop = 1;
+}
+
+static int reserve(uint8_t** p, size_t* cap, size_t size) {
+	uint8_t* n;
+	if(size <= *cap) return 0;
+	n = realloc(*p, size);
+	if(n == NULL) return -1;
+	*p = n;
+	*cap = size;
+	return 0;
+}
+
+static void respond(client* c, const flink_remote_request* r, int32_t result, const void* data, uint32_t size) {
+	flink_remote_response resp = { r->id, result, size };
+
+	if(c->closed) return;
+	if(reserve(&c->out, &c->out_cap, c->out_len + sizeof(resp) + size) < 0) {
+		c->closed = true;
+		return;
+	}
+	memcpy(c->out + c->out_len, &resp, sizeof(resp));
+	if(size) memcpy(c->out + c->out_len + sizeof(resp), data, size);
+	c->out_len += sizeof(resp) + size;
+}
+
+static int32_t result(ssize_t ret) {
+	if(ret >= 0) return ret;
+	return errno ? -errno : -EIO;
+}
+
+static bool is_read(const flink_remote_request* r) {
+	return r->cmd == FLINK_REMOTE_READ || r->cmd == FLINK_REMOTE_READ_BLOCK;
+}
+
+static bool is_write(const flink_remote_request* r) {
+	return r->cmd == FLINK_REMOTE_WRITE || r->cmd == FLINK_REMOTE_WRITE_BLOCK;
+}
+
+// Executes a single request
+static void execute(request* q) {
+	const flink_remote_request* r = &q->r;
+	flink_subdev* subdev;
+	flink_remote_subdev_info info;
+	ssize_t ret;
+	uint8_t bit;
+
+	errno = 0;
+	if(r->cmd == FLINK_REMOTE_NOF_SUBDEVICES) {
+		respond(q->c, r, nof_subdevices, NULL, 0);
+		return;
+	}
+	if(r->subdev >= nof_subdevices) {
+		respond(q->c, r, -EINVAL, NULL, 0);
+		return;
+	}
+	subdev = flink_get_subdevice_by_id(dev, r->subdev);
+	if(subdev == NULL) {
+		respond(q->c, r, -EINVAL, NULL, 0);
+		return;
+	}
+	if(r->cmd != FLINK_REMOTE_SUBDEVICE_INFO) nof_transfers++;
+	switch(r->cmd) {
+		case FLINK_REMOTE_SUBDEVICE_INFO:
+			info.function_id      = flink_subdevice_get_function(subdev);
+			info.sub_function_id  = flink_subdevice_get_subfunction(subdev);
+			info.function_version = flink_subdevice_get_function_version(subdev);
+			info.base_addr        = flink_subdevice_get_baseaddr(subdev);
+			info.mem_size         = flink_subdevice_get_memsize(subdev);
+			info.nof_channels     = flink_subdevice_get_nofchannels(subdev);
+			info.unique_id        = flink_subdevice_get_unique_id(subdev);
+			respond(q->c, r, 0, &info, sizeof(info));
+			break;
+		case FLINK_REMOTE_READ:
+		case FLINK_REMOTE_READ_BLOCK:
+			if(r->cmd == FLINK_REMOTE_READ && r->size <= UINT8_MAX) ret = flink_read(subdev, r->offset, r->size, buf);
+			else ret = flink_read_block(subdev, r->offset, r->size, buf);
+			respond(q->c, r, result(ret), buf, ret > 0 ? ret : 0);
+			break;
+		case FLINK_REMOTE_WRITE:
+		case FLINK_REMOTE_WRITE_BLOCK:
+			if(r->cmd == FLINK_REMOTE_WRITE && r->size <= UINT8_MAX) ret = flink_write(subdev, r->offset, r->size, (void*)q->data);
+			else ret = flink_write_block(subdev, r->offset, r->size, q->data);
+			respond(q->c, r, result(ret), NULL, 0);
+			break;
+		case FLINK_REMOTE_READ_BIT:
+			bit = 0;
+			ret = flink_read_bit(subdev, r->offset, r->bit, &bit);
+			respond(q->c, r, result(ret), &bit, ret < 0 ? 0 : 1);
+			break;
+		case FLINK_REMOTE_WRITE_BIT:
+			bit = r->value;
+			respond(q->c, r, result(flink_write_bit(subdev, r->offset, r->bit, &bit)), NULL, 0);
+			break;
+		default:
+			respond(q->c, r, -ENOTSUP, NULL, 0);
+			break;
+	}
+}
+
+// Executes requests q[0..n-1], adjacent or overlapping reads or adjacent writes of one subdevice, in one transfer
+static void execute_merged(request* q, int n, uint32_t start, uint32_t end) {
+	flink_subdev* subdev;
+	ssize_t ret;
+	int i;
+
+	if(q[0].r.subdev >= nof_subdevices) {
+		for(i = 0; i < n; i++) respond(q[i].c, &q[i].r, -EINVAL, NULL, 0);
+		return;
+	}
+	subdev = flink_get_subdevice_by_id(dev, q[0].r.subdev);
+	errno = 0;
+	nof_transfers++;
+	if(is_read(&q[0].r)) {
+		ret = flink_read_block(subdev, start, end - start, buf);
+		for(i = 0; i < n; i++) {
+			respond(q[i].c, &q[i].r, ret < 0 ? result(ret) : (int32_t)q[i].r.size, buf + q[i].r.offset - start, ret < 0 ? 0 : q[i].r.size);
+		}
+	}
+	else {
+		for(i = 0; i < n; i++) memcpy(buf + q[i].r.offset - start, q[i].data, q[i].r.size);
+		ret = flink_write_block(subdev, start, end - start, buf);
+		for(i = 0; i < n; i++) respond(q[i].c, &q[i].r, ret < 0 ? result(ret) : (int32_t)q[i].r.size, NULL, 0);
+	}
+}
+
+// Executes the requests of all clients, merging runs of compatible requests
+static void execute_batch(request* q, int n) {
+	uint32_t start, end;
+	int i = 0, j;
+
+	while(i < n) {
+		if(!q[i].valid || !(is_read(&q[i].r) || is_write(&q[i].r))) {
+			execute(&q[i++]);
+			continue;
+		}
+		start = q[i].r.offset;
+		end = start + q[i].r.size;
+		for(j = i + 1; j < n && q[j].valid && q[j].r.subdev == q[i].r.subdev; j++) {
+			if(is_read(&q[i].r)) {
+				if(!is_read(&q[j].r) || q[j].r.offset < start || q[j].r.offset > end) break;
+				if(q[j].r.offset + q[j].r.size > end) {
+					if(q[j].r.offset + q[j].r.size - start > FLINK_REMOTE_MAX_SIZE) break;
+					end = q[j].r.offset + q[j].r.size;
+				}
+			}
+			else {
+				if(!is_write(&q[j].r) || q[j].r.offset != end || end + q[j].r.size - start > FLINK_REMOTE_MAX_SIZE) break;
+				end += q[j].r.size;
+			}
+		}
+		if(j - i == 1) execute(&q[i]);
+		else execute_merged(&q[i], j - i, start, end);
+		i = j;
+	}
+}
+
+// Nof bytes of the response to a request at most
+static size_t response_size(const flink_remote_request* r) {
+	if(is_read(r)) return sizeof(flink_remote_response) + r->size;
+	return sizeof(flink_remote_response) + sizeof(flink_remote_subdev_info);
+}
+
+// Moves the complete requests of a client into the batch, as long as their responses fit into the output buffer
+static int parse(client* c, request** batch, int* n, int* cap) {
+	flink_remote_request req;
+	const flink_remote_request* r;
+	flink_subdev* subdev;
+	request* q;
+	size_t pos = 0, size, out = c->out_len;
+
+	while(c->in_len - pos >= sizeof(flink_remote_request)) {
+		memcpy(&req, c->in + pos, sizeof(req));
+		r = &req;
+		if(r->cmd >= FLINK_NOF_REMOTE_CMDS || r->size > FLINK_REMOTE_MAX_SIZE) return -1;
+		size = sizeof(flink_remote_request) + (is_write(r) ? r->size : 0);
+		if(c->in_len - pos < size) break;
+		if(out > 0 && out + response_size(r) > MAX_OUTPUT) break;	// client does not read its responses
+		out += response_size(r);
+
+		if(*n == *cap) {
+			q = realloc(*batch, (*cap * 2 + 16) * sizeof(request));
+			if(q == NULL) return -1;
+			*batch = q;
+			*cap = *cap * 2 + 16;
+		}
+		q = &(*batch)[(*n)++];
+		q->c = c;
+		q->r = req;
+		q->data = c->in + pos + sizeof(flink_remote_request);
+		subdev = r->subdev < nof_subdevices ? flink_get_subdevice_by_id(dev, r->subdev) : NULL;
+		q->valid = subdev && r->size > 0 && (uint64_t)r->offset + r->size <= flink_subdevice_get_memsize(subdev);
+		nof_requests++;
+		pos += size;
+	}
+	c->in_used = pos;
+	return 0;
+}
+
+static void receive(client* c) {
+	ssize_t ret;
+
+	while(!c->closed && c->in_len < MAX_PENDING) {
+		if(reserve(&c->in, &c->in_cap, c->in_len + READ_CHUNK) < 0) {
+			c->closed = true;
+			break;
+		}
+		ret = read(c->fd, c->in + c->in_len, c->in_cap - c->in_len);
+		if(ret > 0) c->in_len += ret;
+		else if(ret < 0 && errno == EINTR) continue;
+		else {
+			if(ret == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) c->closed = true;
+			break;
+		}
+	}
+}
+
+static void transmit(client* c) {
+	ssize_t ret;
+	size_t pos = 0;
+
+	while(!c->closed && pos < c->out_len) {
+		ret = send(c->fd, c->out + pos, c->out_len - pos, MSG_NOSIGNAL);
+		if(ret > 0) pos += ret;
+		else if(ret < 0 && errno == EINTR) continue;
+		else {
+			if(errno != EAGAIN && errno != EWOULDBLOCK) c->closed = true;
+			break;
+		}
+	}
+	memmove(c->out, c->out + pos, c->out_len - pos);
+	c->out_len -= pos;
+}
+
+static void free_client(client* c) {
+	close(c->fd);
+	free(c->in);
+	free(c->out);
+}
+
+int main(int argc, char* argv[]) {
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	struct pollfd pfd[MAX_CLIENTS + 1];
+	client   clients[MAX_CLIENTS];
+	request* batch = NULL;
+	char*    dev_name = DEFAULT_DEV;
+	char*    socket_name = DEFAULT_SOCKET;
+	bool     verbose = false;
+	int      nof_clients = 0, n, cap = 0, fd, lfd, k;
+
+	// Error message if long dashes (en dash) are used
+	int i;
+	for (i=0; i < argc; i++) {
+		 if ((argv[i][0] == 226) && (argv[i][1] == 128) && (argv[i][2] == 147)) {
+			fprintf(stderr, "Error: Invalid arguments. En dashes are used.\n");
+			return -1;
+		 }
+	}
+
+	/* Compute command line arguments */
+	int c;
+	while((c = getopt(argc, argv, "d:s:v")) != -1) {
+		switch(c) {
+			case 'd': // device file
+				dev_name = optarg;
+				break;
+			case 's': // socket
+				socket_name = optarg;
+				break;
+			case 'v': // verbose
+				verbose = true;
+				break;
+			case '?':
+				if(optopt == 'd' || optopt == 's') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+				else if(isprint(optopt)) fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+				return -1;
+			default:
+				abort();
+		}
+	}
+	if(strlen(socket_name) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket name %s too long!\n", socket_name);
+		return EPARAM;
+	}
+
+	// Open flink device
+	dev = flink_open(dev_name);
+	if(dev == NULL) {
+		fprintf(stderr, "Failed to open device %s!\n", dev_name);
+		return EOPEN;
+	}
+	nof_subdevices = flink_get_nof_subdevices(dev);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_name);
+	unlink(socket_name);
+	lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if(lfd < 0 || bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(lfd, MAX_CLIENTS) < 0) {
+		fprintf(stderr, "Failed to listen on %s: %s\n", socket_name, strerror(errno));
+		flink_close(dev);
+		return EOPEN;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	if(verbose) printf("Serving %s on %s\n", dev_name, socket_name);
+
+	while(!stop) {
+		pfd[0].fd = lfd;
+		pfd[0].events = nof_clients < MAX_CLIENTS ? POLLIN : 0;
+		for(k = 0; k < nof_clients; k++) {
+			pfd[k + 1].fd = clients[k].fd;
+			pfd[k + 1].events = (clients[k].in_len < MAX_PENDING ? POLLIN : 0) | (clients[k].out_len ? POLLOUT : 0);
+		}
+		if(poll(pfd, nof_clients + 1, -1) < 0) {
+			if(errno == EINTR) continue;
+			break;
+		}
+
+		// Requests of all clients which arrived meanwhile form one batch
+		n = 0;
+		for(k = 0; k < nof_clients; k++) {
+			if(pfd[k + 1].revents & (POLLIN | POLLHUP | POLLERR)) receive(&clients[k]);
+			if(!clients[k].closed && parse(&clients[k], &batch, &n, &cap) < 0) clients[k].closed = true;
+		}
+		execute_batch(batch, n);
+		for(k = 0; k < nof_clients; k++) {
+			memmove(clients[k].in, clients[k].in + clients[k].in_used, clients[k].in_len - clients[k].in_used);
+			clients[k].in_len -= clients[k].in_used;
+			clients[k].in_used = 0;
+			transmit(&clients[k]);
+		}
+
+		// Remove closed clients
+		for(k = 0; k < nof_clients; k++) {
+			if(!clients[k].closed) continue;
+			free_client(&clients[k]);
+			clients[k--] = clients[--nof_clients];
+			if(verbose) printf("Client disconnected, %d connected\n", nof_clients);
+		}
+
+		// Accept new clients
+		if(pfd[0].revents & POLLIN) {
+			while(nof_clients < MAX_CLIENTS && (fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+				memset(&clients[nof_clients], 0, sizeof(client));
+				clients[nof_clients++].fd = fd;
+				if(verbose) printf("Client connected, %d connected\n", nof_clients);
+			}
+		}
+	}
+
+	if(verbose) {
+		printf("%llu requests in %llu device transfers\n", (unsigned long long)nof_requests, (unsigned long long)nof_transfers);
+	}
+	for(k = 0; k < nof_clients; k++) free_client(&clients[k]);
+	free(batch);
+	close(lfd);
+	unlink(socket_name);
+
+	// Close flink device
+	flink_close(dev);
+	return EXIT_SUCCESS;
+}
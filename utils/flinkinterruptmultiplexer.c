@@ -5,6 +5,7 @@
 #include <ctype.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <string.h>
 
 #include <flinklib.h>
 
@@ -16,6 +17,39 @@
 
 #define DEFAULT_DEV "/dev/flink0"
 
+/**
+ * Reads a mapping file into the multiplexer table. Each line holds a destination
+ * irq and a flink irq, separated by whitespace. Lines starting with '#' are ignored.
+ */
+static int load_mapping(const char* file_name, uint32_t* table, uint32_t nof_irqs, bool verbose) {
+	FILE*    file;
+	char     line[128];
+	unsigned irq, flink_irq;
+	int      line_nr = 0;
+
+	file = fopen(file_name, "r");
+	if(file == NULL) {
+		fprintf(stderr, "Failed to open mapping file %s!\n", file_name);
+		return -1;
+	}
+	while(fgets(line, sizeof(line), file) != NULL) {
+		line_nr++;
+		char* p = line + strspn(line, " \t");
+		if(*p == '#' || *p == '\n' || *p == '\0') continue;
+		if(sscanf(p, "%u %u", &irq, &flink_irq) != 2 || irq >= nof_irqs) {
+			fprintf(stderr, "%s:%d: invalid mapping!\n", file_name, line_nr);
+			fclose(file);
+			return -1;
+		}
+		if(verbose && table[irq] != flink_irq) {
+			printf("IRQ Nr: %u changes from flink irq %u to %u\n", irq, table[irq], flink_irq);
+		}
+		table[irq] = flink_irq;
+	}
+	fclose(file);
+	return 0;
+}
+
 int main(int argc, char* argv[]) {
 	flink_dev*    dev;
 	flink_subdev* subdev;
@@ -26,6 +60,7 @@ int main(int argc, char* argv[]) {
 	bool          verbose = false;
 	int           error = 0;
 	uint32_t      signal_offset;
+	char*         map_file = NULL;
 	
 	// Error message if long dashes (en dash) are used
 	int i;
@@ -38,7 +73,7 @@ int main(int argc, char* argv[]) {
 	
 	/* Compute command line arguments */
 	int c;
-	while((c = getopt(argc, argv, "d:s:i:f:v")) != -1) {
+	while((c = getopt(argc, argv, "d:s:i:f:m:v")) != -1) {
 		switch(c) {
 			case 'd': // device file
 				dev_name = optarg;
@@ -52,11 +87,14 @@ int main(int argc, char* argv[]) {
 			case 'f': // flink irq
 				flink_irq_nr = atoi(optarg);
 				break;
+			case 'm': // mapping file
+				map_file = optarg;
+				break;
 			case 'v':
 				verbose = true;
 				break;
 			case '?':
-				if(optopt == 'd' || optopt == 'i' || optopt == 'f') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+				if(optopt == 'd' || optopt == 'i' || optopt == 'f' || optopt == 'm') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
 				else if(isprint(optopt)) fprintf (stderr, "Unknown option `-%c'.\n", optopt);
 				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
 				return EPARAM;
@@ -86,6 +124,27 @@ int main(int argc, char* argv[]) {
 		return ESUBDEVID;
 	}
 
+	// load a whole mapping
+	if(map_file != NULL) {
+		uint32_t nof_irqs = flink_subdevice_get_nofchannels(subdev);
+		uint32_t table[nof_irqs];
+		error = flink_get_irq_multiplex_table(subdev, table);
+		if(error != 0) {
+			printf("Could not read IRQ table. error: %d!\n", error);
+			return EREAD;
+		}
+		if(load_mapping(map_file, table, nof_irqs, verbose) != 0) {
+			return EPARAM;
+		}
+		error = flink_set_irq_multiplex_table(subdev, table);
+		if(error != 0) {
+			printf("Could not set IRQ table. error: %d!\n", error);
+			return EWRITE;
+		}
+		flink_close(dev);
+		return EXIT_SUCCESS;
+	}
+
 	// set the irq
 	error = flink_set_irq_multiplex(subdev, irq_nr, flink_irq_nr);
 	if(error != 0) {
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+
+#include <flinklib.h>
+
+#define EOPEN     -1
+#define ESUBDEVID -2
+#define EREAD     -3
+#define EPARAM    -5
+
+#define DEFAULT_DEV      "/dev/flink0"
+#define DEFAULT_RATE     100		// Hz, sample rate of changing channels
+#define DEFAULT_MIN_RATE 1			// Hz, sample rate of constant channels
+#define MAX_GROUPS       512
+#define DISPLAY_NS       250000000ULL
+
+// Consecutive registers of a subdevice, one per channel, read together
+typedef struct _channel {
+	uint32_t value;
+	uint32_t min;
+	uint32_t max;
+	double   rate;			/// Change per second between the last two samples
+	uint64_t sample_ns;		/// Time of the last sample
+	uint64_t interval_ns;	/// Current sample interval, adapted to the activity of the channel
+	uint64_t next_ns;		/// Time the channel is due
+	bool     valid;
+} channel;
+
+typedef struct _group {
+	flink_subdev* subdev;
+	const char*   name;
+	uint32_t      offset;
+	uint32_t      nof_channels;
+	bool          hex;
+	channel*      channels;
+	uint32_t*     buf;
+} group;
+
+static group    groups[MAX_GROUPS];
+static uint32_t nof_groups = 0;
+static uint64_t min_interval, max_interval;
+static uint64_t nof_reads = 0, nof_bytes = 0;
+static volatile sig_atomic_t stop = 0;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void handle_signal(int sig) {
+	stop = 1;
+}
+
+static void add_group(flink_subdev* subdev, const char* name, uint32_t offset, uint32_t nof_channels, bool hex) {
+	uint32_t memsize = flink_subdevice_get_memsize(subdev);
+	group* g;
+
+	if(nof_groups >= MAX_GROUPS || nof_channels == 0 || offset >= memsize) return;
+	if(offset + nof_channels * REGISTER_WITH > memsize) nof_channels = (memsize - offset) / REGISTER_WITH;
+	g = &groups[nof_groups];
+	g->channels = calloc(nof_channels, sizeof(channel));
+	g->buf = calloc(nof_channels, REGISTER_WITH);
+	if(g->channels == NULL || g->buf == NULL) {
+		free(g->channels);
+		free(g->buf);
+		return;
+	}
+	g->subdev = subdev;
+	g->name = name;
+	g->offset = offset;
+	g->nof_channels = nof_channels;
+	g->hex = hex;
+	nof_groups++;
+}
+
+/**
+ * @brief Adds the readable registers of a subdevice, with the register layout used by the library.
+ */
+static void add_subdevice(flink_subdev* subdev) {
+	uint32_t base = HEADER_SIZE + SUBHEADER_SIZE;
+	uint32_t n = flink_subdevice_get_nofchannels(subdev);
+	uint32_t words = n ? (n - 1) / (REGISTER_WITH * 8) + 1 : 0;
+
+	switch(flink_subdevice_get_function(subdev)) {
+		case ANALOG_INPUT_INTERFACE_ID:
+			add_group(subdev, "value", base + ANALOG_INPUT_FIRST_VALUE_OFFSET, n, false);
+			break;
+		case COUNTER_INTERFACE_ID:
+			add_group(subdev, "count", base, n, false);
+			break;
+		case GPIO_INTERFACE_ID:
+			// One register holds the values of 32 channels
+			add_group(subdev, "value", base + 4 + words * REGISTER_WITH, words, true);
+			break;
+		case PWM_INTERFACE_ID:
+			add_group(subdev, "period", base + PWM_FIRSTPWM_OFFSET, n, false);
+			add_group(subdev, "hightime", base + PWM_FIRSTPWM_OFFSET + n * REGISTER_WITH, n, false);
+			break;
+		case PPWA_INTERFACE_ID:
+			add_group(subdev, "period", base + PPWA_FIRSTPPWA_OFFSET, n, false);
+			add_group(subdev, "hightime", base + PPWA_FIRSTPPWA_OFFSET + n * REGISTER_WITH, n, false);
+			break;
+		case SENSOR_INTERFACE_ID:
+			add_group(subdev, "value", base + REFLECTIVE_SENSOR_FIRST_VALUE_OFFSET, n, false);
+			break;
+		case WD_INTERFACE_ID:
+			add_group(subdev, "status", STATUS_OFFSET, 1, true);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * @brief Reads the span of all due channels of a group in one transfer.
+ * @return int: Nof channels sampled or -1 in case of failure.
+ */
+static int sample_group(group* g, uint64_t now, FILE* csv, uint64_t start) {
+	uint32_t first = g->nof_channels, last = 0, i;
+	channel* c;
+	uint32_t size;
+
+	for(i = 0; i < g->nof_channels; i++) {
+		if(g->channels[i].next_ns <= now) {
+			if(first == g->nof_channels) first = i;
+			last = i;
+		}
+	}
+	if(first == g->nof_channels) return 0;
+
+	size = (last - first + 1) * REGISTER_WITH;
+	if(flink_read_block(g->subdev, g->offset + first * REGISTER_WITH, size, &g->buf[first]) != size) return -1;
+	nof_reads++;
+	nof_bytes += size;
+	now = now_ns();
+
+	// Channels inside the span are sampled as well, even if not yet due
+	for(i = first; i <= last; i++) {
+		c = &g->channels[i];
+		if(!c->valid) {
+			c->min = c->max = g->buf[i];
+			c->interval_ns = min_interval;
+			c->valid = true;
+		}
+		else if(g->buf[i] != c->value) {
+			c->rate = ((double)g->buf[i] - c->value) * 1e9 / (now - c->sample_ns);
+			c->interval_ns = c->interval_ns / 2 > min_interval ? c->interval_ns / 2 : min_interval;
+		}
+		else {
+			c->rate = 0;
+			c->interval_ns = c->interval_ns * 2 < max_interval ? c->interval_ns * 2 : max_interval;
+		}
+		if(g->buf[i] < c->min) c->min = g->buf[i];
+		if(g->buf[i] > c->max) c->max = g->buf[i];
+		c->value = g->buf[i];
+		c->sample_ns = now;
+		c->next_ns = now + c->interval_ns;
+		if(csv) fprintf(csv, "%.6f,%u,%s,%u,%u\n", (now - start) / 1e9, flink_subdevice_get_id(g->subdev), g->name, i, c->value);
+	}
+	return last - first + 1;
+}
+
+static void display(const char* dev_name, double elapsed, double reads_per_s, double bytes_per_s) {
+	uint32_t i, j;
+	group* g;
+	channel* c;
+
+	printf("\033[H\033[2J");
+	printf("flinkmon %s  %.1f s  %.0f reads/s  %.1f kB/s\n\n", dev_name, elapsed, reads_per_s, bytes_per_s / 1e3);
+	printf("%6s %-22s %-8s %4s %12s %12s %12s %12s %9s\n", "subdev", "function", "register", "ch", "value", "rate/s", "min", "max", "period ms");
+	for(i = 0; i < nof_groups; i++) {
+		g = &groups[i];
+		for(j = 0; j < g->nof_channels; j++) {
+			c = &g->channels[j];
+			printf("%6u %-22.22s %-8s %4u ", flink_subdevice_get_id(g->subdev), flink_subdevice_id2str(flink_subdevice_get_function(g->subdev)), g->name, j);
+			if(g->hex) printf("  0x%08x %12.0f   0x%08x   0x%08x", c->value, c->rate, c->min, c->max);
+			else printf("%12u %12.0f %12u %12u", c->value, c->rate, c->min, c->max);
+			printf(" %9.1f\n", c->interval_ns / 1e6);
+		}
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+	flink_dev*  dev;
+	FILE*       csv = NULL;
+	char*       dev_name = DEFAULT_DEV;
+	char*       csv_name = NULL;
+	double      rate = DEFAULT_RATE, min_rate = DEFAULT_MIN_RATE, duration = 0;
+	bool        quiet = false;
+	uint64_t    start, now, next, next_display, last_display, last_reads = 0, last_bytes = 0;
+	struct timespec ts;
+	uint32_t    g;
+	int         nof_subdevices, error = 0;
+
+	// Error message if long dashes (en dash) are used
+	int i;
+	for (i=0; i < argc; i++) {
+		 if ((argv[i][0] == 226) && (argv[i][1] == 128) && (argv[i][2] == 147)) {
+			fprintf(stderr, "Error: Invalid arguments. En dashes are used.\n");
+			return -1;
+		 }
+	}
+
+	/* Compute command line arguments */
+	int c;
+	while((c = getopt(argc, argv, "d:r:m:l:t:q")) != -1) {
+		switch(c) {
+			case 'd': // device file
+				dev_name = optarg;
+				break;
+			case 'r': // sample rate of changing channels
+				rate = atof(optarg);
+				break;
+			case 'm': // sample rate of constant channels
+				min_rate = atof(optarg);
+				break;
+			case 'l': // CSV log file
+				csv_name = optarg;
+				break;
+			case 't': // duration in seconds
+				duration = atof(optarg);
+				break;
+			case 'q': // no display, only log
+				quiet = true;
+				break;
+			case '?':
+				if(optopt == 'd' || optopt == 'r' || optopt == 'm' || optopt == 'l' || optopt == 't') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+				else if(isprint(optopt)) fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+				return -1;
+			default:
+				abort();
+		}
+	}
+	if(rate <= 0 || min_rate <= 0 || min_rate > rate) {
+		fprintf(stderr, "Invalid sample rates!\n");
+		return EPARAM;
+	}
+	min_interval = 1e9 / rate;
+	max_interval = 1e9 / min_rate;
+
+	// Open flink device
+	dev = flink_open(dev_name);
+	if(dev == NULL) {
+		fprintf(stderr, "Failed to open device %s!\n", dev_name);
+		return EOPEN;
+	}
+	nof_subdevices = flink_get_nof_subdevices(dev);
+	for(i = 0; i < nof_subdevices; i++) add_subdevice(flink_get_subdevice_by_id(dev, i));
+	if(nof_groups == 0) {
+		fprintf(stderr, "No readable subdevice on %s!\n", dev_name);
+		flink_close(dev);
+		return ESUBDEVID;
+	}
+
+	if(csv_name) {
+		csv = fopen(csv_name, "w");
+		if(csv == NULL) {
+			fprintf(stderr, "Failed to open log file %s!\n", csv_name);
+			flink_close(dev);
+			return EOPEN;
+		}
+		fprintf(csv, "time,subdev,register,channel,value\n");
+	}
+
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+	start = last_display = now_ns();
+	next_display = start;
+	while(!stop && error == 0) {
+		now = now_ns();
+		if(duration > 0 && now - start >= duration * 1e9) break;
+		for(g = 0; g < nof_groups; g++) {
+			if(sample_group(&groups[g], now, csv, start) < 0) {
+				fprintf(stderr, "Reading subdevice %u failed!\n", flink_subdevice_get_id(groups[g].subdev));
+				error = EREAD;
+				break;
+			}
+		}
+		now = now_ns();
+		if(!quiet && now >= next_display) {
+			display(dev_name, (now - start) / 1e9, (nof_reads - last_reads) * 1e9 / (now - last_display + 1), (nof_bytes - last_bytes) * 1e9 / (now - last_display + 1));
+			last_reads = nof_reads;
+			last_bytes = nof_bytes;
+			last_display = now;
+			next_display = now + DISPLAY_NS;
+		}
+
+		// Sleep until the next channel is due
+		next = quiet ? UINT64_MAX : next_display;
+		for(g = 0; g < nof_groups; g++) {
+			for(i = 0; i < (int)groups[g].nof_channels; i++) {
+				if(groups[g].channels[i].next_ns < next) next = groups[g].channels[i].next_ns;
+			}
+		}
+		if(next > now) {
+			ts.tv_sec = next / 1000000000ULL;
+			ts.tv_nsec = next % 1000000000ULL;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		}
+	}
+
+	if(csv) fclose(csv);
+	if(!quiet) printf("%llu reads, %llu bytes\n", (unsigned long long)nof_reads, (unsigned long long)nof_bytes);
+
+	// Close flink device
+	for(g = 0; g < nof_groups; g++) {
+		free(groups[g].channels);
+		free(groups[g].buf);
+	}
+	flink_close(dev);
+
+	return error;
+}
@@ -54,6 +54,7 @@ int main(int argc, char* argv[]) {
 	uint32_t      value = 0;
 	uint32_t      upperlevel, lowerlevel;
 	bool          lower = false, upper= false;
+	uint32_t      calibration_samples = 0;
 	
 	// Error message if long dashes (en dash) are used
 	int i;
@@ -66,7 +67,7 @@ int main(int argc, char* argv[]) {
 	
 	/* Compute command line arguments */
 	int c;
-	while((c = getopt(argc, argv, "d:s:c:u:l:v")) != -1) {
+	while((c = getopt(argc, argv, "d:s:c:u:l:a:v")) != -1) {
 		switch(c) {
 			case 'd': // device file
 				dev_name = optarg;
@@ -85,11 +86,14 @@ int main(int argc, char* argv[]) {
 				lowerlevel = atoi(optarg);
 				lower = true;
 				break;
+			case 'a': // auto calibration
+				calibration_samples = atoi(optarg);
+				break;
 			case 'v':
 				verbose = true;
 				break;
 			case '?':
-				if(optopt == 'd' || optopt == 's' || optopt == 'c') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+				if(optopt == 'd' || optopt == 's' || optopt == 'c' || optopt == 'a') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
 				else if(isprint(optopt)) fprintf (stderr, "Unknown option `-%c'.\n", optopt);
 				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
 				return EPARAM;
@@ -119,6 +123,20 @@ int main(int argc, char* argv[]) {
 		return ESUBDEVID;
 	}
 
+	// calibrate the levels of all channels
+	if (calibration_samples > 0) {
+		uint32_t nof_channels = flink_subdevice_get_nofchannels(subdev);
+		uint32_t upper_levels[nof_channels], lower_levels[nof_channels];
+		error = flink_reflectivesensor_calibrate(subdev, calibration_samples, 1000, 20, upper_levels, lower_levels);
+		if(error != 0) {
+			printf("Calibrating subdevice failed!\n");
+			return EWRITE;
+		}
+		for(i = 0; i < nof_channels; i++) {
+			printf("Channel %u calibrated: Upper Bound: %u, Lower Bound: %u\n", i, upper_levels[i], lower_levels[i]);
+		}
+	}
+
 	// set and get hysteresis
 	error = 0;
 	if (upper) {
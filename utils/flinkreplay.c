@@ -0,0 +1,275 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include <flinklib.h>
+
+#define EOPEN     -1
+#define ESUBDEVID -2
+#define EREAD     -3
+#define EWRITE    -4
+#define EPARAM    -5
+
+#define DEFAULT_DEV "/dev/flink0"
+#define MAX_DEVICES 16
+#define SPIN_NS     100000
+
+typedef struct _op_result {
+	uint64_t count;
+	uint64_t errors;
+	uint64_t total_ns;
+	uint64_t max_ns;
+} op_result;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t) {
+	struct timespec ts;
+	// Sleeping is too coarse for short gaps, spin for the last part
+	if(t > now_ns() + SPIN_NS) {
+		ts.tv_sec = (t - SPIN_NS) / 1000000000ULL;
+		ts.tv_nsec = (t - SPIN_NS) % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+	while(now_ns() < t);
+}
+
+static void check_device(flink_dev* dev, const char* dev_name, uint16_t index, const flink_record_entry* e, const uint16_t* functions) {
+	flink_subdev* subdev;
+	int nof_subdevices = flink_get_nof_subdevices(dev);
+	uint8_t i;
+
+	if(nof_subdevices != e->subdev) {
+		fprintf(stderr, "Warning: recorded device %u had %u subdevices, %s has %d!\n", index, e->subdev, dev_name, nof_subdevices);
+	}
+	for(i = 0; i < e->subdev && i < nof_subdevices; i++) {
+		subdev = flink_get_subdevice_by_id(dev, i);
+		if(flink_subdevice_get_function(subdev) != functions[i]) {
+			fprintf(stderr, "Warning: subdevice %u of recorded device %u had function 0x%x, on %s it has 0x%x!\n",
+			        i, index, functions[i], dev_name, flink_subdevice_get_function(subdev));
+		}
+	}
+}
+
+static ssize_t replay(flink_subdev* subdev, const flink_record_entry* e, void* data, void* buf, bool compare, uint64_t* mismatches) {
+	ssize_t ret;
+	uint8_t bit;
+
+	switch(e->op) {
+		case FLINK_OP_READ:
+			ret = flink_read(subdev, e->offset, e->size, buf);
+			break;
+		case FLINK_OP_WRITE:
+			return flink_write(subdev, e->offset, e->size, data);
+		case FLINK_OP_READ_BIT:
+			ret = flink_read_bit(subdev, e->offset, e->bit, buf);
+			break;
+		case FLINK_OP_WRITE_BIT:
+			bit = *(uint8_t*)data;
+			return flink_write_bit(subdev, e->offset, e->bit, &bit);
+		case FLINK_OP_READ_BLOCK:
+			ret = flink_read_block(subdev, e->offset, e->size, buf);
+			break;
+		case FLINK_OP_WRITE_BLOCK:
+			return flink_write_block(subdev, e->offset, e->size, data);
+		default:
+			return -1;
+	}
+	if(ret >= 0 && compare && memcmp(buf, data, e->size) != 0) (*mismatches)++;
+	return ret;
+}
+
+int main(int argc, char* argv[]) {
+	flink_record_header header;
+	flink_record_entry  e;
+	flink_subdev* subdev;
+	flink_dev*    devs[MAX_DEVICES];
+	const char*   dev_names[MAX_DEVICES];
+	flink_dev*    recorded[MAX_DEVICES] = { NULL };
+	op_result     results[FLINK_NOF_OPS];
+	FILE*         file;
+	char*         file_name = NULL;
+	uint8_t*      data = NULL;
+	uint8_t*      buf = NULL;
+	uint32_t      buf_size = 0;
+	uint32_t      nof_devs = 0;
+	uint64_t      first = 0, start = 0, t0, ns, total = 0, mismatches = 0, late = 0, max_late = 0;
+	double        speed = 0;	// 0: as fast as possible
+	bool          compare = false;
+	bool          verbose = false;
+	int           error = 0;
+
+	// Error message if long dashes (en dash) are used
+	int i;
+	for (i=0; i < argc; i++) {
+		 if ((argv[i][0] == 226) && (argv[i][1] == 128) && (argv[i][2] == 147)) {
+			fprintf(stderr, "Error: Invalid arguments. En dashes are used.\n");
+			return -1;
+		 }
+	}
+
+	/* Compute command line arguments */
+	int c;
+	while((c = getopt(argc, argv, "d:f:ts:cv")) != -1) {
+		switch(c) {
+			case 'd': // device file, one per recorded device
+				if(nof_devs >= MAX_DEVICES) {
+					fprintf(stderr, "Too many devices!\n");
+					return EPARAM;
+				}
+				dev_names[nof_devs++] = optarg;
+				break;
+			case 'f': // record file
+				file_name = optarg;
+				break;
+			case 't': // original timing
+				if(speed == 0) speed = 1;
+				break;
+			case 's': // original timing, sped up by a factor
+				speed = atof(optarg);
+				if(speed <= 0) {
+					fprintf(stderr, "Invalid speed factor %s!\n", optarg);
+					return EPARAM;
+				}
+				break;
+			case 'c': // compare read values
+				compare = true;
+				break;
+			case 'v': // verbose
+				verbose = true;
+				break;
+			case '?':
+				if(optopt == 'd' || optopt == 'f' || optopt == 's') fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+				else if(isprint(optopt)) fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+				else fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+				return -1;
+			default:
+				abort();
+		}
+	}
+	if(file_name == NULL) {
+		fprintf(stderr, "No record file given, use -f file!\n");
+		return EPARAM;
+	}
+	if(nof_devs == 0) dev_names[nof_devs++] = DEFAULT_DEV;
+
+	file = fopen(file_name, "rb");
+	if(file == NULL) {
+		fprintf(stderr, "Failed to open record file %s!\n", file_name);
+		return EOPEN;
+	}
+	if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, FLINK_RECORD_MAGIC, sizeof(header.magic)) != 0 ||
+	   header.version != FLINK_RECORD_VERSION) {
+		fprintf(stderr, "%s is no flink record file of version %u!\n", file_name, FLINK_RECORD_VERSION);
+		fclose(file);
+		return EPARAM;
+	}
+
+	// Open flink devices
+	for(i = 0; i < (int)nof_devs; i++) {
+		devs[i] = flink_open(dev_names[i]);
+		if(devs[i] == NULL) {
+			fprintf(stderr, "Failed to open device %s!\n", dev_names[i]);
+			return EOPEN;
+		}
+	}
+
+	memset(results, 0, sizeof(results));
+	while(fread_unlocked(&e, sizeof(e), 1, file) == 1) {
+		if(e.size > buf_size) {
+			buf_size = e.size;
+			data = realloc(data, buf_size);
+			buf = realloc(buf, buf_size);
+			if(data == NULL || buf == NULL) {
+				fprintf(stderr, "Out of memory!\n");
+				error = EREAD;
+				break;
+			}
+		}
+		if(e.size && fread_unlocked(data, e.size, 1, file) != 1) {
+			fprintf(stderr, "Record file is truncated!\n");
+			break;
+		}
+
+		// Recorded devices are mapped in order to the devices given, the last one takes the remaining devices
+		if(e.dev >= MAX_DEVICES) {
+			fprintf(stderr, "Recorded device %u not supported!\n", e.dev);
+			error = ESUBDEVID;
+			break;
+		}
+		if(e.op == FLINK_RECORD_OP_DEVICE) {
+			// Data holds the function id of each subdevice
+			if(e.size != e.subdev * sizeof(uint16_t) || (e.size && data == NULL)) {
+				fprintf(stderr, "Invalid device entry in record file!\n");
+				error = EREAD;
+				break;
+			}
+			recorded[e.dev] = devs[e.dev < nof_devs ? e.dev : nof_devs - 1];
+			check_device(recorded[e.dev], dev_names[e.dev < nof_devs ? e.dev : nof_devs - 1], e.dev, &e, (uint16_t*)data);
+			continue;
+		}
+		if(e.op >= FLINK_NOF_OPS || recorded[e.dev] == NULL) {
+			fprintf(stderr, "Invalid entry in record file!\n");
+			error = EREAD;
+			break;
+		}
+		subdev = e.subdev < flink_get_nof_subdevices(recorded[e.dev]) ? flink_get_subdevice_by_id(recorded[e.dev], e.subdev) : NULL;
+		if(subdev == NULL) {
+			fprintf(stderr, "Illegal subdevice id %u!\n", e.subdev);
+			error = ESUBDEVID;
+			break;
+		}
+
+		// Original timing relative to the first access, entries of several threads are not in order of their start
+		if(total == 0) {
+			first = e.time_ns;
+			start = now_ns();
+		}
+		if(speed > 0) {
+			t0 = start + (uint64_t)((e.time_ns > first ? e.time_ns - first : 0) / speed);
+			ns = now_ns();
+			if(ns < t0) sleep_until(t0);
+			else if(ns - t0 > max_late) max_late = ns - t0;
+			if(ns > t0 + 1000000) late++;
+		}
+
+		if(verbose) printf("%s subdev %u offset 0x%x size %u\n", flink_op2str(e.op), e.subdev, e.offset, e.size);
+		t0 = now_ns();
+		if(replay(subdev, &e, data, buf, compare, &mismatches) < 0) results[e.op].errors++;
+		ns = now_ns() - t0;
+		results[e.op].count++;
+		results[e.op].total_ns += ns;
+		if(ns > results[e.op].max_ns) results[e.op].max_ns = ns;
+		total++;
+	}
+	ns = total ? now_ns() - start : 0;
+	fclose(file);
+
+	// Print results
+	printf("%-12s %10s %8s %10s %10s\n", "operation", "count", "errors", "mean us", "max us");
+	for(i = 0; i < FLINK_NOF_OPS; i++) {
+		if(results[i].count == 0) continue;
+		printf("%-12s %10llu %8llu %10.2f %10.2f\n", flink_op2str(i), (unsigned long long)results[i].count,
+		       (unsigned long long)results[i].errors, results[i].total_ns / 1e3 / results[i].count, results[i].max_ns / 1e3);
+	}
+	printf("%llu accesses in %.3f s, %.0f ops/s\n", (unsigned long long)total, ns / 1e9, ns ? total * 1e9 / ns : 0.0);
+	if(speed > 0) printf("%llu accesses more than 1 ms late, at most %.3f ms\n", (unsigned long long)late, max_late / 1e6);
+	if(compare) printf("%llu reads differ from the recording\n", (unsigned long long)mismatches);
+
+	// Close flink devices
+	for(i = 0; i < (int)nof_devs; i++) flink_close(devs[i]);
+	free(data);
+	free(buf);
+
+	return error;
+}